@@ -0,0 +1,27 @@
+# micromaya-bench: timings of the core library's hot paths.
+# Run it from the repository so it finds obj_files/ and jsons/.
+QT = core
+
+TARGET = micromaya-bench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += c++1z
+CONFIG += release
+CONFIG += warn_on
+
+DEFINES += MICROMAYA_CORE
+INCLUDEPATH += ../include ../src
+DEPENDPATH += ../src
+
+LIBS += -L$$OUT_PWD/../lib -lmicromaya-core
+win32: PRE_TARGETDEPS += $$OUT_PWD/../lib/micromaya-core.lib
+else: PRE_TARGETDEPS += $$OUT_PWD/../lib/libmicromaya-core.a
+
+SOURCES += ../src/bench/main.cpp
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
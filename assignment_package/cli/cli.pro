@@ -0,0 +1,34 @@
+# micromaya-cli: batch mesh pipelines on top of the core library.
+QT = core
+
+TARGET = micromaya-cli
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += c++1z
+CONFIG += warn_on
+
+DEFINES += MICROMAYA_CORE
+INCLUDEPATH += ../include ../src
+DEPENDPATH += ../src
+
+LIBS += -L$$OUT_PWD/../lib -lmicromaya-core
+win32: PRE_TARGETDEPS += $$OUT_PWD/../lib/micromaya-core.lib
+else: PRE_TARGETDEPS += $$OUT_PWD/../lib/libmicromaya-core.a
+
+SOURCES += ../src/cli/main.cpp
+
+# Counts every allocation by subsystem, not only the tagged ones.
+heap_hooks {
+    SOURCES += ../src/profiling/heaphooks.cpp
+}
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
+address_sanitizer {
+    QMAKE_CXXFLAGS += -fsanitize=address
+    QMAKE_LFLAGS += -fsanitize=address
+}
@@ -0,0 +1,24 @@
+# The core library: meshes, skeletons, I/O and algorithms without
+# widgets or GL, for tools that run without a window.
+QT = core
+
+TARGET = micromaya-core
+TEMPLATE = lib
+CONFIG += staticlib
+CONFIG += c++1z
+CONFIG += warn_on
+DESTDIR = $$OUT_PWD/../lib
+
+DEFINES += MICROMAYA_CORE
+INCLUDEPATH += ../include
+
+include(../src/core.pri)
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
+address_sanitizer {
+    QMAKE_CXXFLAGS += -fsanitize=address
+}
@@ -13,12 +13,19 @@
 
 uniform vec3 u_CamPos;
 
+uniform bool u_SmoothNormals;           // Whether to shade with fs_SmoothNor rather than fs_Nor.
+uniform bool u_FaceColors;              // Whether to color by face attributes rather than fs_Col.
+uniform usamplerBuffer u_FaceAttribs;   // One texel per face: .r the color as RGBA8,
+                                        // .g the flags (bit 0: selected) and the material id above them.
+uniform usamplerBuffer u_TriangleFaces; // The face each triangle, gl_PrimitiveID, belongs to.
+
 // These are the interpolated values out of the rasterizer, so you can't know
 // their specific values without knowing the vertices that contributed to them
 in vec3 fs_Pos;
-in vec4 fs_Nor;
+flat in vec4 fs_Nor;
+in vec4 fs_SmoothNor;
 in vec4 fs_LightVec;
-in vec4 fs_Col;
+flat in vec4 fs_Col;
 
 out vec4 out_Col; // This is the final output color that you will see on your
                   // screen for the pixel that is currently being processed.
@@ -27,10 +34,20 @@ void main()
 {
     // Material base color (before shading)
         vec4 diffuseColor = fs_Col;
+        if (u_FaceColors) {
+            int face = int(texelFetch(u_TriangleFaces, gl_PrimitiveID).r);
+            uvec2 attribs = texelFetch(u_FaceAttribs, face).rg;
+            diffuseColor = vec4(uvec4(attribs.r, attribs.r >> 8u, attribs.r >> 16u, attribs.r >> 24u) & 255u) / 255.0;
+            if ((attribs.g & 1u) != 0u) {
+                // Lighten the selected face.
+                diffuseColor.rgb = mix(diffuseColor.rgb, vec3(1), 0.35);
+            }
+        }
 
         // Calculate the diffuse term for Lambert shading
         vec3 lightVec = normalize(u_CamPos - fs_Pos);
-        float diffuseTerm = dot(normalize(fs_Nor.xyz), normalize(lightVec));
+        vec3 normal = u_SmoothNormals ? fs_SmoothNor.xyz : fs_Nor.xyz;
+        float diffuseTerm = dot(normalize(normal), normalize(lightVec));
         // Avoid negative lighting values
         diffuseTerm = clamp(diffuseTerm, 0, 1);
 
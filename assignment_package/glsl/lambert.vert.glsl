@@ -20,6 +20,11 @@ uniform mat4 u_ViewProj;    // The matrix that defines the camera's transformati
                             // We've written a static matrix for you to use for HW2,
                             // but in HW3 you'll have to generate one yourself
 
+uniform vec3 u_PosOffset;   // Positions may be stored quantized to the bounds of the geometry,
+uniform vec3 u_PosScale;    // and are decoded as u_PosOffset + u_PosScale * vs_Pos.xyz.
+
+uniform bool u_OctNormals;  // Whether vs_Nor.xy holds an octahedral encoded normal.
+
 in vec4 vs_Pos;             // The array of vertex positions passed to the shader
 
 in vec4 vs_Nor;             // The array of vertex normals passed to the shader
@@ -27,22 +32,42 @@ in vec4 vs_Nor;             // The array of vertex normals passed to the shader
 in vec4 vs_Col;             // The array of vertex colors passed to the shader.
 
 out vec3 fs_Pos;
-out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
-out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
+flat out vec4 fs_Nor;       // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
+flat out vec4 fs_Col;       // The color of each vertex. This is implicitly passed to the fragment shader.
+                            // Both are flat: every triangle takes them from its last (provoking) vertex,
+                            // so vertices shared between faces need not agree on them.
+out vec4 fs_SmoothNor;      // The same normals interpolated across each triangle, for meshes whose
+                            // shared vertices do agree on them.
+
+// Unfolds an octahedral encoded normal onto the unit sphere.
+vec3 decodeNormal(vec4 n)
+{
+    if (!u_OctNormals) {
+        return vec3(n);
+    }
+    vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+    if (v.z < 0) {
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0 ? 1.0 : -1.0, v.y >= 0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
 
 void main()
 {
-    fs_Col = vs_Col;                         // Pass the vertex colors to the fragment shader for interpolation
+    vec4 pos = vec4(u_PosOffset + u_PosScale * vs_Pos.xyz, 1);
+
+    fs_Col = vs_Col;                         // Pass the vertex colors to the fragment shader
 
     mat3 invTranspose = mat3(u_ModelInvTr);
-    fs_Nor = vec4(invTranspose * vec3(vs_Nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
+    fs_Nor = vec4(invTranspose * decodeNormal(vs_Nor), 0);          // Pass the vertex normals to the fragment shader.
                                                             // Transform the geometry's normals by the inverse transpose of the
                                                             // model matrix. This is necessary to ensure the normals remain
                                                             // perpendicular to the surface after the surface is transformed by
                                                             // the model matrix.
+    fs_SmoothNor = fs_Nor;
 
 
-    vec4 modelposition = u_Model * vs_Pos;   // Temporarily store the transformed vertex positions for use below
+    vec4 modelposition = u_Model * pos;      // Temporarily store the transformed vertex positions for use below
     fs_Pos = modelposition.xyz;
 
     gl_Position = u_ViewProj * modelposition;// gl_Position is a built-in variable of OpenGL which is
@@ -0,0 +1,28 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// Writes what is under each pixel into the integer ID buffer:
+// .r the kind of element (see PickBuffer) and .g its index.
+
+uniform uint u_PickKind;
+uniform int u_PickMode;     // Where the index comes from: 0 u_PickIndex, 1 the face of
+                            // the triangle, 2 gl_PrimitiveID, 3 the vertex being drawn.
+uniform int u_PickIndex;
+uniform usamplerBuffer u_TriangleFaces;
+
+flat in int fs_VertexID;
+
+out uvec2 out_ID;
+
+void main()
+{
+    uint index = uint(u_PickIndex);
+    if (u_PickMode == 1) {
+        index = texelFetch(u_TriangleFaces, gl_PrimitiveID).r;
+    } else if (u_PickMode == 2) {
+        index = uint(gl_PrimitiveID);
+    } else if (u_PickMode == 3) {
+        index = uint(fs_VertexID);
+    }
+    out_ID = uvec2(u_PickKind, index);
+}
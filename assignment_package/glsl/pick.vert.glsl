@@ -0,0 +1,42 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// Places geometry for the ID pass. Refer to the lambert and skelaton
+// shader files for useful comments.
+
+uniform mat4 u_Model;
+uniform mat4 u_ViewProj;
+
+uniform vec3 u_PosOffset;
+uniform vec3 u_PosScale;
+
+uniform bool u_Skinned;     // Whether to deform by the joint palette, as the skelaton shader does.
+uniform samplerBuffer u_JointPalette;
+uniform int u_JointCount;
+
+in vec4 vs_Pos;
+in vec2 jointWts;
+in ivec2 jointIDs;
+
+flat out int fs_VertexID;   // Names the vertex when points are drawn.
+
+mat4 jointMat(int id)
+{
+    int base = id * 4;
+    return mat4(texelFetch(u_JointPalette, base),
+                texelFetch(u_JointPalette, base + 1),
+                texelFetch(u_JointPalette, base + 2),
+                texelFetch(u_JointPalette, base + 3));
+}
+
+void main()
+{
+    fs_VertexID = gl_VertexID;
+
+    vec4 pos = vec4(u_PosOffset + u_PosScale * vs_Pos.xyz, 1);
+    if (u_Skinned) {
+        pos = (jointMat(jointIDs[0]) * pos) * jointWts[0] + (jointMat(jointIDs[1]) * pos) * jointWts[1];
+    }
+
+    gl_Position = u_ViewProj * (u_Model * pos);
+}
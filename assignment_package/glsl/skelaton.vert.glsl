@@ -20,11 +20,19 @@ uniform mat4 u_ViewProj;    // The matrix that defines the camera's transformati
                             // We've written a static matrix for you to use for HW2,
                             // but in HW3 you'll have to generate one yourself
 
-uniform mat4[30] bindMats;              // The bind matrices of all skelaton joints.
-uniform mat4[30] overallTMats;          // The overall transformations of each joint when bound.
+uniform vec3 u_PosOffset;   // Positions may be stored quantized to the bounds of the geometry,
+uniform vec3 u_PosScale;    // and are decoded as u_PosOffset + u_PosScale * vs_Pos.xyz.
+
+uniform bool u_OctNormals;  // Whether vs_Nor.xy holds an octahedral encoded normal.
+
+uniform samplerBuffer u_JointPalette;   // The skinning matrix (overall transformation * bind matrix)
+                                        // of every joint, stored as four RGBA32F texels (columns) per joint.
+                                        // Instanced draws store one full palette per instance, one after another.
+
+uniform int u_JointCount;   // The number of joints in one instance's palette.
 
 in vec2 jointWts;
-in ivec2 jointIDs;          // Used to index joint bind & overall transform matrices.
+in ivec2 jointIDs;          // Used to index the joint palette.
 
 in vec4 vs_Pos;             // The array of vertex positions passed to the shader
 
@@ -33,31 +41,51 @@ in vec4 vs_Nor;             // The array of vertex normals passed to the shader
 in vec4 vs_Col;             // The array of vertex colors passed to the shader.
 
 out vec3 fs_Pos;
-out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
-out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
+flat out vec4 fs_Nor;       // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
+flat out vec4 fs_Col;       // The color of each vertex. This is implicitly passed to the fragment shader.
+                            // Both are flat: every triangle takes them from its last (provoking) vertex,
+                            // so vertices shared between faces need not agree on them.
+out vec4 fs_SmoothNor;      // The same normals interpolated across each triangle, for meshes whose
+                            // shared vertices do agree on them.
+
+mat4 jointMat(int id)
+{
+    int base = (gl_InstanceID * u_JointCount + id) * 4;
+    return mat4(texelFetch(u_JointPalette, base),
+                texelFetch(u_JointPalette, base + 1),
+                texelFetch(u_JointPalette, base + 2),
+                texelFetch(u_JointPalette, base + 3));
+}
+
+// Unfolds an octahedral encoded normal onto the unit sphere.
+vec3 decodeNormal(vec4 n)
+{
+    if (!u_OctNormals) {
+        return vec3(n);
+    }
+    vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+    if (v.z < 0) {
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0 ? 1.0 : -1.0, v.y >= 0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
 
 void main()
 {
-    fs_Col = vs_Col;                         // Pass the vertex colors to the fragment shader for interpolation
+    vec4 pos = vec4(u_PosOffset + u_PosScale * vs_Pos.xyz, 1);
+
+    fs_Col = vs_Col;                         // Pass the vertex colors to the fragment shader
 
     mat3 invTranspose = mat3(u_ModelInvTr);
-    fs_Nor = vec4(invTranspose * vec3(vs_Nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
+    fs_Nor = vec4(invTranspose * decodeNormal(vs_Nor), 0);          // Pass the vertex normals to the fragment shader.
                                                             // Transform the geometry's normals by the inverse transpose of the
                                                             // model matrix. This is necessary to ensure the normals remain
                                                             // perpendicular to the surface after the surface is transformed by
                                                             // the model matrix.
+    fs_SmoothNor = fs_Nor;
 
-    mat4 bind1 = bindMats[jointIDs[0]];
-    mat4 bind2 = bindMats[jointIDs[1]];
-
-    mat4 currT1 = overallTMats[jointIDs[0]];
-    mat4 currT2 = overallTMats[jointIDs[1]];
-
-//    vec4 joint1WorldPos = currT1 * bind1 * vs_Pos;
-//    vec4 joint2WorldPos = currT2 * bind2 * vs_Pos;
-
-    vec4 joint1WorldPos = currT1 * bind1 * vs_Pos;
-    vec4 joint2WorldPos = currT2 * bind2 * vs_Pos;
+    vec4 joint1WorldPos = jointMat(jointIDs[0]) * pos;
+    vec4 joint2WorldPos = jointMat(jointIDs[1]) * pos;
 
     vec4 weightedJointPos = joint1WorldPos * jointWts[0] + joint2WorldPos * jointWts[1];
 
@@ -0,0 +1,9 @@
+# Builds the core library, the command line tool, the benchmarks
+# and the GUI.
+# halfEdge.pro still builds the GUI on its own.
+TEMPLATE = subdirs
+
+SUBDIRS = core cli bench app
+app.file = halfEdge.pro
+cli.depends = core
+bench.depends = core
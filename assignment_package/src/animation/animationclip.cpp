@@ -0,0 +1,390 @@
+#include "animationclip.h"
+#include <algorithm>
+#include <cmath>
+
+//--------------------------------------------------
+// PoseSoA
+//--------------------------------------------------
+void PoseSoA::resize(size_t jointCount) {
+    rx.assign(jointCount, 0.f);
+    ry.assign(jointCount, 0.f);
+    rz.assign(jointCount, 0.f);
+    rw.assign(jointCount, 1.f);
+    tx.assign(jointCount, 0.f);
+    ty.assign(jointCount, 0.f);
+    tz.assign(jointCount, 0.f);
+}
+
+size_t PoseSoA::size() const {
+    return rw.size();
+}
+
+glm::quat PoseSoA::rotation(size_t j) const {
+    return glm::quat(rw[j], rx[j], ry[j], rz[j]);
+}
+
+glm::vec3 PoseSoA::translation(size_t j) const {
+    return glm::vec3(tx[j], ty[j], tz[j]);
+}
+
+void PoseSoA::setRotation(size_t j, const glm::quat &q) {
+    rx[j] = q.x;
+    ry[j] = q.y;
+    rz[j] = q.z;
+    rw[j] = q.w;
+}
+
+void PoseSoA::setTranslation(size_t j, const glm::vec3 &t) {
+    tx[j] = t.x;
+    ty[j] = t.y;
+    tz[j] = t.z;
+}
+
+void SampleCursor::reset(size_t jointCount) {
+    rot.assign(jointCount, 0);
+    pos.assign(jointCount, 0);
+}
+
+//--------------------------------------------------
+// AnimationClip
+//--------------------------------------------------
+AnimationClip::AnimationClip(size_t jointCount)
+    : rotTracks(jointCount), posTracks(jointCount),
+      interp(Interpolation::LINEAR), length(0.f)
+{}
+
+// Inserts key k at time t into a sorted track,
+// replacing any key already at that time.
+template<typename T>
+static void insertKey(std::vector<float> &times, std::vector<T> &keys, float t, const T &k) {
+    auto it = std::lower_bound(times.begin(), times.end(), t);
+    size_t i = it - times.begin();
+    if (it != times.end() && *it == t) {
+        keys[i] = k;
+        return;
+    }
+    times.insert(it, t);
+    keys.insert(keys.begin() + i, k);
+}
+
+void AnimationClip::setRotationKey(size_t joint, float t, const glm::quat &q) {
+    insertKey(rotTracks[joint].times, rotTracks[joint].keys, t, q);
+    length = std::max(length, t);
+}
+
+void AnimationClip::setTranslationKey(size_t joint, float t, const glm::vec3 &p) {
+    insertKey(posTracks[joint].times, posTracks[joint].keys, t, p);
+    length = std::max(length, t);
+}
+
+void AnimationClip::appendRotationKey(size_t joint, float t, const glm::quat &q) {
+    rotTracks[joint].times.push_back(t);
+    rotTracks[joint].keys.push_back(q);
+    length = std::max(length, t);
+}
+
+void AnimationClip::appendTranslationKey(size_t joint, float t, const glm::vec3 &p) {
+    posTracks[joint].times.push_back(t);
+    posTracks[joint].keys.push_back(p);
+    length = std::max(length, t);
+}
+
+void AnimationClip::setInterpolation(Interpolation i) {
+    interp = i;
+}
+
+Interpolation AnimationClip::interpolation() const {
+    return interp;
+}
+
+const RotationTrack& AnimationClip::rotationTrack(size_t joint) const {
+    return rotTracks[joint];
+}
+
+const TranslationTrack& AnimationClip::translationTrack(size_t joint) const {
+    return posTracks[joint];
+}
+
+size_t AnimationClip::keyCount() const {
+    size_t n = 0;
+    for (size_t j = 0; j < rotTracks.size(); j++) {
+        n += rotTracks[j].keys.size() + posTracks[j].keys.size();
+    }
+    return n;
+}
+
+float AnimationClip::duration() const {
+    return length;
+}
+
+size_t AnimationClip::jointCount() const {
+    return rotTracks.size();
+}
+
+uint32_t findSegment(const std::vector<float> &times, float t, uint32_t hint) {
+    uint32_t last = times.size() < 2 ? 0 : times.size() - 2;
+    if (hint > last) {
+        hint = last;
+    }
+    // Playback usually stays in the same segment or moves to the next one.
+    if (times[hint] <= t) {
+        if (hint == last || t < times[hint + 1]) {
+            return hint;
+        }
+        if (hint + 1 == last || t < times[hint + 2]) {
+            return hint + 1;
+        }
+    }
+    auto it = std::upper_bound(times.begin(), times.end(), t);
+    if (it == times.begin()) {
+        return 0;
+    }
+    return std::min<uint32_t>(it - times.begin() - 1, last);
+}
+
+// Returns the four keys around the segment starting at key k,
+// clamped to the ends of the track.
+static void segmentKeys(size_t count, uint32_t k, uint32_t idx[4]) {
+    uint32_t last = count - 1;
+    idx[1] = std::min(k, last);
+    idx[0] = idx[1] == 0 ? 0 : idx[1] - 1;
+    idx[2] = std::min(idx[1] + 1, last);
+    idx[3] = std::min(idx[2] + 1, last);
+}
+
+void AnimationClip::sample(float t, PoseSoA &pose, SampleCursor &cursor,
+                           SampleScratch &scratch) const {
+    size_t joints = rotTracks.size();
+    blend::reserve(scratch, joints);
+    bool cubic = interp == Interpolation::CUBIC;
+    uint32_t idx[4];
+    float times[4];
+
+    // Rotations. Gather each joint's segment into the scratch lanes,
+    // then blend every lane at once.
+    scratch.rotJoints.clear();
+    for (size_t j = 0; j < joints; j++) {
+        const RotationTrack &tr = rotTracks[j];
+        if (tr.keys.empty()) {
+            continue;
+        }
+        cursor.rot[j] = findSegment(tr.times, t, cursor.rot[j]);
+        segmentKeys(tr.keys.size(), cursor.rot[j], idx);
+        glm::quat keys[4];
+        for (int c = 0; c < 4; c++) {
+            keys[c] = tr.keys[idx[c]];
+            times[c] = tr.times[idx[c]];
+        }
+        blend::gatherRotation(scratch, scratch.rotJoints.size(), keys, times, t, cubic);
+        scratch.rotJoints.push_back(j);
+    }
+    size_t n = scratch.rotJoints.size();
+    if (cubic) {
+        blend::hermite(scratch, n, true);
+    } else {
+        blend::slerp(scratch, n);
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint32_t j = scratch.rotJoints[i];
+        pose.rx[j] = scratch.ax[i];
+        pose.ry[j] = scratch.ay[i];
+        pose.rz[j] = scratch.az[i];
+        pose.rw[j] = scratch.aw[i];
+    }
+
+    // Translations.
+    scratch.posJoints.clear();
+    for (size_t j = 0; j < joints; j++) {
+        const TranslationTrack &tr = posTracks[j];
+        if (tr.keys.empty()) {
+            continue;
+        }
+        cursor.pos[j] = findSegment(tr.times, t, cursor.pos[j]);
+        segmentKeys(tr.keys.size(), cursor.pos[j], idx);
+        glm::vec3 keys[4];
+        for (int c = 0; c < 4; c++) {
+            keys[c] = tr.keys[idx[c]];
+            times[c] = tr.times[idx[c]];
+        }
+        blend::gatherTranslation(scratch, scratch.posJoints.size(), keys, times, t, cubic);
+        scratch.posJoints.push_back(j);
+    }
+    n = scratch.posJoints.size();
+    if (cubic) {
+        blend::hermite(scratch, n, false);
+    } else {
+        blend::lerp(scratch, n);
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint32_t j = scratch.posJoints[i];
+        pose.tx[j] = scratch.ax[i];
+        pose.ty[j] = scratch.ay[i];
+        pose.tz[j] = scratch.az[i];
+    }
+}
+
+//--------------------------------------------------
+// Gathering
+//--------------------------------------------------
+void blend::reserve(SampleScratch &s, size_t n) {
+    for (auto *v : {&s.ax, &s.ay, &s.az, &s.aw, &s.bx, &s.by, &s.bz, &s.bw,
+                    &s.max, &s.may, &s.maz, &s.maw, &s.mbx, &s.mby, &s.mbz, &s.mbw,
+                    &s.alpha}) {
+        if (v->size() < n) {
+            v->resize(n);
+        }
+    }
+}
+
+// Returns the blend factor of t between times[1] and times[2].
+static float segmentAlpha(const float times[4], float t) {
+    float dt = times[2] - times[1];
+    float a = dt > 0.f ? (t - times[1]) / dt : 0.f;
+    return glm::clamp(a, 0.f, 1.f);
+}
+
+// Catmull-Rom tangents at both ends of the segment,
+// scaled to the segment's duration.
+template<typename T>
+static void segmentTangents(const T keys[4], const float times[4], T &ma, T &mb) {
+    float dt = times[2] - times[1];
+    float spanA = times[2] - times[0];
+    float spanB = times[3] - times[1];
+    ma = spanA > 0.f ? (keys[2] - keys[0]) * (dt / spanA) : T(0.f);
+    mb = spanB > 0.f ? (keys[3] - keys[1]) * (dt / spanB) : T(0.f);
+}
+
+void blend::gatherRotation(SampleScratch &s, size_t i, const glm::quat keys[4],
+                           const float times[4], float t, bool cubic) {
+    const glm::quat &a = keys[1];
+    s.ax[i] = a.x; s.ay[i] = a.y; s.az[i] = a.z; s.aw[i] = a.w;
+    s.alpha[i] = segmentAlpha(times, t);
+
+    if (!cubic) {
+        // The slerp kernel picks the short way around itself.
+        const glm::quat &b = keys[2];
+        s.bx[i] = b.x; s.by[i] = b.y; s.bz[i] = b.z; s.bw[i] = b.w;
+        return;
+    }
+
+    // Flip every key into the same hemisphere as its predecessor
+    // so the spline does not take the long way around.
+    glm::vec4 k[4];
+    k[1] = glm::vec4(a.x, a.y, a.z, a.w);
+    for (int c : {0, 2}) {
+        k[c] = glm::vec4(keys[c].x, keys[c].y, keys[c].z, keys[c].w);
+        if (glm::dot(k[1], k[c]) < 0.f) {
+            k[c] = -k[c];
+        }
+    }
+    k[3] = glm::vec4(keys[3].x, keys[3].y, keys[3].z, keys[3].w);
+    if (glm::dot(k[2], k[3]) < 0.f) {
+        k[3] = -k[3];
+    }
+
+    glm::vec4 ma, mb;
+    segmentTangents(k, times, ma, mb);
+    s.bx[i] = k[2].x; s.by[i] = k[2].y; s.bz[i] = k[2].z; s.bw[i] = k[2].w;
+    s.max[i] = ma.x; s.may[i] = ma.y; s.maz[i] = ma.z; s.maw[i] = ma.w;
+    s.mbx[i] = mb.x; s.mby[i] = mb.y; s.mbz[i] = mb.z; s.mbw[i] = mb.w;
+}
+
+void blend::gatherTranslation(SampleScratch &s, size_t i, const glm::vec3 keys[4],
+                              const float times[4], float t, bool cubic) {
+    const glm::vec3 &a = keys[1];
+    const glm::vec3 &b = keys[2];
+    s.ax[i] = a.x; s.ay[i] = a.y; s.az[i] = a.z;
+    s.bx[i] = b.x; s.by[i] = b.y; s.bz[i] = b.z;
+    s.alpha[i] = segmentAlpha(times, t);
+
+    if (cubic) {
+        glm::vec3 ma, mb;
+        segmentTangents(keys, times, ma, mb);
+        s.max[i] = ma.x; s.may[i] = ma.y; s.maz[i] = ma.z;
+        s.mbx[i] = mb.x; s.mby[i] = mb.y; s.mbz[i] = mb.z;
+    }
+}
+
+//--------------------------------------------------
+// Blend kernels
+//--------------------------------------------------
+void blend::slerp(SampleScratch &s, size_t n) {
+    float* ax = s.ax.data(); float* ay = s.ay.data(); float* az = s.az.data(); float* aw = s.aw.data();
+    const float* bx = s.bx.data(); const float* by = s.by.data(); const float* bz = s.bz.data(); const float* bw = s.bw.data();
+    const float* alpha = s.alpha.data();
+
+    for (size_t i = 0; i < n; i++) {
+        float d = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i] + aw[i] * bw[i];
+        // Take the short way around.
+        float sign = d < 0.f ? -1.f : 1.f;
+        d *= sign;
+
+        // Nearly parallel quaternions fall back to a linear blend
+        // to avoid dividing by sin(theta) ~ 0.
+        float theta = std::acos(std::min(d, 1.f));
+        float sinTheta = std::sin(theta);
+        bool nearlyParallel = d > 0.9995f;
+        float wa = nearlyParallel ? 1.f - alpha[i] : std::sin((1.f - alpha[i]) * theta) / sinTheta;
+        float wb = nearlyParallel ? alpha[i] : std::sin(alpha[i] * theta) / sinTheta;
+        wb *= sign;
+
+        float x = wa * ax[i] + wb * bx[i];
+        float y = wa * ay[i] + wb * by[i];
+        float z = wa * az[i] + wb * bz[i];
+        float w = wa * aw[i] + wb * bw[i];
+        float invLen = 1.f / std::sqrt(x * x + y * y + z * z + w * w);
+        ax[i] = x * invLen;
+        ay[i] = y * invLen;
+        az[i] = z * invLen;
+        aw[i] = w * invLen;
+    }
+}
+
+void blend::lerp(SampleScratch &s, size_t n) {
+    float* ax = s.ax.data(); float* ay = s.ay.data(); float* az = s.az.data();
+    const float* bx = s.bx.data(); const float* by = s.by.data(); const float* bz = s.bz.data();
+    const float* alpha = s.alpha.data();
+
+    for (size_t i = 0; i < n; i++) {
+        ax[i] += (bx[i] - ax[i]) * alpha[i];
+        ay[i] += (by[i] - ay[i]) * alpha[i];
+        az[i] += (bz[i] - az[i]) * alpha[i];
+    }
+}
+
+void blend::hermite(SampleScratch &s, size_t n, bool quaternion) {
+    float* a[4] = {s.ax.data(), s.ay.data(), s.az.data(), s.aw.data()};
+    const float* b[4] = {s.bx.data(), s.by.data(), s.bz.data(), s.bw.data()};
+    const float* ma[4] = {s.max.data(), s.may.data(), s.maz.data(), s.maw.data()};
+    const float* mb[4] = {s.mbx.data(), s.mby.data(), s.mbz.data(), s.mbw.data()};
+    const float* alpha = s.alpha.data();
+    int count = quaternion ? 4 : 3;
+
+    for (int c = 0; c < count; c++) {
+        float* ac = a[c];
+        const float* bc = b[c];
+        const float* mac = ma[c];
+        const float* mbc = mb[c];
+        for (size_t i = 0; i < n; i++) {
+            float u = alpha[i];
+            float u2 = u * u;
+            float u3 = u2 * u;
+            float h00 = 2.f * u3 - 3.f * u2 + 1.f;
+            float h10 = u3 - 2.f * u2 + u;
+            float h01 = -2.f * u3 + 3.f * u2;
+            float h11 = u3 - u2;
+            ac[i] = h00 * ac[i] + h10 * mac[i] + h01 * bc[i] + h11 * mbc[i];
+        }
+    }
+
+    if (quaternion) {
+        for (size_t i = 0; i < n; i++) {
+            float invLen = 1.f / std::sqrt(a[0][i] * a[0][i] + a[1][i] * a[1][i] +
+                                           a[2][i] * a[2][i] + a[3][i] * a[3][i]);
+            a[0][i] *= invLen;
+            a[1][i] *= invLen;
+            a[2][i] *= invLen;
+            a[3][i] *= invLen;
+        }
+    }
+}
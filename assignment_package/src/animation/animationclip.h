@@ -0,0 +1,141 @@
+#ifndef ANIMATIONCLIP_H
+#define ANIMATIONCLIP_H
+
+#include "la.h"
+#include <glm/gtc/quaternion.hpp>
+#include <cstdint>
+#include <vector>
+
+// How a clip fills in the pose between two keyframes.
+enum class Interpolation {
+    LINEAR, // Quaternion slerp for rotations, lerp for translations.
+    CUBIC   // Hermite splines with Catmull-Rom tangents.
+};
+
+// The local rotation and translation of every joint of a rig,
+// stored as a structure of arrays indexed by joint id so a
+// whole rig can be blended in a single loop per component.
+struct PoseSoA {
+    std::vector<float> rx, ry, rz, rw;
+    std::vector<float> tx, ty, tz;
+
+    void resize(size_t jointCount);
+    size_t size() const;
+
+    glm::quat rotation(size_t j) const;
+    glm::vec3 translation(size_t j) const;
+    void setRotation(size_t j, const glm::quat &q);
+    void setTranslation(size_t j, const glm::vec3 &t);
+};
+
+// Per-joint key search positions that persist between samples.
+// Playback moves forward in small steps, so starting the search
+// from the previous key makes locating a segment O(1) amortized.
+struct SampleCursor {
+    std::vector<uint32_t> rot;
+    std::vector<uint32_t> pos;
+
+    void reset(size_t jointCount);
+};
+
+struct RotationTrack {
+    std::vector<float> times;
+    std::vector<glm::quat> keys;
+};
+
+struct TranslationTrack {
+    std::vector<float> times;
+    std::vector<glm::vec3> keys;
+};
+
+// Scratch space shared by the gather and blend passes of a sample.
+// Kept between samples so sampling a clip does not allocate.
+struct SampleScratch {
+    // Joint ids that have a rotation / translation track.
+    std::vector<uint32_t> rotJoints, posJoints;
+    // Segment endpoints, tangents and blend factors, one lane per joint.
+    std::vector<float> ax, ay, az, aw, bx, by, bz, bw;
+    std::vector<float> max, may, maz, maw, mbx, mby, mbz, mbw;
+    std::vector<float> alpha;
+};
+
+// Anything that can write a rig pose for a point in time.
+// AnimationPlayer only sees this interface, so raw and
+// compressed clips are played back the same way.
+class ClipSource {
+public:
+    virtual ~ClipSource() {}
+
+    virtual float duration() const = 0;
+    virtual size_t jointCount() const = 0;
+    // Overwrites the pose of every joint that has a track.
+    // Joints without keys keep the values already in pose.
+    virtual void sample(float t, PoseSoA &pose, SampleCursor &cursor,
+                        SampleScratch &scratch) const = 0;
+};
+
+// A keyframed animation of a rig. Every joint may have its own
+// rotation and translation keys at arbitrary times.
+class AnimationClip : public ClipSource {
+private:
+    std::vector<RotationTrack> rotTracks;
+    std::vector<TranslationTrack> posTracks;
+    Interpolation interp;
+    float length;
+
+    friend class ClipCompressor;
+
+public:
+    AnimationClip(size_t jointCount = 0);
+
+    // Inserts or replaces the keys of one joint at time t.
+    // Keys are kept sorted by time.
+    void setRotationKey(size_t joint, float t, const glm::quat &q);
+    void setTranslationKey(size_t joint, float t, const glm::vec3 &p);
+    // Appends keys at the end of a joint's tracks.
+    // Times must not decrease; used by importers that stream frames in order.
+    void appendRotationKey(size_t joint, float t, const glm::quat &q);
+    void appendTranslationKey(size_t joint, float t, const glm::vec3 &p);
+
+    void setInterpolation(Interpolation i);
+    Interpolation interpolation() const;
+
+    const RotationTrack& rotationTrack(size_t joint) const;
+    const TranslationTrack& translationTrack(size_t joint) const;
+    size_t keyCount() const;
+
+    float duration() const override;
+    size_t jointCount() const override;
+    void sample(float t, PoseSoA &pose, SampleCursor &cursor,
+                SampleScratch &scratch) const override;
+};
+
+// Blend kernels over the structure-of-arrays lanes of a SampleScratch.
+// Results are written back to the a lanes. Each iteration is
+// independent and branch-free so the loops vectorize across joints.
+namespace blend {
+    // Spherical interpolation of quaternions from a to b by alpha.
+    void slerp(SampleScratch &s, size_t n);
+    // Linear interpolation of the xyz lanes from a to b by alpha.
+    void lerp(SampleScratch &s, size_t n);
+    // Cubic Hermite interpolation from a to b with tangents ma and mb.
+    // Quaternion results are renormalized.
+    void hermite(SampleScratch &s, size_t n, bool quaternion);
+
+    // Write one joint's segment into lane i of the scratch space.
+    // keys and times hold the key before the segment, its two ends and
+    // the key after it, clamped to the ends of the track.
+    void gatherRotation(SampleScratch &s, size_t i, const glm::quat keys[4],
+                        const float times[4], float t, bool cubic);
+    void gatherTranslation(SampleScratch &s, size_t i, const glm::vec3 keys[4],
+                           const float times[4], float t, bool cubic);
+    // Grows the scratch lanes to hold at least n joints.
+    void reserve(SampleScratch &s, size_t n);
+}
+
+// Finds the key segment containing t, starting from hint.
+// Returns the index k of the segment's first key
+// (times[k] <= t < times[k + 1]), clamped to the valid range.
+uint32_t findSegment(const std::vector<float> &times, float t, uint32_t hint);
+
+#endif // ANIMATIONCLIP_H
@@ -0,0 +1,101 @@
+#include "animationplayer.h"
+#include <cmath>
+
+AnimationPlayer::AnimationPlayer()
+    : clip(nullptr), time(0.f), playing(false), looping(true),
+      lastTick(), pose(), cursor(), scratch(),
+      lastSampleNs(0.0), avgSampleNs(0.0)
+{}
+
+void AnimationPlayer::setClip(const ClipSource* c, const PoseSoA &restPose) {
+    clip = c;
+    pose = restPose;
+    cursor.reset(restPose.size());
+    time = 0.f;
+    avgSampleNs = 0.0;
+}
+
+const ClipSource* AnimationPlayer::getClip() const {
+    return clip;
+}
+
+void AnimationPlayer::play() {
+    if (clip == nullptr) {
+        return;
+    }
+    playing = true;
+    lastTick = std::chrono::steady_clock::now();
+}
+
+void AnimationPlayer::stop() {
+    playing = false;
+}
+
+bool AnimationPlayer::isPlaying() const {
+    return playing;
+}
+
+void AnimationPlayer::setLooping(bool loop) {
+    looping = loop;
+}
+
+void AnimationPlayer::seek(float t) {
+    if (clip == nullptr) {
+        return;
+    }
+    time = t;
+    samplePose();
+}
+
+bool AnimationPlayer::tick() {
+    if (!playing || clip == nullptr) {
+        return false;
+    }
+    auto now = std::chrono::steady_clock::now();
+    time += std::chrono::duration<float>(now - lastTick).count();
+    lastTick = now;
+
+    float length = clip->duration();
+    if (time > length) {
+        if (looping && length > 0.f) {
+            time = std::fmod(time, length);
+        } else {
+            time = length;
+            playing = false;
+        }
+    }
+
+    samplePose();
+    return true;
+}
+
+float AnimationPlayer::currentTime() const {
+    return time;
+}
+
+const PoseSoA& AnimationPlayer::currentPose() const {
+    return pose;
+}
+
+double AnimationPlayer::lastSampleTimeNs() const {
+    return lastSampleNs;
+}
+
+double AnimationPlayer::averageSampleTimeNs() const {
+    return avgSampleNs;
+}
+
+void AnimationPlayer::samplePose() {
+    if (pose.size() < clip->jointCount()) {
+        pose.resize(clip->jointCount());
+        cursor.reset(clip->jointCount());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    clip->sample(time, pose, cursor, scratch);
+    auto end = std::chrono::steady_clock::now();
+
+    lastSampleNs = std::chrono::duration<double, std::nano>(end - start).count();
+    avgSampleNs = avgSampleNs == 0.0 ? lastSampleNs
+                                     : avgSampleNs * 0.95 + lastSampleNs * 0.05;
+}
@@ -0,0 +1,57 @@
+#ifndef ANIMATIONPLAYER_H
+#define ANIMATIONPLAYER_H
+
+#include "animation/animationclip.h"
+#include <chrono>
+
+// Advances a clip in wall-clock time and samples it into a pose.
+// Driven by a steady timer, but the playhead follows the real
+// elapsed time so late ticks never slow the animation down.
+class AnimationPlayer {
+private:
+    const ClipSource* clip;
+    float time;
+    bool playing;
+    bool looping;
+    std::chrono::steady_clock::time_point lastTick;
+
+    PoseSoA pose;
+    SampleCursor cursor;
+    SampleScratch scratch;
+
+    // Sampling cost of the most recent frame
+    // and an exponential moving average over recent frames.
+    double lastSampleNs;
+    double avgSampleNs;
+
+public:
+    AnimationPlayer();
+
+    // Sets the clip to play and the rest pose used
+    // for joints that the clip has no keys for.
+    void setClip(const ClipSource* c, const PoseSoA &restPose);
+    const ClipSource* getClip() const;
+
+    void play();
+    void stop();
+    bool isPlaying() const;
+    void setLooping(bool loop);
+
+    // Moves the playhead to t and samples the pose there.
+    void seek(float t);
+    // Advances the playhead by the time elapsed since the
+    // previous tick and samples the pose.
+    // Returns false if nothing is playing.
+    bool tick();
+
+    float currentTime() const;
+    const PoseSoA& currentPose() const;
+
+    double lastSampleTimeNs() const;
+    double averageSampleTimeNs() const;
+
+private:
+    void samplePose();
+};
+
+#endif // ANIMATIONPLAYER_H
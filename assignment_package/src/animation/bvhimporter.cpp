@@ -0,0 +1,318 @@
+#include "bvhimporter.h"
+#include "parsenumber.h"
+#include <glm/gtc/quaternion.hpp>
+#include <sstream>
+
+// Frames parsed before they are handed to the clip in one locked append.
+static const size_t FRAME_BATCH = 64;
+
+// Reads the next whitespace-separated token as a float, through the
+// same parser as the frame values so neither depends on the locale.
+static bool readFloat(std::istream &in, float &out) {
+    std::string token;
+    if (!(in >> token)) {
+        return false;
+    }
+    const char* end = token.data() + token.size();
+    return parseFloat(token.data(), end, out) == end;
+}
+
+//--------------------------------------------------
+// StreamingClip
+//--------------------------------------------------
+StreamingClip::StreamingClip(size_t jointCount)
+    : lock(), clip(jointCount)
+{}
+
+void StreamingClip::appendFrames(const std::vector<float> &times,
+                                 const std::vector<glm::quat> &rotations,
+                                 const std::vector<glm::vec3> &translations,
+                                 const std::vector<bool> &hasRotation,
+                                 const std::vector<bool> &hasTranslation) {
+    size_t joints = clip.jointCount();
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t f = 0; f < times.size(); f++) {
+        for (size_t j = 0; j < joints; j++) {
+            if (hasRotation[j]) {
+                clip.appendRotationKey(j, times[f], rotations[f * joints + j]);
+            }
+            if (hasTranslation[j]) {
+                clip.appendTranslationKey(j, times[f], translations[f * joints + j]);
+            }
+        }
+    }
+}
+
+void StreamingClip::setInterpolation(Interpolation i) {
+    std::lock_guard<std::mutex> guard(lock);
+    clip.setInterpolation(i);
+}
+
+const AnimationClip& StreamingClip::finishedClip() const {
+    return clip;
+}
+
+float StreamingClip::duration() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return clip.duration();
+}
+
+size_t StreamingClip::jointCount() const {
+    return clip.jointCount();
+}
+
+void StreamingClip::sample(float t, PoseSoA &pose, SampleCursor &cursor,
+                           SampleScratch &scratch) const {
+    std::lock_guard<std::mutex> guard(lock);
+    clip.sample(t, pose, cursor, scratch);
+}
+
+//--------------------------------------------------
+// BvhImporter
+//--------------------------------------------------
+BvhImporter::BvhImporter()
+    : file(), bvhJoints(), channelCount(0), totalFrames(0), frameTime(0.f),
+      streamClip(nullptr), worker(), loadedFrames(0), done(false), cancelled(false),
+      errorMessage()
+{}
+
+BvhImporter::~BvhImporter() {
+    cancel();
+}
+
+bool BvhImporter::open(const std::string &path) {
+    file.open(path);
+    if (!file.is_open()) {
+        errorMessage = "Cannot open " + path;
+        return false;
+    }
+    if (!readHierarchy()) {
+        return false;
+    }
+    streamClip = std::make_unique<StreamingClip>(bvhJoints.size());
+    return true;
+}
+
+void BvhImporter::start() {
+    if (streamClip == nullptr || worker.joinable()) {
+        return;
+    }
+    worker = std::thread(&BvhImporter::readMotion, this);
+}
+
+void BvhImporter::cancel() {
+    cancelled = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+const std::vector<BvhJoint>& BvhImporter::joints() const {
+    return bvhJoints;
+}
+
+StreamingClip* BvhImporter::clip() {
+    return streamClip.get();
+}
+
+float BvhImporter::frameRate() const {
+    return frameTime > 0.f ? 1.f / frameTime : 0.f;
+}
+
+size_t BvhImporter::frameCount() const {
+    return totalFrames;
+}
+
+size_t BvhImporter::framesLoaded() const {
+    return loadedFrames;
+}
+
+bool BvhImporter::finished() const {
+    return done;
+}
+
+const std::string& BvhImporter::error() const {
+    return errorMessage;
+}
+
+bool BvhImporter::readHierarchy() {
+    std::string token;
+    if (!(file >> token) || token != "HIERARCHY") {
+        errorMessage = "Missing HIERARCHY";
+        return false;
+    }
+
+    // Index of the joint whose braces we are inside.
+    std::vector<int> stack;
+    int pending = -1; // Joint declared but whose '{' is not read yet.
+
+    while (file >> token) {
+        if (token == "ROOT" || token == "JOINT" || token == "End") {
+            BvhJoint j;
+            j.parent = stack.empty() ? -1 : stack.back();
+            j.offset = glm::vec3(0.f);
+            j.firstChannel = channelCount;
+            std::string name;
+            file >> name;
+            if (token == "End") {
+                // "End Site": named after its parent.
+                name = (j.parent >= 0 ? bvhJoints[j.parent].name : std::string()) + "_End";
+            }
+            j.name = name;
+            bvhJoints.push_back(j);
+            pending = bvhJoints.size() - 1;
+        } else if (token == "{") {
+            if (pending < 0) {
+                errorMessage = "Unexpected {";
+                return false;
+            }
+            stack.push_back(pending);
+            pending = -1;
+        } else if (token == "}") {
+            if (stack.empty()) {
+                errorMessage = "Unbalanced }";
+                return false;
+            }
+            stack.pop_back();
+        } else if (token == "OFFSET") {
+            if (stack.empty()) {
+                errorMessage = "OFFSET outside a joint";
+                return false;
+            }
+            glm::vec3 &o = bvhJoints[stack.back()].offset;
+            if (!readFloat(file, o.x) || !readFloat(file, o.y) || !readFloat(file, o.z)) {
+                errorMessage = "Malformed OFFSET";
+                return false;
+            }
+        } else if (token == "CHANNELS") {
+            if (stack.empty()) {
+                errorMessage = "CHANNELS outside a joint";
+                return false;
+            }
+            BvhJoint &j = bvhJoints[stack.back()];
+            int n = 0;
+            file >> n;
+            j.firstChannel = channelCount;
+            for (int i = 0; i < n; i++) {
+                std::string c;
+                file >> c;
+                if      (c == "Xposition") j.channels.push_back(BvhJoint::XPOS);
+                else if (c == "Yposition") j.channels.push_back(BvhJoint::YPOS);
+                else if (c == "Zposition") j.channels.push_back(BvhJoint::ZPOS);
+                else if (c == "Xrotation") j.channels.push_back(BvhJoint::XROT);
+                else if (c == "Yrotation") j.channels.push_back(BvhJoint::YROT);
+                else if (c == "Zrotation") j.channels.push_back(BvhJoint::ZROT);
+                else {
+                    errorMessage = "Unknown channel " + c;
+                    return false;
+                }
+            }
+            channelCount += n;
+        } else if (token == "MOTION") {
+            break;
+        } else {
+            errorMessage = "Unexpected token " + token;
+            return false;
+        }
+    }
+    if (!stack.empty() || bvhJoints.empty()) {
+        errorMessage = "Incomplete HIERARCHY";
+        return false;
+    }
+
+    // "Frames: N" and "Frame Time: dt"
+    std::string frames, frame, time;
+    if (!(file >> frames >> totalFrames >> frame >> time) || !readFloat(file, frameTime) ||
+        frames != "Frames:" || frame != "Frame" || time != "Time:") {
+        errorMessage = "Malformed MOTION header";
+        return false;
+    }
+    // Skip the rest of the header line.
+    std::getline(file, token);
+    return true;
+}
+
+void BvhImporter::readMotion() {
+    size_t joints = bvhJoints.size();
+    std::vector<bool> hasRotation(joints, false), hasTranslation(joints, false);
+    for (size_t j = 0; j < joints; j++) {
+        for (BvhJoint::Channel c : bvhJoints[j].channels) {
+            if (c >= BvhJoint::XROT) {
+                hasRotation[j] = true;
+            } else {
+                hasTranslation[j] = true;
+            }
+        }
+    }
+
+    std::vector<float> values(channelCount);
+    std::vector<float> times;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> translations;
+    times.reserve(FRAME_BATCH);
+    rotations.reserve(FRAME_BATCH * joints);
+    translations.reserve(FRAME_BATCH * joints);
+
+    auto flush = [&]() {
+        if (times.empty()) {
+            return;
+        }
+        streamClip->appendFrames(times, rotations, translations, hasRotation, hasTranslation);
+        loadedFrames += times.size();
+        times.clear();
+        rotations.clear();
+        translations.clear();
+    };
+
+    std::string line;
+    size_t frame = 0;
+    while (frame < totalFrames && !cancelled && std::getline(file, line)) {
+        // Parse the channel values of one frame.
+        const char* p = line.data();
+        const char* lineEnd = p + line.size();
+        uint32_t n = 0;
+        for (; n < channelCount; n++) {
+            const char* end = parseFloat(p, lineEnd, values[n]);
+            if (end == p) {
+                break;
+            }
+            p = end;
+        }
+        if (n == 0) {
+            continue; // Blank line
+        }
+        if (n < channelCount) {
+            errorMessage = "Frame " + std::to_string(frame) + " is missing channels";
+            break;
+        }
+
+        for (size_t j = 0; j < joints; j++) {
+            const BvhJoint &bj = bvhJoints[j];
+            glm::vec3 t = bj.offset;
+            glm::quat q(1.f, 0.f, 0.f, 0.f);
+            // Rotations apply in the order the channels are listed.
+            for (size_t c = 0; c < bj.channels.size(); c++) {
+                float v = values[bj.firstChannel + c];
+                switch (bj.channels[c]) {
+                case BvhJoint::XPOS: t.x += v; break;
+                case BvhJoint::YPOS: t.y += v; break;
+                case BvhJoint::ZPOS: t.z += v; break;
+                case BvhJoint::XROT: q = q * glm::angleAxis(glm::radians(v), glm::vec3(1, 0, 0)); break;
+                case BvhJoint::YROT: q = q * glm::angleAxis(glm::radians(v), glm::vec3(0, 1, 0)); break;
+                case BvhJoint::ZROT: q = q * glm::angleAxis(glm::radians(v), glm::vec3(0, 0, 1)); break;
+                }
+            }
+            rotations.push_back(q);
+            translations.push_back(t);
+        }
+        times.push_back(frame * frameTime);
+        frame++;
+
+        if (times.size() == FRAME_BATCH) {
+            flush();
+        }
+    }
+    flush();
+    file.close();
+    done = true;
+}
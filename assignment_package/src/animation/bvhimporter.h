@@ -0,0 +1,99 @@
+#ifndef BVHIMPORTER_H
+#define BVHIMPORTER_H
+
+#include "animation/animationclip.h"
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One joint of a BVH hierarchy. End sites are included as
+// joints without channels so the last bone of a chain has a tip.
+struct BvhJoint {
+    enum Channel { XPOS, YPOS, ZPOS, XROT, YROT, ZROT };
+
+    std::string name;
+    int parent;                     // Index of the parent joint, -1 for the root.
+    glm::vec3 offset;               // Rest translation relative to the parent.
+    std::vector<Channel> channels;  // In the order they appear in a frame line.
+    uint32_t firstChannel;          // Index of this joint's first value in a frame line.
+};
+
+// A clip that an importer appends frames to while it is being played.
+// Appends happen in batches under a lock that sampling also takes,
+// so the player sees whole frames only.
+class StreamingClip : public ClipSource {
+private:
+    mutable std::mutex lock;
+    AnimationClip clip;
+
+public:
+    StreamingClip(size_t jointCount);
+
+    // Appends one frame's keys for every joint.
+    // Joints without rotation / translation channels get no keys.
+    void appendFrames(const std::vector<float> &times,
+                      const std::vector<glm::quat> &rotations,
+                      const std::vector<glm::vec3> &translations,
+                      const std::vector<bool> &hasRotation,
+                      const std::vector<bool> &hasTranslation);
+    void setInterpolation(Interpolation i);
+
+    // Only valid once nothing appends to the clip any more.
+    const AnimationClip& finishedClip() const;
+
+    float duration() const override;
+    size_t jointCount() const override;
+    void sample(float t, PoseSoA &pose, SampleCursor &cursor,
+                SampleScratch &scratch) const override;
+};
+
+// Reads a BVH motion capture file. The HIERARCHY section is read by
+// open(); the MOTION section is then read line by line on a background
+// thread and streamed into a StreamingClip in batches, so playback can
+// begin before the file has been fully read and the file's text is
+// never held in memory as a whole.
+class BvhImporter {
+private:
+    std::ifstream file;
+    std::vector<BvhJoint> bvhJoints;
+    uint32_t channelCount;
+    size_t totalFrames;
+    float frameTime;
+
+    std::unique_ptr<StreamingClip> streamClip;
+    std::thread worker;
+    std::atomic<size_t> loadedFrames;
+    std::atomic<bool> done;
+    std::atomic<bool> cancelled;
+    std::string errorMessage;
+
+public:
+    BvhImporter();
+    ~BvhImporter();
+
+    // Opens a file and reads its HIERARCHY and frame header.
+    // Returns false and sets error() on a malformed file.
+    bool open(const std::string &path);
+    // Starts reading frames on the background thread.
+    void start();
+    // Stops the background thread and waits for it to finish.
+    void cancel();
+
+    const std::vector<BvhJoint>& joints() const;
+    StreamingClip* clip();
+    float frameRate() const;
+    size_t frameCount() const;
+    size_t framesLoaded() const;
+    bool finished() const;
+    // Set before open() returns false, or before finished() becomes true.
+    const std::string& error() const;
+
+private:
+    bool readHierarchy();
+    void readMotion();
+};
+
+#endif // BVHIMPORTER_H
@@ -0,0 +1,607 @@
+#include "clipcompressor.h"
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
+
+// Longest run of keys a single reduced segment may replace.
+// Bounds the cost of reducing long, nearly constant tracks.
+static const uint32_t MAX_SEGMENT_KEYS = 512;
+
+static const float SQRT1_2 = 0.70710678118f;
+static const uint32_t COMPONENT_MAX = (1 << 15) - 1;
+
+CompressionSettings::CompressionSettings()
+    : angularError(glm::radians(0.1f)), positionalError(0.001f), sampleRate(120.f)
+{}
+
+//--------------------------------------------------
+// Smallest-three quaternion encoding
+//--------------------------------------------------
+void ClipCompressor::encodeRotation(const glm::quat &q, uint16_t out[3]) {
+    float c[4] = {q.x, q.y, q.z, q.w};
+    int largest = 0;
+    for (int i = 1; i < 4; i++) {
+        if (std::abs(c[i]) > std::abs(c[largest])) {
+            largest = i;
+        }
+    }
+    // q and -q are the same rotation, so make the dropped component
+    // positive and rebuild it from the other three when decoding.
+    float sign = c[largest] < 0.f ? -1.f : 1.f;
+
+    uint64_t bits = static_cast<uint64_t>(largest) << 45;
+    int shift = 30;
+    for (int i = 0; i < 4; i++) {
+        if (i == largest) {
+            continue;
+        }
+        // The three smallest components lie in [-1/sqrt(2), 1/sqrt(2)].
+        float v = glm::clamp(c[i] * sign / SQRT1_2 * 0.5f + 0.5f, 0.f, 1.f);
+        uint64_t quantized = static_cast<uint64_t>(std::lround(v * COMPONENT_MAX));
+        bits |= quantized << shift;
+        shift -= 15;
+    }
+
+    out[0] = static_cast<uint16_t>(bits >> 32);
+    out[1] = static_cast<uint16_t>(bits >> 16);
+    out[2] = static_cast<uint16_t>(bits);
+}
+
+glm::quat ClipCompressor::decodeRotation(const uint16_t in[3]) {
+    uint64_t bits = (static_cast<uint64_t>(in[0]) << 32) |
+                    (static_cast<uint64_t>(in[1]) << 16) |
+                     static_cast<uint64_t>(in[2]);
+    int largest = static_cast<int>((bits >> 45) & 3);
+
+    float c[4];
+    float sumSq = 0.f;
+    int shift = 30;
+    for (int i = 0; i < 4; i++) {
+        if (i == largest) {
+            continue;
+        }
+        uint32_t quantized = static_cast<uint32_t>((bits >> shift) & COMPONENT_MAX);
+        c[i] = (quantized / static_cast<float>(COMPONENT_MAX) * 2.f - 1.f) * SQRT1_2;
+        sumSq += c[i] * c[i];
+        shift -= 15;
+    }
+    c[largest] = std::sqrt(std::max(0.f, 1.f - sumSq));
+
+    return glm::normalize(glm::quat(c[3], c[0], c[1], c[2]));
+}
+
+//--------------------------------------------------
+// Range-relative translation encoding
+//--------------------------------------------------
+// The bounding box of a track's kept keys.
+static void translationRange(const std::vector<glm::vec3> &keys, const std::vector<uint32_t> &kept,
+                             glm::vec3 &lo, glm::vec3 &extent) {
+    if (kept.empty()) {
+        lo = extent = glm::vec3(0.f);
+        return;
+    }
+    glm::vec3 hi(-INFINITY);
+    lo = glm::vec3(INFINITY);
+    for (uint32_t k : kept) {
+        lo = glm::min(lo, keys[k]);
+        hi = glm::max(hi, keys[k]);
+    }
+    extent = hi - lo;
+}
+
+static void encodeTranslation(const glm::vec3 &p, const glm::vec3 &lo, const glm::vec3 &extent,
+                              uint16_t out[3]) {
+    for (int c = 0; c < 3; c++) {
+        float v = extent[c] > 0.f ? (p[c] - lo[c]) / extent[c] : 0.f;
+        out[c] = static_cast<uint16_t>(std::lround(glm::clamp(v, 0.f, 1.f) * 65535.f));
+    }
+}
+
+static glm::vec3 decodeTranslation(const uint16_t in[3], const glm::vec3 &lo, const glm::vec3 &extent) {
+    return lo + extent * glm::vec3(in[0], in[1], in[2]) / 65535.f;
+}
+
+//--------------------------------------------------
+// Key reduction
+//--------------------------------------------------
+static float rotationError(const glm::quat &a, const glm::quat &b) {
+    float d = std::min(1.f, std::abs(glm::dot(a, b)));
+    return 2.f * std::acos(d);
+}
+
+static glm::quat interpolate(const glm::quat &a, const glm::quat &b, float t) {
+    return glm::slerp(a, b, t);
+}
+
+static glm::vec3 interpolate(const glm::vec3 &a, const glm::vec3 &b, float t) {
+    return glm::mix(a, b, t);
+}
+
+static float keyError(const glm::quat &a, const glm::quat &b) {
+    return rotationError(a, b);
+}
+
+static float keyError(const glm::vec3 &a, const glm::vec3 &b) {
+    return glm::length(a - b);
+}
+
+// Returns the indices of the keys to keep so that interpolating
+// between kept keys reproduces every removed key within tolerance.
+// Greedily extends each segment as far as the tolerance allows.
+template<typename T>
+static std::vector<uint32_t> reduceKeys(const std::vector<float> &times,
+                                        const std::vector<T> &keys, float tolerance) {
+    std::vector<uint32_t> kept;
+    uint32_t n = keys.size();
+    if (n == 0) {
+        return kept;
+    }
+    kept.push_back(0);
+
+    uint32_t i = 0;
+    while (i + 1 < n) {
+        uint32_t end = i + 1;
+        uint32_t limit = std::min(n - 1, i + MAX_SEGMENT_KEYS);
+        while (end < limit) {
+            uint32_t candidate = end + 1;
+            float span = times[candidate] - times[i];
+            bool fits = true;
+            for (uint32_t m = i + 1; m < candidate && fits; m++) {
+                float t = span > 0.f ? (times[m] - times[i]) / span : 0.f;
+                fits = keyError(interpolate(keys[i], keys[candidate], t), keys[m]) <= tolerance;
+            }
+            if (!fits) {
+                break;
+            }
+            end = candidate;
+        }
+        kept.push_back(end);
+        i = end;
+    }
+
+    // A track that never moves only needs its first key.
+    if (kept.size() == 2 && keyError(keys[kept[0]], keys[kept[1]]) <= tolerance) {
+        kept.pop_back();
+    }
+    return kept;
+}
+
+//--------------------------------------------------
+// ClipCompressor
+//--------------------------------------------------
+ClipCompressor::ClipCompressor(const CompressionSettings &s)
+    : settings(s)
+{}
+
+std::vector<float> ClipCompressor::jointReach(const RigDesc &rig) {
+    size_t n = rig.parents.size();
+    std::vector<float> reach(n, 0.f);
+    // Children come after their parents, so a reverse pass
+    // sees every child before its parent.
+    for (size_t j = n; j-- > 0;) {
+        int p = rig.parents[j];
+        if (p >= 0) {
+            float bone = glm::length(rig.restPose.translation(j));
+            reach[p] = std::max(reach[p], bone + reach[j]);
+        }
+    }
+    return reach;
+}
+
+static uint16_t toFrame(float t, float sampleRate) {
+    return static_cast<uint16_t>(std::round(t * sampleRate));
+}
+
+// Whether every time of a track rounds to a frame number that fits in
+// the 16 bits it is stored in.
+static bool fitsFrames(const std::vector<float> &times, float sampleRate) {
+    return times.empty() ||
+           (std::round(times.front() * sampleRate) >= 0.f && std::round(times.back() * sampleRate) <= 65535.f);
+}
+
+// Finds the segment containing frame f in a track's frame numbers,
+// starting from hint. Returns the key index relative to the track.
+static uint32_t findFrameSegment(const uint16_t* frames, uint32_t count, float f, uint32_t hint) {
+    uint32_t last = count < 2 ? 0 : count - 2;
+    if (hint > last) {
+        hint = last;
+    }
+    if (frames[hint] <= f) {
+        if (hint == last || f < frames[hint + 1]) {
+            return hint;
+        }
+        if (hint + 1 == last || f < frames[hint + 2]) {
+            return hint + 1;
+        }
+    }
+    const uint16_t* it = std::upper_bound(frames, frames + count, f,
+                                          [](float v, uint16_t e) { return v < e; });
+    if (it == frames) {
+        return 0;
+    }
+    return std::min<uint32_t>(it - frames - 1, last);
+}
+
+// Playback of one kind of key through the blend kernels,
+// so stored keys are checked the way CompressedClip::sample plays them.
+template<typename T> struct KeyPlayback;
+
+template<> struct KeyPlayback<glm::quat> {
+    static void gather(SampleScratch &s, size_t i, const glm::quat keys[4],
+                       const float times[4], float t, bool cubic) {
+        blend::gatherRotation(s, i, keys, times, t, cubic);
+    }
+    static void blend(SampleScratch &s, size_t n, bool cubic) {
+        if (cubic) {
+            blend::hermite(s, n, true);
+        } else {
+            blend::slerp(s, n);
+        }
+    }
+    static glm::quat result(const SampleScratch &s, size_t i) {
+        return glm::quat(s.aw[i], s.ax[i], s.ay[i], s.az[i]);
+    }
+};
+
+template<> struct KeyPlayback<glm::vec3> {
+    static void gather(SampleScratch &s, size_t i, const glm::vec3 keys[4],
+                       const float times[4], float t, bool cubic) {
+        blend::gatherTranslation(s, i, keys, times, t, cubic);
+    }
+    static void blend(SampleScratch &s, size_t n, bool cubic) {
+        if (cubic) {
+            blend::hermite(s, n, false);
+        } else {
+            blend::lerp(s, n);
+        }
+    }
+    static glm::vec3 result(const SampleScratch &s, size_t i) {
+        return glm::vec3(s.ax[i], s.ay[i], s.az[i]);
+    }
+};
+
+// reduceKeys judges segments by exact keys and linear interpolation,
+// but playback sees keys after quantization, at whole frames and
+// possibly through Hermite splines. This plays the stored keys back at
+// every raw key's time and, in each segment that misses a raw key by
+// more than tolerance, keeps the worst one as well, until none miss.
+// store gives the kept keys as they will decode. Only the quantization
+// of the kept keys themselves can remain.
+template<typename T, typename Store>
+static void validateKeys(const std::vector<float> &times, const std::vector<T> &keys, float tolerance,
+                         float sampleRate, bool cubic, Store store, std::vector<uint32_t> &kept) {
+    uint32_t n = keys.size();
+    if (kept.empty()) {
+        return;
+    }
+    SampleScratch scratch;
+    blend::reserve(scratch, n);
+    std::vector<uint16_t> frames;
+    std::vector<float> error(n);
+    std::vector<uint32_t> added;
+
+    while (true) {
+        std::vector<T> stored = store(kept);
+        uint32_t count = kept.size();
+        frames.resize(count);
+        for (uint32_t k = 0; k < count; k++) {
+            frames[k] = toFrame(times[kept[k]], sampleRate);
+        }
+
+        // Lane m plays the stored track at the time of raw key m.
+        uint32_t hint = 0;
+        for (uint32_t m = 0; m < n; m++) {
+            uint32_t k = findFrameSegment(frames.data(), count, times[m] * sampleRate, hint);
+            hint = k;
+            uint32_t last = count - 1;
+            uint32_t idx[4] = {k == 0 ? 0 : k - 1, k, std::min(k + 1, last), std::min(k + 2, last)};
+            T segment[4];
+            float segmentTimes[4];
+            for (int c = 0; c < 4; c++) {
+                segment[c] = stored[idx[c]];
+                segmentTimes[c] = frames[idx[c]] / sampleRate;
+            }
+            KeyPlayback<T>::gather(scratch, m, segment, segmentTimes, times[m], cubic);
+        }
+        KeyPlayback<T>::blend(scratch, n, cubic);
+        for (uint32_t m = 0; m < n; m++) {
+            error[m] = keyError(KeyPlayback<T>::result(scratch, m), keys[m]);
+        }
+
+        // The raw keys between kept[k] and the next kept key,
+        // or the end of the track after the last one.
+        added.clear();
+        for (uint32_t k = 0; k < count; k++) {
+            uint32_t end = k + 1 < count ? kept[k + 1] : n;
+            uint32_t worst = kept[k];
+            for (uint32_t m = kept[k] + 1; m < end; m++) {
+                if (error[m] > tolerance && (worst == kept[k] || error[m] > error[worst])) {
+                    worst = m;
+                }
+            }
+            if (worst != kept[k]) {
+                added.push_back(worst);
+            }
+        }
+        if (added.empty()) {
+            return;
+        }
+        std::vector<uint32_t> merged(kept.size() + added.size());
+        std::merge(kept.begin(), kept.end(), added.begin(), added.end(), merged.begin());
+        kept.swap(merged);
+    }
+}
+
+uPtr<CompressedClip> ClipCompressor::compress(const AnimationClip &clip, const RigDesc* rig) const {
+    size_t joints = clip.jointCount();
+    for (size_t j = 0; j < joints; j++) {
+        if (!fitsFrames(clip.rotTracks[j].times, settings.sampleRate) ||
+            !fitsFrames(clip.posTracks[j].times, settings.sampleRate)) {
+            return nullptr;
+        }
+    }
+
+    uPtr<CompressedClip> out = mkU<CompressedClip>();
+    out->interp = clip.interp;
+    out->sampleRate = settings.sampleRate;
+    out->length = clip.length;
+    bool cubic = clip.interp == Interpolation::CUBIC;
+
+    std::vector<float> reach;
+    if (rig != nullptr) {
+        reach = jointReach(*rig);
+    }
+
+    out->rotTracks.resize(joints);
+    out->posTracks.resize(joints);
+    for (size_t j = 0; j < joints; j++) {
+        // Rotations
+        const RotationTrack &rt = clip.rotTracks[j];
+        float angTol = settings.angularError;
+        if (j < reach.size() && reach[j] > 0.f) {
+            // A rotation error of e radians moves a point r units
+            // away by about r * e.
+            angTol = std::min(angTol, settings.positionalError / reach[j]);
+        }
+        std::vector<uint32_t> kept = reduceKeys(rt.times, rt.keys, angTol);
+        validateKeys(rt.times, rt.keys, angTol, settings.sampleRate, cubic,
+                     [&rt](const std::vector<uint32_t> &k) {
+                         std::vector<glm::quat> stored(k.size());
+                         for (size_t i = 0; i < k.size(); i++) {
+                             uint16_t words[3];
+                             encodeRotation(rt.keys[k[i]], words);
+                             stored[i] = decodeRotation(words);
+                         }
+                         return stored;
+                     }, kept);
+
+        CompressedClip::Track &ct = out->rotTracks[j];
+        ct.firstKey = out->rotFrames.size();
+        ct.keyCount = kept.size();
+        for (uint32_t k : kept) {
+            uint16_t words[3];
+            encodeRotation(rt.keys[k], words);
+            out->rotFrames.push_back(toFrame(rt.times[k], settings.sampleRate));
+            out->rotData.insert(out->rotData.end(), words, words + 3);
+        }
+
+        // Translations, quantized over the range of the kept keys,
+        // which grows as validation keeps more of them. The range of
+        // every key bounds it, so a track whose steps would be too
+        // coarse for positionalError keeps its floats from the start.
+        const TranslationTrack &pt = clip.posTracks[j];
+        kept = reduceKeys(pt.times, pt.keys, settings.positionalError);
+        glm::vec3 lo(INFINITY), hi(-INFINITY);
+        for (const glm::vec3 &p : pt.keys) {
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+        glm::vec3 extent = pt.keys.empty() ? glm::vec3(0.f) : hi - lo;
+        float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+        // Rounding is off by at most half a step in each component.
+        bool exact = maxExtent / 65535.f * 0.5f * std::sqrt(3.f) > settings.positionalError;
+        validateKeys(pt.times, pt.keys, settings.positionalError, settings.sampleRate, cubic,
+                     [&pt, exact](const std::vector<uint32_t> &k) {
+                         std::vector<glm::vec3> stored(k.size());
+                         glm::vec3 lo, extent;
+                         translationRange(pt.keys, k, lo, extent);
+                         for (size_t i = 0; i < k.size(); i++) {
+                             if (exact) {
+                                 stored[i] = pt.keys[k[i]];
+                                 continue;
+                             }
+                             uint16_t words[3];
+                             encodeTranslation(pt.keys[k[i]], lo, extent, words);
+                             stored[i] = decodeTranslation(words, lo, extent);
+                         }
+                         return stored;
+                     }, kept);
+
+        CompressedClip::RangedTrack &cp = out->posTracks[j];
+        cp.firstKey = out->posFrames.size();
+        cp.keyCount = kept.size();
+        cp.exact = exact;
+        cp.firstData = exact ? out->posExact.size() : out->posData.size() / 3;
+        translationRange(pt.keys, kept, cp.rangeMin, cp.rangeExtent);
+        for (uint32_t k : kept) {
+            out->posFrames.push_back(toFrame(pt.times[k], settings.sampleRate));
+            if (exact) {
+                out->posExact.push_back(pt.keys[k]);
+                continue;
+            }
+            uint16_t words[3];
+            encodeTranslation(pt.keys[k], cp.rangeMin, cp.rangeExtent, words);
+            out->posData.insert(out->posData.end(), words, words + 3);
+        }
+    }
+    return out;
+}
+
+// Computes the world position of every joint for a local pose.
+static void worldPositions(const RigDesc &rig, const PoseSoA &pose,
+                           std::vector<glm::mat4> &world, std::vector<glm::vec3> &out) {
+    size_t n = rig.parents.size();
+    for (size_t j = 0; j < n; j++) {
+        glm::mat4 local = glm::translate(glm::mat4(1.f), pose.translation(j)) *
+                          glm::mat4_cast(pose.rotation(j));
+        int p = rig.parents[j];
+        world[j] = p < 0 ? local : world[p] * local;
+        out[j] = glm::vec3(world[j][3]);
+    }
+}
+
+CompressionReport ClipCompressor::evaluate(const AnimationClip &raw, const CompressedClip &compressed,
+                                           const RigDesc &rig) const {
+    CompressionReport report;
+    report.rawKeys = raw.keyCount();
+    report.keptKeys = compressed.keyCount();
+    report.rawBytes = 0;
+    for (size_t j = 0; j < raw.jointCount(); j++) {
+        report.rawBytes += raw.rotationTrack(j).keys.size() * (sizeof(float) + sizeof(glm::quat));
+        report.rawBytes += raw.translationTrack(j).keys.size() * (sizeof(float) + sizeof(glm::vec3));
+    }
+    report.compressedBytes = compressed.byteSize();
+    report.maxWorldError = 0.f;
+
+    size_t n = rig.parents.size();
+    PoseSoA poseA = rig.restPose, poseB = rig.restPose;
+    SampleCursor cursorA, cursorB;
+    cursorA.reset(n);
+    cursorB.reset(n);
+    SampleScratch scratch;
+    std::vector<glm::mat4> world(n);
+    std::vector<glm::vec3> posA(n), posB(n);
+
+    int frames = static_cast<int>(std::ceil(raw.duration() * settings.sampleRate));
+    for (int f = 0; f <= frames; f++) {
+        float t = f / settings.sampleRate;
+        raw.sample(t, poseA, cursorA, scratch);
+        compressed.sample(t, poseB, cursorB, scratch);
+        worldPositions(rig, poseA, world, posA);
+        worldPositions(rig, poseB, world, posB);
+        for (size_t j = 0; j < n; j++) {
+            report.maxWorldError = std::max(report.maxWorldError, glm::length(posA[j] - posB[j]));
+        }
+    }
+    return report;
+}
+
+//--------------------------------------------------
+// CompressedClip
+//--------------------------------------------------
+CompressedClip::CompressedClip()
+    : rotTracks(), posTracks(), rotFrames(), posFrames(), rotData(), posData(), posExact(),
+      interp(Interpolation::LINEAR), sampleRate(120.f), length(0.f)
+{}
+
+size_t CompressedClip::keyCount() const {
+    return rotFrames.size() + posFrames.size();
+}
+
+size_t CompressedClip::byteSize() const {
+    return rotTracks.size() * sizeof(Track) + posTracks.size() * sizeof(RangedTrack) +
+           (rotFrames.size() + posFrames.size() + rotData.size() + posData.size()) * sizeof(uint16_t) +
+           posExact.size() * sizeof(glm::vec3);
+}
+
+float CompressedClip::duration() const {
+    return length;
+}
+
+size_t CompressedClip::jointCount() const {
+    return rotTracks.size();
+}
+
+glm::quat CompressedClip::decodeRotation(uint32_t key) const {
+    return ClipCompressor::decodeRotation(&rotData[key * 3]);
+}
+
+glm::vec3 CompressedClip::decodeTranslation(const RangedTrack &tr, uint32_t key) const {
+    uint32_t i = tr.firstData + (key - tr.firstKey);
+    if (tr.exact) {
+        return posExact[i];
+    }
+    return ::decodeTranslation(&posData[i * 3], tr.rangeMin, tr.rangeExtent);
+}
+
+void CompressedClip::sample(float t, PoseSoA &pose, SampleCursor &cursor,
+                            SampleScratch &scratch) const {
+    size_t joints = rotTracks.size();
+    blend::reserve(scratch, joints);
+    bool cubic = interp == Interpolation::CUBIC;
+    float f = t * sampleRate;
+    float times[4];
+
+    // Only the keys around each joint's segment are decoded.
+    scratch.rotJoints.clear();
+    for (size_t j = 0; j < joints; j++) {
+        const Track &tr = rotTracks[j];
+        if (tr.keyCount == 0) {
+            continue;
+        }
+        const uint16_t* frames = &rotFrames[tr.firstKey];
+        uint32_t k = findFrameSegment(frames, tr.keyCount, f, cursor.rot[j]);
+        cursor.rot[j] = k;
+
+        uint32_t last = tr.keyCount - 1;
+        uint32_t idx[4] = {k == 0 ? 0 : k - 1, k, std::min(k + 1, last), std::min(k + 2, last)};
+        glm::quat keys[4];
+        for (int c = 0; c < 4; c++) {
+            // Only the two segment ends are needed for slerp.
+            if (cubic || c == 1 || c == 2) {
+                keys[c] = decodeRotation(tr.firstKey + idx[c]);
+            }
+            times[c] = frames[idx[c]] / sampleRate;
+        }
+        blend::gatherRotation(scratch, scratch.rotJoints.size(), keys, times, t, cubic);
+        scratch.rotJoints.push_back(j);
+    }
+    size_t n = scratch.rotJoints.size();
+    if (cubic) {
+        blend::hermite(scratch, n, true);
+    } else {
+        blend::slerp(scratch, n);
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint32_t j = scratch.rotJoints[i];
+        pose.rx[j] = scratch.ax[i];
+        pose.ry[j] = scratch.ay[i];
+        pose.rz[j] = scratch.az[i];
+        pose.rw[j] = scratch.aw[i];
+    }
+
+    scratch.posJoints.clear();
+    for (size_t j = 0; j < joints; j++) {
+        const RangedTrack &tr = posTracks[j];
+        if (tr.keyCount == 0) {
+            continue;
+        }
+        const uint16_t* frames = &posFrames[tr.firstKey];
+        uint32_t k = findFrameSegment(frames, tr.keyCount, f, cursor.pos[j]);
+        cursor.pos[j] = k;
+
+        uint32_t last = tr.keyCount - 1;
+        uint32_t idx[4] = {k == 0 ? 0 : k - 1, k, std::min(k + 1, last), std::min(k + 2, last)};
+        glm::vec3 keys[4];
+        for (int c = 0; c < 4; c++) {
+            if (cubic || c == 1 || c == 2) {
+                keys[c] = decodeTranslation(tr, tr.firstKey + idx[c]);
+            }
+            times[c] = frames[idx[c]] / sampleRate;
+        }
+        blend::gatherTranslation(scratch, scratch.posJoints.size(), keys, times, t, cubic);
+        scratch.posJoints.push_back(j);
+    }
+    n = scratch.posJoints.size();
+    if (cubic) {
+        blend::hermite(scratch, n, false);
+    } else {
+        blend::lerp(scratch, n);
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint32_t j = scratch.posJoints[i];
+        pose.tx[j] = scratch.ax[i];
+        pose.ty[j] = scratch.ay[i];
+        pose.tz[j] = scratch.az[i];
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef CLIPCOMPRESSOR_H
+#define CLIPCOMPRESSOR_H
+
+#include "animation/animationclip.h"
+#include "smartpointerhelp.h"
+#include <cstdint>
+#include <vector>
+
+// The joint hierarchy a clip is played on.
+// Joints are ordered so that every parent comes before its children,
+// which holds for skeletons read by Joint::read.
+struct RigDesc {
+    std::vector<int> parents;   // Parent id of each joint, -1 for the root.
+    PoseSoA restPose;           // Local pose used where a clip has no keys.
+};
+
+struct CompressionSettings {
+    float angularError;     // Max rotation error per joint, in radians.
+    float positionalError;  // Max translation error per joint, in scene units.
+    float sampleRate;       // Key times are stored as frame numbers at this rate.
+
+    CompressionSettings();
+};
+
+struct CompressionReport {
+    size_t rawKeys, keptKeys;
+    size_t rawBytes, compressedBytes;
+    // Largest joint position error in world space over
+    // every frame of the clip, measured through the hierarchy.
+    float maxWorldError;
+};
+
+// A clip whose keys have been reduced and quantized.
+// Rotations use the smallest-three encoding in 48 bits:
+// the largest quaternion component is dropped (its index takes 2 bits)
+// and the other three are stored in 15 bits each. Translations are
+// stored as 16 bits per component relative to their track's range,
+// or as floats if the range is too wide for 16 bits to keep within
+// the positional error.
+// Keys are decoded one segment at a time while sampling.
+class CompressedClip : public ClipSource {
+private:
+    struct Track {
+        uint32_t firstKey;
+        uint32_t keyCount;
+    };
+    struct RangedTrack : Track {
+        glm::vec3 rangeMin;
+        glm::vec3 rangeExtent;
+        // Keys are posData[3 * (firstData + i)] or, for exact tracks,
+        // posExact[firstData + i].
+        uint32_t firstData;
+        bool exact;
+    };
+
+    std::vector<Track> rotTracks;
+    std::vector<RangedTrack> posTracks;
+    std::vector<uint16_t> rotFrames, posFrames;
+    std::vector<uint16_t> rotData, posData; // Three words per key.
+    std::vector<glm::vec3> posExact;
+
+    Interpolation interp;
+    float sampleRate;
+    float length;
+
+    friend class ClipCompressor;
+
+public:
+    CompressedClip();
+
+    size_t keyCount() const;
+    size_t byteSize() const;
+
+    float duration() const override;
+    size_t jointCount() const override;
+    void sample(float t, PoseSoA &pose, SampleCursor &cursor,
+                SampleScratch &scratch) const override;
+
+private:
+    glm::quat decodeRotation(uint32_t key) const;
+    glm::vec3 decodeTranslation(const RangedTrack &tr, uint32_t key) const;
+};
+
+class ClipCompressor {
+private:
+    CompressionSettings settings;
+
+public:
+    ClipCompressor(const CompressionSettings &s);
+
+    // Removes keys that linear interpolation between their neighbours
+    // reproduces within the error bounds, then quantizes what remains.
+    // Removed keys are then checked against the quantized keys played
+    // back at whole frames with the clip's interpolation, and those that
+    // miss are kept after all.
+    // If rig is given, each joint's angular bound is tightened so that
+    // the rotation error moves no descendant by more than positionalError.
+    // Returns null if a key lies before the start of the clip or past
+    // frame 65535 at sampleRate, where 16-bit frame numbers cannot go.
+    uPtr<CompressedClip> compress(const AnimationClip &clip, const RigDesc* rig = nullptr) const;
+
+    // Compares two clips frame by frame on rig.
+    CompressionReport evaluate(const AnimationClip &raw, const CompressedClip &compressed,
+                               const RigDesc &rig) const;
+
+    static void encodeRotation(const glm::quat &q, uint16_t out[3]);
+    static glm::quat decodeRotation(const uint16_t in[3]);
+
+private:
+    // Distance from each joint to its farthest descendant in the rest pose.
+    static std::vector<float> jointReach(const RigDesc &rig);
+};
+
+#endif // CLIPCOMPRESSOR_H
@@ -0,0 +1,84 @@
+#include "crowd.h"
+#include "parallel.h"
+#include <chrono>
+#include <cmath>
+
+Crowd::Crowd()
+    : parents(), binds(), instances(), cursors(), lastEvaluateMs(0.0)
+{}
+
+void Crowd::setRig(const std::vector<int> &parents, const std::vector<glm::mat4> &binds) {
+    this->parents = parents;
+    this->binds = binds;
+    for (SampleCursor &c : cursors) {
+        c.reset(parents.size());
+    }
+}
+
+void Crowd::layoutGrid(size_t count, float spacing) {
+    instances.resize(count);
+    cursors.resize(count);
+    size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+    float half = (side - 1) * spacing / 2.f;
+    for (size_t i = 0; i < count; i++) {
+        float x = (i % side) * spacing - half;
+        float z = (i / side) * spacing - half;
+        instances[i].placement = glm::translate(glm::mat4(1.f), glm::vec3(x, 0.f, z));
+        // Golden ratio steps spread the offsets evenly over any clip length.
+        instances[i].timeOffset = std::fmod(i * 0.618034f, 1.f);
+        cursors[i].reset(parents.size());
+    }
+}
+
+void Crowd::clear() {
+    instances.clear();
+    cursors.clear();
+}
+
+size_t Crowd::size() const {
+    return instances.size();
+}
+
+size_t Crowd::jointCount() const {
+    return parents.size();
+}
+
+size_t Crowd::paletteSize() const {
+    return instances.size() * parents.size();
+}
+
+void Crowd::evaluate(const ClipSource* clip, float time, const PoseSoA &pose, glm::mat4* palette) {
+    auto start = std::chrono::steady_clock::now();
+    size_t joints = parents.size();
+    float duration = clip != nullptr ? clip->duration() : 0.f;
+
+    parallelFor(instances.size(), 4, [&](size_t begin, size_t end) {
+        PoseSoA local;
+        SampleScratch scratch;
+        std::vector<glm::mat4> world(joints);
+
+        for (size_t i = begin; i < end; i++) {
+            const PoseSoA* p = &pose;
+            if (duration > 0.f) {
+                // The offset is a fraction of the clip so every instance loops.
+                local = pose;
+                float t = std::fmod(time + instances[i].timeOffset * duration, duration);
+                clip->sample(t, local, cursors[i], scratch);
+                p = &local;
+            }
+
+            glm::mat4* out = palette + i * joints;
+            for (size_t j = 0; j < joints; j++) {
+                glm::mat4 m = glm::translate(glm::mat4(1.f), p->translation(j)) * glm::mat4_cast(p->rotation(j));
+                world[j] = parents[j] < 0 ? instances[i].placement * m : world[parents[j]] * m;
+                out[j] = world[j] * binds[j];
+            }
+        }
+    });
+
+    lastEvaluateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double Crowd::lastEvaluateTimeMs() const {
+    return lastEvaluateMs;
+}
@@ -0,0 +1,48 @@
+#ifndef CROWD_H
+#define CROWD_H
+
+#include "animation/animationclip.h"
+#include <vector>
+
+struct CrowdInstance {
+    glm::mat4 placement;    // Transforms the character's root into the scene.
+    float timeOffset;       // Where in the clip this instance starts, as a
+                            // fraction of its duration from 0 to 1.
+};
+
+// Many copies of one skinned character, each at its own place and
+// point in the clip. Every frame the crowd evaluates all instance
+// poses in parallel and writes their skinning matrices into one
+// palette, instance after instance, for a single instanced draw.
+class Crowd {
+private:
+    std::vector<int> parents;       // Parents precede their children.
+    std::vector<glm::mat4> binds;
+    std::vector<CrowdInstance> instances;
+    std::vector<SampleCursor> cursors;
+    double lastEvaluateMs;
+
+public:
+    Crowd();
+
+    // Sets the skeleton shared by every instance.
+    void setRig(const std::vector<int> &parents, const std::vector<glm::mat4> &binds);
+    // Places count instances on a square grid in the XZ plane,
+    // spacing apart, with scattered clip offsets.
+    void layoutGrid(size_t count, float spacing);
+    void clear();
+
+    size_t size() const;
+    size_t jointCount() const;
+    // Number of matrices evaluate() writes.
+    size_t paletteSize() const;
+
+    // Writes the skinning matrices of every instance to palette.
+    // Each instance samples clip at time + its offset; without a clip
+    // every instance takes pose. pose also supplies the local transform
+    // of joints the clip does not animate.
+    void evaluate(const ClipSource* clip, float time, const PoseSoA &pose, glm::mat4* palette);
+    double lastEvaluateTimeMs() const;
+};
+
+#endif // CROWD_H
@@ -0,0 +1,540 @@
+// micromaya-bench: times the hot paths of the core library on the
+// shipped assets and on generated meshes, and reports time, throughput,
+// peak RSS, heap allocations and memstats' tagged memory, as a table and
+// optionally as JSON.
+//
+//   micromaya-bench [--max-faces N] [--repeat N] [--filter TEXT]
+//                   [--data DIR] [--json FILE] [--trace FILE]
+
+#include "halfedgemesh.h"
+#include "skeletonio.h"
+#include "vertexcache.h"
+#include "lod/decimator.h"
+#include "procedural/generators.h"
+#include "spatial/bvh.h"
+#include "spatial/weld.h"
+#include "subdivision/loop.h"
+#include "skinning/heatweights.h"
+#include "skinning/skinweights.h"
+#include "jobs/threadpool.h"
+#include "profiling/memstats.h"
+#include "profiling/trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <malloc.h>
+#endif
+
+// MSVC spells the few compiler specifics the bench needs its own way.
+#ifdef _MSC_VER
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE [[gnu::noinline]]
+#endif
+
+//--------------------------------------------------
+// Allocation counting
+//--------------------------------------------------
+// Every operator new of the process goes through these, so a case's
+// allocations are the difference of the counters around its run.
+
+namespace {
+    std::atomic<size_t> allocCount{0};
+    std::atomic<size_t> allocBytes{0};
+
+    void* countedAlloc(size_t size) {
+        allocCount.fetch_add(1, std::memory_order_relaxed);
+        allocBytes.fetch_add(size, std::memory_order_relaxed);
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void* countedAlignedAlloc(size_t size, std::align_val_t align) {
+        allocCount.fetch_add(1, std::memory_order_relaxed);
+        allocBytes.fetch_add(size, std::memory_order_relaxed);
+        size_t a = static_cast<size_t>(align);
+#ifdef _MSC_VER
+        // MSVC has no aligned_alloc, and its blocks need _aligned_free.
+        return _aligned_malloc(std::max<size_t>(size, 1), a);
+#else
+        return std::aligned_alloc(a, (std::max<size_t>(size, 1) + a - 1) / a * a);
+#endif
+    }
+
+    // Out of line so the compiler does not pair free() with new.
+    BENCH_NOINLINE void freeBlock(void* p) noexcept {
+        std::free(p);
+    }
+
+    BENCH_NOINLINE void freeAlignedBlock(void* p) noexcept {
+#ifdef _MSC_VER
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+
+    // Keeps the compiler from folding away a loop around it.
+    inline void compilerBarrier() {
+#ifdef _MSC_VER
+        _ReadWriteBarrier();
+#else
+        asm volatile("" ::: "memory");
+#endif
+    }
+}
+
+void* operator new(size_t size) {
+    if (void* p = countedAlloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+void* operator new(size_t size, std::align_val_t align) {
+    if (void* p = countedAlignedAlloc(size, align)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size, std::align_val_t align) {
+    return operator new(size, align);
+}
+void operator delete(void* p) noexcept { freeBlock(p); }
+void operator delete[](void* p) noexcept { freeBlock(p); }
+void operator delete(void* p, size_t) noexcept { freeBlock(p); }
+void operator delete[](void* p, size_t) noexcept { freeBlock(p); }
+void operator delete(void* p, std::align_val_t) noexcept { freeAlignedBlock(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { freeAlignedBlock(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { freeAlignedBlock(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { freeAlignedBlock(p); }
+
+namespace {
+
+//--------------------------------------------------
+// Peak RSS
+//--------------------------------------------------
+
+// Starts a new peak where the OS allows it. On Linux writing 5 to
+// clear_refs resets VmHWM; elsewhere peaks are for the whole process.
+void resetPeakRSS() {
+#ifdef __linux__
+    std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+size_t peakRSS() {
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return size_t(std::strtoull(line.c_str() + 6, nullptr, 10)) * 1024;
+        }
+    }
+#endif
+#ifdef __unix__
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss);
+#else
+    return size_t(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
+//--------------------------------------------------
+// Cases
+//--------------------------------------------------
+
+struct Case {
+    std::string name;
+    std::string unit;               // What items counts.
+    size_t items;                   // Work done by one run.
+    std::function<void()> setup;    // Untimed, before every run.
+    std::function<void()> run;
+};
+
+struct Result {
+    std::string name, unit;
+    size_t items;
+    std::vector<double> ms;
+    size_t allocs, allocBytes;      // Of the last run.
+    size_t peakRSS;
+    // Peak of each memstats tag, and of their sum, over every run.
+    size_t tagPeaks[memstats::TAG_COUNT];
+    size_t tagPeak;
+
+    double min() const { return *std::min_element(ms.begin(), ms.end()); }
+    double median() const {
+        std::vector<double> sorted = ms;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[sorted.size() / 2];
+    }
+    double throughput() const { return items / (min() / 1000.0); }
+};
+
+// Runs are traced under label, which must outlive the trace.
+Result measure(const Case &c, int repeat, const char* label) {
+    Result r{c.name, c.unit, c.items, {}, 0, 0, 0, {}, 0};
+    resetPeakRSS();
+    memstats::resetPeaks();
+    for (int i = 0; i < repeat; i++) {
+        if (c.setup) {
+            c.setup();
+        }
+        size_t count = allocCount.load(), bytes = allocBytes.load();
+        auto start = std::chrono::steady_clock::now();
+        {
+            trace::Scope scope(label);
+            c.run();
+        }
+        auto end = std::chrono::steady_clock::now();
+        r.allocs = allocCount.load() - count;
+        r.allocBytes = allocBytes.load() - bytes;
+        r.ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    r.peakRSS = peakRSS();
+    for (size_t t = 0; t < memstats::TAG_COUNT; t++) {
+        r.tagPeaks[t] = memstats::counters(memstats::Tag(t)).peak;
+    }
+    r.tagPeak = memstats::totals().peak;
+    return r;
+}
+
+std::vector<glm::vec3> jointPositions(const SkeletonDesc &desc) {
+    std::vector<glm::vec3> pos;
+    for (const glm::mat4 &m : desc.worldTransforms()) {
+        pos.push_back(glm::vec3(m[3]));
+    }
+    return pos;
+}
+
+std::string sizeName(size_t faces) {
+    if (faces >= 1000000 && faces % 1000000 == 0) {
+        return std::to_string(faces / 1000000) + "M";
+    }
+    if (faces >= 1000 && faces % 1000 == 0) {
+        return std::to_string(faces / 1000) + "k";
+    }
+    return std::to_string(faces);
+}
+
+bool exists(const std::string &path) {
+    return std::ifstream(path).good();
+}
+
+// Cases on one mesh. mesh is rebuilt from source before every run
+// that changes it; flat holds its triangles for the array cases.
+struct Subject {
+    std::string name;
+    std::function<void(HalfEdgeMesh&)> source;
+    HalfEdgeMesh mesh;
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> triangles;
+};
+
+void addMeshCases(std::vector<Case> &cases, std::shared_ptr<Subject> s,
+                  const std::vector<std::pair<std::string, SkeletonDesc>> &rigs, bool heat) {
+    s->source(s->mesh);
+    s->mesh.flatten(s->positions, s->triangles);
+    size_t faces = s->mesh.faceCount(), verts = s->mesh.vertexCount();
+    size_t tris = s->triangles.size() / 3;
+    auto reset = [s]() { s->source(s->mesh); };
+
+    cases.push_back({"triangulate/" + s->name, "faces", faces, reset, [s]() { s->mesh.triangulate(); }});
+    cases.push_back({"subdivide/" + s->name, "faces", faces, reset, [s]() { s->mesh.subdivide(); }});
+    // Loop subdivision of the mesh fanned into triangles, whole and then
+    // only the geometry pass over tables built once.
+    cases.push_back({"loop/" + s->name, "triangles", tris, [s]() {
+        s->source(s->mesh);
+        s->mesh.triangulate();
+    }, [s]() { s->mesh.subdivideLoop(); }});
+    auto loop = std::make_shared<std::unique_ptr<LoopSubdivider>>();
+    auto refined = std::make_shared<std::vector<glm::vec3>>();
+    cases.push_back({"loop_refine/" + s->name, "triangles", tris, [s, loop, refined]() {
+        if (*loop == nullptr) {
+            *loop = std::make_unique<LoopSubdivider>(s->triangles, s->positions.size());
+            refined->resize((*loop)->childVertexCount());
+        }
+    }, [s, loop, refined]() { (*loop)->refine(s->positions.data(), refined->data()); }});
+    cases.push_back({"limit/" + s->name, "vertices", verts, reset, [s]() { s->mesh.snapToLimit(); }});
+    cases.push_back({"flatten/" + s->name, "faces", faces, reset, [s]() {
+        std::vector<glm::vec3> p;
+        std::vector<uint32_t> t;
+        s->mesh.flatten(p, t);
+    }});
+    // The CPU half of Mesh::create: ordering the index buffer.
+    cases.push_back({"vertex_cache/" + s->name, "triangles", tris, nullptr, [s]() {
+        std::vector<uint32_t> indices = s->triangles;
+        vertexcache::optimizeVertexCache(indices, s->positions.size());
+        vertexcache::optimizeVertexFetch(indices, s->positions.size());
+    }});
+    cases.push_back({"bvh_build/" + s->name, "triangles", tris, nullptr, [s]() {
+        BVH bvh;
+        bvh.build(s->positions, s->triangles);
+    }});
+    // Every corner its own vertex, as from an exporter that splits along
+    // every seam, welded back together.
+    std::shared_ptr<std::vector<glm::vec3>> split = std::make_shared<std::vector<glm::vec3>>();
+    split->reserve(s->triangles.size());
+    for (uint32_t i : s->triangles) {
+        split->push_back(s->positions[i]);
+    }
+    cases.push_back({"weld/" + s->name, "vertices", split->size(), nullptr, [s, split]() {
+        std::vector<glm::vec3> positions = *split;
+        std::vector<uint32_t> faceStarts(positions.size() / 3 + 1), indices(positions.size()), remap;
+        for (size_t i = 0; i < faceStarts.size(); i++) {
+            faceStarts[i] = uint32_t(3 * i);
+        }
+        for (size_t i = 0; i < indices.size(); i++) {
+            indices[i] = uint32_t(i);
+        }
+        weldVertices(positions, remap, 0.f);
+        remapPolygons(remap, faceStarts, indices);
+    }});
+    // The chain the viewport builds: 50, 25, 10 and 1% of the triangles.
+    cases.push_back({"lod_chain/" + s->name, "triangles", tris, nullptr, [s]() {
+        buildLodChain(s->mesh, { 0.5f, 0.25f, 0.1f, 0.01f });
+    }});
+    for (auto const &rig : rigs) {
+        std::vector<glm::vec3> joints = jointPositions(rig.second);
+        cases.push_back({"skin_nearest/" + s->name + "+" + rig.first, "vertices", verts, nullptr, [s, joints]() {
+            nearestJointWeights(s->positions, joints);
+        }});
+        if (heat) {
+            std::vector<int> parents = rig.second.parents;
+            cases.push_back({"skin_heat/" + s->name + "+" + rig.first, "vertices", verts, nullptr, [s, joints, parents]() {
+                HeatWeights weights(s->positions, s->triangles);
+                weights.solve(joints, parents);
+            }});
+        }
+    }
+}
+
+void writeJSON(const std::string &path, const std::vector<Result> &results) {
+    std::ofstream out(path);
+#ifdef _MSC_VER
+    out << "{\n  \"compiler\": \"MSVC " << _MSC_FULL_VER << "\",\n";
+#else
+    out << "{\n  \"compiler\": \"" << __VERSION__ << "\",\n";
+#endif
+#ifdef NDEBUG
+    out << "  \"optimized\": true,\n";
+#else
+    out << "  \"optimized\": false,\n";
+#endif
+    out << "  \"threads\": " << ThreadPool::global().threadCount() << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"unit\": \"" << r.unit << "\", \"items\": " << r.items
+            << ", \"runs\": " << r.ms.size() << ", \"min_ms\": " << r.min() << ", \"median_ms\": " << r.median()
+            << ", \"throughput_per_s\": " << r.throughput()
+            << ", \"allocations\": " << r.allocs << ", \"allocated_bytes\": " << r.allocBytes
+            << ", \"peak_rss_bytes\": " << r.peakRSS << ", \"tagged_peak_bytes\": {";
+        for (size_t t = 0; t < memstats::TAG_COUNT; t++) {
+            out << "\"" << memstats::tagName(memstats::Tag(t)) << "\": " << r.tagPeaks[t] << ", ";
+        }
+        out << "\"total\": " << r.tagPeak << "}}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    size_t maxFaces = 1000000;
+    int repeat = 3;
+    std::string filter, jsonPath, data, tracePath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--max-faces" && hasValue) {
+            maxFaces = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--repeat" && hasValue) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--filter" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (arg == "--data" && hasValue) {
+            data = argv[++i];
+        } else if (arg == "--trace" && hasValue) {
+            tracePath = argv[++i];
+        } else {
+            std::fprintf(stderr, "Usage: micromaya-bench [--max-faces N] [--repeat N] "
+                                 "[--filter TEXT] [--data DIR] [--json FILE] [--trace FILE]\n"
+                                 "DIR holds obj_files/ and jsons/, by default found\n"
+                                 "in the working directory or one of its parents.\n"
+                                 "--trace records every case as Chrome trace JSON.\n");
+            return 2;
+        }
+    }
+    if (data.empty()) {
+        for (std::string dir : {".", "..", "../..", "../../.."}) {
+            if (exists(dir + "/obj_files/cow.obj")) {
+                data = dir;
+                break;
+            }
+        }
+    }
+
+    std::vector<std::pair<std::string, SkeletonDesc>> rigs;
+    for (std::string name : {"cow_skeleton", "simple_spine", "two_joints"}) {
+        SkeletonDesc desc;
+        if (!data.empty() && skeletonio::loadJSON(data + "/jsons/" + name + ".json", desc, nullptr)) {
+            rigs.emplace_back(name, desc);
+        }
+    }
+
+    // Cases come in groups that share a mesh, made just before they
+    // run and freed after, so big meshes are never alive at once.
+    std::vector<std::function<std::vector<Case>()>> groups;
+
+    // What a trace marker costs, off and on. Left out under --trace,
+    // as its markers would flood the trace.
+    if (tracePath.empty()) {
+        groups.push_back([]() {
+            size_t markers = 1 << 20;
+            auto markLoop = [markers]() {
+                for (size_t i = 0; i < markers; i++) {
+                    TRACE_SCOPE("marker");
+                    compilerBarrier();
+                }
+            };
+            std::vector<Case> cases;
+            for (bool on : {false, true}) {
+                cases.push_back({on ? "trace_marker/on" : "trace_marker/off", "markers", markers,
+                                 [on]() { trace::setEnabled(on); },
+                                 [markLoop]() {
+                    markLoop();
+                    trace::setEnabled(false);
+                    trace::clear();
+                }});
+            }
+            return cases;
+        });
+    }
+
+    std::string cowPath = data + "/obj_files/cow.obj";
+    if (!data.empty() && exists(cowPath)) {
+        groups.push_back([cowPath, rigs]() {
+            std::vector<Case> cases;
+            auto cow = std::make_shared<HalfEdgeMesh>();
+            cow->loadOBJ(QString::fromStdString(cowPath));
+            cases.push_back({"load_obj/cow", "faces", cow->faceCount(), nullptr, [cow, cowPath]() {
+                cow->loadOBJ(QString::fromStdString(cowPath));
+            }});
+
+            auto s = std::make_shared<Subject>();
+            s->name = "cow";
+            s->source = [cowPath](HalfEdgeMesh &m) { m.loadOBJ(QString::fromStdString(cowPath)); };
+            addMeshCases(cases, s, rigs, true);
+            return cases;
+        });
+    } else {
+        std::fprintf(stderr, "obj_files/cow.obj not found; pass --data to run its cases\n");
+    }
+
+    for (size_t faces = 1000; faces <= maxFaces; faces *= 10) {
+        groups.push_back([faces]() {
+            std::vector<Case> cases;
+            // Building is timed on every shape, each stressing it in its
+            // own way: boundaries, high valence or no shared edges at all.
+            for (std::string shape : {"torus", "holes", "sphere", "fans", "soup"}) {
+                auto polygons = std::make_shared<PolygonList>();
+                procedural::shape(shape, faces, *polygons);
+                auto built = std::make_shared<HalfEdgeMesh>();
+                cases.push_back({"build/" + shape + sizeName(faces), "faces", polygons->faceCount(), nullptr,
+                                 [polygons, built]() { polygons->build(*built); }});
+            }
+
+            // A torus has no open edges or irregular vertices, so the
+            // subdivision cases time the plain rules.
+            auto polygons = std::make_shared<PolygonList>();
+            procedural::shape("torus", faces, *polygons);
+            auto s = std::make_shared<Subject>();
+            s->name = "torus" + sizeName(faces);
+            s->source = [polygons](HalfEdgeMesh &m) { polygons->build(m); };
+            // A root, 4 children and 16 grandchildren across the torus.
+            // One conjugate gradient solve per joint gets slow past 100k faces.
+            addMeshCases(cases, s, {{"tree21", procedural::skeleton(*polygons, 2, 4)}}, faces <= 100000);
+            return cases;
+        });
+    }
+
+    trace::setThreadName("main");
+    trace::setEnabled(!tracePath.empty());
+    std::printf("%-36s %10s %10s %14s %12s %10s %10s\n",
+                "case", "min ms", "median ms", "items/s", "allocs", "peak MB", "tagged MB");
+    std::vector<Result> results;
+    std::deque<std::string> labels;
+    for (auto const &group : groups) {
+        for (const Case &c : group()) {
+            if (!filter.empty() && c.name.find(filter) == std::string::npos) {
+                continue;
+            }
+            // Single runs of the biggest cases already take seconds.
+            labels.push_back(c.name);
+            Result r = measure(c, c.items > 2000000 ? 1 : repeat, labels.back().c_str());
+            std::printf("%-36s %10.2f %10.2f %14.0f %12zu %10.1f %10.1f\n",
+                        r.name.c_str(), r.min(), r.median(), r.throughput(),
+                        r.allocs, r.peakRSS / double(1 << 20), r.tagPeak / double(1 << 20));
+            std::fflush(stdout);
+            results.push_back(r);
+        }
+    }
+
+    // Where the tagged memory went, at the worst case for each tag.
+    std::printf("\n%-36s %10s %12s\n", "tagged memory", "peak MB", "allocs");
+    for (size_t t = 0; t < memstats::TAG_COUNT; t++) {
+        size_t peak = 0;
+        for (const Result &r : results) {
+            peak = std::max(peak, r.tagPeaks[t]);
+        }
+        memstats::Counters c = memstats::counters(memstats::Tag(t));
+        if (c.allocations > 0) {
+            std::printf("%-36s %10.1f %12zu\n", memstats::tagName(memstats::Tag(t)), peak / double(1 << 20), c.allocations);
+        }
+    }
+    if (!jsonPath.empty()) {
+        writeJSON(jsonPath, results);
+    }
+    if (!tracePath.empty()) {
+        std::string error;
+        if (!trace::writeChromeJSON(tracePath, &error)) {
+            std::fprintf(stderr, "Cannot write trace: %s\n", error.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -80,6 +80,12 @@ glm::mat4 Camera::getViewProj()
     return glm::perspective(glm::radians(fovy), width / (float)height, near_clip, far_clip) * glm::lookAt(eye, ref, up);
 }
 
+Ray Camera::Raycast(float ndcX, float ndcY) const
+{
+    glm::vec3 p = ref + ndcX * H + ndcY * V;
+    return Ray{eye, glm::normalize(p - eye)};
+}
+
 void Camera::RecomputeAttributes()
 {
     glm::mat4 horiRot_tMat = glm::rotate(glm::mat4(1.0f), glm::radians(theta), glm::vec3(0, 1, 0));
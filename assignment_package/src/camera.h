@@ -1,6 +1,7 @@
 #pragma once
 
 #include <la.h>
+#include "spatial/ray.h"
 
 
 const glm::vec4 unit_look = glm::vec4(0, 0, 1, 0);
@@ -50,6 +51,9 @@ public:
 
 
     glm::mat4 getViewProj();
+    // The ray from the eye through the point at normalized device
+    // coordinates (ndcX, ndcY), both in [-1, 1] from the bottom left.
+    Ray Raycast(float ndcX, float ndcY) const;
 
     void RecomputeAttributes();
 };
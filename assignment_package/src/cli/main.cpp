@@ -0,0 +1,311 @@
+// micromaya-cli: runs mesh pipelines without a window or GL context,
+// on top of the core library. Every algorithm spreads over the global
+// thread pool, which has one thread per hardware thread.
+
+#include "halfedgemesh.h"
+#include "lod/decimator.h"
+#include "skeletonio.h"
+#include "profiling/memstats.h"
+#include "profiling/trace.h"
+#include "procedural/generators.h"
+#include "skinning/heatweights.h"
+#include "skinning/skinweights.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+    const char* USAGE =
+        "Usage: micromaya-cli <step>...\n"
+        "Runs the steps in order on one mesh and skeleton.\n"
+        "  load <file.obj>       Replaces the mesh.\n"
+        "  weld <tolerance>      Merges vertices of files loaded after it\n"
+        "                        that lie within tolerance, a fraction of\n"
+        "                        the bounding box diagonal; 0 merges only\n"
+        "                        exact duplicates, -1 turns welding off.\n"
+        "  generate <shape> <n>  Replaces the mesh with a shape of about n\n"
+        "                        faces: grid holes torus sphere fans soup.\n"
+        "  skeleton <file>       Loads a skeleton from .json or .skel.\n"
+        "  rig <depth> <fanout>  Replaces the skeleton with a tree fitted\n"
+        "                        to the mesh, fanout children per joint.\n"
+        "  triangulate           Splits every face into triangles.\n"
+        "  subdivide <n>         Runs n steps of Loop subdivision on\n"
+        "                        triangle meshes and of Catmull-Clark on\n"
+        "                        others.\n"
+        "  limit                 Moves every vertex onto the Catmull-Clark\n"
+        "                        limit surface, so a coarse mesh exports\n"
+        "                        as smooth as many more steps.\n"
+        "  decimate <ratio>      Collapses edges until about ratio of the\n"
+        "                        triangles are left, keeping the skin.\n"
+        "  skin nearest|heat     Binds the mesh to the skeleton.\n"
+        "  export <file.obj>     Writes the mesh.\n"
+        "  weights <file>        Writes the skin, one vertex per line:\n"
+        "                        joint0 joint1 weight0 weight1\n"
+        "  stats                 Prints the size of the mesh and the memory\n"
+        "                        of each subsystem.\n"
+        "  budget <MB>           Fails if tracked memory peaked above MB\n"
+        "                        since the last budget step.\n"
+        "  trace <file.json>     Traces the steps after it and writes the\n"
+        "                        trace for chrome://tracing or Perfetto.\n"
+        "Example:\n"
+        "  micromaya-cli weld 1e-6 load scan.obj decimate 0.1 export scan_lod.obj\n"
+        "  micromaya-cli load cow.obj subdivide 2 skeleton cow.json skin heat export out.obj\n"
+        "  micromaya-cli generate torus 1000000 rig 3 4 skin nearest stats\n";
+
+    struct Step {
+        std::string name;
+        std::string arg;
+        std::string arg2;
+    };
+
+    // Everything the steps work on.
+    struct Pipeline {
+        HalfEdgeMesh mesh;
+        SkeletonDesc skeleton;
+        bool meshLoaded = false;
+        bool skinned = false;
+        float weldTolerance = -1.f;
+        std::string tracePath;
+    };
+
+    int argumentCount(const std::string &name) {
+        if (name == "generate" || name == "rig") {
+            return 2;
+        }
+        if (name == "load" || name == "weld" || name == "skeleton" || name == "subdivide"
+            || name == "decimate" || name == "skin" || name == "export" || name == "weights" || name == "trace"
+            || name == "budget") {
+            return 1;
+        }
+        return 0;
+    }
+
+    bool isStep(const std::string &name) {
+        return argumentCount(name) > 0 || name == "triangulate" || name == "limit" || name == "stats";
+    }
+
+    bool endsWith(const std::string &s, const std::string &suffix) {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    bool fail(const std::string &message) {
+        std::fprintf(stderr, "%s\n", message.c_str());
+        return false;
+    }
+
+    bool run(Pipeline &p, const Step &step) {
+        if (step.name == "trace") {
+            p.tracePath = step.arg;
+            trace::setEnabled(true);
+            return true;
+        }
+        if (step.name == "budget") {
+            double budget = std::atof(step.arg.c_str());
+            double peak = memstats::totals().peak / double(1 << 20);
+            memstats::resetPeaks();
+            if (budget <= 0) {
+                return fail("budget takes a size in MB");
+            }
+            std::printf("  peak %.1f MB of %.1f MB\n", peak, budget);
+            if (peak > budget) {
+                return fail("Over budget\n" + memstats::report());
+            }
+            return true;
+        }
+        if (step.name == "weld") {
+            p.weldTolerance = float(std::atof(step.arg.c_str()));
+            return true;
+        }
+        if (step.name == "load") {
+            WeldStats weld;
+            if (!p.mesh.loadOBJ(QString::fromStdString(step.arg), nullptr, p.weldTolerance, &weld)) {
+                return fail("Cannot load " + step.arg);
+            }
+            if (p.weldTolerance >= 0.f) {
+                std::printf("  welded %zu vertices into %zu, dropped %zu corners and %zu faces in %.1f ms\n",
+                            weld.verticesIn, weld.verticesOut, weld.cornersDropped, weld.facesDropped, weld.ms);
+            }
+            p.meshLoaded = true;
+            p.skinned = false;
+            return true;
+        }
+        if (step.name == "generate") {
+            PolygonList polygons;
+            long long faces = std::atoll(step.arg2.c_str());
+            if (faces <= 0) {
+                return fail("generate takes a shape and a face count");
+            }
+            if (!procedural::shape(step.arg, size_t(faces), polygons)) {
+                return fail("Unknown shape " + step.arg + "; one of " + procedural::shapeNames());
+            }
+            if (!polygons.build(p.mesh)) {
+                return fail("Cannot build " + step.arg);
+            }
+            p.meshLoaded = true;
+            p.skinned = false;
+            return true;
+        }
+        if (step.name == "skeleton") {
+            std::string error;
+            bool ok = endsWith(step.arg, ".skel") ? skeletonio::loadBinary(step.arg, p.skeleton, &error)
+                                                  : skeletonio::loadJSON(step.arg, p.skeleton, &error);
+            if (!ok) {
+                return fail("Cannot load " + step.arg + ": " + error);
+            }
+            return true;
+        }
+
+        if (!p.meshLoaded) {
+            return fail(step.name + " needs a mesh; load one first");
+        }
+        if (step.name == "rig") {
+            int depth = std::atoi(step.arg.c_str()), fanOut = std::atoi(step.arg2.c_str());
+            if (depth < 0 || fanOut < 1) {
+                return fail("rig takes a depth and a fanout of at least 1");
+            }
+            PolygonList bounds;
+            p.mesh.flatten(bounds.positions, bounds.indices);
+            p.skeleton = procedural::skeleton(bounds, size_t(depth), size_t(fanOut));
+            std::printf("  %zu joints\n", p.skeleton.size());
+            p.skinned = false;
+        } else if (step.name == "triangulate") {
+            p.mesh.triangulate();
+            p.skinned = false;
+        } else if (step.name == "subdivide") {
+            int n = std::atoi(step.arg.c_str());
+            if (n < 0) {
+                return fail("subdivide takes a step count");
+            }
+            // Loop subdivision carries the skin over, Catmull-Clark does not.
+            for (int i = 0; i < n; i++) {
+                bool loop = p.mesh.isTriangleMesh();
+                p.mesh.refine();
+                p.skinned = loop && p.skinned;
+            }
+        } else if (step.name == "limit") {
+            size_t kept = p.mesh.snapToLimit();
+            std::printf("  %zu of %zu vertices moved\n", p.mesh.vertexCount() - kept, p.mesh.vertexCount());
+        } else if (step.name == "decimate") {
+            float ratio = float(std::atof(step.arg.c_str()));
+            if (ratio <= 0.f || ratio > 1.f) {
+                return fail("decimate takes a ratio in (0, 1]");
+            }
+            std::vector<uPtr<HalfEdgeMesh>> chain = buildLodChain(p.mesh, { ratio });
+            if (chain.empty()) {
+                return fail("Cannot decimate the mesh");
+            }
+            p.mesh = std::move(*chain[0]);
+            std::printf("  %zu triangles left\n", p.mesh.faceCount());
+        } else if (step.name == "skin") {
+            if (p.skeleton.size() == 0) {
+                return fail("skin needs a skeleton; load one first");
+            }
+            std::vector<glm::vec3> positions;
+            std::vector<uint32_t> triangles;
+            p.mesh.flatten(positions, triangles);
+            std::vector<glm::mat4> world = p.skeleton.worldTransforms();
+            std::vector<glm::vec3> jointPos(world.size());
+            for (size_t i = 0; i < world.size(); i++) {
+                jointPos[i] = glm::vec3(world[i][3]);
+            }
+            if (step.arg == "nearest") {
+                p.mesh.setSkin(nearestJointWeights(positions, jointPos));
+            } else if (step.arg == "heat") {
+                HeatWeights heat(positions, triangles);
+                p.mesh.setSkin(heat.solve(jointPos, p.skeleton.parents));
+                const HeatSolveStats &stats = heat.stats();
+                std::printf("  assemble %.1f ms, solve %.1f ms, max CG iterations %zu (%zu unconverged)\n",
+                            stats.assembleMs, stats.solveMs, stats.maxIterations, stats.unconverged);
+            } else {
+                return fail("skin takes nearest or heat");
+            }
+            p.skinned = true;
+        } else if (step.name == "export") {
+            if (!p.mesh.saveOBJ(QString::fromStdString(step.arg))) {
+                return fail("Cannot write " + step.arg);
+            }
+        } else if (step.name == "weights") {
+            if (!p.skinned) {
+                return fail("weights needs a skin; run skin after the last topology change");
+            }
+            std::ofstream out(step.arg);
+            SkinInfluences skin = p.mesh.skin();
+            for (size_t i = 0; i < skin.ids.size(); i++) {
+                out << skin.ids[i].x << ' ' << skin.ids[i].y << ' '
+                    << skin.weights[i].x << ' ' << skin.weights[i].y << '\n';
+            }
+            if (!out) {
+                return fail("Cannot write " + step.arg);
+            }
+        } else if (step.name == "stats") {
+            std::printf("  vertices %zu, faces %zu, %.1f MB\n%s",
+                        p.mesh.vertexCount(), p.mesh.faceCount(),
+                        p.mesh.memoryBytes() / double(1 << 20), memstats::report().c_str());
+        }
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // Read every step before running any, so a typo at the end
+    // does not surface only after a long subdivision.
+    std::vector<Step> steps;
+    for (int i = 1; i < argc; i++) {
+        Step step{argv[i], "", ""};
+        if (step.name == "-h" || step.name == "--help") {
+            std::printf("%s", USAGE);
+            return 0;
+        }
+        if (!isStep(step.name)) {
+            std::fprintf(stderr, "Unknown step %s\n\n%s", argv[i], USAGE);
+            return 2;
+        }
+        int count = argumentCount(step.name);
+        if (i + count >= argc) {
+            std::fprintf(stderr, "%s needs %d argument%s\n\n%s", argv[i], count, count > 1 ? "s" : "", USAGE);
+            return 2;
+        }
+        if (count > 0) {
+            step.arg = argv[++i];
+        }
+        if (count > 1) {
+            step.arg2 = argv[++i];
+        }
+        steps.push_back(step);
+    }
+    if (steps.empty()) {
+        std::fprintf(stderr, "%s", USAGE);
+        return 2;
+    }
+
+    trace::setThreadName("main");
+    Pipeline p;
+    bool ok = true;
+    for (const Step &step : steps) {
+        std::printf("%s %s %s\n", step.name.c_str(), step.arg.c_str(), step.arg2.c_str());
+        auto start = std::chrono::steady_clock::now();
+        // steps outlives the trace, so its names can label spans.
+        trace::Scope scope(step.name.c_str());
+        if (!run(p, step)) {
+            ok = false;
+            break;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::printf("  done in %.1f ms\n", ms);
+    }
+    // A trace of a failed run is still worth reading.
+    if (!p.tracePath.empty()) {
+        std::string error;
+        if (!trace::writeChromeJSON(p.tracePath, &error)) {
+            std::fprintf(stderr, "Cannot write trace: %s\n", error.c_str());
+            return 1;
+        }
+        std::printf("wrote %zu trace events to %s\n", trace::eventCount(), p.tracePath.c_str());
+    }
+    return ok ? 0 : 1;
+}
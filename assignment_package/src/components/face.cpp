@@ -1,13 +1,26 @@
 #include "face.h"
 
-size_t Face::next_id { 1 };
+std::atomic<size_t> Face::next_id{ 1 };
 
 Face::Face() : id(next_id++), half_edge()
 {
-    QListWidgetItem::setText(QString::number(id));
+    setItemLabel(*this, id);
     // Generate a random color for each face.
     float r = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
     float g = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
     float b = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
     color = glm::vec3(r, g, b);
 }
+
+Face::Face(size_t id) : id(id), color(), half_edge()
+{
+    setItemLabel(*this, id);
+}
+
+void* Face::operator new(size_t size) {
+    return allocateComponent(memstats::Tag::FACES, size);
+}
+
+void Face::operator delete(void* p, size_t size) {
+    freeComponent(memstats::Tag::FACES, p, size);
+}
@@ -2,26 +2,37 @@
 #define FACE_H
 
 #include "la.h"
-#include <QListWidgetItem>
+#include "components/listitem.h"
+#include <atomic>
 
 class HalfEdge;
 
-class Face : public QListWidgetItem
+class Face : public ListItem
 {
 private:
-    static size_t next_id;
+    // Atomic since meshes are also built on worker threads.
+    static std::atomic<size_t> next_id;
 
     size_t id;
     glm::vec3 color;
     HalfEdge* half_edge;
 
     friend class Mesh;
+    friend class HalfEdgeMesh;
+    friend class MeshDelta;
     friend class HalfEdge;
     friend class FaceDisplay;
     friend class MyGL;
 
+    // For faces whose ids were reserved up front. Takes no random color.
+    explicit Face(size_t id);
+
 public:
     Face();
+
+    // Counted by memstats.
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
 };
 
 #endif // FACE_H
@@ -1,11 +1,15 @@
 #include "halfedge.h"
 
-size_t HalfEdge::next_id { 1 };
+std::atomic<size_t> HalfEdge::next_id{ 1 };
 
 HalfEdge::HalfEdge()
-    : id(next_id++), next(), vertex(), sym(), face()
+    : HalfEdge(next_id++)
+{}
+
+HalfEdge::HalfEdge(size_t id)
+    : id(id), next(), vertex(), sym(), face()
 {
-    QListWidgetItem::setText(QString::number(id));
+    setItemLabel(*this, id);
 }
 
 void HalfEdge::set_vertex(Vertex* vertex)
@@ -30,3 +34,11 @@ void HalfEdge::set_sym(HalfEdge* sym_edge)
     this->sym = sym_edge;
     sym_edge->sym = this;
 }
+
+void* HalfEdge::operator new(size_t size) {
+    return allocateComponent(memstats::Tag::HALF_EDGES, size);
+}
+
+void HalfEdge::operator delete(void* p, size_t size) {
+    freeComponent(memstats::Tag::HALF_EDGES, p, size);
+}
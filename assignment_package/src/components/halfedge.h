@@ -3,12 +3,14 @@
 
 #include "components/face.h"
 #include "components/vertex.h"
-#include <QListWidgetItem>
+#include "components/listitem.h"
+#include <atomic>
 
-class HalfEdge : public QListWidgetItem
+class HalfEdge : public ListItem
 {
 private:
-    static size_t next_id;
+    // Atomic since meshes are also built on worker threads.
+    static std::atomic<size_t> next_id;
 
     size_t id;
     HalfEdge* next;
@@ -17,13 +19,22 @@ private:
     Face* face;
 
     friend class Mesh;
+    friend class HalfEdgeMesh;
+    friend class MeshDelta;
     friend class HalfEdgeDisplay;
     friend class FaceDisplay;
     friend class MyGL;
 
+    // For half-edges whose ids were reserved up front.
+    explicit HalfEdge(size_t id);
+
 public:
     HalfEdge();
 
+    // Counted by memstats.
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+
     void set_vertex(Vertex* vertex);
     void set_face(Face* face);
     void set_next(HalfEdge* next);
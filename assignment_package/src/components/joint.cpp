@@ -6,14 +6,14 @@ Joint::Joint(OpenGLContext* context)
     : QTreeWidgetItem(), Drawable(context), name(""), id(next_id++),
     parent(nullptr), children(std::vector<uPtr<Joint>>()),
     pos(glm::vec3()), rot(glm::quat()), bind(glm::mat4()),
-    selected(false)
+    overallT(glm::mat4(1.f)), selected(false)
 {}
 
 Joint::Joint(const Joint &j) : QTreeWidgetItem(), Drawable(j.mp_context),
                                name(j.name), id(j.id),
                                parent(j.parent),
                                pos(j.pos), rot(j.rot), bind(j.bind),
-                               selected(j.selected)
+                               overallT(j.overallT), selected(j.selected)
 {
     QTreeWidgetItem::setText(0, name);
     // Create deep copy of the children.
@@ -61,19 +61,15 @@ void Joint::create() {
     glm::vec4 blue = glm::vec4(0, 0, 1, 0);
 
     // Circle 1
-    std::vector<glm::vec4> circlePos = getCirclePos();
-    std::vector<glm::vec4> circlePosXY;
-    for (auto const &p : circlePos) {
-        circlePosXY.push_back(getOverallTransformation() * p);
-    }
+    std::vector<glm::vec4> circlePosXY = getCirclePos();
     pushCircle(posVBO, norVBO, colVBO, idx, circlePosXY,
                selected ? white : blue);
 
     // Circle 2
     std::vector<glm::vec4> circlePosXZ;
     glm::mat4 M = glm::rotate(glm::mat4(1.f), glm::radians(90.0f), glm::vec3(1, 0, 0));
-    for (auto const &p : circlePos) {
-        circlePosXZ.push_back(getOverallTransformation() * M * p);
+    for (auto const &p : circlePosXY) {
+        circlePosXZ.push_back(M * p);
     }
     pushCircle(posVBO, norVBO, colVBO, idx, circlePosXZ,
                selected ? white : green);
@@ -81,16 +77,18 @@ void Joint::create() {
     // Circle 3
     std::vector<glm::vec4> circlePosYZ;
     M = glm::rotate(glm::mat4(1.f), glm::radians(90.0f), glm::vec3(0, 1, 0));
-    for (auto const &p : circlePos) {
-        circlePosYZ.push_back(getOverallTransformation() * M * p);
+    for (auto const &p : circlePosXY) {
+        circlePosYZ.push_back(M * p);
     }
     pushCircle(posVBO, norVBO, colVBO, idx, circlePosYZ,
                selected ? white : red);
 
-    // Draw an edge from this joint to its parent.
-    if (parent != nullptr) {
-        posVBO.push_back(getOverallTransformation() * glm::vec4(0, 0, 0, 1));
-        posVBO.push_back(parent->getOverallTransformation() * glm::vec4(0, 0, 0, 1));
+    // Draw an edge from this joint to each of its children.
+    // A child's offset in this joint's space is its local position,
+    // which does not change when either joint is rotated.
+    for (auto const &c : children) {
+        posVBO.push_back(glm::vec4(c->pos, 1));
+        posVBO.push_back(glm::vec4(0, 0, 0, 1));
         // This is just an arbitrary normal
         // since we're rendering the joint display
         // with the flat shader.
@@ -98,10 +96,10 @@ void Joint::create() {
         norVBO.push_back(glm::normalize(glm::vec4(1.f)));
         colVBO.push_back(glm::vec4(1, 1, 0, 0));
         colVBO.push_back(glm::vec4(1, 0, 0, 0));
-    }
 
-    idx.push_back(posVBO.size() - 2);
-    idx.push_back(posVBO.size() - 1);
+        idx.push_back(posVBO.size() - 2);
+        idx.push_back(posVBO.size() - 1);
+    }
 
     count = idx.size();
 
@@ -127,40 +125,6 @@ GLenum Joint::drawMode() {
     return GL_LINES;
 }
 
-void Joint::read(const QJsonObject &json, Joint* parent) {
-    // Parse name and position
-    setName(json["name"].toString());
-    for (int i = 0; i < 3; i++) {
-        pos[i] = json["pos"][i].toDouble();
-    }
-
-    // Parse rotation
-    float angle = glm::radians(json["rot"][0].toDouble());
-    float qx = json["rot"][1].toDouble() * glm::sin(angle / 2);
-    float qy = json["rot"][2].toDouble() * glm::sin(angle / 2);
-    float qz = json["rot"][3].toDouble() * glm::sin(angle / 2);
-    float qw = glm::cos(angle / 2);
-    rot = glm::quat(qw, qx, qy, qz);
-
-    // Add this joint as a child to its parents
-    if (parent != nullptr) {
-        this->parent = parent;
-        parent->children.push_back(mkU<Joint>(*this));
-        parent->QTreeWidgetItem::addChild(parent->children.back().get());
-    }
-
-    // Parse children and set parent
-    QJsonArray children_obj = json["children"].toArray();
-    for (auto const &c : children_obj) {
-        Joint child = Joint(this->mp_context);
-        if (parent == nullptr) {
-            child.read(c.toObject(), this);
-        } else {
-            child.read(c.toObject(), parent->children.back().get());
-        }
-    }
-}
-
 //--------------------------------------------------
 // Helper functions
 //--------------------------------------------------
@@ -5,9 +5,7 @@
 #include "smartpointerhelp.h"
 #include "drawable.h"
 
-#include <QJsonObject>
 #include <QTreeWidgetItem>
-#include <QJsonArray>
 
 class Joint : public QTreeWidgetItem, public Drawable {
 private:
@@ -23,6 +21,9 @@ private:
     glm::vec3 pos;
     glm::quat rot;
     glm::mat4 bind;
+    // Cached overall transformation of the current pose.
+    // Refreshed top-down by MyGL::updatePose.
+    glm::mat4 overallT;
 
     bool selected;
 
@@ -61,13 +62,14 @@ public:
 
     // Creates VBO data to make a visual
     // representation of the currently selected Joint
-    // and a line to its parent.
+    // and a line to each of its children.
+    // The geometry is built in the joint's local space
+    // and positioned at draw time with overallT as the model matrix,
+    // so posing a joint never requires rebuilding it.
     void create() override;
 
     GLenum drawMode() override;
 
-    void read(const QJsonObject &json, Joint*  parent);
-
 private:
     //--------------------------------------------------------------------------------
     // Private helper functions
@@ -0,0 +1,53 @@
+#ifndef LISTITEM_H
+#define LISTITEM_H
+
+#include "profiling/memstats.h"
+#include <cstddef>
+
+// The GUI lists mesh components by handing the components themselves
+// to its list widgets, so they derive from QListWidgetItem. The core
+// library is built with MICROMAYA_CORE and links no widgets; there they
+// derive from an empty stand-in and skip their labels.
+#ifdef MICROMAYA_CORE
+
+class ListItem {
+public:
+    virtual ~ListItem() = default;
+};
+
+inline void setItemLabel(ListItem &, size_t) {}
+
+// Only the vtable pointer, which belongs to the component.
+const size_t LIST_ITEM_BYTES = 0;
+
+#else
+
+#include <QListWidgetItem>
+
+typedef QListWidgetItem ListItem;
+
+inline void setItemLabel(ListItem &item, size_t id) {
+    MEMORY_SCOPE(LIST_ITEMS);
+    item.setText(QString::number(id));
+}
+
+const size_t LIST_ITEM_BYTES = sizeof(ListItem);
+
+#endif
+
+// Components count their memory under their own tag, less the list
+// item they derive from, which counts under LIST_ITEMS.
+inline void* allocateComponent(memstats::Tag tag, size_t size) {
+    void* p = memstats::allocate(tag, size);
+    memstats::transfer(tag, memstats::Tag::LIST_ITEMS, LIST_ITEM_BYTES);
+    return p;
+}
+
+inline void freeComponent(memstats::Tag tag, void* p, size_t size) {
+    if (p != nullptr) {
+        memstats::transfer(memstats::Tag::LIST_ITEMS, tag, LIST_ITEM_BYTES);
+        memstats::deallocate(tag, p, size);
+    }
+}
+
+#endif // LISTITEM_H
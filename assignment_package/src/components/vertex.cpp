@@ -1,9 +1,20 @@
 #include "vertex.h"
 
-size_t Vertex::next_id{ 1 };
+std::atomic<size_t> Vertex::next_id{ 1 };
 
-Vertex::Vertex(glm::vec3 pos) : id(next_id++), pos(pos), half_edge(),
-                                infl_joints{nullptr, nullptr}, infl_weights{0, 0}
+Vertex::Vertex(glm::vec3 pos) : Vertex(next_id++, pos)
+{}
+
+Vertex::Vertex(size_t id, glm::vec3 pos) : id(id), pos(pos), half_edge(),
+                                           infl_ids{0, 0}, infl_weights{0, 0}
 {
-    QListWidgetItem::setText(QString::number(id));
+    setItemLabel(*this, id);
+}
+
+void* Vertex::operator new(size_t size) {
+    return allocateComponent(memstats::Tag::VERTICES, size);
+}
+
+void Vertex::operator delete(void* p, size_t size) {
+    freeComponent(memstats::Tag::VERTICES, p, size);
 }
@@ -2,32 +2,42 @@
 #define VERTEX_H
 
 #include "la.h"
-#include "components/joint.h"
-#include <QListWidgetItem>
+#include "components/listitem.h"
+#include <atomic>
 
 class HalfEdge;
 
-class Vertex : public QListWidgetItem
+class Vertex : public ListItem
 {
 private:
-    static size_t next_id;
+    // Atomic since meshes are also built on worker threads.
+    static std::atomic<size_t> next_id;
 
     size_t id;
     glm::vec3 pos;
     HalfEdge* half_edge;
 
-    Joint* infl_joints[2];
+    int infl_ids[2];            // Ids of the two joints it follows.
     float infl_weights[2];
 
     friend class Mesh;
+    friend class HalfEdgeMesh;
+    friend class MeshDelta;
     friend class HalfEdge;
     friend class VertexDisplay;
     friend class HalfEdgeDisplay;
     friend class FaceDisplay;
     friend class MyGL;
 
+    // For vertices whose ids were reserved up front.
+    Vertex(size_t id, glm::vec3 pos);
+
 public:
     Vertex(glm::vec3 pos);
+
+    // Counted by memstats.
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
 };
 
 
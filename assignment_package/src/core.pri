@@ -0,0 +1,65 @@
+# Geometry, skeletons, I/O and algorithms, free of widgets and GL.
+# The GUI compiles these along with its own files; the core library
+# and the CLI build them with MICROMAYA_CORE.
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/components/face.cpp \
+    $$PWD/components/halfedge.cpp \
+    $$PWD/components/vertex.cpp \
+    $$PWD/vertexcache.cpp \
+    $$PWD/spatial/bvh.cpp \
+    $$PWD/spatial/weld.cpp \
+    $$PWD/procedural/generators.cpp \
+    $$PWD/lod/decimator.cpp \
+    $$PWD/subdivision/loop.cpp \
+    $$PWD/subdivision/limit.cpp \
+    $$PWD/skeletonio.cpp \
+    $$PWD/animation/animationclip.cpp \
+    $$PWD/animation/animationplayer.cpp \
+    $$PWD/animation/clipcompressor.cpp \
+    $$PWD/animation/bvhimporter.cpp \
+    $$PWD/animation/crowd.cpp \
+    $$PWD/skinning/heatweights.cpp \
+    $$PWD/skinning/skinweights.cpp \
+    $$PWD/halfedgemesh.cpp \
+    $$PWD/meshdelta.cpp \
+    $$PWD/edithistory.cpp \
+    $$PWD/jobs/threadpool.cpp \
+    $$PWD/jobs/job.cpp \
+    $$PWD/profiling/trace.cpp \
+    $$PWD/profiling/memstats.cpp
+
+HEADERS += \
+    $$PWD/components/face.h \
+    $$PWD/components/halfedge.h \
+    $$PWD/components/vertex.h \
+    $$PWD/components/listitem.h \
+    $$PWD/la.h \
+    $$PWD/vertexcache.h \
+    $$PWD/spatial/ray.h \
+    $$PWD/spatial/bvh.h \
+    $$PWD/spatial/weld.h \
+    $$PWD/procedural/generators.h \
+    $$PWD/lod/decimator.h \
+    $$PWD/subdivision/loop.h \
+    $$PWD/subdivision/limit.h \
+    $$PWD/smartpointerhelp.h \
+    $$PWD/parsenumber.h \
+    $$PWD/skeletonio.h \
+    $$PWD/animation/animationclip.h \
+    $$PWD/animation/animationplayer.h \
+    $$PWD/animation/clipcompressor.h \
+    $$PWD/animation/bvhimporter.h \
+    $$PWD/animation/crowd.h \
+    $$PWD/skinning/heatweights.h \
+    $$PWD/skinning/skinweights.h \
+    $$PWD/parallel.h \
+    $$PWD/halfedgemesh.h \
+    $$PWD/meshdelta.h \
+    $$PWD/edithistory.h \
+    $$PWD/jobs/threadpool.h \
+    $$PWD/jobs/job.h \
+    $$PWD/profiling/trace.h \
+    $$PWD/profiling/memstats.h
@@ -2,8 +2,12 @@
 #include <la.h>
 
 Drawable::Drawable(OpenGLContext* context)
-    : count(-1), bufIdx(), bufPos(), bufNor(), bufCol(),
+    : count(-1), bufIdx(), bufPos(), bufNor(), bufCol(), bufWts(), bufIDs(),
+      wtsBound(false), IDsBound(false),
       idxBound(false), posBound(false), norBound(false), colBound(false),
+      posFormat{4, GL_FLOAT, GL_FALSE}, norFormat{4, GL_FLOAT, GL_FALSE}, colFormat{4, GL_FLOAT, GL_FALSE},
+      wtsFormat{2, GL_FLOAT, GL_FALSE}, IDsFormat{2, GL_INT, GL_FALSE},
+      posOffset(0.f), posScale(1.f), octNormals(false), smoothNormals(false), faceColors(false),
       mp_context(context)
 {}
 
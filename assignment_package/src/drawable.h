@@ -4,6 +4,13 @@
 #include <openglcontext.h>
 #include <la.h>
 
+// How an attribute is stored in its VBO, as glVertexAttribPointer takes it.
+struct AttribFormat {
+    GLint size;             // Components per vertex.
+    GLenum type;            // GL_FLOAT, GL_SHORT, GL_UNSIGNED_BYTE, ...
+    GLboolean normalized;   // Integers are read as [0, 1] or [-1, 1].
+};
+
 //This defines a class which can be rendered by our shader program.
 //Make any geometry a subclass of ShaderProgram::Drawable in order to render it with the ShaderProgram class.
 class Drawable
@@ -27,10 +34,21 @@ protected:
     bool norBound;
     bool colBound;
 
+    // Attribute layouts, vec4 floats (vec2 floats and ivec2 ints
+    // for skinning) unless a subclass packs its data tighter.
+    AttribFormat posFormat, norFormat, colFormat, wtsFormat, IDsFormat;
+    // Positions are decoded as posOffset + posScale * stored position,
+    // so quantized positions can span the bounds of the geometry.
+    glm::vec3 posOffset, posScale;
+    bool octNormals;        // Normals are octahedral encoded in .xy.
+    bool smoothNormals;     // Normals are interpolated, not taken from the provoking vertex.
+    bool faceColors;        // Colors come from per-face attributes, not vs_Col.
+
     OpenGLContext* mp_context; // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                           // we need to pass our OpenGL context to the Drawable in order to call GL functions
                           // from within this class.
 
+    friend class ShaderProgram;
 
 public:
     Drawable(OpenGLContext* context);
@@ -0,0 +1,114 @@
+#include "edithistory.h"
+#include "profiling/memstats.h"
+
+EditCommand::EditCommand(const QString &name, uPtr<MeshDelta> delta, const void* mergeKey)
+    : name(name), mergeKey(mergeKey), delta(std::move(delta)), other(nullptr)
+{}
+
+EditCommand::EditCommand(const QString &name, uPtr<HalfEdgeMesh> other)
+    : name(name), mergeKey(nullptr), delta(nullptr), other(std::move(other))
+{}
+
+size_t EditCommand::memoryBytes() const {
+    size_t b = sizeof(EditCommand);
+    if (delta != nullptr) {
+        b += delta->memoryBytes();
+    }
+    if (other != nullptr) {
+        b += other->memoryBytes();
+    }
+    return b;
+}
+
+EditHistory::EditHistory(size_t budget)
+    : commands(), applied(0), budget(budget), bytes(0)
+{}
+
+void EditHistory::push(EditCommand command) {
+    MEMORY_SCOPE(HISTORY);
+    while (commands.size() > applied) {
+        bytes -= commands.back().memoryBytes();
+        commands.pop_back();
+    }
+
+    if (!commands.empty() && command.mergeKey != nullptr) {
+        EditCommand &last = commands.back();
+        if (last.name == command.name && last.mergeKey == command.mergeKey
+                && last.delta != nullptr && command.delta != nullptr) {
+            bytes -= last.memoryBytes();
+            bool merged = last.delta->merge(*command.delta);
+            bytes += last.memoryBytes();
+            if (merged) {
+                // The merged command grows too, so it must fit as well.
+                trim();
+                return;
+            }
+        }
+    }
+
+    bytes += command.memoryBytes();
+    commands.push_back(std::move(command));
+    applied = commands.size();
+    trim();
+}
+
+void EditHistory::clear() {
+    commands.clear();
+    applied = 0;
+    bytes = 0;
+}
+
+bool EditHistory::canUndo() const {
+    return applied > 0;
+}
+
+bool EditHistory::canRedo() const {
+    return applied < commands.size();
+}
+
+EditCommand& EditHistory::nextUndo() {
+    bytes -= commands[applied - 1].memoryBytes();
+    return commands[applied - 1];
+}
+
+EditCommand& EditHistory::nextRedo() {
+    bytes -= commands[applied].memoryBytes();
+    return commands[applied];
+}
+
+void EditHistory::finishUndo() {
+    applied--;
+    bytes += commands[applied].memoryBytes();
+}
+
+void EditHistory::finishRedo() {
+    bytes += commands[applied].memoryBytes();
+    applied++;
+}
+
+void EditHistory::setBudget(size_t budgetBytes) {
+    budget = budgetBytes;
+    trim();
+}
+
+size_t EditHistory::getBudget() const {
+    return budget;
+}
+
+size_t EditHistory::memoryBytes() const {
+    return bytes;
+}
+
+size_t EditHistory::size() const {
+    return commands.size();
+}
+
+// Forgets the oldest done commands until the history fits.
+// Commands that can be redone are newer and are kept.
+void EditHistory::trim() {
+    while (bytes > budget && applied > 1) {
+        bytes -= commands.front().memoryBytes();
+        commands.pop_front();
+        applied--;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef EDITHISTORY_H
+#define EDITHISTORY_H
+
+#include "meshdelta.h"
+#include <QString>
+#include <deque>
+
+// One undoable step. Edits made in place keep a delta. Edits that
+// build a whole new mesh keep the mesh on the other side of the edit
+// instead, which undo and redo swap with the current one.
+struct EditCommand {
+    QString name;
+    // Consecutive edits with the same name and key are merged.
+    const void* mergeKey;
+    uPtr<MeshDelta> delta;
+    uPtr<HalfEdgeMesh> other;
+
+    EditCommand(const QString &name, uPtr<MeshDelta> delta, const void* mergeKey = nullptr);
+    EditCommand(const QString &name, uPtr<HalfEdgeMesh> other);
+
+    size_t memoryBytes() const;
+};
+
+// A linear undo history that keeps its commands within a memory budget
+// by forgetting the oldest ones. The newest command is always kept.
+class EditHistory {
+private:
+    std::deque<EditCommand> commands;
+    size_t applied;     // Commands before this index are done.
+    size_t budget;
+    size_t bytes;
+
+public:
+    explicit EditHistory(size_t budget = 64 << 20);
+
+    // Records a command that has just been done, dropping
+    // everything that could have been redone.
+    void push(EditCommand command);
+    void clear();
+
+    bool canUndo() const;
+    bool canRedo() const;
+    // The command to undo or redo. The caller applies it to the
+    // mesh, then calls the matching finish so memory is re-counted.
+    EditCommand& nextUndo();
+    EditCommand& nextRedo();
+    void finishUndo();
+    void finishRedo();
+
+    void setBudget(size_t budgetBytes);
+    size_t getBudget() const;
+    size_t memoryBytes() const;
+    size_t size() const;
+
+private:
+    void trim();
+};
+
+#endif // EDITHISTORY_H
@@ -0,0 +1,131 @@
+#include "faceattributes.h"
+#include <algorithm>
+
+FaceAttributes::FaceAttributes(OpenGLContext* context)
+    : texels(), dirtyBegin(0), dirtyEnd(0),
+      triangleFaces(), trianglesDirty(false),
+      faceBuf(), faceTex(), triBuf(), triTex(), created(false), gpuCapacity(0),
+      mp_context(context)
+{}
+
+FaceAttributes::~FaceAttributes() {
+    destroy();
+}
+
+void FaceAttributes::markDirty(size_t face) {
+    if (dirtyBegin == dirtyEnd) {
+        dirtyBegin = face;
+        dirtyEnd = face + 1;
+    } else {
+        dirtyBegin = std::min(dirtyBegin, face);
+        dirtyEnd = std::max(dirtyEnd, face + 1);
+    }
+}
+
+void FaceAttributes::resize(size_t faceCount) {
+    texels.resize(faceCount * 2, 0);
+    dirtyBegin = 0;
+    dirtyEnd = faceCount;
+}
+
+size_t FaceAttributes::size() const {
+    return texels.size() / 2;
+}
+
+void FaceAttributes::setColor(size_t face, const glm::vec3 &color) {
+    uint32_t packed = 0;
+    for (int c = 0; c < 3; c++) {
+        packed |= uint32_t(glm::clamp(color[c], 0.f, 1.f) * 255.f + 0.5f) << (8 * c);
+    }
+    texels[face * 2] = packed;
+    markDirty(face);
+}
+
+void FaceAttributes::setFlags(size_t face, uint32_t flags) {
+    texels[face * 2 + 1] = (texels[face * 2 + 1] & ~0xffu) | (flags & 0xffu);
+    markDirty(face);
+}
+
+uint32_t FaceAttributes::getFlags(size_t face) const {
+    return texels[face * 2 + 1] & 0xffu;
+}
+
+void FaceAttributes::setMaterial(size_t face, uint32_t material) {
+    texels[face * 2 + 1] = (texels[face * 2 + 1] & 0xffu) | (material << 8);
+    markDirty(face);
+}
+
+void FaceAttributes::setTriangleFaces(std::vector<uint32_t> faces) {
+    triangleFaces = std::move(faces);
+    trianglesDirty = true;
+}
+
+uint32_t FaceAttributes::triangleFace(size_t triangle) const {
+    return triangleFaces[triangle];
+}
+
+void FaceAttributes::upload() {
+    if (!created) {
+        mp_context->glGenBuffers(1, &faceBuf);
+        mp_context->glGenTextures(1, &faceTex);
+        mp_context->glGenBuffers(1, &triBuf);
+        mp_context->glGenTextures(1, &triTex);
+        created = true;
+    }
+
+    mp_context->glBindBuffer(GL_TEXTURE_BUFFER, faceBuf);
+    if (gpuCapacity < size()) {
+        // Grow the buffer and send everything.
+        gpuCapacity = std::max<size_t>(size(), 1);
+        mp_context->glBufferData(GL_TEXTURE_BUFFER, gpuCapacity * 2 * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+        dirtyBegin = 0;
+        dirtyEnd = size();
+
+        mp_context->glBindTexture(GL_TEXTURE_BUFFER, faceTex);
+        mp_context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, faceBuf);
+    }
+    if (dirtyBegin < dirtyEnd) {
+        mp_context->glBufferSubData(GL_TEXTURE_BUFFER,
+                                    dirtyBegin * 2 * sizeof(uint32_t),
+                                    (dirtyEnd - dirtyBegin) * 2 * sizeof(uint32_t),
+                                    &texels[dirtyBegin * 2]);
+    }
+    dirtyBegin = dirtyEnd = 0;
+
+    if (trianglesDirty) {
+        mp_context->glBindBuffer(GL_TEXTURE_BUFFER, triBuf);
+        mp_context->glBufferData(GL_TEXTURE_BUFFER, triangleFaces.size() * sizeof(uint32_t),
+                                 triangleFaces.data(), GL_STATIC_DRAW);
+        mp_context->glBindTexture(GL_TEXTURE_BUFFER, triTex);
+        mp_context->glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, triBuf);
+        trianglesDirty = false;
+    }
+}
+
+void FaceAttributes::bind(GLuint faceUnit, GLuint triangleUnit) {
+    if (!created) {
+        return;
+    }
+    mp_context->glActiveTexture(GL_TEXTURE0 + faceUnit);
+    mp_context->glBindTexture(GL_TEXTURE_BUFFER, faceTex);
+    mp_context->glActiveTexture(GL_TEXTURE0 + triangleUnit);
+    mp_context->glBindTexture(GL_TEXTURE_BUFFER, triTex);
+    mp_context->glActiveTexture(GL_TEXTURE0);
+}
+
+void FaceAttributes::destroy() {
+    if (!created) {
+        return;
+    }
+    mp_context->glDeleteBuffers(1, &faceBuf);
+    mp_context->glDeleteTextures(1, &faceTex);
+    mp_context->glDeleteBuffers(1, &triBuf);
+    mp_context->glDeleteTextures(1, &triTex);
+    created = false;
+    gpuCapacity = 0;
+    trianglesDirty = true;
+}
+
+size_t FaceAttributes::memoryBytes() const {
+    return created ? (gpuCapacity * 2 + triangleFaces.size()) * sizeof(uint32_t) : 0;
+}
@@ -0,0 +1,60 @@
+#ifndef FACEATTRIBUTES_H
+#define FACEATTRIBUTES_H
+
+#include <openglcontext.h>
+#include <la.h>
+#include <cstdint>
+#include <vector>
+
+// Attributes stored once per face in a texture buffer and looked up by
+// the fragment shader, rather than copied into every vertex of the face.
+// Each face is one RG32UI texel: .r holds the color as RGBA8 and .g the
+// flags in its low byte and a material id above them. A second buffer
+// maps gl_PrimitiveID, the triangle being drawn, to its face.
+// As with JointPalette only the faces changed since the last upload are sent.
+class FaceAttributes
+{
+private:
+    std::vector<uint32_t> texels;       // Two per face.
+    size_t dirtyBegin, dirtyEnd;        // In faces.
+    std::vector<uint32_t> triangleFaces;
+    bool trianglesDirty;
+
+    GLuint faceBuf, faceTex;
+    GLuint triBuf, triTex;
+    bool created;
+    size_t gpuCapacity;
+
+    OpenGLContext* mp_context;
+
+    void markDirty(size_t face);
+
+public:
+    // Flag bits.
+    static const uint32_t SELECTED = 1;
+
+    FaceAttributes(OpenGLContext* context);
+    ~FaceAttributes();
+
+    // Sets the number of faces. New faces are black with no flags.
+    void resize(size_t faceCount);
+    size_t size() const;
+
+    void setColor(size_t face, const glm::vec3 &color);
+    void setFlags(size_t face, uint32_t flags);
+    uint32_t getFlags(size_t face) const;
+    void setMaterial(size_t face, uint32_t material);
+    // Sets the face of every triangle, in index buffer order.
+    void setTriangleFaces(std::vector<uint32_t> faces);
+    uint32_t triangleFace(size_t triangle) const;
+
+    // Sends the changed faces, and the triangle map if it changed, to the GPU.
+    void upload();
+    // Binds the face texels and the triangle map to the given texture units.
+    void bind(GLuint faceUnit, GLuint triangleUnit);
+    void destroy();
+    // Bytes of both buffers on the GPU.
+    size_t memoryBytes() const;
+};
+
+#endif // FACEATTRIBUTES_H
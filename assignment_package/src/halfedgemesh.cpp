@@ -0,0 +1,1179 @@
+#include "halfedgemesh.h"
+#include "meshdelta.h"
+#include "parallel.h"
+#include "profiling/trace.h"
+#include "subdivision/loop.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+HalfEdgeMesh::HalfEdgeMesh()
+    : faces(), half_edges(), vertices()
+{}
+
+HalfEdgeMesh::~HalfEdgeMesh() {}
+
+uPtr<HalfEdgeMesh> HalfEdgeMesh::clone() const {
+    uPtr<HalfEdgeMesh> copy = mkU<HalfEdgeMesh>();
+    std::unordered_map<const Vertex*, Vertex*, PTRHASH> vmap;
+    std::unordered_map<const HalfEdge*, HalfEdge*, PTRHASH> hmap;
+    std::unordered_map<const Face*, Face*, PTRHASH> fmap;
+    vmap.reserve(vertices.size());
+    hmap.reserve(half_edges.size());
+    fmap.reserve(faces.size());
+
+    // Copy every component, keeping its id, then point the
+    // copies at each other instead of at the originals.
+    copy->vertices.reserve(vertices.size());
+    for (auto const &v : vertices) {
+        copy->vertices.push_back(mkU<Vertex>(*v));
+        vmap[v.get()] = copy->vertices.back().get();
+    }
+    copy->half_edges.reserve(half_edges.size());
+    for (auto const &he : half_edges) {
+        copy->half_edges.push_back(mkU<HalfEdge>(*he));
+        hmap[he.get()] = copy->half_edges.back().get();
+    }
+    copy->faces.reserve(faces.size());
+    for (auto const &f : faces) {
+        copy->faces.push_back(mkU<Face>(*f));
+        fmap[f.get()] = copy->faces.back().get();
+    }
+    hmap[nullptr] = nullptr;
+    fmap[nullptr] = nullptr;
+    vmap[nullptr] = nullptr;
+
+    for (auto const &v : copy->vertices) {
+        v->half_edge = hmap.at(v->half_edge);
+    }
+    for (auto const &he : copy->half_edges) {
+        he->next = hmap.at(he->next);
+        he->sym = hmap.at(he->sym);
+        he->vertex = vmap.at(he->vertex);
+        he->face = fmap.at(he->face);
+    }
+    for (auto const &f : copy->faces) {
+        f->half_edge = hmap.at(f->half_edge);
+    }
+    return copy;
+}
+
+// In order to ensure key pairs match regardless of order,
+// we ensure the vertex pointer with the smaller address is
+// always first.
+ENDPT HalfEdgeMesh::generateKey(Vertex* v1, Vertex* v2) {
+    if (v1 < v2) {
+        return ENDPT(v1, v2);
+    }
+    return ENDPT(v2, v1);
+}
+
+bool HalfEdgeMesh::parseOBJ(QTextStream &in, qint64 fileSize, JobControl* control,
+                            std::vector<glm::vec3> &positions,
+                            std::vector<uint32_t> &faceStarts, std::vector<uint32_t> &indices) {
+    positions.clear();
+    faceStarts.assign(1, 0);
+    indices.clear();
+    for (size_t lineCount = 0; !in.atEnd(); lineCount++) {
+        QString line = in.readLine();
+
+        if (control != nullptr && lineCount % 4096 == 0) {
+            if (control->isCancelled()) {
+                return false;
+            }
+            control->setProgress(float(in.pos()) / fileSize);
+        }
+        if (line.size() < 2) {
+            continue;
+        }
+        if (line.first(2) == "v ") {
+            QStringList list = line.split(' ');
+            positions.push_back(glm::vec3(list[1].toFloat(), list[2].toFloat(), list[3].toFloat()));
+        } else if (line.first(2) == "f ") {
+            QStringList list = line.split(' ');
+            for (int i = 1; i < list.size(); ++i) {
+                indices.push_back(uint32_t(list[i].split('/')[0].toInt() - 1));
+            }
+            faceStarts.push_back(uint32_t(indices.size()));
+        }
+    }
+    return true;
+}
+
+bool HalfEdgeMesh::loadOBJ(const QString &OBJ_file, JobControl* control,
+                           float weldTolerance, WeldStats* weldStats) {
+    TRACE_SCOPE("loadOBJ");
+    faces.clear();
+    half_edges.clear();
+    vertices.clear();
+
+    QFile file(OBJ_file);
+    {
+        TRACE_SCOPE("loadOBJ: open");
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            return false;
+        }
+    }
+    qint64 fileSize = std::max<qint64>(file.size(), 1);
+
+    // Welding renumbers the vertices, so the faces are read by index
+    // first and linked only once they point at the merged vertices.
+    if (weldTolerance >= 0.f) {
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> faceStarts, indices, remap;
+        QTextStream in(&file);
+        {
+            TRACE_SCOPE("loadOBJ: parse");
+            if (!parseOBJ(in, fileSize, control, positions, faceStarts, indices)) {
+                return false;
+            }
+        }
+        WeldStats stats;
+        weldVertices(positions, remap, weldTolerance, &stats);
+        // Out of range indices all go to one past the end, which stays
+        // out of range for buildFromPolygons to refuse.
+        for (uint32_t &i : indices) {
+            i = std::min(i, uint32_t(remap.size()));
+        }
+        remap.push_back(uint32_t(positions.size()));
+        remapPolygons(remap, faceStarts, indices, &stats);
+        if (weldStats != nullptr) {
+            *weldStats = stats;
+        }
+        return buildFromPolygons(positions, faceStarts, indices);
+    }
+
+    TRACE_SCOPE("loadOBJ: parse and link");
+    ENDPT_MAP seen_vps;
+
+    QTextStream in(&file);
+    for (size_t lineCount = 0; !in.atEnd(); lineCount++) {
+        QString line = in.readLine();
+
+        if (control != nullptr && lineCount % 4096 == 0) {
+            if (control->isCancelled()) {
+                return false;
+            }
+            control->setProgress(float(in.pos()) / fileSize);
+        }
+
+        if        (line.size() < 2) {
+            continue;
+        }
+
+        // Populate mesh vertices.
+        // At this point, the vertices' half edge pointers are not set.
+        if        (line.first(2) == "v ") {
+            QStringList list = line.split(' ');
+            vertices.push_back(mkU<Vertex>(Vertex(glm::vec3(list[1].toFloat(),
+                                                                   list[2].toFloat(),                                                           list[3].toFloat()))));
+        // Populate mesh faces and half edges.
+        } else if (line.first(2) == "f ") {
+            // Create face.
+            faces.push_back(mkU<Face>(Face()));
+            bool first_he = true;
+            HalfEdge* first_he_ptr = nullptr;
+            QStringList list = line.split(' ');
+            for (int i = 1; i < list.size(); ++i) {
+                // Find a half edges's endpoint vertices.
+                int curr_vi = list[i].split('/')[0].toInt() - 1;
+                int next_vi;
+                if (i + 1 == list.size()) {
+                    next_vi = list[1].split('/')[0].toInt() - 1;
+                } else {
+                    next_vi = list[i + 1].split('/')[0].toInt() - 1;
+                }
+                // Create a half edge.
+                // At this point, sym half edges are not set yet.
+                half_edges.push_back(mkU<HalfEdge>(HalfEdge()));
+                HalfEdge* this_he_ptr = half_edges.back().get();
+                // Update face and vertex half edge pointers.
+                this_he_ptr->set_vertex(vertices[next_vi].get());
+                this_he_ptr->set_face(faces.back().get());
+
+                // Add the half edges vertex pair to the map
+                // if they haven't been encountered.
+                // If a vertex pair has been encountered, set sym half edges.
+                // In this implementation, Vertex ptr with the lower address is first in the pair.
+                ENDPT key = generateKey(vertices[curr_vi].get(), vertices[next_vi].get());
+                auto seen = seen_vps.find(key);
+                if (seen != seen_vps.end()) {
+                    this_he_ptr->set_sym(seen_vps.at(key));
+                } else {
+                    seen_vps[key] = this_he_ptr;
+                }
+
+                // The first half edge of each face is a special case.
+                if (first_he) {
+                    // We need to save the first half edge to set as the last half edge's next.
+                    first_he_ptr = this_he_ptr;
+                    // There doesn't exist a previous half edge
+                    // so we can skip the rest of this loop.
+                    first_he = false;
+                    continue;
+                }
+
+                // Set the previous edge's next half edge pointer to this half edge.
+                half_edges[half_edges.size() - 2]->set_next(this_he_ptr);
+
+                // Last half edge has it's next pointer pointing to first half edge.
+                if (i + 1 == list.size()) {
+                    this_he_ptr->set_next(first_he_ptr);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void HalfEdgeMesh::renumber() {
+    for (size_t i = 0; i < vertices.size(); i++) {
+        vertices[i]->id = i + 1;
+    }
+    for (size_t i = 0; i < half_edges.size(); i++) {
+        half_edges[i]->id = i + 1;
+    }
+    for (size_t i = 0; i < faces.size(); i++) {
+        faces[i]->id = i + 1;
+    }
+    Vertex::next_id = vertices.size() + 1;
+    HalfEdge::next_id = half_edges.size() + 1;
+    Face::next_id = faces.size() + 1;
+}
+
+bool HalfEdgeMesh::buildFromPolygons(const std::vector<glm::vec3> &positions,
+                                     const std::vector<uint32_t> &faceStarts,
+                                     const std::vector<uint32_t> &indices) {
+    TRACE_SCOPE("buildFromPolygons");
+    faces.clear();
+    half_edges.clear();
+    vertices.clear();
+
+    size_t faceCount = faceStarts.empty() ? 0 : faceStarts.size() - 1;
+    if (faceCount > 0 && faceStarts.back() != indices.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < faceCount; i++) {
+        if (faceStarts[i + 1] < faceStarts[i] + 3) {
+            return false;
+        }
+    }
+    for (uint32_t i : indices) {
+        if (i >= positions.size()) {
+            return false;
+        }
+    }
+
+    // Ids are reserved up front and handed out by position in each list.
+    size_t firstVertexId = Vertex::next_id.fetch_add(positions.size());
+    size_t firstEdgeId = HalfEdge::next_id.fetch_add(indices.size());
+    size_t firstFaceId = Face::next_id.fetch_add(faceCount);
+    vertices.resize(positions.size());
+    half_edges.resize(indices.size());
+    faces.resize(faceCount);
+    parallelFor(positions.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            vertices[i] = uPtr<Vertex>(new Vertex(firstVertexId + i, positions[i]));
+        }
+    });
+    parallelFor(indices.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            half_edges[i] = uPtr<HalfEdge>(new HalfEdge(firstEdgeId + i));
+        }
+    });
+
+    // Half-edge k leaves corner k of its face for the next corner.
+    parallelFor(faceCount, 1024, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; f++) {
+            Face* face = new Face(firstFaceId + f);
+            // rand() is not thread-safe, so colors come from a hash of the id.
+            uint32_t h = uint32_t(firstFaceId + f) * 2654435761u;
+            face->color = glm::vec3(h & 0xff, (h >> 8) & 0xff, (h >> 16) & 0xff) / 255.f;
+            faces[f] = uPtr<Face>(face);
+            uint32_t first = faceStarts[f], last = faceStarts[f + 1] - 1;
+            for (uint32_t k = first; k <= last; k++) {
+                HalfEdge* he = half_edges[k].get();
+                he->next = half_edges[k == last ? first : k + 1].get();
+                he->vertex = vertices[indices[k == last ? first : k + 1]].get();
+                he->face = face;
+            }
+            face->half_edge = half_edges[first].get();
+        }
+    });
+
+    // Outgoing half-edges of every vertex, so each half-edge finds
+    // its sym among the few that leave the vertex it points to.
+    size_t n = positions.size();
+    std::unique_ptr<std::atomic<uint32_t>[]> fill(new std::atomic<uint32_t>[n]());
+    parallelFor(indices.size(), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            fill[indices[k]].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    std::vector<uint32_t> outStart(n + 1, 0);
+    for (size_t v = 0; v < n; v++) {
+        outStart[v + 1] = outStart[v] + fill[v].load(std::memory_order_relaxed);
+        fill[v].store(outStart[v], std::memory_order_relaxed);
+    }
+    std::vector<uint32_t> outgoing(indices.size());
+    parallelFor(indices.size(), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            outgoing[fill[indices[k]].fetch_add(1, std::memory_order_relaxed)] = uint32_t(k);
+        }
+    });
+    fill.reset();
+
+    // Each vertex takes the half-edge that reaches it ahead of the
+    // first half-edge leaving it, which keeps the choice deterministic.
+    parallelFor(n, 4096, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            if (outStart[v] == outStart[v + 1]) {
+                continue;
+            }
+            uint32_t k = *std::min_element(outgoing.begin() + outStart[v], outgoing.begin() + outStart[v + 1]);
+            size_t f = std::upper_bound(faceStarts.begin(), faceStarts.end(), k) - faceStarts.begin() - 1;
+            vertices[v]->half_edge = half_edges[k == faceStarts[f] ? faceStarts[f + 1] - 1 : k - 1].get();
+            // Sorted by where they lead, so high valence vertices
+            // are searched by bisection below.
+            std::sort(outgoing.begin() + outStart[v], outgoing.begin() + outStart[v + 1], [&](uint32_t a, uint32_t b) {
+                return half_edges[a]->vertex < half_edges[b]->vertex;
+            });
+        }
+    });
+    parallelFor(faceCount, 1024, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; f++) {
+            uint32_t first = faceStarts[f], last = faceStarts[f + 1] - 1;
+            for (uint32_t k = first; k <= last; k++) {
+                const Vertex* from = vertices[indices[k]].get();
+                uint32_t to = indices[k == last ? first : k + 1];
+                HalfEdge* he = half_edges[k].get();
+                auto o = std::lower_bound(outgoing.begin() + outStart[to], outgoing.begin() + outStart[to + 1], from,
+                                          [&](uint32_t a, const Vertex* b) { return half_edges[a]->vertex < b; });
+                if (o != outgoing.begin() + outStart[to + 1] && half_edges[*o]->vertex == from) {
+                    he->sym = half_edges[*o].get();
+                }
+            }
+        }
+    });
+    return true;
+}
+
+bool HalfEdgeMesh::saveOBJ(const QString &OBJ_file) const {
+    QFile file(OBJ_file);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        return false;
+    }
+    std::unordered_map<const Vertex*, size_t, PTRHASH> index;
+    index.reserve(vertices.size());
+
+    QTextStream out(&file);
+    for (auto const &v : vertices) {
+        index[v.get()] = index.size() + 1;
+        out << "v " << v->pos.x << ' ' << v->pos.y << ' ' << v->pos.z << '\n';
+    }
+    for (auto const &f : faces) {
+        out << 'f';
+        HalfEdge* curr_he = f->half_edge;
+        do {
+            out << ' ' << index[curr_he->vertex];
+            curr_he = curr_he->next;
+        } while (curr_he != f->half_edge);
+        out << '\n';
+    }
+    out.flush();
+    return out.status() == QTextStream::Ok;
+}
+
+size_t HalfEdgeMesh::vertexCount() const {
+    return vertices.size();
+}
+
+size_t HalfEdgeMesh::faceCount() const {
+    return faces.size();
+}
+
+void HalfEdgeMesh::flatten(std::vector<glm::vec3> &positions, std::vector<uint32_t> &triangles,
+                           std::vector<uint32_t>* triangleFaces) const {
+    std::unordered_map<const Vertex*, uint32_t, PTRHASH> index;
+    index.reserve(vertices.size());
+    positions.clear();
+    positions.reserve(vertices.size());
+    for (auto const &v : vertices) {
+        index[v.get()] = uint32_t(positions.size());
+        positions.push_back(v->pos);
+    }
+    triangles.clear();
+    if (triangleFaces != nullptr) {
+        triangleFaces->clear();
+    }
+    for (size_t i = 0; i < faces.size(); i++) {
+        const Face* f = faces[i].get();
+        uint32_t first = index[f->half_edge->vertex];
+        HalfEdge* he = f->half_edge->next;
+        while (he->next != f->half_edge) {
+            triangles.push_back(first);
+            triangles.push_back(index[he->vertex]);
+            triangles.push_back(index[he->next->vertex]);
+            if (triangleFaces != nullptr) {
+                triangleFaces->push_back(uint32_t(i));
+            }
+            he = he->next;
+        }
+    }
+}
+
+void HalfEdgeMesh::setSkin(const SkinInfluences &influences) {
+    for (size_t i = 0; i < vertices.size(); i++) {
+        for (int k = 0; k < 2; k++) {
+            vertices[i]->infl_ids[k] = influences.ids[i][k];
+            vertices[i]->infl_weights[k] = influences.weights[i][k];
+        }
+    }
+}
+
+SkinInfluences HalfEdgeMesh::skin() const {
+    SkinInfluences influences;
+    influences.ids.resize(vertices.size());
+    influences.weights.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex* v = vertices[i].get();
+        influences.ids[i] = glm::ivec2(v->infl_ids[0], v->infl_ids[1]);
+        influences.weights[i] = glm::vec2(v->infl_weights[0], v->infl_weights[1]);
+    }
+    return influences;
+}
+
+void HalfEdgeMesh::setColors(const std::vector<glm::vec3> &colors) {
+    for (size_t i = 0; i < faces.size() && i < colors.size(); i++) {
+        faces[i]->color = colors[i];
+    }
+}
+
+std::vector<glm::vec3> HalfEdgeMesh::colors() const {
+    std::vector<glm::vec3> colors(faces.size());
+    for (size_t i = 0; i < faces.size(); i++) {
+        colors[i] = faces[i]->color;
+    }
+    return colors;
+}
+
+// This function splits the passed in edge
+// by adding a vertex in the middle.
+// An edge on the boundary has no sym, and only its own side is split.
+Vertex* HalfEdgeMesh::splitEdge(HalfEdge* he, MeshDelta* delta) {
+    HalfEdge* he_sym = he->sym;
+    if (delta != nullptr) {
+        delta->touch(he);
+        delta->touch(he->vertex);
+        delta->touch(he->face);
+        if (he_sym != nullptr) {
+            delta->touch(he_sym);
+            delta->touch(he_sym->vertex);
+            delta->touch(he_sym->face);
+        }
+    }
+
+    // The vertex he leaves, found around its face if there is no sym.
+    Vertex* origin;
+    if (he_sym != nullptr) {
+        origin = he_sym->vertex;
+    } else {
+        HalfEdge* prev = he;
+        while (prev->next != he) {
+            prev = prev->next;
+        }
+        origin = prev->vertex;
+    }
+
+    // V3 is the average of the endpoints of the selected half-edge
+    glm::vec3 v1_pos = he->vertex->pos;
+    glm::vec3 v2_pos = origin->pos;
+    glm::vec3 v3_pos = (v1_pos + v2_pos);
+    v3_pos /= 2;
+    vertices.push_back(mkU<Vertex>(Vertex(v3_pos)));
+    Vertex* v3 = vertices.back().get();
+
+    // Create a new half edge, and one for the sym if there is one,
+    // with the same face and vertex pointers as the original
+    half_edges.push_back(mkU<HalfEdge>(HalfEdge()));
+    HalfEdge* he_copy = half_edges.back().get();
+    // Update face and vertex half edge pointers.
+    he_copy->set_vertex(he->vertex);
+    he_copy->set_face(he->face);
+    // Rearrange pointers to correct data structure flow
+    he_copy->set_next(he->next);
+    he->set_next(he_copy);
+    he->set_vertex(v3);
+
+    if (he_sym != nullptr) {
+        half_edges.push_back(mkU<HalfEdge>(HalfEdge()));
+        HalfEdge* he_sym_copy = half_edges.back().get();
+        he_sym_copy->set_vertex(he_sym->vertex);
+        he_sym_copy->set_face(he_sym->face);
+        he_sym_copy->set_next(he_sym->next);
+        he_sym->set_next(he_sym_copy);
+        he_sym->set_vertex(v3);
+
+        he->set_sym(he_sym_copy);
+        he_sym->set_sym(he_copy);
+    }
+
+    return v3;
+}
+
+// Splits an N-gon face into triangles by ear clipping, which,
+// unlike a fan, also handles concave faces.
+void HalfEdgeMesh::triangulateFace(Face* f, MeshDelta* delta) {
+    if (f == nullptr) {
+        return;
+    }
+    size_t n = valence(f);
+    if (n <= 3) {
+        return;
+    }
+    if (delta != nullptr) {
+        delta->touchLoop(f);
+    }
+
+    size_t firstEdge = half_edges.size(), firstFace = faces.size();
+    for (size_t i = 0; i < n - 3; i++) {
+        half_edges.push_back(mkU<HalfEdge>());
+        half_edges.push_back(mkU<HalfEdge>());
+        faces.push_back(mkU<Face>());
+    }
+    clipEars(f, &half_edges[firstEdge], &faces[firstFace]);
+}
+
+// Every face is split on its own, so the faces are spread over the
+// thread pool. A prefix sum over face valences gives each face its own
+// slots for the half-edges and faces it adds, which are all made up front.
+bool HalfEdgeMesh::triangulate(JobControl* control) {
+    TRACE_SCOPE("triangulate");
+    size_t n = faces.size();
+    // Diagonals per face, then the prefix sum of those.
+    std::vector<size_t> offsets(n + 1, 0);
+    parallelFor(n, 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            offsets[i + 1] = std::max<size_t>(valence(faces[i].get()), 3) - 3;
+        }
+    });
+    for (size_t i = 0; i < n; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    size_t diagonals = offsets[n];
+    if (diagonals == 0) {
+        return true;
+    }
+    if (control != nullptr) {
+        control->setProgress(0.2f);
+        if (control->isCancelled()) {
+            return false;
+        }
+    }
+
+    size_t firstEdge = half_edges.size(), firstFace = faces.size();
+    size_t firstEdgeId = HalfEdge::next_id.fetch_add(2 * diagonals);
+    size_t firstFaceId = Face::next_id.fetch_add(diagonals);
+    half_edges.resize(firstEdge + 2 * diagonals);
+    faces.resize(firstFace + diagonals);
+    parallelFor(diagonals, 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            half_edges[firstEdge + 2 * i] = uPtr<HalfEdge>(new HalfEdge(firstEdgeId + 2 * i));
+            half_edges[firstEdge + 2 * i + 1] = uPtr<HalfEdge>(new HalfEdge(firstEdgeId + 2 * i + 1));
+            faces[firstFace + i] = uPtr<Face>(new Face(firstFaceId + i));
+        }
+    });
+    if (control != nullptr) {
+        control->setProgress(0.6f);
+        if (control->isCancelled()) {
+            return false;
+        }
+    }
+
+    parallelFor(n, 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (offsets[i + 1] > offsets[i]) {
+                clipEars(faces[i].get(), &half_edges[firstEdge + 2 * offsets[i]], &faces[firstFace + offsets[i]]);
+            }
+        }
+    });
+    if (control != nullptr) {
+        control->setProgress(1.f);
+    }
+    return true;
+}
+
+size_t HalfEdgeMesh::valence(const Face* f) {
+    size_t n = 0;
+    const HalfEdge* he = f->half_edge;
+    do {
+        n++;
+        he = he->next;
+    } while (he != f->half_edge);
+    return n;
+}
+
+// Whether q lies in triangle abc, which faces along normal.
+static bool inTriangle(const glm::vec3 &q, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c,
+                       const glm::vec3 &normal) {
+    return glm::dot(glm::cross(b - a, q - a), normal) >= 0.f
+        && glm::dot(glm::cross(c - b, q - b), normal) >= 0.f
+        && glm::dot(glm::cross(a - c, q - c), normal) >= 0.f;
+}
+
+// Cuts ears off the loop of f until one triangle is left, which f keeps.
+// Each ear becomes one of newFaces and each cut one pair of newEdges.
+// Only f, its half-edges and the new components are written; vertices
+// keep half-edges that still point at them. So faces can be clipped
+// in parallel.
+void HalfEdgeMesh::clipEars(Face* f, uPtr<HalfEdge>* newEdges, uPtr<Face>* newFaces) {
+    // ring[i] runs from the end of ring[i - 1] to its own vertex.
+    std::vector<HalfEdge*> ring;
+    HalfEdge* he = f->half_edge;
+    do {
+        ring.push_back(he);
+        he = he->next;
+    } while (he != f->half_edge);
+
+    // Newell's normal, which holds up for concave and warped faces.
+    glm::vec3 normal(0.f);
+    for (size_t i = 0; i < ring.size(); i++) {
+        const glm::vec3 &p = ring[i]->vertex->pos;
+        const glm::vec3 &q = ring[(i + 1) % ring.size()]->vertex->pos;
+        normal += glm::vec3((p.y - q.y) * (p.z + q.z), (p.z - q.z) * (p.x + q.x), (p.x - q.x) * (p.y + q.y));
+    }
+    auto convexAt = [&](size_t i) {
+        size_t m = ring.size();
+        const glm::vec3 &p = ring[(i + m - 1) % m]->vertex->pos;
+        const glm::vec3 &c = ring[i]->vertex->pos;
+        const glm::vec3 &n = ring[(i + 1) % m]->vertex->pos;
+        return glm::dot(glm::cross(c - p, n - c), normal) > 0.f;
+    };
+    bool convex = true;
+    for (size_t i = 0; i < ring.size() && convex; i++) {
+        convex = convexAt(i);
+    }
+    // The corner at the end of ring[i] is an ear if it is convex and
+    // no other corner lies in the triangle it would cut off.
+    auto isEar = [&](size_t i) {
+        if (convex) {
+            return true;
+        }
+        if (!convexAt(i)) {
+            return false;
+        }
+        size_t m = ring.size();
+        Vertex* p = ring[(i + m - 1) % m]->vertex;
+        Vertex* c = ring[i]->vertex;
+        Vertex* n = ring[(i + 1) % m]->vertex;
+        for (size_t j = 0; j < m; j++) {
+            Vertex* q = ring[j]->vertex;
+            if (q != p && q != c && q != n && inTriangle(q->pos, p->pos, c->pos, n->pos, normal)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    size_t nextEdge = 0, nextFace = 0;
+    size_t i = 0;
+    while (ring.size() > 3) {
+        size_t m = ring.size();
+        // Look for an ear from where the last one was cut. If rounding
+        // leaves none, cut a convex corner, or failing that any corner.
+        size_t ear = m;
+        for (size_t k = 0; k < m && ear == m; k++) {
+            if (isEar((i + k) % m)) {
+                ear = (i + k) % m;
+            }
+        }
+        for (size_t k = 0; k < m && ear == m; k++) {
+            if (convexAt(k)) {
+                ear = k;
+            }
+        }
+        if (ear == m) {
+            ear = i % m;
+        }
+
+        // Close the ear with a new edge from n back to p, and bridge
+        // the rest of the loop with its sym from p to n.
+        size_t prev = (ear + m - 1) % m, next = (ear + 1) % m;
+        HalfEdge* a = ring[ear];
+        HalfEdge* b = ring[next];
+        HalfEdge* close = newEdges[nextEdge++].get();
+        HalfEdge* bridge = newEdges[nextEdge++].get();
+        Face* t = newFaces[nextFace++].get();
+
+        close->vertex = ring[prev]->vertex;
+        bridge->vertex = b->vertex;
+        close->sym = bridge;
+        bridge->sym = close;
+
+        a->next = b;
+        b->next = close;
+        close->next = a;
+        a->face = b->face = close->face = t;
+        t->half_edge = a;
+        t->color = f->color;
+        bridge->face = f;
+
+        ring[ear] = bridge;
+        ring.erase(ring.begin() + next);
+        i = next < ear ? ear - 1 : ear;
+    }
+
+    ring[0]->next = ring[1];
+    ring[1]->next = ring[2];
+    ring[2]->next = ring[0];
+    for (HalfEdge* e : ring) {
+        e->face = f;
+    }
+    f->half_edge = ring[0];
+}
+
+// This function adds centroids to the mesh
+// and populates a map such that
+// key = face*, value = centroid*.
+CENTROID_MAP HalfEdgeMesh::createCentroids() {
+    CENTROID_MAP centroids;
+
+    for (auto &f : faces) {
+        // Calculate the centroid position
+        // by averaging all vertices of the face.
+        int counter = 0;
+        glm::vec3 avg_pos(0);
+        HalfEdge* curr = f->half_edge;
+        do {
+            avg_pos += curr->vertex->pos;
+            counter++;
+            curr = curr->next;
+        } while (curr != f->half_edge);
+        avg_pos /= counter;
+
+        // Create centroid.
+        // Add the face and centroid to map.
+        vertices.push_back(mkU<Vertex>(Vertex(avg_pos)));
+        Vertex* centroid = vertices.back().get();
+        centroids[f.get()] = centroid;
+
+    }
+
+    return centroids;
+}
+
+// This function adds smoothed midpoints to the mesh.
+// It also splits edges with the smooth midpoint.
+// It returns a set of all the original vertices of the mesh.
+VPTR_SET HalfEdgeMesh::createSmoothMidpts(CENTROID_MAP &cm) {
+    VPTR_SET og_verts;
+
+    for (size_t i = 0; i < vertices.size() - cm.size(); i++) {
+        og_verts.insert(vertices[i].get());
+    }
+
+    // We only want to iterate through the original edges.
+    // Additionally if a half edge is included,
+    // it's sym does not need to be.
+    HEPTR_SET syms;
+    std::vector<HalfEdge*> edges_to_split;
+    for (auto const &e : half_edges) {
+        if (syms.find(e.get()) == syms.end()) {
+            edges_to_split.push_back(e.get());
+            syms.insert(e->sym);
+        }
+    }
+
+    for (auto const &e : edges_to_split) {
+        // Split the edge
+        splitEdge(e);
+
+        // An open edge keeps the plain midpoint splitEdge gave it.
+        if (e->sym == nullptr) {
+            continue;
+        }
+
+        // Otherwise it is smoothed towards the two face points.
+        glm::vec3 midpt_pos(0);
+        midpt_pos += e->next->vertex->pos;
+        midpt_pos += e->sym->vertex->pos;
+        midpt_pos += cm.at(e->face)->pos;
+        midpt_pos += cm.at(e->sym->face)->pos;
+        midpt_pos /= 4;
+
+        // And modify the newly created vertex
+        // from the split edge.
+        e->vertex->pos = midpt_pos;
+    }
+    return og_verts;
+}
+
+VPTR_SET HalfEdgeMesh::getAdjMidpts(Vertex* v) const {
+    VPTR_SET adjVerts;
+    HalfEdge* curr = v->half_edge;
+    do {
+        curr = curr->next;
+        adjVerts.insert(curr->vertex);
+        curr = curr->sym;
+    } while (curr != v->half_edge);
+    return adjVerts;
+}
+
+VPTR_SET HalfEdgeMesh::getIncCentroids(Vertex* v, CENTROID_MAP &cm) const {
+    VPTR_SET incCentroids;
+    HalfEdge* curr = v->half_edge;
+    do {
+        curr = curr->next;
+        incCentroids.insert(cm.at(curr->face));
+        curr = curr->sym;
+    } while (curr != v->half_edge);
+    return incCentroids;
+}
+
+void HalfEdgeMesh::smoothOrigVerts(VPTR_SET& vs, CENTROID_MAP &cm) {
+    // The midpoints along the open edges at every vertex. Each half of a
+    // split open edge joins an original vertex to its midpoint.
+    std::unordered_map<Vertex*, std::vector<Vertex*>> open;
+    for (auto const &e : half_edges) {
+        if (e->sym != nullptr) {
+            continue;
+        }
+        HalfEdge* prev = e.get();
+        while (prev->next != e.get()) {
+            prev = prev->next;
+        }
+        open[e->vertex].push_back(prev->vertex);
+        open[prev->vertex].push_back(e->vertex);
+    }
+
+    for (auto const &vptr : vs) {
+        glm::vec3 og_pos = vptr->pos;
+
+        // Boundary vertices follow the outline alone, 3/4 v plus 1/8 of
+        // either neighbour along it, which the midpoints m_a and m_b turn
+        // into v / 2 + (m_a + m_b) / 4. Corners where more than two open
+        // edges meet stay put.
+        auto found = open.find(vptr);
+        if (found != open.end()) {
+            const std::vector<Vertex*> &mids = found->second;
+            if (mids.size() == 2) {
+                vptr->pos = og_pos / 2.f + (mids[0]->pos + mids[1]->pos) / 4.f;
+            }
+            continue;
+        }
+
+        VPTR_SET adj_verts = getAdjMidpts(vptr);
+        glm::vec3 adjv_sum(0);
+        for (auto const &v : adj_verts) {
+            adjv_sum += v->pos;
+        }
+
+        VPTR_SET inc_centroids = getIncCentroids(vptr, cm);
+        glm::vec3 incc_sum(0);
+        for (auto const &c : inc_centroids) {
+            incc_sum += c->pos;
+        }
+
+        int n = adj_verts.size();
+
+        // Catmull-Clark's rule is (n - 2) v / n plus the old neighbours
+        // and the face points over n^2. The neighbours are only reached
+        // through the smoothed midpoints by now, each (v + neighbour + two
+        // face points) / 4, which turns the rule into this.
+        og_pos *= (n - 3);
+        og_pos /= n;
+        adjv_sum *= 4;
+        adjv_sum /= (n * n);
+        incc_sum /= (n * n);
+
+        vptr->pos = og_pos + adjv_sum - incc_sum;
+    }
+}
+
+void HalfEdgeMesh::quadrangulateFace(Face* f, CENTROID_MAP &cm) {
+    HalfEdge* curr = f->half_edge->next;
+    curr->set_face(f);
+
+    HalfEdge* connection_edge;
+    HalfEdge* next_connection_edge = curr->next;
+    HalfEdge* next_face_edge = curr->next->next;
+
+    HalfEdge* start_edge =curr->next->next;
+
+    HalfEdge* first_centroid_to_midpt_edge;
+    HalfEdge* prev_midpt_to_centroid;
+
+    bool loop = true;
+
+    while (loop) {
+        Vertex* prev_midpt = curr->vertex;      // Store previous midpoint.
+        curr = next_face_edge;                  // Update starting edge of new face.
+        connection_edge = next_connection_edge; // Update edge that points to starting edge.
+        next_connection_edge = curr->next;      // Store pointer to next connection edge.
+        next_face_edge = curr->next->next;      // Store pointer to starting edge of next new face.
+
+        // Create two new half edges
+        half_edges.push_back(mkU<HalfEdge>(HalfEdge()));
+        HalfEdge *midpt_to_centroid = half_edges.back().get();
+        midpt_to_centroid->set_vertex(cm.at(f));
+        half_edges.push_back(mkU<HalfEdge>(HalfEdge()));
+        HalfEdge *centroid_to_midpt = half_edges.back().get();
+        centroid_to_midpt->set_vertex(prev_midpt);
+
+
+        // Last quadrangulated face is a special case.
+        // We don't need to create a new face.
+        Face* face;
+        if (next_face_edge == start_edge) {
+            face = f;
+        // Create new face
+        } else {
+            faces.push_back(mkU<Face>(Face()));
+            face = faces.back().get();
+        }
+
+        // Update half-edge face pointers.
+        midpt_to_centroid->set_face(face);
+        centroid_to_midpt->set_face(face);
+        connection_edge->set_face(face);
+        curr->set_face(face);
+
+        // Update half edge next pointers.
+        curr->set_next(midpt_to_centroid);
+        midpt_to_centroid->set_next(centroid_to_midpt);
+        centroid_to_midpt->set_next(connection_edge);
+
+        // Set sym pointers.
+        // First quadrangulated face is a special case,
+        // since no edge has been previously created.
+        if (curr == start_edge) {
+            first_centroid_to_midpt_edge = centroid_to_midpt;
+            prev_midpt_to_centroid = midpt_to_centroid;
+
+        } else if (next_face_edge == start_edge) {
+            centroid_to_midpt->set_sym(prev_midpt_to_centroid);
+            midpt_to_centroid->set_sym(first_centroid_to_midpt_edge);
+            loop = false;
+        }
+        else {
+            centroid_to_midpt->set_sym(prev_midpt_to_centroid);
+            prev_midpt_to_centroid = midpt_to_centroid;
+        }
+    }
+}
+
+bool HalfEdgeMesh::subdivide(JobControl* control) {
+    TRACE_SCOPE("subdivide");
+    auto step = [control](float progress) {
+        if (control == nullptr) {
+            return true;
+        }
+        control->setProgress(progress);
+        return !control->isCancelled();
+    };
+
+    CENTROID_MAP cm;
+    {
+        TRACE_SCOPE("subdivide: face points");
+        cm = createCentroids();
+    }
+    if (!step(0.25f)) {
+        return false;
+    }
+    VPTR_SET vs;
+    {
+        TRACE_SCOPE("subdivide: edge points");
+        vs = createSmoothMidpts(cm);
+    }
+    if (!step(0.5f)) {
+        return false;
+    }
+    {
+        TRACE_SCOPE("subdivide: vertex points");
+        smoothOrigVerts(vs, cm);
+    }
+    if (!step(0.75f)) {
+        return false;
+    }
+
+    // We need to create a copy of the original faces
+    // since quadrangulateFace will add new faces.
+    TRACE_SCOPE("subdivide: quadrangulate");
+    std::vector<Face*> face_copy;
+    for (auto const &f : faces) {
+        face_copy.push_back(f.get());
+    }
+    for (auto const &f : face_copy) {
+        quadrangulateFace(f, cm);
+    }
+    return step(1.f);
+}
+
+bool HalfEdgeMesh::subdivideLoop(JobControl* control) {
+    TRACE_SCOPE("subdivideLoop");
+    auto step = [control](float progress) {
+        if (control == nullptr) {
+            return true;
+        }
+        control->setProgress(progress);
+        return !control->isCancelled();
+    };
+
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> triangles, triangleFaces;
+    flatten(positions, triangles, &triangleFaces);
+    std::vector<glm::vec3> parentColors = colors();
+    SkinInfluences parentSkin = skin();
+    if (!step(0.2f)) {
+        return false;
+    }
+    LoopSubdivider loop(triangles, positions.size());
+    if (!step(0.5f)) {
+        return false;
+    }
+    std::vector<glm::vec3> refined(loop.childVertexCount());
+    loop.refine(positions.data(), refined.data());
+    if (!step(0.6f)) {
+        return false;
+    }
+
+    const std::vector<uint32_t> &children = loop.childTriangles();
+    std::vector<uint32_t> faceStarts(children.size() / 3 + 1);
+    for (size_t i = 0; i < faceStarts.size(); i++) {
+        faceStarts[i] = uint32_t(3 * i);
+    }
+    std::vector<glm::vec3> childColors(children.size() / 3);
+    for (size_t i = 0; i < childColors.size(); i++) {
+        childColors[i] = parentColors[triangleFaces[i / 4]];
+    }
+    SkinInfluences childSkin;
+    childSkin.ids.resize(refined.size());
+    childSkin.weights.resize(refined.size());
+    for (size_t i = 0; i < refined.size(); i++) {
+        uint32_t source = uint32_t(i), other;
+        if (i >= positions.size()) {
+            loop.edgeEnds(i - positions.size(), source, other);
+        }
+        childSkin.ids[i] = parentSkin.ids[source];
+        childSkin.weights[i] = parentSkin.weights[source];
+    }
+    if (!buildFromPolygons(refined, faceStarts, children)) {
+        return false;
+    }
+    setColors(childColors);
+    setSkin(childSkin);
+    return step(1.f);
+}
+
+bool HalfEdgeMesh::isTriangleMesh() const {
+    for (auto const &f : faces) {
+        if (f->half_edge->next->next->next != f->half_edge) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HalfEdgeMesh::refine(JobControl* control) {
+    return isTriangleMesh() ? subdivideLoop(control) : subdivide(control);
+}
+
+bool HalfEdgeMesh::limitFrame(const Vertex* v, LimitFrame &frame) {
+    frame.position = v->pos;
+    frame.tangentU = frame.tangentV = frame.normal = glm::vec3(0.f);
+    HalfEdge* start = v->half_edge;
+    if (start == nullptr) {
+        return false;
+    }
+    auto previous = [](HalfEdge* he) {
+        HalfEdge* p = he;
+        while (p->next != he) {
+            p = p->next;
+        }
+        return p;
+    };
+    auto cornerNormal = [&previous, v](HalfEdge* he) {
+        return glm::cross(he->next->vertex->pos - v->pos, previous(he)->vertex->pos - v->pos);
+    };
+
+    // Clockwise around v by the half-edges that reach it, and if that
+    // runs into an open edge, the other way from start to the other one.
+    glm::vec3 normal(0.f);
+    size_t n = 0;
+    bool quads = true;
+    HalfEdge* he = start;
+    do {
+        normal += cornerNormal(he);
+        quads = quads && he->next->next->next->next == he;
+        n++;
+        he = he->next->sym;
+    } while (he != nullptr && he != start);
+    bool closed = he != nullptr;
+    if (!closed) {
+        for (he = start; he->sym != nullptr; ) {
+            he = previous(he->sym);
+            if (he == start) {
+                break;
+            }
+            normal += cornerNormal(he);
+        }
+    }
+    float length = glm::length(normal);
+    frame.normal = length > 0.f ? normal / length : normal;
+    if (!closed || !quads || n < 3) {
+        return false;
+    }
+
+    // catmullClarkLimit takes the ring counter-clockwise, so it is
+    // read back to front. Corner j then lies between edge j and
+    // edge j + 1, as catmullClarkLimit expects.
+    glm::vec3 edgeBuf[16], faceBuf[16];
+    std::vector<glm::vec3> edgeHeap, faceHeap;
+    glm::vec3* edges = edgeBuf;
+    glm::vec3* corners = faceBuf;
+    if (n > 16) {
+        edgeHeap.resize(n);
+        faceHeap.resize(n);
+        edges = edgeHeap.data();
+        corners = faceHeap.data();
+    }
+    he = start;
+    for (size_t i = 0; i < n; i++) {
+        size_t j = (n - i) % n;
+        edges[j] = he->next->vertex->pos;
+        corners[j] = he->next->next->vertex->pos;
+        he = he->next->sym;
+    }
+    frame = catmullClarkLimit(v->pos, edges, corners, n);
+    return true;
+}
+
+size_t HalfEdgeMesh::snapToLimit() {
+    TRACE_SCOPE("snapToLimit");
+    std::vector<glm::vec3> limit(vertices.size());
+    std::atomic<size_t> kept(0);
+    parallelFor(vertices.size(), 4096, [&](size_t begin, size_t end) {
+        size_t k = 0;
+        for (size_t i = begin; i < end; i++) {
+            LimitFrame frame;
+            k += !limitFrame(vertices[i].get(), frame);
+            limit[i] = frame.position;
+        }
+        kept += k;
+    });
+    parallelFor(vertices.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            vertices[i]->pos = limit[i];
+        }
+    });
+    return kept;
+}
+
+size_t HalfEdgeMesh::memoryBytes() const {
+    return vertices.capacity() * sizeof(uPtr<Vertex>) + vertices.size() * sizeof(Vertex)
+         + half_edges.capacity() * sizeof(uPtr<HalfEdge>) + half_edges.size() * sizeof(HalfEdge)
+         + faces.capacity() * sizeof(uPtr<Face>) + faces.size() * sizeof(Face);
+}
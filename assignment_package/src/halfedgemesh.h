@@ -0,0 +1,177 @@
+#ifndef HALFEDGEMESH_H
+#define HALFEDGEMESH_H
+
+#include "components/halfedge.h"
+#include "jobs/job.h"
+#include "profiling/memstats.h"
+#include "skinning/skinweights.h"
+#include "spatial/weld.h"
+#include "subdivision/limit.h"
+#include "smartpointerhelp.h"
+
+#include <QString>
+#include <QTextStream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//--------------------------------------------------
+// TYPEDEFs and HASH structs
+//--------------------------------------------------
+typedef std::pair<Vertex*, Vertex*> ENDPT;
+
+struct PAIRHASH {
+    std::size_t operator()(const ENDPT& vp) const
+    {
+        return std::hash<Vertex*>()(vp.first) ^
+           (std::hash<Vertex*>()(vp.second) << 1);
+    }
+};
+
+struct PTRHASH {
+    template<typename T>
+    std::size_t operator()(const T* ptr) const
+    {
+        return std::hash<const T*>()(ptr);
+    }
+};
+
+// Counted under memstats' topology maps.
+typedef std::unordered_map<Face*, Vertex*, PTRHASH, std::equal_to<Face*>,
+                           memstats::Allocator<std::pair<Face* const, Vertex*>, memstats::Tag::TOPOLOGY_MAPS>> CENTROID_MAP;
+typedef std::unordered_map<ENDPT, HalfEdge*, PAIRHASH, std::equal_to<ENDPT>,
+                           memstats::Allocator<std::pair<const ENDPT, HalfEdge*>, memstats::Tag::TOPOLOGY_MAPS>> ENDPT_MAP;
+typedef std::unordered_set<Vertex*, PTRHASH, std::equal_to<Vertex*>,
+                           memstats::Allocator<Vertex*, memstats::Tag::TOPOLOGY_MAPS>> VPTR_SET;
+typedef std::unordered_set<HalfEdge*, PTRHASH, std::equal_to<HalfEdge*>,
+                           memstats::Allocator<HalfEdge*, memstats::Tag::TOPOLOGY_MAPS>> HEPTR_SET;
+//--------------------------------------------------
+// END
+//--------------------------------------------------
+
+// The half-edge structure of a mesh and the operations that edit it.
+// It holds no GL state, so a copy can be built or edited on a worker
+// thread while the Mesh it came from is still being drawn.
+class MeshDelta;
+
+class HalfEdgeMesh
+{
+protected:
+    std::vector<uPtr<Face>> faces;
+    std::vector<uPtr<HalfEdge>> half_edges;
+    std::vector<uPtr<Vertex>> vertices;
+
+    friend class MyGL;
+    friend class MeshDelta;
+
+public:
+    HalfEdgeMesh();
+    virtual ~HalfEdgeMesh();
+
+    HalfEdgeMesh(HalfEdgeMesh &&m) = default;
+    HalfEdgeMesh& operator=(HalfEdgeMesh &&m) = default;
+
+    // A deep copy with the same ids, positions and colors.
+    uPtr<HalfEdgeMesh> clone() const;
+    // Numbers the components from 1 in the order they are kept and
+    // restarts the id counters after them. Meshes are built anywhere
+    // with ids that never collide, and only the one about to replace
+    // every other, on the thread that edits it, is renumbered.
+    void renumber();
+
+    // Replaces this mesh with the contents of an OBJ file.
+    // Returns false if the file cannot be read or control cancels.
+    // With a weldTolerance of 0 or more, vertices are first merged by
+    // weldVertices and faces pointed at the merged ones, before any
+    // half-edge is built; weldStats, if given, says what was merged.
+    bool loadOBJ(const QString &OBJ_file, JobControl* control = nullptr,
+                 float weldTolerance = -1.f, WeldStats* weldStats = nullptr);
+    // Replaces this mesh with polygons given by index, without OBJ text.
+    // Face i runs through indices[faceStarts[i]] up to but excluding
+    // indices[faceStarts[i + 1]], counter-clockwise, so faceStarts holds
+    // one entry more than there are faces. Built in parallel. Returns
+    // false, leaving the mesh empty, if a face has fewer than three
+    // corners or an index is out of range.
+    bool buildFromPolygons(const std::vector<glm::vec3> &positions,
+                           const std::vector<uint32_t> &faceStarts,
+                           const std::vector<uint32_t> &indices);
+    // Writes positions and faces as an OBJ file, vertices in the order
+    // this mesh keeps them. Returns false if the file cannot be written.
+    bool saveOBJ(const QString &OBJ_file) const;
+
+    size_t vertexCount() const;
+    size_t faceCount() const;
+
+    // Vertex positions in order, and each face fanned into triangles
+    // around its first corner, three indices per triangle. If given,
+    // triangleFaces receives the index of the face of every triangle.
+    void flatten(std::vector<glm::vec3> &positions, std::vector<uint32_t> &triangles,
+                 std::vector<uint32_t>* triangleFaces = nullptr) const;
+    // Binds vertex i to the joints and weights of entry i.
+    void setSkin(const SkinInfluences &influences);
+    SkinInfluences skin() const;
+    // The color of face i is entry i.
+    void setColors(const std::vector<glm::vec3> &colors);
+    std::vector<glm::vec3> colors() const;
+
+    // The edits below touch every component they change in delta,
+    // if one is given, so they can be undone.
+
+    // Splits the edge of he by adding a vertex in the middle
+    // and returns the new vertex.
+    Vertex* splitEdge(HalfEdge* he, MeshDelta* delta = nullptr);
+    // Splits an N-gon face into triangles.
+    void triangulateFace(Face* f, MeshDelta* delta = nullptr);
+    // Splits every face into triangles, spread over the thread pool.
+    // Returns false if control cancels, leaving the mesh half split.
+    bool triangulate(JobControl* control = nullptr);
+    // One step of Catmull-Clark subdivision. Open edges split at their
+    // midpoints and vertices on one outline move along it alone.
+    // Returns false if control cancels, leaving the mesh half subdivided.
+    bool subdivide(JobControl* control = nullptr);
+    // One step of Loop subdivision, through LoopSubdivider. Faces that
+    // are not triangles are fanned as in flatten first. Child faces keep
+    // the colors of their parents, vertex points their skin weights and
+    // edge points those of the first end of their edge. The mesh is
+    // rebuilt with new ids. Returns false if control cancels, leaving
+    // the mesh as it was.
+    bool subdivideLoop(JobControl* control = nullptr);
+    // Whether every face has three corners.
+    bool isTriangleMesh() const;
+    // One step of Loop subdivision if every face is a triangle,
+    // so triangle cages stay triangles, and of Catmull-Clark otherwise.
+    bool refine(JobControl* control = nullptr);
+
+    // The Catmull-Clark limit point of v with its tangents and normal,
+    // from catmullClarkLimit over its one-ring. Exact where every face
+    // around v is a quad, as after one step of subdivide. Elsewhere, and
+    // on open edges, returns false with v's own position and the average
+    // normal of its faces.
+    static bool limitFrame(const Vertex* v, LimitFrame &frame);
+    // Moves every vertex onto the limit surface at once, in parallel.
+    // Returns how many vertices limitFrame left where they were.
+    size_t snapToLimit();
+
+    // Bytes held by the components and the vectors that own them.
+    size_t memoryBytes() const;
+
+private:
+    static ENDPT generateKey(Vertex* v_ptr1, Vertex* v_ptr2);
+    // Reads the positions and faces of an OBJ file by index, in the
+    // layout of buildFromPolygons. False if control cancels.
+    static bool parseOBJ(QTextStream &in, qint64 fileSize, JobControl* control,
+                         std::vector<glm::vec3> &positions,
+                         std::vector<uint32_t> &faceStarts, std::vector<uint32_t> &indices);
+    static size_t valence(const Face* f);
+    static void clipEars(Face* f, uPtr<HalfEdge>* newEdges, uPtr<Face>* newFaces);
+
+    // CATMULL stuff
+    CENTROID_MAP createCentroids();
+    VPTR_SET createSmoothMidpts(CENTROID_MAP &cm);
+    VPTR_SET getAdjMidpts(Vertex* v) const;
+    VPTR_SET getIncCentroids(Vertex* v, CENTROID_MAP &cm) const;
+    void smoothOrigVerts(VPTR_SET& vs, CENTROID_MAP &cm);
+    void quadrangulateFace(Face* f, CENTROID_MAP &cm);
+};
+
+#endif // HALFEDGEMESH_H
@@ -0,0 +1,21 @@
+#include "job.h"
+
+JobControl::JobControl()
+    : cancelled(false), progress(0.f)
+{}
+
+void JobControl::cancel() {
+    cancelled = true;
+}
+
+bool JobControl::isCancelled() const {
+    return cancelled;
+}
+
+void JobControl::setProgress(float p) {
+    progress = p;
+}
+
+float JobControl::getProgress() const {
+    return progress;
+}
@@ -0,0 +1,108 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include "jobs/threadpool.h"
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+
+// Shared between a running job and whoever started it. The job
+// reports progress and checks for cancellation between steps.
+class JobControl {
+private:
+    std::atomic<bool> cancelled;
+    std::atomic<float> progress;
+
+public:
+    JobControl();
+
+    void cancel();
+    bool isCancelled() const;
+
+    // Progress from 0 to 1.
+    void setProgress(float p);
+    float getProgress() const;
+};
+
+// Work that runs on the thread pool and produces a T.
+// The owner polls finished() and then take()s the result on its own
+// thread, so results are only ever handed over once complete.
+// A cancelled job, or one that threw, finishes without a result,
+// and one that threw keeps the exception's message for take().
+template<typename T>
+class Job {
+private:
+    struct State {
+        JobControl control;
+        std::optional<T> result;
+        std::string error;      // Written before done, read after it.
+        std::atomic<bool> done;
+
+        State() : control(), result(), error(), done(false) {}
+    };
+    std::shared_ptr<State> state;
+
+public:
+    Job() : state(nullptr) {}
+
+    // Starts fn(JobControl&) on the pool.
+    template<typename F>
+    static Job run(F fn, ThreadPool &pool = ThreadPool::global()) {
+        Job job;
+        job.state = std::make_shared<State>();
+        std::shared_ptr<State> s = job.state;
+        pool.submit([s, fn]() mutable {
+            if (!s->control.isCancelled()) {
+                try {
+                    T value = fn(s->control);
+                    if (!s->control.isCancelled()) {
+                        s->result.emplace(std::move(value));
+                    }
+                } catch (const std::exception &e) {
+                    s->result.reset();
+                    s->error = e.what();
+                } catch (...) {
+                    s->result.reset();
+                    s->error = "Unknown exception";
+                }
+            }
+            s->done = true;
+        });
+        return job;
+    }
+
+    // Whether a job has been started and not yet taken.
+    bool active() const {
+        return state != nullptr;
+    }
+    bool finished() const {
+        return state != nullptr && state->done;
+    }
+    float progress() const {
+        return state != nullptr ? state->control.getProgress() : 0.f;
+    }
+    // Asks the job to stop and forgets it. It finishes in the background.
+    void cancel() {
+        if (state != nullptr) {
+            state->control.cancel();
+            state = nullptr;
+        }
+    }
+    // Hands over the result of a finished job and forgets the job.
+    // If the job threw, error, if given, receives the message.
+    std::optional<T> take(std::string* error = nullptr) {
+        std::optional<T> r;
+        if (finished()) {
+            r = std::move(state->result);
+            if (error != nullptr) {
+                *error = state->error;
+            }
+            state = nullptr;
+        }
+        return r;
+    }
+};
+
+#endif // JOB_H
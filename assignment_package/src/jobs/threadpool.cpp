@@ -0,0 +1,102 @@
+#include "threadpool.h"
+#include "profiling/trace.h"
+#include <algorithm>
+#include <string>
+
+// Index of the calling thread's own queue in the pool that owns it.
+static thread_local ThreadPool* t_pool = nullptr;
+static thread_local size_t t_queue = 0;
+
+ThreadPool::ThreadPool(size_t threads)
+    : queues(), threads(), sleepLock(), wake(), pending(0), nextQueue(0), stopping(false)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        this->threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &t : threads) {
+        t.join();
+    }
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::submit(Task task) {
+    size_t q = t_pool == this ? t_queue : nextQueue++ % queues.size();
+    {
+        // Counted before it is queued so pending never drops below zero.
+        // Taking the lock orders this with a worker about to sleep.
+        std::lock_guard<std::mutex> guard(sleepLock);
+        pending++;
+    }
+    {
+        std::lock_guard<std::mutex> guard(queues[q]->lock);
+        queues[q]->tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::popTask(Task &task) {
+    size_t self = t_pool == this ? t_queue : 0;
+    // Own queue first, newest task first.
+    if (t_pool == this) {
+        Queue &own = *queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            pending--;
+            return true;
+        }
+    }
+    // Then steal the oldest task of another queue.
+    for (size_t i = 0; i < queues.size(); i++) {
+        Queue &other = *queues[(self + 1 + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(other.lock);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            pending--;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t ThreadPool::threadCount() const {
+    return threads.size();
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    t_pool = this;
+    t_queue = index;
+    trace::setThreadName("worker " + std::to_string(index));
+    while (true) {
+        Task task;
+        if (popTask(task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(sleepLock);
+        wake.wait(guard, [this]() { return stopping || pending > 0; });
+        if (stopping && pending == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A work-stealing thread pool. Every worker has its own task queue:
+// it takes its newest task first, and when its queue runs dry it steals
+// the oldest task of another worker. Tasks submitted from a worker go
+// to that worker's queue, so nested work stays on the thread that made it.
+class ThreadPool {
+public:
+    typedef std::function<void()> Task;
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    std::atomic<size_t> pending;
+    std::atomic<size_t> nextQueue;
+    bool stopping;
+
+public:
+    // threads = 0 uses one thread per hardware thread.
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    // The pool shared by the whole application.
+    static ThreadPool& global();
+
+    void submit(Task task);
+
+    size_t threadCount() const;
+
+private:
+    bool popTask(Task &task);
+    void workerLoop(size_t index);
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,97 @@
+#include "jointpalette.h"
+#include <algorithm>
+
+JointPalette::JointPalette(OpenGLContext* context)
+    : mats(), dirtyBegin(0), dirtyEnd(0),
+      buf(), tex(), created(false), gpuCapacity(0),
+      mp_context(context)
+{}
+
+JointPalette::~JointPalette() {
+    destroy();
+}
+
+void JointPalette::resize(size_t jointCount) {
+    mats.resize(jointCount, glm::mat4(1.f));
+    dirtyBegin = 0;
+    dirtyEnd = mats.size();
+}
+
+size_t JointPalette::size() const {
+    return mats.size();
+}
+
+void JointPalette::set(size_t id, const glm::mat4 &m) {
+    mats[id] = m;
+    if (dirtyBegin == dirtyEnd) {
+        dirtyBegin = id;
+        dirtyEnd = id + 1;
+    } else {
+        dirtyBegin = std::min(dirtyBegin, id);
+        dirtyEnd = std::max(dirtyEnd, id + 1);
+    }
+}
+
+glm::mat4* JointPalette::writeRange(size_t begin, size_t end) {
+    if (begin < end) {
+        if (dirtyBegin == dirtyEnd) {
+            dirtyBegin = begin;
+            dirtyEnd = end;
+        } else {
+            dirtyBegin = std::min(dirtyBegin, begin);
+            dirtyEnd = std::max(dirtyEnd, end);
+        }
+    }
+    return mats.data() + begin;
+}
+
+const glm::mat4& JointPalette::get(size_t id) const {
+    return mats[id];
+}
+
+void JointPalette::upload() {
+    if (!created) {
+        mp_context->glGenBuffers(1, &buf);
+        mp_context->glGenTextures(1, &tex);
+        created = true;
+    }
+
+    mp_context->glBindBuffer(GL_TEXTURE_BUFFER, buf);
+    if (gpuCapacity < mats.size()) {
+        // Grow the buffer and send everything.
+        gpuCapacity = std::max<size_t>(mats.size(), 1);
+        mp_context->glBufferData(GL_TEXTURE_BUFFER, gpuCapacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+        dirtyBegin = 0;
+        dirtyEnd = mats.size();
+
+        // Each mat4 is read back as four RGBA32F texels (its columns).
+        mp_context->glBindTexture(GL_TEXTURE_BUFFER, tex);
+        mp_context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buf);
+    }
+
+    if (dirtyBegin < dirtyEnd) {
+        mp_context->glBufferSubData(GL_TEXTURE_BUFFER,
+                                    dirtyBegin * sizeof(glm::mat4),
+                                    (dirtyEnd - dirtyBegin) * sizeof(glm::mat4),
+                                    &mats[dirtyBegin]);
+    }
+    dirtyBegin = dirtyEnd = 0;
+}
+
+void JointPalette::bind(GLuint unit) {
+    if (!created) {
+        return;
+    }
+    mp_context->glActiveTexture(GL_TEXTURE0 + unit);
+    mp_context->glBindTexture(GL_TEXTURE_BUFFER, tex);
+}
+
+void JointPalette::destroy() {
+    if (!created) {
+        return;
+    }
+    mp_context->glDeleteBuffers(1, &buf);
+    mp_context->glDeleteTextures(1, &tex);
+    created = false;
+    gpuCapacity = 0;
+}
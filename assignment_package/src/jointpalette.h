@@ -0,0 +1,47 @@
+#ifndef JOINTPALETTE_H
+#define JOINTPALETTE_H
+
+#include <openglcontext.h>
+#include <la.h>
+#include <vector>
+
+// The skinning matrix (overall transformation * bind matrix) of every
+// joint, kept in a texture buffer and read by the skinning shader with
+// texelFetch. Unlike a uniform mat4 array this is not limited by the
+// number of uniform components, so rigs with hundreds of joints fit.
+// Only the range of matrices changed since the last upload is sent.
+class JointPalette
+{
+private:
+    std::vector<glm::mat4> mats;
+    size_t dirtyBegin, dirtyEnd;
+
+    GLuint buf;
+    GLuint tex;
+    bool created;
+    size_t gpuCapacity;
+
+    OpenGLContext* mp_context;
+
+public:
+    JointPalette(OpenGLContext* context);
+    ~JointPalette();
+
+    // Sets the number of joints in the palette.
+    // New entries are identity matrices.
+    void resize(size_t jointCount);
+    size_t size() const;
+
+    void set(size_t id, const glm::mat4 &m);
+    // Marks [begin, end) as changed and returns it for writing in bulk.
+    glm::mat4* writeRange(size_t begin, size_t end);
+    const glm::mat4& get(size_t id) const;
+
+    // Sends the changed range of matrices to the GPU.
+    void upload();
+    // Binds the palette's texture to the given texture unit.
+    void bind(GLuint unit);
+    void destroy();
+};
+
+#endif // JOINTPALETTE_H
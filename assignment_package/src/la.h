@@ -12,6 +12,8 @@
 #    include <glm/gtc/type_ptr.hpp>
 //#undef GLM_CIS460
 
+// The core library links no Qt GUI module, so it goes without these.
+#ifndef MICROMAYA_CORE
 #include <QMatrix4x4>
 #include<QVector4D>
 
@@ -20,6 +22,7 @@ namespace la {
     QMatrix4x4 to_qmat(const glm::mat4 &m);
     QVector4D to_qvec(const glm::vec4 &v);
 }
+#endif
 
 
 #endif // LA
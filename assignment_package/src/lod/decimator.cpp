@@ -0,0 +1,494 @@
+#include "decimator.h"
+#include "parallel.h"
+#include "profiling/trace.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+namespace {
+
+// Upper triangle, by rows, of w [n d]^T [n d] for the plane n.p + d = 0.
+void addPlane(double q[10], const glm::dvec3 &n, double d, double w) {
+    q[0] += w * n.x * n.x; q[1] += w * n.x * n.y; q[2] += w * n.x * n.z; q[3] += w * n.x * d;
+    q[4] += w * n.y * n.y; q[5] += w * n.y * n.z; q[6] += w * n.y * d;
+    q[7] += w * n.z * n.z; q[8] += w * n.z * d;
+    q[9] += w * d * d;
+}
+
+double quadricError(const double q[10], const glm::dvec3 &p) {
+    return q[0] * p.x * p.x + 2 * q[1] * p.x * p.y + 2 * q[2] * p.x * p.z + 2 * q[3] * p.x
+         + q[4] * p.y * p.y + 2 * q[5] * p.y * p.z + 2 * q[6] * p.y
+         + q[7] * p.z * p.z + 2 * q[8] * p.z
+         + q[9];
+}
+
+glm::vec3 triangleCross(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+    return glm::cross(b - a, c - a);
+}
+
+} // namespace
+
+Decimator::Settings::Settings()
+    : boundaryWeight(1000.f), minNormalDot(0.2f)
+{}
+
+Decimator::Decimator(const std::vector<glm::vec3> &positions,
+                     const std::vector<uint32_t> &triangles,
+                     const Settings &settings)
+    : settings(settings), positions(positions), quadrics(positions.size()), stamps(positions.size(), 0),
+      boundary(positions.size(), 0), vertexAlive(positions.size(), 1), vertexTriangles(positions.size()),
+      triangles(triangles), triangleAlive(triangles.size() / 3, 1), liveTriangles(triangles.size() / 3),
+      heap(), collapses(0)
+{
+    TRACE_SCOPE("Decimator: setup");
+    this->triangles.resize(liveTriangles * 3);
+    std::vector<uint32_t> counts(positions.size(), 0);
+    for (uint32_t v : this->triangles) {
+        counts[v]++;
+    }
+    for (size_t v = 0; v < positions.size(); v++) {
+        vertexTriangles[v].reserve(counts[v]);
+    }
+    for (size_t t = 0; t < liveTriangles; t++) {
+        for (int k = 0; k < 3; k++) {
+            vertexTriangles[this->triangles[3 * t + k]].push_back(uint32_t(t));
+        }
+    }
+    computeQuadrics();
+
+    // Every edge once, from its lower vertex, then all costs in parallel.
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    edges.reserve(this->triangles.size() / 2 + positions.size());
+    std::vector<uint32_t> around;
+    for (size_t v = 0; v < positions.size(); v++) {
+        neighbours(uint32_t(v), around);
+        for (uint32_t n : around) {
+            if (n > v) {
+                edges.emplace_back(uint32_t(v), n);
+            }
+        }
+    }
+    std::vector<Candidate> candidates(edges.size());
+    std::vector<uint8_t> valid(edges.size(), 0);
+    parallelFor(edges.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            valid[i] = evaluate(edges[i].first, edges[i].second, candidates[i]);
+        }
+    });
+    heap.reserve(edges.size());
+    for (size_t i = 0; i < edges.size(); i++) {
+        if (valid[i]) {
+            heap.push_back(candidates[i]);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+}
+
+void Decimator::computeQuadrics() {
+    // Each vertex sums the planes of its own triangles, so vertices
+    // are independent and no two threads write the same quadric.
+    parallelFor(positions.size(), 2048, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            Quadric &q = quadrics[v];
+            std::fill(q.q, q.q + 10, 0.0);
+            for (uint32_t t : vertexTriangles[v]) {
+                const uint32_t* c = &triangles[3 * t];
+                glm::dvec3 n = glm::dvec3(triangleCross(positions[c[0]], positions[c[1]], positions[c[2]]));
+                double len = glm::length(n);
+                if (len <= 0.0) {
+                    continue;
+                }
+                n /= len;
+                addPlane(q.q, n, -glm::dot(n, glm::dvec3(positions[c[0]])), len / 2);
+            }
+        }
+    });
+
+    // A directed edge with no reverse is open. Sorted keys find
+    // reverses by bisection.
+    std::vector<uint64_t> keys(triangles.size());
+    parallelFor(liveTriangles, 4096, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++) {
+            for (int k = 0; k < 3; k++) {
+                keys[3 * t + k] = uint64_t(triangles[3 * t + k]) << 32 | triangles[3 * t + (k + 1) % 3];
+            }
+        }
+    });
+    std::vector<uint64_t> sorted = keys;
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < keys.size(); i++) {
+        uint32_t u = uint32_t(keys[i] >> 32), v = uint32_t(keys[i]);
+        if (std::binary_search(sorted.begin(), sorted.end(), uint64_t(v) << 32 | u)) {
+            continue;
+        }
+        boundary[u] = boundary[v] = 1;
+        // The plane through the edge perpendicular to its triangle.
+        const uint32_t* c = &triangles[i - i % 3];
+        glm::dvec3 face = glm::dvec3(triangleCross(positions[c[0]], positions[c[1]], positions[c[2]]));
+        glm::dvec3 e = glm::dvec3(positions[v]) - glm::dvec3(positions[u]);
+        glm::dvec3 n = glm::cross(e, face);
+        double len = glm::length(n);
+        if (len <= 0.0) {
+            continue;
+        }
+        n /= len;
+        double d = -glm::dot(n, glm::dvec3(positions[u]));
+        double w = settings.boundaryWeight * glm::dot(e, e);
+        addPlane(quadrics[u].q, n, d, w);
+        addPlane(quadrics[v].q, n, d, w);
+    }
+}
+
+void Decimator::neighbours(uint32_t v, std::vector<uint32_t> &out) const {
+    out.clear();
+    for (uint32_t t : vertexTriangles[v]) {
+        if (!triangleAlive[t]) {
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            if (triangles[3 * t + k] != v) {
+                out.push_back(triangles[3 * t + k]);
+            }
+        }
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+bool Decimator::evaluate(uint32_t u, uint32_t v, Candidate &c) const {
+    double q[10];
+    for (int i = 0; i < 10; i++) {
+        q[i] = quadrics[u].q[i] + quadrics[v].q[i];
+    }
+    glm::dvec3 pu(positions[u]), pv(positions[v]);
+
+    // The minimum of the quadric, if it has one near the edge.
+    glm::dmat3 A(q[0], q[1], q[2],
+                 q[1], q[4], q[5],
+                 q[2], q[5], q[7]);
+    double trace = q[0] + q[4] + q[7];
+    double det = glm::determinant(A);
+    glm::dvec3 best = (pu + pv) / 2.0;
+    double cost = quadricError(q, best);
+    bool solved = false;
+    if (trace > 0.0 && std::abs(det) > 1e-9 * trace * trace * trace) {
+        glm::dvec3 p = glm::inverse(A) * -glm::dvec3(q[3], q[6], q[8]);
+        glm::dvec3 mid = (pu + pv) / 2.0;
+        // Nearly flat quadrics put the minimum far away along the surface.
+        if (glm::dot(p - mid, p - mid) <= 4.0 * glm::dot(pv - pu, pv - pu)) {
+            best = p;
+            cost = quadricError(q, p);
+            solved = true;
+        }
+    }
+    if (!solved) {
+        for (const glm::dvec3 &p : { pu, pv }) {
+            double e = quadricError(q, p);
+            if (e < cost) {
+                cost = e;
+                best = p;
+            }
+        }
+    }
+
+    // Flat regions cost nothing to collapse anywhere. A little for
+    // length, scaled by the area around the edge, keeps the collapses
+    // spread out instead of letting one vertex swallow its neighbours.
+    cost = std::max(cost, 0.0) + 1e-3 * trace * glm::dot(pv - pu, pv - pu);
+
+    // A boundary vertex outlives an inner one, otherwise the nearer does.
+    bool keepU = boundary[u] != boundary[v]
+               ? bool(boundary[u])
+               : glm::dot(best - pu, best - pu) < glm::dot(best - pv, best - pv);
+    c.cost = cost;
+    c.a = keepU ? v : u;
+    c.b = keepU ? u : v;
+    c.stampA = stamps[c.a];
+    c.stampB = stamps[c.b];
+    c.target = glm::vec3(best);
+    return std::isfinite(c.cost);
+}
+
+bool Decimator::canCollapse(const Candidate &c) const {
+    uint32_t a = c.a, b = c.b;
+    if (!vertexAlive[a] || !vertexAlive[b] || stamps[a] != c.stampA || stamps[b] != c.stampB) {
+        return false;
+    }
+
+    // The triangles on the edge, and the corners across from it.
+    uint32_t opposite[2];
+    size_t shared = 0;
+    for (uint32_t t : vertexTriangles[a]) {
+        if (!triangleAlive[t]) {
+            continue;
+        }
+        const uint32_t* v = &triangles[3 * t];
+        if (v[0] != b && v[1] != b && v[2] != b) {
+            continue;
+        }
+        if (shared == 2) {
+            return false;
+        }
+        opposite[shared++] = v[0] != a && v[0] != b ? v[0] : v[1] != a && v[1] != b ? v[1] : v[2];
+    }
+    if (shared == 0 || liveTriangles - shared < 4) {
+        return false;
+    }
+    // Joining two boundary vertices across the inside pinches the surface.
+    if (boundary[a] && boundary[b] && shared != 1) {
+        return false;
+    }
+
+    // Link condition: the only vertices next to both are those across
+    // the edge, or merging them would fold two triangles together.
+    std::vector<uint32_t> na, nb;
+    neighbours(a, na);
+    neighbours(b, nb);
+    size_t common = 0;
+    for (size_t i = 0, j = 0; i < na.size() && j < nb.size();) {
+        if (na[i] < nb[j]) {
+            i++;
+        } else if (nb[j] < na[i]) {
+            j++;
+        } else {
+            if (na[i] != opposite[0] && (shared < 2 || na[i] != opposite[1])) {
+                return false;
+            }
+            common++;
+            i++;
+            j++;
+        }
+    }
+    if (common != shared) {
+        return false;
+    }
+
+    // No triangle that moves may flip or collapse to a sliver.
+    for (uint32_t end : { a, b }) {
+        for (uint32_t t : vertexTriangles[end]) {
+            if (!triangleAlive[t]) {
+                continue;
+            }
+            const uint32_t* v = &triangles[3 * t];
+            bool hasA = v[0] == a || v[1] == a || v[2] == a;
+            bool hasB = v[0] == b || v[1] == b || v[2] == b;
+            if (hasA && hasB) {
+                continue;
+            }
+            glm::vec3 p[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = v[k] == end ? c.target : positions[v[k]];
+            }
+            glm::vec3 before = triangleCross(positions[v[0]], positions[v[1]], positions[v[2]]);
+            glm::vec3 after = triangleCross(p[0], p[1], p[2]);
+            float lenBefore = glm::length(before), lenAfter = glm::length(after);
+            if (lenAfter <= 1e-6f * lenBefore
+                    || glm::dot(before, after) < settings.minNormalDot * lenBefore * lenAfter) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Decimator::collapse(const Candidate &c) {
+    uint32_t a = c.a, b = c.b;
+    positions[b] = c.target;
+    for (int i = 0; i < 10; i++) {
+        quadrics[b].q[i] += quadrics[a].q[i];
+    }
+    boundary[b] |= boundary[a];
+    vertexAlive[a] = 0;
+    stamps[a]++;
+    stamps[b]++;
+
+    // Triangles on the edge go, the rest of a's move over to b.
+    std::vector<uint32_t> &bt = vertexTriangles[b];
+    for (uint32_t t : vertexTriangles[a]) {
+        if (!triangleAlive[t]) {
+            continue;
+        }
+        uint32_t* v = &triangles[3 * t];
+        if (v[0] == b || v[1] == b || v[2] == b) {
+            triangleAlive[t] = 0;
+            liveTriangles--;
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            if (v[k] == a) {
+                v[k] = b;
+            }
+        }
+        bt.push_back(t);
+    }
+    std::vector<uint32_t>().swap(vertexTriangles[a]);
+    bt.erase(std::remove_if(bt.begin(), bt.end(), [this](uint32_t t) { return !triangleAlive[t]; }), bt.end());
+    collapses++;
+    pushEdges(b);
+}
+
+void Decimator::pushEdges(uint32_t v) {
+    std::vector<uint32_t> around;
+    neighbours(v, around);
+    for (uint32_t n : around) {
+        Candidate c;
+        if (evaluate(v, n, c)) {
+            heap.push_back(c);
+            std::push_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+        }
+    }
+}
+
+bool Decimator::collapseTo(size_t target, JobControl* control) {
+    TRACE_SCOPE("Decimator::collapseTo");
+    size_t popped = 0;
+    while (liveTriangles > target && !heap.empty()) {
+        if (control != nullptr && ++popped % 1024 == 0 && control->isCancelled()) {
+            return false;
+        }
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+        Candidate c = heap.back();
+        heap.pop_back();
+        // Stale and refused entries are dropped. A vertex that changes
+        // later pushes its edges again.
+        if (canCollapse(c)) {
+            collapse(c);
+        }
+    }
+    return true;
+}
+
+size_t Decimator::triangleCount() const {
+    return liveTriangles;
+}
+
+size_t Decimator::collapseCount() const {
+    return collapses;
+}
+
+void Decimator::extract(std::vector<glm::vec3> &positions, std::vector<uint32_t> &triangles,
+                        std::vector<uint32_t> &sourceTriangle, std::vector<uint32_t> &sourceVertex) const {
+    const uint32_t UNUSED = ~0u;
+    std::vector<uint32_t> remap(this->positions.size(), UNUSED);
+    for (size_t t = 0; t < triangleAlive.size(); t++) {
+        if (triangleAlive[t]) {
+            for (int k = 0; k < 3; k++) {
+                remap[this->triangles[3 * t + k]] = 0;
+            }
+        }
+    }
+    positions.clear();
+    sourceVertex.clear();
+    for (size_t v = 0; v < remap.size(); v++) {
+        if (remap[v] != UNUSED) {
+            remap[v] = uint32_t(positions.size());
+            positions.push_back(this->positions[v]);
+            sourceVertex.push_back(uint32_t(v));
+        }
+    }
+    triangles.clear();
+    sourceTriangle.clear();
+    triangles.reserve(liveTriangles * 3);
+    sourceTriangle.reserve(liveTriangles);
+    for (size_t t = 0; t < triangleAlive.size(); t++) {
+        if (triangleAlive[t]) {
+            for (int k = 0; k < 3; k++) {
+                triangles.push_back(remap[this->triangles[3 * t + k]]);
+            }
+            sourceTriangle.push_back(uint32_t(t));
+        }
+    }
+}
+
+//--------------------------------------------------
+// LOD chains
+//--------------------------------------------------
+std::vector<uPtr<HalfEdgeMesh>> buildLodChain(const HalfEdgeMesh &mesh, const std::vector<float> &ratios,
+                                               JobControl* control) {
+    TRACE_SCOPE("buildLodChain");
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> triangles, triangleFaces;
+    mesh.flatten(positions, triangles, &triangleFaces);
+    std::vector<glm::vec3> colors = mesh.colors();
+    SkinInfluences skin = mesh.skin();
+
+    Decimator decimator(positions, triangles);
+    size_t full = triangles.size() / 3;
+    size_t last = full;
+    for (float r : ratios) {
+        last = std::min(last, size_t(std::max(r, 0.f) * full));
+    }
+
+    std::vector<uPtr<HalfEdgeMesh>> chain;
+    std::vector<glm::vec3> lodPositions;
+    std::vector<uint32_t> lodTriangles, sourceTriangle, sourceVertex;
+    for (float r : ratios) {
+        if (!decimator.collapseTo(size_t(std::max(r, 0.f) * full), control)) {
+            return {};
+        }
+        decimator.extract(lodPositions, lodTriangles, sourceTriangle, sourceVertex);
+
+        std::vector<uint32_t> faceStarts(sourceTriangle.size() + 1);
+        for (size_t i = 0; i < faceStarts.size(); i++) {
+            faceStarts[i] = uint32_t(3 * i);
+        }
+        uPtr<HalfEdgeMesh> lod = mkU<HalfEdgeMesh>();
+        if (!lod->buildFromPolygons(lodPositions, faceStarts, lodTriangles)) {
+            return {};
+        }
+        std::vector<glm::vec3> lodColors(sourceTriangle.size());
+        for (size_t i = 0; i < sourceTriangle.size(); i++) {
+            lodColors[i] = colors[triangleFaces[sourceTriangle[i]]];
+        }
+        lod->setColors(lodColors);
+        SkinInfluences lodSkin;
+        lodSkin.ids.resize(sourceVertex.size());
+        lodSkin.weights.resize(sourceVertex.size());
+        for (size_t i = 0; i < sourceVertex.size(); i++) {
+            lodSkin.ids[i] = skin.ids[sourceVertex[i]];
+            lodSkin.weights[i] = skin.weights[sourceVertex[i]];
+        }
+        lod->setSkin(lodSkin);
+        chain.push_back(std::move(lod));
+
+        if (control != nullptr) {
+            control->setProgress(full > last ? float(full - decimator.triangleCount()) / float(full - last) : 1.f);
+        }
+    }
+    return chain;
+}
+
+float projectedPixels(float radius, float distance, float fovy, unsigned height) {
+    if (distance <= radius) {
+        return std::numeric_limits<float>::max();
+    }
+    // The sphere's angular radius against half the field of view.
+    float angle = std::asin(radius / distance);
+    return height * std::tan(angle) / std::tan(glm::radians(fovy) / 2.f);
+}
+
+int selectLod(const std::vector<size_t> &triangleCounts, float pixels, int current,
+              float trianglePixels, float hysteresis) {
+    if (triangleCounts.empty()) {
+        return 0;
+    }
+    float half = pixels / 2.f;
+    double wanted = 3.14159265 * double(half) * half / trianglePixels;
+    // The coarsest level with at least as many triangles as wanted.
+    auto pick = [&triangleCounts](double want) {
+        int level = 0;
+        for (size_t i = 0; i < triangleCounts.size(); i++) {
+            if (double(triangleCounts[i]) >= want) {
+                level = int(i);
+            }
+        }
+        return level;
+    };
+    int finest = pick(wanted * (1.0 + hysteresis));
+    int coarsest = pick(wanted * (1.0 - hysteresis));
+    if (current >= finest && current <= coarsest) {
+        return current;
+    }
+    return pick(wanted);
+}
@@ -0,0 +1,110 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include "halfedgemesh.h"
+#include "jobs/job.h"
+#include "smartpointerhelp.h"
+#include <la.h>
+#include <cstdint>
+#include <vector>
+
+// Simplifies a triangle mesh by quadric error edge collapse (Garland and
+// Heckbert). Every vertex sums the planes of its triangles, weighted by
+// area, into a quadric Q, and collapsing an edge costs v^T Q v for the
+// best position v of the merged vertex under the sum of both quadrics.
+// Edges wait in a priority queue that is never updated in place: an
+// entry is skipped when popped if either vertex changed since it was
+// pushed, and the edges around every merged vertex are pushed again.
+//
+// Open edges add planes through them, perpendicular to their triangle,
+// with a heavy weight, so outlines stay where they are. A collapse is
+// refused if it would make the surface non-manifold, join two boundary
+// vertices across the inside, or flip or flatten a triangle.
+class Decimator
+{
+public:
+    struct Settings {
+        float boundaryWeight;   // Of open edge planes against triangle planes.
+        float minNormalDot;     // Least cosine a triangle's normal may turn by.
+
+        Settings();
+    };
+
+private:
+    // Symmetric 4x4 matrix, upper triangle by rows.
+    struct Quadric {
+        double q[10];
+    };
+    struct Candidate {
+        double cost;
+        uint32_t a, b;          // a merges into b.
+        uint32_t stampA, stampB;
+        glm::vec3 target;
+
+        bool operator>(const Candidate &c) const { return cost > c.cost; }
+    };
+
+    Settings settings;
+    std::vector<glm::vec3> positions;
+    std::vector<Quadric> quadrics;
+    std::vector<uint32_t> stamps;       // Bumped every time a vertex changes.
+    std::vector<uint8_t> boundary;
+    std::vector<uint8_t> vertexAlive;
+    // The triangles around every vertex. Dead ones are dropped lazily.
+    std::vector<std::vector<uint32_t>> vertexTriangles;
+    std::vector<uint32_t> triangles;    // Three corners each.
+    std::vector<uint8_t> triangleAlive;
+    size_t liveTriangles;
+    std::vector<Candidate> heap;        // Min-heap on cost.
+    size_t collapses;
+
+    void computeQuadrics();
+    void pushEdges(uint32_t v);
+    bool evaluate(uint32_t u, uint32_t v, Candidate &c) const;
+    bool canCollapse(const Candidate &c) const;
+    void collapse(const Candidate &c);
+    // Vertices sharing a live triangle with v, in no particular order.
+    void neighbours(uint32_t v, std::vector<uint32_t> &out) const;
+
+public:
+    // positions and triangles as from HalfEdgeMesh::flatten.
+    Decimator(const std::vector<glm::vec3> &positions,
+              const std::vector<uint32_t> &triangles,
+              const Settings &settings = Settings());
+
+    // Collapses the cheapest edges until at most target triangles are
+    // left or no edge can go. Returns false if control cancels.
+    bool collapseTo(size_t target, JobControl* control = nullptr);
+
+    size_t triangleCount() const;
+    size_t collapseCount() const;
+
+    // The mesh as it stands, with unused vertices dropped.
+    // sourceTriangle gives the input triangle every triangle was,
+    // and sourceVertex the input vertex every vertex kept.
+    void extract(std::vector<glm::vec3> &positions, std::vector<uint32_t> &triangles,
+                 std::vector<uint32_t> &sourceTriangle, std::vector<uint32_t> &sourceVertex) const;
+};
+
+// Decimated copies of mesh, copy i having about ratios[i] of its
+// triangles, in the order given. Faces keep the colors of the faces they
+// came from and vertices their skin weights. The copies come from one
+// run of collapses, so ratios should fall. Returns no copies if control
+// cancels.
+std::vector<uPtr<HalfEdgeMesh>> buildLodChain(const HalfEdgeMesh &mesh, const std::vector<float> &ratios,
+                                               JobControl* control = nullptr);
+
+// Height in pixels of a sphere of the given radius and distance from the
+// eye, seen through a vertical field of view of fovy degrees on a viewport
+// height pixels high.
+float projectedPixels(float radius, float distance, float fovy, unsigned height);
+
+// The level to draw, given the triangles of every level from finest to
+// coarsest and the projected height of the mesh. Picks the coarsest level
+// that still spends trianglePixels square pixels or less per triangle, but
+// stays at current while the ideal level is within the hysteresis fraction
+// of it, so the level does not flicker at a threshold.
+int selectLod(const std::vector<size_t> &triangleCounts, float pixels, int current,
+              float trianglePixels = 8.f, float hysteresis = 0.25f);
+
+#endif // DECIMATOR_H
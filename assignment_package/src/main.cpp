@@ -1,4 +1,5 @@
 #include <mainwindow.h>
+#include "profiling/trace.h"
 
 #include <QApplication>
 #include <QSurfaceFormat>
@@ -38,8 +39,19 @@ int main(int argc, char *argv[])
     QSurfaceFormat::setDefaultFormat(format);
     debugFormatVersion();
 
+    // MICROMAYA_TRACE=trace.json traces the whole session, shader
+    // compiles included, and writes the trace on exit.
+    QString tracePath = qEnvironmentVariable("MICROMAYA_TRACE");
+    trace::setThreadName("main");
+    trace::setEnabled(!tracePath.isEmpty());
+
     MainWindow w;
     w.show();
 
-    return a.exec();
+    int status = a.exec();
+    std::string error;
+    if (!tracePath.isEmpty() && !trace::writeChromeJSON(tracePath.toStdString(), &error)) {
+        qWarning() << "Cannot write trace:" << QString::fromStdString(error);
+    }
+    return status;
 }
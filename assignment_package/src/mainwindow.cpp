@@ -1,7 +1,9 @@
 #include "mainwindow.h"
 #include <ui_mainwindow.h>
 #include "cameracontrolshelp.h"
+#include "profiling/trace.h"
 #include <QFileDialog>
+#include <QInputDialog>
 
 
 MainWindow::MainWindow(QWidget *parent) :
@@ -53,6 +55,10 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->triangulateFaceButton, SIGNAL(clicked()),
             ui->mygl, SLOT(slot_triangulateFace()));
 
+    // Triangulate every face of the mesh
+    connect(ui->triangulateAllButton, SIGNAL(clicked()),
+            ui->mygl, SLOT(slot_triangulateMesh()));
+
     // Subdivide the mesh
     connect(ui->subdivideButton, SIGNAL(clicked()),
             ui->mygl, SLOT(slot_subdivide()));
@@ -86,6 +92,47 @@ MainWindow::MainWindow(QWidget *parent) :
     // Skin the mesh
     connect(ui->skinMeshButton, SIGNAL(clicked()),
             ui->mygl, SLOT(slot_skinMesh()));
+    connect(ui->heatSkinButton, SIGNAL(clicked()),
+            ui->mygl, SLOT(slot_heatSkinMesh()));
+
+    // Key the current pose and play back the keyed clip
+    connect(ui->setKeyButton, SIGNAL(clicked()),
+            ui->mygl, SLOT(slot_setKey()));
+    connect(ui->playButton, SIGNAL(clicked()),
+            ui->mygl, SLOT(slot_togglePlayback()));
+    connect(ui->cubicCheckBox, SIGNAL(toggled(bool)),
+            ui->mygl, SLOT(slot_setCubic(bool)));
+    connect(ui->compressButton, SIGNAL(clicked()),
+            ui->mygl, SLOT(slot_compressClip()));
+
+    // Draw a crowd of instances in place of the skinned mesh
+    connect(ui->crowdSpinBox, SIGNAL(valueChanged(int)),
+            ui->mygl, SLOT(slot_setCrowdSize(int)));
+
+    // Show statistics sent by MyGL
+    connect(ui->mygl, SIGNAL(sig_sendStats(QString)), this, SLOT(slot_setStats(QString)));
+
+    // Show and cancel background jobs
+    ui->jobProgressBar->setVisible(false);
+    connect(ui->mygl, SIGNAL(sig_sendProgress(int)), this, SLOT(slot_setProgress(int)));
+    connect(ui->cancelJobButton, SIGNAL(clicked()),
+            ui->mygl, SLOT(slot_cancelJobs()));
+
+    // Preview subdivision levels and step between them
+    connect(ui->previewButton, SIGNAL(clicked()),
+            ui->mygl, SLOT(slot_previewSubdivision()));
+    connect(ui->levelSpinBox, SIGNAL(valueChanged(int)),
+            ui->mygl, SLOT(slot_setSubdivisionLevel(int)));
+    connect(ui->mygl, SIGNAL(sig_sendLevels(int,int)), this, SLOT(slot_setLevels(int,int)));
+    connect(ui->mygl, SIGNAL(sig_releaseListWidgets()), this, SLOT(slot_releaseListWidgets()));
+    connect(ui->mygl, SIGNAL(sig_takeListItems(int,int,int)), this, SLOT(slot_takeListItems(int,int,int)));
+
+    // Reveal components and joints picked in the viewport
+    connect(ui->mygl, SIGNAL(sig_showListItem(QListWidgetItem*)), this, SLOT(slot_showListItem(QListWidgetItem*)));
+    connect(ui->mygl, SIGNAL(sig_showTreeItem(QTreeWidgetItem*)), this, SLOT(slot_showTreeItem(QTreeWidgetItem*)));
+
+    // Tracing may already be on from MICROMAYA_TRACE.
+    ui->actionRecord_Trace->setChecked(trace::enabled());
 }
 
 MainWindow::~MainWindow()
@@ -118,6 +165,111 @@ void MainWindow::on_actionLoad_JSON_triggered()
     }
 }
 
+void MainWindow::on_actionLoad_BVH_triggered()
+{
+    QString BVH_file = QFileDialog::getOpenFileName(this, tr("Load BVH"),
+                                                    "../jsons",
+                                                    tr("BVH Files (*.bvh)"));
+    if (BVH_file != "") {
+        ui->mygl->load_BVH(BVH_file);
+    }
+}
+
+void MainWindow::on_actionLoad_Skeleton_triggered()
+{
+    QString SKEL_file = QFileDialog::getOpenFileName(this, tr("Load Skeleton"),
+                                                     "../jsons",
+                                                     tr("Binary Skeletons (*.skel)"));
+    if (SKEL_file != "") {
+        ui->mygl->load_SKEL(SKEL_file);
+    }
+}
+
+void MainWindow::on_actionSave_Skeleton_triggered()
+{
+    QString SKEL_file = QFileDialog::getSaveFileName(this, tr("Save Skeleton"),
+                                                     "../jsons",
+                                                     tr("Binary Skeletons (*.skel)"));
+    if (SKEL_file != "") {
+        ui->mygl->save_SKEL(SKEL_file);
+    }
+}
+
+void MainWindow::on_actionUndo_triggered()
+{
+    ui->mygl->slot_undo();
+}
+
+void MainWindow::on_actionRedo_triggered()
+{
+    ui->mygl->slot_redo();
+}
+
+void MainWindow::on_actionHistory_Budget_triggered()
+{
+    bool ok;
+    int megabytes = QInputDialog::getInt(this, tr("Undo History Budget"), tr("Megabytes:"),
+                                         ui->mygl->m_history.getBudget() >> 20, 1, 1 << 16, 1, &ok);
+    if (ok) {
+        ui->mygl->slot_setHistoryBudget(megabytes);
+    }
+}
+
+void MainWindow::on_actionWeld_on_Load_toggled(bool checked)
+{
+    ui->mygl->slot_setWeldOnLoad(checked);
+}
+
+void MainWindow::on_actionOptimize_Vertex_Cache_toggled(bool checked)
+{
+    ui->mygl->slot_setOptimizeIndices(checked);
+}
+
+void MainWindow::on_actionLimit_Surface_Shading_toggled(bool checked)
+{
+    ui->mygl->slot_setLimitShading(checked);
+}
+
+void MainWindow::on_actionMemory_Usage_triggered()
+{
+    ui->mygl->slot_showMemory();
+}
+
+void MainWindow::on_actionBuild_LOD_Chain_triggered()
+{
+    ui->mygl->slot_buildLods();
+}
+
+void MainWindow::on_actionAutomatic_LOD_toggled(bool checked)
+{
+    ui->mygl->slot_setAutoLod(checked);
+}
+
+void MainWindow::on_actionRecord_Trace_toggled(bool checked)
+{
+    // Each recording starts from an empty trace.
+    if (checked) {
+        trace::clear();
+    }
+    trace::setEnabled(checked);
+}
+
+void MainWindow::on_actionSave_Trace_triggered()
+{
+    QString file = QFileDialog::getSaveFileName(this, tr("Save Trace"), "trace.json",
+                                                tr("Chrome Traces (*.json)"));
+    if (file == "") {
+        return;
+    }
+    std::string error;
+    if (trace::writeChromeJSON(file.toStdString(), &error)) {
+        slot_setStats(tr("Saved %1 trace events; open them in chrome://tracing or ui.perfetto.dev")
+                      .arg(trace::eventCount()));
+    } else {
+        slot_setStats(tr("Cannot save trace: %1").arg(QString::fromStdString(error)));
+    }
+}
+
 void MainWindow::on_actionCamera_Controls_triggered()
 {
     CameraControlsHelp* c = new CameraControlsHelp();
@@ -149,8 +301,67 @@ void MainWindow::slot_clearListWidgets() {
     ui->facesListWidget->clear();
 }
 
+// Unlike clear(), taking the items leaves them to their owners.
+// Taking from the back keeps each removal cheap.
+void MainWindow::slot_releaseListWidgets() {
+    ui->mygl->m_vertDisplay = VertexDisplay(ui->mygl);
+    ui->mygl->m_heDisplay = HalfEdgeDisplay(ui->mygl);
+    ui->mygl->m_faceDisplay = FaceDisplay(ui->mygl);
+    for (QListWidget* list : {ui->vertsListWidget, ui->halfEdgesListWidget, ui->facesListWidget}) {
+        for (int i = list->count() - 1; i >= 0; i--) {
+            list->takeItem(i);
+        }
+    }
+}
+
+void MainWindow::slot_takeListItems(int verts, int edges, int faces) {
+    ui->mygl->m_vertDisplay = VertexDisplay(ui->mygl);
+    ui->mygl->m_heDisplay = HalfEdgeDisplay(ui->mygl);
+    ui->mygl->m_faceDisplay = FaceDisplay(ui->mygl);
+    ui->mygl->m_mesh.setSelectedFace(nullptr);
+    for (int i = 0; i < verts; i++) {
+        ui->vertsListWidget->takeItem(ui->vertsListWidget->count() - 1);
+    }
+    for (int i = 0; i < edges; i++) {
+        ui->halfEdgesListWidget->takeItem(ui->halfEdgesListWidget->count() - 1);
+    }
+    for (int i = 0; i < faces; i++) {
+        ui->facesListWidget->takeItem(ui->facesListWidget->count() - 1);
+    }
+}
+
+void MainWindow::slot_showListItem(QListWidgetItem* i) {
+    i->listWidget()->setCurrentItem(i);
+    i->listWidget()->scrollToItem(i);
+}
+
+void MainWindow::slot_showTreeItem(QTreeWidgetItem* i) {
+    ui->jointsTreeWidget->setCurrentItem(i);
+    ui->jointsTreeWidget->scrollToItem(i);
+}
+
 void MainWindow::slot_clearTreeWidget() {
     ui->mygl->selectedJoint = nullptr;
     ui->mygl->joint = mkU<Joint>(Joint(ui->mygl));
     ui->jointsTreeWidget->clear();
 }
+
+void MainWindow::slot_setStats(QString s) {
+    ui->statsLabel->setText(s);
+}
+
+void MainWindow::slot_setLevels(int level, int finest) {
+    ui->levelSpinBox->blockSignals(true);
+    ui->levelSpinBox->setMaximum(finest);
+    ui->levelSpinBox->setValue(level);
+    ui->levelSpinBox->blockSignals(false);
+}
+
+void MainWindow::slot_setProgress(int percent) {
+    bool running = percent >= 0;
+    ui->jobProgressBar->setVisible(running);
+    ui->cancelJobButton->setEnabled(running);
+    if (running) {
+        ui->jobProgressBar->setValue(percent);
+    }
+}
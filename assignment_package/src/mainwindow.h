@@ -23,6 +23,20 @@ private slots:
     void on_actionQuit_triggered();
     void on_actionLoad_OBJ_triggered();
     void on_actionLoad_JSON_triggered();
+    void on_actionLoad_BVH_triggered();
+    void on_actionLoad_Skeleton_triggered();
+    void on_actionSave_Skeleton_triggered();
+    void on_actionUndo_triggered();
+    void on_actionRedo_triggered();
+    void on_actionHistory_Budget_triggered();
+    void on_actionOptimize_Vertex_Cache_toggled(bool checked);
+    void on_actionLimit_Surface_Shading_toggled(bool checked);
+    void on_actionWeld_on_Load_toggled(bool checked);
+    void on_actionMemory_Usage_triggered();
+    void on_actionBuild_LOD_Chain_triggered();
+    void on_actionAutomatic_LOD_toggled(bool checked);
+    void on_actionRecord_Trace_toggled(bool checked);
+    void on_actionSave_Trace_triggered();
     void on_actionCamera_Controls_triggered();
 
     void slot_addVertexToListWidget(QListWidgetItem*);
@@ -33,8 +47,20 @@ private slots:
     void slot_addJointToTreeWidget(QTreeWidgetItem*);
 
     void slot_clearListWidgets();
+    void slot_releaseListWidgets();
+    void slot_takeListItems(int, int, int);
+    // Selects and scrolls to an item picked in the viewport.
+    void slot_showListItem(QListWidgetItem*);
+    void slot_showTreeItem(QTreeWidgetItem*);
     void slot_clearTreeWidget();
 
+    // Shows playback and performance statistics.
+    void slot_setStats(QString);
+    // Lets the level spin box step through the finished levels.
+    void slot_setLevels(int, int);
+    // Shows the progress of a background job, or hides it at -1.
+    void slot_setProgress(int);
+
 
 private:
     Ui::MainWindow *ui;
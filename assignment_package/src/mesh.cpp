@@ -1,86 +1,429 @@
 #include "mesh.h"
+#include "vertexcache.h"
+#include "parallel.h"
+#include "profiling/memstats.h"
+#include "profiling/trace.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
 
-Mesh::Mesh(OpenGLContext* context) : Drawable(context),
-                                     skinned(false)
-{}
+Mesh::Mesh(OpenGLContext* context) : HalfEdgeMesh(), Drawable(context),
+                                     skinned(false), topologyDirty(true), builtSizes{0, 0, 0},
+                                     optimizeIndices(true), limitShading(false), limitPositions(),
+                                     acmrBefore(0), acmrAfter(0), gpuBytes(0),
+                                     faceAttributes(context), selectedFace(nullptr),
+                                     pickEdges(), bufEdgeIdx(0), pickEdgesBuilt(false),
+                                     bvh(), bvhState(BVHState::BUILD)
+{
+    posFormat = {4, GL_UNSIGNED_SHORT, GL_TRUE};
+    norFormat = {2, GL_SHORT, GL_TRUE};
+    wtsFormat = {2, GL_UNSIGNED_SHORT, GL_TRUE};
+    IDsFormat = {2, GL_UNSIGNED_SHORT, GL_FALSE};
+    octNormals = true;
+    faceColors = true;
+}
 
-void Mesh::create() {
-    // Collect geometry vertice attributes
-    // to later setup VBO's for the shader program.
-    std::vector<glm::vec4> pos_VBO, nor_VBO, col_VBO;
-    std::vector<GLuint> idx;
+Mesh::~Mesh() {
+    if (bufEdgeIdx != 0) {
+        mp_context->glDeleteBuffers(1, &bufEdgeIdx);
+    }
+}
+
+void Mesh::replace(HalfEdgeMesh &&m) {
+    HalfEdgeMesh::operator=(std::move(m));
+    skinned = false;
+    topologyDirty = true;
+    selectedFace = nullptr;
+}
+
+void Mesh::markTopologyChanged() {
+    topologyDirty = true;
+}
+
+void Mesh::setOptimizeIndices(bool optimize) {
+    if (optimizeIndices != optimize) {
+        optimizeIndices = optimize;
+        topologyDirty = true;
+    }
+}
+
+void Mesh::setLimitShading(bool on) {
+    limitShading = on;
+    smoothNormals = on;
+}
+
+bool Mesh::getLimitShading() const {
+    return limitShading;
+}
+
+float Mesh::getAcmrBefore() const {
+    return acmrBefore;
+}
+
+float Mesh::getAcmrAfter() const {
+    return acmrAfter;
+}
 
-    std::vector<glm::vec2> jointWts_VBO;
-    std::vector<glm::ivec2> jointIDs_VBO;
+size_t Mesh::gpuVertexCount() const {
+    return vertexSources.size();
+}
+
+size_t Mesh::gpuMemoryBytes() const {
+    return gpuBytes;
+}
+
+size_t Mesh::faceSlot(const Face* f) const {
+    size_t count = std::min(faces.size(), faceAttributes.size());
+    for (size_t i = 0; i < count; i++) {
+        if (faces[i].get() == f) {
+            return i;
+        }
+    }
+    return faceAttributes.size();
+}
 
-    int global_vct = 0;
+void Mesh::updateFaceColor(const Face* f) {
+    size_t slot = faceSlot(f);
+    if (slot >= faceAttributes.size()) {
+        return;
+    }
+    faceAttributes.setColor(slot, f->color);
+    faceAttributes.upload();
+}
+
+void Mesh::setSelectedFace(const Face* f) {
+    if (f == selectedFace) {
+        return;
+    }
+    for (const Face* g : {selectedFace, f}) {
+        size_t slot = g != nullptr ? faceSlot(g) : faceAttributes.size();
+        if (slot < faceAttributes.size()) {
+            faceAttributes.setFlags(slot, g == f ? FaceAttributes::SELECTED : 0);
+        }
+    }
+    selectedFace = f;
+    faceAttributes.upload();
+}
+
+void Mesh::bindFaceAttributes(GLuint faceUnit, GLuint triangleUnit) {
+    faceAttributes.bind(faceUnit, triangleUnit);
+}
+
+void Mesh::createPickEdges() {
+    if (pickEdgesBuilt) {
+        return;
+    }
+    std::unordered_map<const Vertex*, uint32_t> gpuIndex;
+    gpuIndex.reserve(vertices.size());
+    for (size_t i = 0; i < vertexSources.size(); i++) {
+        gpuIndex.emplace(vertexSources[i]->vertex, uint32_t(i));
+    }
+
+    // A half-edge runs from the vertex of the one before it to its own.
+    std::vector<uint32_t> lines;
+    lines.reserve(half_edges.size() * 2);
+    pickEdges.reserve(half_edges.size());
     for (const auto& face : faces) {
-        int face_vct = 0;
+        HalfEdge* prev = face->half_edge;
+        while (prev->next != face->half_edge) {
+            prev = prev->next;
+        }
         HalfEdge* curr_he = face->half_edge;
         do {
-            // Add vertex position to VBO.
-            pos_VBO.push_back(glm::vec4(curr_he->vertex->pos, 1));
-            // Add vertex normal to VBO.
-            nor_VBO.push_back(glm::vec4(glm::normalize(glm::cross(curr_he->vertex->pos        - curr_he->sym->vertex->pos,
-                                        curr_he->next->vertex->pos  - curr_he->next->sym->vertex->pos)), 0));
-            // Add vertex color to VBO.
-            col_VBO.push_back(glm::vec4(face->color, 0));
-
-            if (skinned) {
-                // Add vertex joint weights to VBO
-                jointWts_VBO.push_back(glm::vec2(curr_he->vertex->infl_weights[0],
-                                                 curr_he->vertex->infl_weights[1]));
-                // Add vertex jointID's to VBO
-                jointIDs_VBO.push_back(glm::ivec2(curr_he->vertex->infl_joints[0]->id,
-                                                  curr_he->vertex->infl_joints[1]->id));
-            }
+            lines.push_back(gpuIndex[prev->vertex]);
+            lines.push_back(gpuIndex[curr_he->vertex]);
+            pickEdges.push_back(curr_he);
+            prev = curr_he;
+            curr_he = curr_he->next;
+        } while (curr_he != face->half_edge);
+    }
+
+    if (bufEdgeIdx == 0) {
+        mp_context->glGenBuffers(1, &bufEdgeIdx);
+    }
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufEdgeIdx);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, lines.size() * sizeof(GLuint), lines.data(), GL_STATIC_DRAW);
+    pickEdgesBuilt = true;
+}
+
+// Maps [0, 1] onto the full range of an unsigned short.
+static GLushort unorm16(float f) {
+    return GLushort(glm::clamp(f, 0.f, 1.f) * 65535.f + 0.5f);
+}
+
+// Maps [-1, 1] onto a signed short.
+static GLshort snorm16(float f) {
+    return GLshort(std::round(glm::clamp(f, -1.f, 1.f) * 32767.f));
+}
+
+// Folds a unit vector onto the octahedron |x| + |y| + |z| = 1 and the
+// lower half over the upper one, leaving a point in [-1, 1]^2.
+static glm::vec2 encodeOctahedral(const glm::vec3 &n) {
+    glm::vec2 p = glm::vec2(n.x, n.y) / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+    if (n.z < 0) {
+        glm::vec2 s(p.x >= 0 ? 1.f : -1.f, p.y >= 0 ? 1.f : -1.f);
+        p = (1.f - glm::abs(glm::vec2(p.y, p.x))) * s;
+    }
+    return p;
+}
+
+bool Mesh::updateBVH() {
+    if (topologyDirty || builtSizes[0] != vertices.size()
+            || builtSizes[1] != half_edges.size() || builtSizes[2] != faces.size()) {
+        return false;
+    }
+    if (bvhState != BVHState::READY) {
+        std::vector<glm::vec3> positions(vertexSources.size());
+        for (size_t i = 0; i < vertexSources.size(); i++) {
+            positions[i] = limitPositions.empty() ? vertexSources[i]->vertex->pos : limitPositions[i];
+        }
+        if (bvhState == BVHState::BUILD) {
+            bvh.build(positions, indices);
+        } else {
+            bvh.refit(positions);
+        }
+        bvhState = BVHState::READY;
+    }
+    return true;
+}
+
+Face* Mesh::raycast(const Ray &ray, glm::vec3* point) {
+    BVH::Hit hit;
+    if (!updateBVH() || !bvh.raycast(ray, hit)) {
+        return nullptr;
+    }
+    if (point != nullptr) {
+        *point = ray.origin + ray.direction * hit.t;
+    }
+    return faces[faceAttributes.triangleFace(hit.triangle)].get();
+}
+
+Face* Mesh::closestPoint(const glm::vec3 &p, glm::vec3* point) {
+    BVH::Closest closest;
+    if (!updateBVH() || !bvh.closestPoint(p, closest)) {
+        return nullptr;
+    }
+    if (point != nullptr) {
+        *point = closest.point;
+    }
+    return faces[faceAttributes.triangleFace(closest.triangle)].get();
+}
+
+size_t Mesh::bvhMemoryBytes() const {
+    return bvh.memoryBytes();
+}
+
+void Mesh::buildIndices() {
+    MEMORY_SCOPE(RENDER_BUFFERS);
+    vertexSources.clear();
+    indices.clear();
+    vertexSources.reserve(vertices.size() + faces.size());
+    std::vector<uint32_t> triangleFaces;
 
+    std::unordered_map<const Vertex*, uint32_t> shared;
+    shared.reserve(vertices.size());
+    std::vector<uint32_t> loop;
+    for (size_t slot = 0; slot < faces.size(); slot++) {
+        const Face* face = faces[slot].get();
+        // The first corner that reaches a vertex stands in for it.
+        loop.clear();
+        HalfEdge* curr_he = face->half_edge;
+        do {
+            auto inserted = shared.emplace(curr_he->vertex, uint32_t(vertexSources.size()));
+            if (inserted.second) {
+                vertexSources.push_back(curr_he);
+            }
+            loop.push_back(inserted.first->second);
             curr_he = curr_he->next;
-            face_vct++;
         } while (curr_he != face->half_edge);
 
-        // Triangulate face by adding indices to VBO.
-        for (int i = 0; i < face_vct - 2; i++) {
-            idx.push_back(global_vct);
-            idx.push_back(global_vct + i + 1);
-            idx.push_back(global_vct + i + 2);
+        uint32_t provoking = uint32_t(vertexSources.size());
+        vertexSources.push_back(face->half_edge);
+        // Fan around the first corner, which goes last in every triangle
+        // since OpenGL takes flat inputs from the last vertex by default.
+        for (size_t i = 1; i + 1 < loop.size(); i++) {
+            indices.push_back(loop[i]);
+            indices.push_back(loop[i + 1]);
+            indices.push_back(provoking);
+            triangleFaces.push_back(uint32_t(slot));
         }
+    }
 
-        global_vct += face_vct;
+    acmrBefore = acmrAfter = vertexcache::computeACMR(indices, vertexSources.size());
+    if (optimizeIndices) {
+        TRACE_SCOPE("Mesh::create: optimize indices");
+        std::vector<uint32_t> triangleOrder;
+        vertexcache::optimizeVertexCache(indices, vertexSources.size(), &triangleOrder);
+        std::vector<uint32_t> reordered(triangleOrder.size());
+        for (size_t i = 0; i < triangleOrder.size(); i++) {
+            reordered[i] = triangleFaces[triangleOrder[i]];
+        }
+        triangleFaces.swap(reordered);
+        std::vector<uint32_t> order = vertexcache::optimizeVertexFetch(indices, vertexSources.size());
+        std::vector<HalfEdge*> sources(order.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            sources[i] = vertexSources[order[i]];
+        }
+        vertexSources.swap(sources);
+        acmrAfter = vertexcache::computeACMR(indices, vertexSources.size());
     }
-    count = idx.size();
+
+    faceAttributes.setTriangleFaces(std::move(triangleFaces));
+    pickEdges.clear();
+    pickEdgesBuilt = false;
+    bvh.clear();
+    bvhState = BVHState::BUILD;
+
+    builtSizes[0] = vertices.size();
+    builtSizes[1] = half_edges.size();
+    builtSizes[2] = faces.size();
+    topologyDirty = false;
+}
+
+void Mesh::create() {
+    TRACE_SCOPE("Mesh::create");
+    // A change in any count means the topology moved on without
+    // markTopologyChanged, and the sources may point at freed corners.
+    if (topologyDirty || builtSizes[0] != vertices.size()
+            || builtSizes[1] != half_edges.size() || builtSizes[2] != faces.size()) {
+        TRACE_SCOPE("Mesh::create: build indices");
+        buildIndices();
+    }
+    // Vertices may have moved, and the boxes with them.
+    if (bvhState == BVHState::READY) {
+        bvhState = BVHState::REFIT;
+    }
+
+    size_t n = vertexSources.size();
+    memstats::Vector<glm::vec3, memstats::Tag::GPU_STAGING> limitNormals;
+    if (limitShading) {
+        TRACE_SCOPE("Mesh::create: limit surface");
+        {
+            MEMORY_SCOPE(RENDER_BUFFERS);
+            limitPositions.resize(n);
+        }
+        limitNormals.resize(n);
+        parallelFor(n, 4096, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                LimitFrame frame;
+                limitFrame(vertexSources[i]->vertex, frame);
+                limitPositions[i] = frame.position;
+                limitNormals[i] = frame.normal;
+            }
+        });
+    } else {
+        limitPositions.clear();
+        limitPositions.shrink_to_fit();
+    }
+    auto position = [this](size_t i) -> const glm::vec3& {
+        return limitPositions.empty() ? vertexSources[i]->vertex->pos : limitPositions[i];
+    };
+
+    // Quantize positions to the bounds of the mesh.
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (size_t i = 0; i < n; i++) {
+        lo = glm::min(lo, position(i));
+        hi = glm::max(hi, position(i));
+    }
+    if (vertexSources.empty()) {
+        lo = hi = glm::vec3(0);
+    }
+    posOffset = lo;
+    posScale = hi - lo;
+    glm::vec3 toUnit(0);
+    for (int i = 0; i < 3; i++) {
+        toUnit[i] = posScale[i] > 0 ? 1.f / posScale[i] : 0.f;
+    }
+
+    // Collect geometry vertice attributes
+    // to later setup VBO's for the shader program.
+    // Each attribute is packed into the narrowest type that holds it:
+    // positions as 16 bit fractions of the bounds, normals octahedral
+    // encoded in two 16 bit values, skin weights in 16 bits.
+    // Colors are kept per face in faceAttributes instead.
+    memstats::Vector<GLushort, memstats::Tag::GPU_STAGING> pos_VBO(n * 4, 0);
+    memstats::Vector<GLshort, memstats::Tag::GPU_STAGING> nor_VBO(n * 2);
+
+    memstats::Vector<GLushort, memstats::Tag::GPU_STAGING> jointWts_VBO;
+    memstats::Vector<GLushort, memstats::Tag::GPU_STAGING> jointIDs_VBO;
+    if (skinned) {
+        jointWts_VBO.resize(n * 2);
+        jointIDs_VBO.resize(n * 2);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const HalfEdge* curr_he = vertexSources[i];
+        // Add vertex position to VBO.
+        glm::vec3 unit = (position(i) - lo) * toUnit;
+        for (int c = 0; c < 3; c++) {
+            pos_VBO[i * 4 + c] = unorm16(unit[c]);
+        }
+        // Add vertex normal to VBO. Only the provoking vertex's is shown,
+        // unless limit normals are interpolated across the face.
+        glm::vec3 normal = limitShading ? limitNormals[i] : glm::vec3(0.f);
+        if (normal == glm::vec3(0.f)) {
+            normal = glm::normalize(glm::cross(curr_he->vertex->pos        - curr_he->sym->vertex->pos,
+                                               curr_he->next->vertex->pos  - curr_he->next->sym->vertex->pos));
+        }
+        glm::vec2 oct = encodeOctahedral(normal);
+        nor_VBO[i * 2] = snorm16(oct.x);
+        nor_VBO[i * 2 + 1] = snorm16(oct.y);
+
+        if (skinned) {
+            // Add vertex joint weights to VBO
+            jointWts_VBO[i * 2] = unorm16(curr_he->vertex->infl_weights[0]);
+            jointWts_VBO[i * 2 + 1] = unorm16(curr_he->vertex->infl_weights[1]);
+            // Add vertex jointID's to VBO
+            jointIDs_VBO[i * 2] = GLushort(curr_he->vertex->infl_ids[0]);
+            jointIDs_VBO[i * 2 + 1] = GLushort(curr_he->vertex->infl_ids[1]);
+        }
+    }
+    count = indices.size();
 
     // Setup VBO's.
     // Create a VBO on our GPU and store its handle in bufIdx
+    TRACE_SCOPE("Mesh::create: upload");
     generateIdx();
     // Tell OpenGL that we want to perform subsequent operations on the VBO referred to by bufIdx
     // and that it will be treated as an element array buffer (since it will contain triangle indices)
     mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
-    // Pass the data stored in idx into the bound buffer, reading a number of bytes equal to
-    // idx.size() multiplied by the size of a GLuint. This data is sent to the GPU to be read by shader programs.
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_STATIC_DRAW);
+    // Pass the data stored in indices into the bound buffer, reading a number of bytes equal to
+    // indices.size() multiplied by the size of a GLuint. This data is sent to the GPU to be read by shader programs.
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
 
     // The next few sets of function calls are basically the same as above, except bufPos and bufNor are
     // array buffers rather than element array buffers, as they store vertex attributes like position.
     generatePos();
     mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, pos_VBO.size() * sizeof(glm::vec4), pos_VBO.data(), GL_STATIC_DRAW);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, pos_VBO.size() * sizeof(GLushort), pos_VBO.data(), GL_STATIC_DRAW);
 
     generateNor();
     mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufNor);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, nor_VBO.size() * sizeof(glm::vec4), nor_VBO.data(), GL_STATIC_DRAW);
-
-    generateCol();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufCol);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, col_VBO.size() * sizeof(glm::vec4), col_VBO.data(), GL_STATIC_DRAW);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, nor_VBO.size() * sizeof(GLshort), nor_VBO.data(), GL_STATIC_DRAW);
 
+    // Leave stale weights of an earlier skin unbound.
+    wtsBound = IDsBound = false;
     if (skinned) {
         generateWts();
         mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufWts);
-        mp_context->glBufferData(GL_ARRAY_BUFFER, jointWts_VBO.size() * sizeof(glm::vec2), jointWts_VBO.data(), GL_STATIC_DRAW);
+        mp_context->glBufferData(GL_ARRAY_BUFFER, jointWts_VBO.size() * sizeof(GLushort), jointWts_VBO.data(), GL_STATIC_DRAW);
 
         generateIDs();
         mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufIDs);
-        mp_context->glBufferData(GL_ARRAY_BUFFER, jointIDs_VBO.size() * sizeof(glm::ivec2), jointIDs_VBO.data(), GL_STATIC_DRAW);
+        mp_context->glBufferData(GL_ARRAY_BUFFER, jointIDs_VBO.size() * sizeof(GLushort), jointIDs_VBO.data(), GL_STATIC_DRAW);
     }
+
+    // Face colors and flags, one texel per face in the order of faces.
+    faceAttributes.resize(faces.size());
+    for (size_t i = 0; i < faces.size(); i++) {
+        faceAttributes.setColor(i, faces[i]->color);
+        faceAttributes.setFlags(i, faces[i].get() == selectedFace ? FaceAttributes::SELECTED : 0);
+    }
+    faceAttributes.upload();
+
+    gpuBytes = indices.size() * sizeof(GLuint)
+               + pos_VBO.size() * sizeof(GLushort) + nor_VBO.size() * sizeof(GLshort)
+               + (jointWts_VBO.size() + jointIDs_VBO.size()) * sizeof(GLushort)
+               + faceAttributes.memoryBytes();
 }
@@ -1,24 +1,100 @@
 #ifndef MESH_H
 #define MESH_H
 
-#include "components/halfedge.h"
+#include "halfedgemesh.h"
 #include "drawable.h"
+#include "faceattributes.h"
+#include "spatial/bvh.h"
 #include "smartpointerhelp.h"
 #include <vector>
 
-class Mesh :  public Drawable
+class Mesh : public HalfEdgeMesh, public Drawable
 {
 private:
-    std::vector<uPtr<Face>> faces;
-    std::vector<uPtr<HalfEdge>> half_edges;
-    std::vector<uPtr<Vertex>> vertices;
-
     bool skinned;
 
+    // The GPU vertex layout, rebuilt only when the topology changes.
+    // Every mesh vertex becomes one GPU vertex shared by all its faces.
+    // Each face adds one more, a copy of its first corner, which closes
+    // every triangle of its fan as the provoking vertex and carries the
+    // face's normal to the flat shader input.
+    // vertexSources holds the corner each GPU vertex reads from.
+    std::vector<HalfEdge*> vertexSources;
+    std::vector<uint32_t> indices;
+    bool topologyDirty;
+    size_t builtSizes[3];       // Component counts the layout was built for.
+    bool optimizeIndices;       // Run the vertex cache and fetch passes.
+    // Draw every vertex at its Catmull-Clark limit point, with the limit
+    // normal interpolated across faces, so a mesh subdivided once or
+    // twice shades like a far denser one. limitPositions holds where
+    // each GPU vertex went, for queries, and is empty otherwise.
+    bool limitShading;
+    std::vector<glm::vec3> limitPositions;
+    float acmrBefore, acmrAfter;
+    size_t gpuBytes;            // Index and vertex buffers as last uploaded.
+
+    // Face colors and flags, read by the shader through the face
+    // of each triangle. Face i of faces is texel i, the index
+    // flatten() gives in its triangleFaces as well.
+    FaceAttributes faceAttributes;
+    const Face* selectedFace;
+
+    // Lines for the ID pass, one per half-edge, built on first use after
+    // each layout change. Line i of bufEdgeIdx draws pickEdges[i].
+    std::vector<HalfEdge*> pickEdges;
+    GLuint bufEdgeIdx;
+    bool pickEdgesBuilt;
+
+    // Triangles of the last layout for queries on the CPU, at rest
+    // positions. Built by the first query after the layout changes,
+    // and only refit by the first query after the vertices move.
+    BVH bvh;
+    enum class BVHState { READY, REFIT, BUILD } bvhState;
+
+    void buildIndices();
+    // The texel of f, or faceAttributes.size() if f has none.
+    size_t faceSlot(const Face* f) const;
+    // Brings bvh up to date. False if the layout is out of date too.
+    bool updateBVH();
+
     friend class MyGL;
 
 public:
     Mesh(OpenGLContext* context);
+    ~Mesh();
+
+    // Takes over the components of m, dropping the current ones.
+    // The new components carry no skin weights.
+    void replace(HalfEdgeMesh &&m);
+    // Call after edits that add, remove or relink components so
+    // the next create() lays the GPU vertices out again.
+    void markTopologyChanged();
+
+    void setOptimizeIndices(bool optimize);
+    // Takes effect at the next create().
+    void setLimitShading(bool on);
+    bool getLimitShading() const;
+    // Average cache miss ratio of the index buffer in face order and
+    // after optimization, as of the last layout built.
+    float getAcmrBefore() const;
+    float getAcmrAfter() const;
+    size_t gpuVertexCount() const;
+    size_t gpuMemoryBytes() const;
+
+    // Sends the color of f alone to the GPU.
+    void updateFaceColor(const Face* f);
+    // Flags f as selected, or nothing for nullptr, so the shader highlights it.
+    void setSelectedFace(const Face* f);
+    void bindFaceAttributes(GLuint faceUnit, GLuint triangleUnit);
+    // Uploads the lines of the ID pass unless they are up to date.
+    void createPickEdges();
+
+    // The face ray hits first, or nullptr, along with the hit point.
+    Face* raycast(const Ray &ray, glm::vec3* point = nullptr);
+    // The face nearest p, or nullptr if the mesh is empty, along
+    // with the point on it nearest p.
+    Face* closestPoint(const glm::vec3 &p, glm::vec3* point = nullptr);
+    size_t bvhMemoryBytes() const;
 
     void create() override;
 };
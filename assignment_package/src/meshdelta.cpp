@@ -0,0 +1,178 @@
+#include "meshdelta.h"
+#include <unordered_map>
+
+MeshDelta::MeshDelta(const HalfEdgeMesh &mesh)
+    : firstVertex(mesh.vertices.size()), firstHalfEdge(mesh.half_edges.size()), firstFace(mesh.faces.size()),
+      vertexCount(0), halfEdgeCount(0), faceCount(0),
+      vertexIdLimit(Vertex::next_id), halfEdgeIdLimit(HalfEdge::next_id), faceIdLimit(Face::next_id),
+      oldVerts(), newVerts(), oldEdges(), newEdges(), oldFaces(), newFaces(),
+      vertStash(), edgeStash(), faceStash(), touched()
+{}
+
+void MeshDelta::touch(Vertex* v) {
+    if (v != nullptr && v->id < vertexIdLimit && touched.insert(v).second) {
+        oldVerts.push_back({v, v->pos, v->half_edge});
+    }
+}
+
+void MeshDelta::touch(HalfEdge* he) {
+    if (he != nullptr && he->id < halfEdgeIdLimit && touched.insert(he).second) {
+        oldEdges.push_back({he, he->next, he->sym, he->vertex, he->face});
+    }
+}
+
+void MeshDelta::touch(Face* f) {
+    if (f != nullptr && f->id < faceIdLimit && touched.insert(f).second) {
+        oldFaces.push_back({f, f->color, f->half_edge});
+    }
+}
+
+void MeshDelta::touchLoop(Face* f) {
+    touch(f);
+    HalfEdge* he = f->half_edge;
+    do {
+        touch(he);
+        touch(he->vertex);
+        he = he->next;
+    } while (he != f->half_edge);
+}
+
+void MeshDelta::finish(const HalfEdgeMesh &mesh) {
+    vertexCount = mesh.vertices.size() - firstVertex;
+    halfEdgeCount = mesh.half_edges.size() - firstHalfEdge;
+    faceCount = mesh.faces.size() - firstFace;
+
+    newVerts.reserve(oldVerts.size());
+    for (const VertexRecord &r : oldVerts) {
+        newVerts.push_back({r.v, r.v->pos, r.v->half_edge});
+    }
+    newEdges.reserve(oldEdges.size());
+    for (const HalfEdgeRecord &r : oldEdges) {
+        newEdges.push_back({r.he, r.he->next, r.he->sym, r.he->vertex, r.he->face});
+    }
+    newFaces.reserve(oldFaces.size());
+    for (const FaceRecord &r : oldFaces) {
+        newFaces.push_back({r.f, r.f->color, r.f->half_edge});
+    }
+    touched = std::unordered_set<const void*>();
+}
+
+void MeshDelta::apply(const std::vector<VertexRecord> &verts,
+                      const std::vector<HalfEdgeRecord> &edges,
+                      const std::vector<FaceRecord> &faces) {
+    for (const VertexRecord &r : verts) {
+        r.v->pos = r.pos;
+        r.v->half_edge = r.half_edge;
+    }
+    for (const HalfEdgeRecord &r : edges) {
+        r.he->next = r.next;
+        r.he->sym = r.sym;
+        r.he->vertex = r.vertex;
+        r.he->face = r.face;
+    }
+    for (const FaceRecord &r : faces) {
+        r.f->color = r.color;
+        r.f->half_edge = r.half_edge;
+    }
+}
+
+// Moves the components from first on out of v and into stash.
+template<typename T>
+static void stashTail(std::vector<uPtr<T>> &v, size_t first, std::vector<uPtr<T>> &stash) {
+    stash.assign(std::make_move_iterator(v.begin() + first), std::make_move_iterator(v.end()));
+    v.resize(first);
+}
+
+template<typename T>
+static void unstashTail(std::vector<uPtr<T>> &v, std::vector<uPtr<T>> &stash) {
+    v.insert(v.end(), std::make_move_iterator(stash.begin()), std::make_move_iterator(stash.end()));
+    stash.clear();
+}
+
+void MeshDelta::undo(HalfEdgeMesh &mesh) {
+    apply(oldVerts, oldEdges, oldFaces);
+    stashTail(mesh.vertices, firstVertex, vertStash);
+    stashTail(mesh.half_edges, firstHalfEdge, edgeStash);
+    stashTail(mesh.faces, firstFace, faceStash);
+}
+
+void MeshDelta::redo(HalfEdgeMesh &mesh) {
+    unstashTail(mesh.vertices, vertStash);
+    unstashTail(mesh.half_edges, edgeStash);
+    unstashTail(mesh.faces, faceStash);
+    apply(newVerts, newEdges, newFaces);
+}
+
+// Keeps the oldest and newest value of every record. The records
+// are indexed by component once, so a merge is linear in both sizes.
+template<typename R, typename P>
+static void mergeRecords(std::vector<R> &olds, std::vector<R> &news,
+                         const std::vector<R> &laterOlds, const std::vector<R> &laterNews,
+                         P R::*key) {
+    std::unordered_map<const void*, size_t> index;
+    index.reserve(news.size() + laterNews.size());
+    for (size_t j = 0; j < news.size(); j++) {
+        index.emplace(news[j].*key, j);
+    }
+    for (size_t i = 0; i < laterNews.size(); i++) {
+        auto found = index.emplace(laterNews[i].*key, news.size());
+        if (!found.second) {
+            news[found.first->second] = laterNews[i];
+        } else {
+            olds.push_back(laterOlds[i]);
+            news.push_back(laterNews[i]);
+        }
+    }
+}
+
+bool MeshDelta::merge(const MeshDelta &later) {
+    if (createsComponents() || later.createsComponents()) {
+        return false;
+    }
+    mergeRecords(oldVerts, newVerts, later.oldVerts, later.newVerts, &VertexRecord::v);
+    mergeRecords(oldEdges, newEdges, later.oldEdges, later.newEdges, &HalfEdgeRecord::he);
+    mergeRecords(oldFaces, newFaces, later.oldFaces, later.newFaces, &FaceRecord::f);
+    return true;
+}
+
+bool MeshDelta::createsComponents() const {
+    return vertexCount + halfEdgeCount + faceCount > 0;
+}
+
+bool MeshDelta::changesShape() const {
+    return createsComponents() || !newVerts.empty() || !newEdges.empty();
+}
+
+size_t MeshDelta::firstCreatedVertex() const {
+    return firstVertex;
+}
+
+size_t MeshDelta::firstCreatedHalfEdge() const {
+    return firstHalfEdge;
+}
+
+size_t MeshDelta::firstCreatedFace() const {
+    return firstFace;
+}
+
+size_t MeshDelta::createdVertices() const {
+    return vertexCount;
+}
+
+size_t MeshDelta::createdHalfEdges() const {
+    return halfEdgeCount;
+}
+
+size_t MeshDelta::createdFaces() const {
+    return faceCount;
+}
+
+size_t MeshDelta::memoryBytes() const {
+    return sizeof(MeshDelta)
+         + (oldVerts.capacity() + newVerts.capacity()) * sizeof(VertexRecord)
+         + (oldEdges.capacity() + newEdges.capacity()) * sizeof(HalfEdgeRecord)
+         + (oldFaces.capacity() + newFaces.capacity()) * sizeof(FaceRecord)
+         + vertStash.size() * (sizeof(uPtr<Vertex>) + sizeof(Vertex))
+         + edgeStash.size() * (sizeof(uPtr<HalfEdge>) + sizeof(HalfEdge))
+         + faceStash.size() * (sizeof(uPtr<Face>) + sizeof(Face));
+}
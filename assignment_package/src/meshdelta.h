@@ -0,0 +1,97 @@
+#ifndef MESHDELTA_H
+#define MESHDELTA_H
+
+#include "halfedgemesh.h"
+#include <unordered_set>
+#include <vector>
+
+// The fields of one component at one point in time.
+struct VertexRecord {
+    Vertex* v;
+    glm::vec3 pos;
+    HalfEdge* half_edge;
+};
+
+struct HalfEdgeRecord {
+    HalfEdge* he;
+    HalfEdge* next;
+    HalfEdge* sym;
+    Vertex* vertex;
+    Face* face;
+};
+
+struct FaceRecord {
+    Face* f;
+    glm::vec3 color;
+    HalfEdge* half_edge;
+};
+
+// What one edit did to a mesh: the components it created, which sit
+// at the end of the component vectors, and the old and new fields of
+// every existing component it changed. Undo and redo take time in
+// proportion to the edit rather than to the mesh.
+//
+// To record an edit, make a delta from the mesh, touch every existing
+// component before the edit changes it, then finish the delta.
+class MeshDelta {
+private:
+    // Component counts before the edit. Created components follow.
+    size_t firstVertex, firstHalfEdge, firstFace;
+    size_t vertexCount, halfEdgeCount, faceCount;
+    // Ids handed out from here on belong to created components,
+    // which need no records since undo keeps them as they are.
+    size_t vertexIdLimit, halfEdgeIdLimit, faceIdLimit;
+
+    std::vector<VertexRecord> oldVerts, newVerts;
+    std::vector<HalfEdgeRecord> oldEdges, newEdges;
+    std::vector<FaceRecord> oldFaces, newFaces;
+
+    // The created components while the edit is undone.
+    std::vector<uPtr<Vertex>> vertStash;
+    std::vector<uPtr<HalfEdge>> edgeStash;
+    std::vector<uPtr<Face>> faceStash;
+
+    // Components touched so far, while recording.
+    std::unordered_set<const void*> touched;
+
+public:
+    explicit MeshDelta(const HalfEdgeMesh &mesh);
+
+    void touch(Vertex* v);
+    void touch(HalfEdge* he);
+    void touch(Face* f);
+    // Touches f, its half-edges and their vertices.
+    void touchLoop(Face* f);
+
+    // Records the new fields and the created components.
+    void finish(const HalfEdgeMesh &mesh);
+
+    // Both must be given the mesh as the edit left it or found it.
+    void undo(HalfEdgeMesh &mesh);
+    void redo(HalfEdgeMesh &mesh);
+
+    // Folds a later edit that created nothing into this one,
+    // so a run of small changes undoes in one step.
+    bool merge(const MeshDelta &later);
+
+    bool createsComponents() const;
+    // False if the edit only recolored faces, which leaves jobs
+    // working from the mesh's shape as good as they were.
+    bool changesShape() const;
+    size_t firstCreatedVertex() const;
+    size_t firstCreatedHalfEdge() const;
+    size_t firstCreatedFace() const;
+    size_t createdVertices() const;
+    size_t createdHalfEdges() const;
+    size_t createdFaces() const;
+
+    size_t memoryBytes() const;
+
+private:
+    // Writes the recorded fields back to their components.
+    static void apply(const std::vector<VertexRecord> &verts,
+                      const std::vector<HalfEdgeRecord> &edges,
+                      const std::vector<FaceRecord> &faces);
+};
+
+#endif // MESHDELTA_H
@@ -1,32 +1,63 @@
 #include "mygl.h"
+#include "profiling/memstats.h"
+#include "profiling/trace.h"
 #include <la.h>
 
 #include <iostream>
+#include <limits>
 #include <utility>
 #include <QApplication>
 #include <QFile>
 #include <QKeyEvent>
+#include <QMouseEvent>
 
 MyGL::MyGL(QWidget *parent)
     : OpenGLContext(parent),
       m_geomSquare(this),
       m_progLambert(this), m_progFlat(this),
-      m_progSkelaton(this),
+      m_progSkelaton(this), m_progPick(this),
       m_glCamera(),
       m_mesh(this), mesh_loaded(false),
       m_vertDisplay(this), m_heDisplay(this), m_faceDisplay(this),
       joint(mkU<Joint>(this)), joint_loaded(false),
-      selectedJoint(nullptr),
-      bindMats{}, overallTMats{}
+      selectedJoint(nullptr), jointsByID(),
+      m_jointPalette(this),
+      m_clip(nullptr), m_compressedClip(nullptr), m_bvh(nullptr), m_bvhAutoPlay(false), m_interp(Interpolation::LINEAR), m_player(),
+      m_crowd(), m_crowdSize(0), m_crowdPalette(this),
+      m_meshJob(), m_meshJobName(), m_meshJobFromMesh(false), m_meshJobVersion(0),
+      m_meshJobWeld(nullptr), m_weldOnLoad(false),
+      m_levels(), m_level(0), m_levelsVersion(0), m_levelJob(), m_levelWorking(nullptr),
+      m_lods(), m_lodTriangles(), m_lodCenter(0.f), m_lodRadius(0.f), m_lodVersion(0), m_lodLevel(0),
+      m_autoLod(true), m_lodJob(),
+      m_skinJob(), m_skinJobName(), m_skinJobVersion(0), m_meshVersion(0), m_jobTimer(this),
+      m_history(),
+      m_pickBuffer(this), m_pickRequested(false), m_pickX(0), m_pickY(0), m_pickVersion(0),
+      m_timer(this), m_frameTimer(), m_statsFrame(0)
 {
     setFocusPolicy(Qt::StrongFocus);
+
+    // Tick playback at 60 Hz. The player advances by measured
+    // wall-clock time, so a late tick never slows the animation.
+    m_timer.setTimerType(Qt::PreciseTimer);
+    m_timer.setInterval(16);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(timerUpdate()));
+
+    m_jobTimer.setInterval(50);
+    connect(&m_jobTimer, SIGNAL(timeout()), this, SLOT(pollJobs()));
 }
 
 MyGL::~MyGL()
 {
+    m_meshJob.cancel();
+    m_levelJob.cancel();
+    m_lodJob.cancel();
+    m_skinJob.cancel();
     makeCurrent();
     glDeleteVertexArrays(1, &vao);
     m_geomSquare.destroy();
+    m_jointPalette.destroy();
+    m_crowdPalette.destroy();
+    m_pickBuffer.destroy();
 }
 
 void MyGL::initializeGL()
@@ -62,6 +93,8 @@ void MyGL::initializeGL()
     m_progFlat.create(":/glsl/flat.vert.glsl", ":/glsl/flat.frag.glsl");
     // Create and set up the skelaton deform shader.
     m_progSkelaton.create(":/glsl/skelaton.vert.glsl", ":/glsl/lambert.frag.glsl");
+    // Create and set up the ID pass shader used for picking.
+    m_progPick.create(":/glsl/pick.vert.glsl", ":/glsl/pick.frag.glsl");
 
     // We have to have a VAO bound in OpenGL 3.2 Core. But if we're not
     // using multiple VAOs, we can just bind one once.
@@ -87,6 +120,23 @@ void MyGL::resizeGL(int w, int h)
 //For example, when the function update() is called, paintGL is called implicitly.
 void MyGL::paintGL()
 {
+    // Passes are timed on the CPU; the GPU may finish them later.
+    TRACE_SCOPE("paintGL");
+    if (m_pickBuffer.pending()) {
+        PickResult result;
+        if (m_pickBuffer.poll(result)) {
+            applyPick(result);
+        } else {
+            // Look again next frame rather than wait for the GPU.
+            update();
+        }
+    }
+    if (m_pickRequested) {
+        m_pickRequested = false;
+        renderPickPass();
+        update();
+    }
+
     // Clear the screen so that we only see newly drawn images
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -100,12 +150,26 @@ void MyGL::paintGL()
 
 
     if (mesh_loaded) {
-        if (m_mesh.skinned) {
+        TRACE_SCOPE("paintGL: mesh");
+        Mesh &mesh = displayMesh();
+        mesh.bindFaceAttributes(1, 2);
+        if (mesh.skinned) {
+            m_progSkelaton.setFaceAttributes(1, 2);
+            m_progSkelaton.setJointPalette(0);
+            m_progSkelaton.setJointCount(jointsByID.size());
             m_progSkelaton.setModelMatrix(glm::mat4(1.f));
-            m_progSkelaton.draw(m_mesh);
+            if (m_crowd.size() > 0) {
+                updateCrowd();
+                m_crowdPalette.bind(0);
+                m_progSkelaton.draw(mesh, m_crowd.size());
+            } else {
+                m_jointPalette.bind(0);
+                m_progSkelaton.draw(mesh);
+            }
         } else {
+            m_progLambert.setFaceAttributes(1, 2);
             m_progLambert.setModelMatrix(glm::mat4(1.f));
-            m_progLambert.draw(m_mesh);
+            m_progLambert.draw(mesh);
         }
         glDisable(GL_DEPTH_TEST);
         if (m_vertDisplay.isSelected) {
@@ -138,15 +202,146 @@ void MyGL::paintGL()
 
     // Draw joints
     if (joint_loaded) {
+        TRACE_SCOPE("paintGL: joints");
         glDisable(GL_DEPTH_TEST);
         traverseDraw(joint.get());
+        m_progFlat.setModelMatrix(glm::mat4(1.f));
         glEnable(GL_DEPTH_TEST);
     }
 }
 
+void MyGL::renderPickPass() {
+    TRACE_SCOPE("paintGL: pick pass");
+    int w = int(width() * devicePixelRatio());
+    int h = int(height() * devicePixelRatio());
+    m_pickBuffer.begin(w, h);
+    // Blended edges would mix IDs.
+    glDisable(GL_LINE_SMOOTH);
+    glDisable(GL_POLYGON_SMOOTH);
+
+    m_progPick.setViewProjMatrix(m_glCamera.getViewProj());
+    m_progPick.setModelMatrix(glm::mat4(1.f));
+    if (mesh_loaded) {
+        if (m_mesh.skinned) {
+            m_jointPalette.bind(0);
+            m_progPick.setJointPalette(0);
+        }
+        m_mesh.bindFaceAttributes(1, 2);
+        m_progPick.setFaceAttributes(1, 2);
+
+        // Faces sit slightly behind the edges and vertices drawn on them.
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1.f, 1.f);
+        m_progPick.setPick(uint32_t(PickKind::FACE), 1);
+        m_progPick.draw(m_mesh);
+        glDisable(GL_POLYGON_OFFSET_FILL);
+
+        glDepthFunc(GL_LEQUAL);
+        m_mesh.createPickEdges();
+        m_progPick.setPick(uint32_t(PickKind::HALF_EDGE), 2);
+        m_progPick.drawElements(m_mesh, GL_LINES, m_mesh.bufEdgeIdx, int(m_mesh.pickEdges.size() * 2));
+        glPointSize(PickBuffer::REGION);
+        m_progPick.setPick(uint32_t(PickKind::VERTEX), 3);
+        m_progPick.drawArrays(m_mesh, GL_POINTS, int(m_mesh.gpuVertexCount()));
+        glPointSize(5);
+        glDepthFunc(GL_LESS);
+    }
+    if (joint_loaded) {
+        // Joints are drawn over the mesh, so they are picked over it too.
+        glDisable(GL_DEPTH_TEST);
+        for (Joint* j : jointsByID) {
+            m_progPick.setModelMatrix(j->overallT);
+            m_progPick.setPick(uint32_t(PickKind::JOINT), 0, int(j->id));
+            m_progPick.draw(*j);
+        }
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    glEnable(GL_LINE_SMOOTH);
+    glEnable(GL_POLYGON_SMOOTH);
+    m_pickBuffer.end(m_pickX, m_pickY, defaultFramebufferObject());
+    glViewport(0, 0, w, h);
+    m_pickVersion = m_meshVersion;
+}
+
+void MyGL::applyPick(const PickResult &result) {
+    if (result.kind == PickKind::JOINT) {
+        if (result.index < jointsByID.size()) {
+            slot_setSelectedJoint(jointsByID[result.index]);
+            emit sig_showTreeItem(jointsByID[result.index]);
+        }
+        return;
+    }
+    // Mesh indices are only good for the layout the ID pass drew.
+    if (!mesh_loaded || m_pickVersion != m_meshVersion) {
+        return;
+    }
+    if (result.kind == PickKind::FACE && result.index < m_mesh.faces.size()) {
+        Face* f = m_mesh.faces[result.index].get();
+        slot_setSelectedFace(f);
+        emit sig_showListItem(f);
+    } else if (result.kind == PickKind::HALF_EDGE && result.index < m_mesh.pickEdges.size()) {
+        HalfEdge* he = m_mesh.pickEdges[result.index];
+        slot_setSelectedHalfEdge(he);
+        emit sig_showListItem(he);
+    } else if (result.kind == PickKind::VERTEX && result.index < m_mesh.vertexSources.size()) {
+        Vertex* v = m_mesh.vertexSources[result.index]->vertex;
+        slot_setSelectedVertex(v);
+        emit sig_showListItem(v);
+    }
+}
+
+void MyGL::mousePressEvent(QMouseEvent *e) {
+    if (e->button() != Qt::LeftButton) {
+        return;
+    }
+    if (e->modifiers() & Qt::ShiftModifier) {
+        raycastFace(e->pos().x(), e->pos().y());
+        return;
+    }
+    // Mouse positions are in widget pixels from the top left.
+    qreal ratio = devicePixelRatio();
+    m_pickX = int(e->pos().x() * ratio);
+    m_pickY = int((height() - 1 - e->pos().y()) * ratio);
+    m_pickRequested = true;
+    update();
+}
+
+void MyGL::raycastFace(int x, int y) {
+    if (!mesh_loaded) {
+        return;
+    }
+    // Rays go through pixel centers, in widget pixels from the top left.
+    float ndcX = 2.f * (x + 0.5f) / width() - 1.f;
+    float ndcY = 1.f - 2.f * (y + 0.5f) / height();
+    Ray ray = m_glCamera.Raycast(ndcX, ndcY);
+
+    QElapsedTimer timer;
+    timer.start();
+    glm::vec3 point;
+    Face* f = m_mesh.raycast(ray, &point);
+    qint64 ns = timer.nsecsElapsed();
+
+    if (f == nullptr) {
+        emit sig_sendStats(QString("Ray cast: no hit in %1 us").arg(ns / 1000.0, 0, 'f', 1));
+        return;
+    }
+    slot_setSelectedFace(f);
+    emit sig_showListItem(f);
+    emit sig_sendStats(QString("Ray cast: hit at (%1, %2, %3), distance %4\n"
+                               "%5 us (first cast after an edit includes the BVH update)\n"
+                               "BVH: %6 MB")
+                       .arg(point.x, 0, 'f', 3).arg(point.y, 0, 'f', 3).arg(point.z, 0, 'f', 3)
+                       .arg(glm::length(point - ray.origin), 0, 'f', 3)
+                       .arg(ns / 1000.0, 0, 'f', 1)
+                       .arg(m_mesh.bvhMemoryBytes() / double(1 << 20), 0, 'f', 2));
+}
+
 // This functions sends signals to the UIWindow
 // to populate List Wigets with mesh components.
 void MyGL::populateWidgets() {
+    TRACE_SCOPE("MyGL::populateWidgets");
+    MEMORY_SCOPE(LIST_ITEMS);
     // Send vertices, faces, and edge pointers to QListWidget
     for (auto const &v : m_mesh.vertices) {
         emit sig_sendVertex(v.get());
@@ -159,528 +354,622 @@ void MyGL::populateWidgets() {
     }
 }
 
-// In order to ensure key pairs match regardless of order,
-// we ensure the vertex pointer with the smaller address is
-// always first.
-ENDPT MyGL::generateKey(Vertex* v1, Vertex* v2) {
-    if (v1 < v2) {
-        return ENDPT(v1, v2);
+void MyGL::sendNewComponents(size_t vertCount, size_t edgeCount, size_t faceCount) {
+    MEMORY_SCOPE(LIST_ITEMS);
+    for (size_t i = vertCount; i < m_mesh.vertices.size(); i++) {
+        emit sig_sendVertex(m_mesh.vertices[i].get());
+    }
+    for (size_t i = edgeCount; i < m_mesh.half_edges.size(); i++) {
+        emit sig_sendEdge(m_mesh.half_edges[i].get());
+    }
+    for (size_t i = faceCount; i < m_mesh.faces.size(); i++) {
+        emit sig_sendFace(m_mesh.faces[i].get());
     }
-    return ENDPT(v2, v1);
 }
 
 void MyGL::load_OBJ(const QString OBJ_file) {
-    // reset all the component id variables
-    Vertex::next_id = 1;
-    HalfEdge::next_id = 1;
-    Face::next_id = 1;
-
-    m_mesh = Mesh(this);
-    emit sig_clearListWidgets();
-
-    QFile file(OBJ_file);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        return;
-    }
-
-    ENDPT_MAP seen_vps;
-
-    QTextStream in(&file);
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-
-        if        (line.size() < 2) {
-            continue;
-        }
-
-        // Populate mesh vertices.
-        // At this point, the vertices' half edge pointers are not set.
-        if        (line.first(2) == "v ") {
-            QStringList list = line.split(' ');
-            m_mesh.vertices.push_back(mkU<Vertex>(Vertex(glm::vec3(list[1].toFloat(),
-                                                                   list[2].toFloat(),                                                           list[3].toFloat()))));
-        // Populate mesh faces and half edges.
-        } else if (line.first(2) == "f ") {
-            // Create face.
-            m_mesh.faces.push_back(mkU<Face>(Face()));
-            bool first_he = true;
-            HalfEdge* first_he_ptr = nullptr;
-            QStringList list = line.split(' ');
-            for (int i = 1; i < list.size(); ++i) {
-                // Find a half edges's endpoint vertices.
-                int curr_vi = list[i].split('/')[0].toInt() - 1;
-                int next_vi;
-                if (i + 1 == list.size()) {
-                    next_vi = list[1].split('/')[0].toInt() - 1;
-                } else {
-                    next_vi = list[i + 1].split('/')[0].toInt() - 1;
-                }
-                // Create a half edge.
-                // At this point, sym half edges are not set yet.
-                m_mesh.half_edges.push_back(mkU<HalfEdge>(HalfEdge()));
-                HalfEdge* this_he_ptr = m_mesh.half_edges.back().get();
-                // Update face and vertex half edge pointers.
-                this_he_ptr->set_vertex(m_mesh.vertices[next_vi].get());
-                this_he_ptr->set_face(m_mesh.faces.back().get());
-
-                // Add the half edges vertex pair to the map
-                // if they haven't been encountered.
-                // If a vertex pair has been encountered, set sym half edges.
-                // In this implementation, Vertex ptr with the lower address is first in the pair.
-                ENDPT key = generateKey(m_mesh.vertices[curr_vi].get(), m_mesh.vertices[next_vi].get());
-                auto seen = seen_vps.find(key);
-                if (seen != seen_vps.end()) {
-                    this_he_ptr->set_sym(seen_vps.at(key));
-                } else {
-                    seen_vps[key] = this_he_ptr;
-                }
-
-                // The first half edge of each face is a special case.
-                if (first_he) {
-                    // We need to save the first half edge to set as the last half edge's next.
-                    first_he_ptr = this_he_ptr;
-                    // There doesn't exist a previous half edge
-                    // so we can skip the rest of this loop.
-                    first_he = false;
-                    continue;
-                }
-
-                // Set the previous edge's next half edge pointer to this half edge.
-                m_mesh.half_edges[m_mesh.half_edges.size() - 2]->set_next(this_he_ptr);
-
-                // Last half edge has it's next pointer pointing to first half edge.
-                if (i + 1 == list.size()) {
-                    this_he_ptr->set_next(first_he_ptr);
-                }
-            }
+    float tolerance = m_weldOnLoad ? WELD_TOLERANCE : -1.f;
+    sPtr<WeldStats> weld = m_weldOnLoad ? mkS<WeldStats>() : nullptr;
+    startMeshJob("Loading OBJ", [OBJ_file, tolerance, weld](JobControl &control) -> uPtr<HalfEdgeMesh> {
+        uPtr<HalfEdgeMesh> m = mkU<HalfEdgeMesh>();
+        if (!m->loadOBJ(OBJ_file, &control, tolerance, weld.get())) {
+            return nullptr;
         }
-    }
-    mesh_loaded = true;
-    m_mesh.create();
-    populateWidgets();
+        return m;
+    }, false);
+    m_meshJobWeld = weld;
 }
 
-void MyGL::load_JSON(const QString JSON_file) {
-   Joint::next_id = 0;
-   if (mesh_loaded) {
-       m_mesh.skinned = false;
-   }
-   emit sig_clearTreeWidget();
-
-   QFile loadFile(JSON_file);
-   if (!loadFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-       return;
-   }
+uPtr<HalfEdgeMesh> MyGL::replaceMesh(HalfEdgeMesh &&m) {
+    TRACE_SCOPE("MyGL::replaceMesh");
+    emit sig_releaseListWidgets();
+    uPtr<HalfEdgeMesh> old = mkU<HalfEdgeMesh>(std::move(static_cast<HalfEdgeMesh&>(m_mesh)));
+    m_mesh.replace(std::move(m));
+    populateWidgets();
 
-   QByteArray jointData = loadFile.readAll();
-   QJsonDocument loadDoc(QJsonDocument::fromJson(jointData));
+    m_mesh.create();
+    mesh_loaded = true;
+    m_meshVersion++;
+    dropLevels();
+    dropLods();
+    rebuildCrowd();
+    update();
+    return old;
+}
 
-   read(loadDoc.object());
+void MyGL::dropLevels() {
+    m_levelJob.cancel();
+    m_levelWorking = nullptr;
+    m_levels.clear();
+    m_level = 0;
+    emit sig_sendLevels(0, 0);
+}
 
-   // Traverse the joint tree and create every joint
-   traverseCalcBind(joint.get());
-   traverseCreate(joint.get());
+const std::vector<float>& MyGL::lodRatios() {
+    static const std::vector<float> ratios = { 0.5f, 0.25f, 0.1f, 0.01f };
+    return ratios;
+}
 
-   joint_loaded = true;
-   emit sig_sendJoint(joint.get());
+void MyGL::dropLods() {
+    m_lodJob.cancel();
+    m_lods.clear();
+    m_lodTriangles.clear();
+    m_lodLevel = 0;
 }
 
-void MyGL::read(const QJsonObject &json)
-{
-    if (json.contains("root") && json["root"].isObject()) {
-        joint->read(json["root"].toObject(), nullptr);
+Mesh& MyGL::displayMesh() {
+    if (!m_autoLod || m_lods.empty() || m_lodVersion != m_meshVersion) {
+        m_lodLevel = 0;
+        return m_mesh;
+    }
+    float pixels = projectedPixels(m_lodRadius, glm::distance(m_glCamera.eye, m_lodCenter),
+                                   m_glCamera.fovy, unsigned(height() * devicePixelRatio()));
+    int level = selectLod(m_lodTriangles, pixels, m_lodLevel);
+    if (level != m_lodLevel) {
+        m_lodLevel = level;
+        emit sig_sendStats(QString("LOD %1 of %2: %3 triangles")
+                           .arg(level).arg(m_lods.size()).arg(m_lodTriangles[level]));
     }
+    return level == 0 ? m_mesh : *m_lods[level - 1];
 }
 
-void MyGL::traverseCalcBind(Joint* j) {
-    for (auto &child : j->children) {
-        traverseCalcBind(child.get());
-    }
-    j->bind = glm::inverse(j->getOverallTransformation());
+void MyGL::startLevelJob() {
+    sPtr<HalfEdgeMesh> working = m_levelWorking;
+    bool last = m_levels.size() == PREVIEW_LEVELS;
+    m_levelJob = Job<uPtr<HalfEdgeMesh>>::run([working, last](JobControl &control) -> uPtr<HalfEdgeMesh> {
+        if (!working->refine(&control)) {
+            return nullptr;
+        }
+        // The working copy goes on to the next level.
+        return last ? mkU<HalfEdgeMesh>(std::move(*working)) : working->clone();
+    });
+    m_jobTimer.start();
+    emit sig_sendProgress(0);
 }
 
-void MyGL::traverseCreate(Joint* j) {
-    for (auto &child : j->children) {
-        traverseCreate(child.get());
+void MyGL::showLevel(int i) {
+    if (i == m_level || i < 0 || i >= int(m_levels.size())) {
+        return;
     }
+    // Both levels stay alive, so the list items only change hands.
+    emit sig_releaseListWidgets();
+    m_levels[m_level] = mkU<HalfEdgeMesh>(std::move(static_cast<HalfEdgeMesh&>(m_mesh)));
+    m_mesh.replace(std::move(*m_levels[i]));
+    m_levels[i] = nullptr;
+    m_level = i;
+    populateWidgets();
+    // The recorded edits belong to the level just stashed.
+    m_history.clear();
 
-    j->create();
+    m_mesh.create();
+    m_meshVersion++;
+    m_levelsVersion = m_meshVersion;
+    dropLods();
+    rebuildCrowd();
+    update();
+    emit sig_sendLevels(m_level, m_levels.size() - 1);
 }
 
-void MyGL::traverseDraw(Joint* j) {
-    for (auto &child : j->children) {
-        traverseDraw(child.get());
-    }
+void MyGL::startMeshJob(const QString &name,
+                        std::function<uPtr<HalfEdgeMesh>(JobControl&)> work,
+                        bool fromMesh) {
+    m_meshJob.cancel();
+    m_meshJob = Job<uPtr<HalfEdgeMesh>>::run(work);
+    m_meshJobName = name;
+    m_meshJobFromMesh = fromMesh;
+    m_meshJobVersion = m_meshVersion;
+    m_meshJobWeld = nullptr;
+    m_jobTimer.start();
+    emit sig_sendProgress(0);
+}
 
-    m_progFlat.draw(*j);
+void MyGL::startSkinJob(const QString &name, std::function<SkinResult(JobControl&)> work) {
+    m_skinJob.cancel();
+    m_skinJob = Job<SkinResult>::run(work);
+    m_skinJobName = name;
+    m_skinJobVersion = m_meshVersion;
+    m_jobTimer.start();
+    emit sig_sendProgress(0);
 }
 
-void MyGL::traverseSkin(Vertex* curr, Joint** closest, Joint** nextClosest,
-                        float* minDist, float* nextMinDist, Joint* j) const {
-    float distToJoint = glm::length(glm::vec4(curr->pos, 1) - j->getOverallTransformation() * glm::vec4(0, 0, 0, 1));
-    if (distToJoint < *minDist || (distToJoint < *minDist && *nextClosest == nullptr)) {
-        *nextMinDist = *minDist;
-        *nextClosest = *closest;
+// The stats line for a job that produced nothing, with the
+// message of what it threw if it did.
+static QString failed(const QString &job, const std::string &error) {
+    if (error.empty()) {
+        return QString("%1 failed").arg(job);
+    }
+    return QString("%1 failed\n%2").arg(job).arg(QString::fromStdString(error));
+}
 
-        *minDist = distToJoint;
-        *closest = j;
-    } else if (distToJoint < *nextMinDist) {
-        *nextMinDist = distToJoint;
-        *nextClosest = j;
+// Hands finished results over to the mesh on the GUI thread.
+// Results computed from a mesh that has since changed are dropped.
+void MyGL::pollJobs() {
+    std::string error;
+    if (m_meshJob.finished()) {
+        std::optional<uPtr<HalfEdgeMesh>> r = m_meshJob.take(&error);
+        if (!r.has_value() || *r == nullptr) {
+            emit sig_sendStats(failed(m_meshJobName, error));
+        } else if (m_meshJobFromMesh && m_meshJobVersion != m_meshVersion) {
+            emit sig_sendStats(QString("%1 discarded\nThe mesh was edited meanwhile").arg(m_meshJobName));
+        } else {
+            // A mesh that replaces the history starts its ids over.
+            if (!m_meshJobFromMesh) {
+                (*r)->renumber();
+            }
+            uPtr<HalfEdgeMesh> old = replaceMesh(std::move(**r));
+            if (m_meshJobFromMesh) {
+                m_history.push(EditCommand(m_meshJobName, std::move(old)));
+            } else {
+                m_history.clear();
+            }
+            memstats::Counters heap = memstats::totals();
+            QString weld;
+            if (m_meshJobWeld != nullptr) {
+                weld = QString("\nWelded %1 vertices into %2, dropped %3 corners and %4 faces")
+                       .arg(m_meshJobWeld->verticesIn).arg(m_meshJobWeld->verticesOut)
+                       .arg(m_meshJobWeld->cornersDropped).arg(m_meshJobWeld->facesDropped);
+            }
+            emit sig_sendStats(QString("%1 done%2\nVertices: %3, faces: %4\n%5\nTracked heap: %6 MB, peak %7 MB")
+                               .arg(m_meshJobName).arg(weld)
+                               .arg(m_mesh.vertices.size()).arg(m_mesh.faces.size())
+                               .arg(indexStats())
+                               .arg(heap.current / double(1 << 20), 0, 'f', 1)
+                               .arg(heap.peak / double(1 << 20), 0, 'f', 1));
+        }
+    }
+    if (m_levelJob.finished()) {
+        std::optional<uPtr<HalfEdgeMesh>> r = m_levelJob.take(&error);
+        if (!r.has_value() || *r == nullptr) {
+            m_levelWorking = nullptr;
+            emit sig_sendStats(failed("Subdivision preview", error));
+        } else if (m_levelsVersion != m_meshVersion) {
+            dropLevels();
+            emit sig_sendStats("Subdivision preview discarded\nThe mesh was edited meanwhile");
+        } else {
+            m_levels.push_back(std::move(*r));
+            showLevel(m_levels.size() - 1);
+            emit sig_sendStats(QString("Subdivision level %1 of %2\nVertices: %3, faces: %4")
+                               .arg(m_level).arg(PREVIEW_LEVELS)
+                               .arg(m_mesh.vertices.size()).arg(m_mesh.faces.size()));
+            if (m_level < PREVIEW_LEVELS) {
+                startLevelJob();
+            } else {
+                m_levelWorking = nullptr;
+            }
+        }
+    }
+    if (m_lodJob.finished()) {
+        std::optional<std::vector<uPtr<HalfEdgeMesh>>> r = m_lodJob.take(&error);
+        if (!r.has_value() || r->empty()) {
+            emit sig_sendStats(failed("LOD chain", error));
+        } else if (m_lodVersion != m_meshVersion) {
+            emit sig_sendStats("LOD chain discarded\nThe mesh was edited meanwhile");
+        } else {
+            QString stats = QString("LOD chain built\nLevel 0: %1 triangles").arg(m_lodTriangles[0]);
+            for (uPtr<HalfEdgeMesh> &level : *r) {
+                uPtr<Mesh> lod = mkU<Mesh>(this);
+                lod->replace(std::move(*level));
+                lod->skinned = m_mesh.skinned;
+                lod->setLimitShading(m_mesh.getLimitShading());
+                lod->create();
+                m_lodTriangles.push_back(lod->faceCount());
+                stats += QString("\nLevel %1: %2 triangles").arg(m_lods.size() + 1).arg(lod->faceCount());
+                m_lods.push_back(std::move(lod));
+            }
+            update();
+            emit sig_sendStats(stats);
+        }
+    }
+    if (m_skinJob.finished()) {
+        std::optional<SkinResult> r = m_skinJob.take(&error);
+        if (!r.has_value()) {
+            emit sig_sendStats(failed(m_skinJobName, error));
+        } else if (m_skinJobVersion != m_meshVersion) {
+            emit sig_sendStats(QString("%1 discarded\nThe mesh was edited meanwhile").arg(m_skinJobName));
+        } else {
+            applySkin(r->influences);
+            emit sig_sendStats(r->report.isEmpty() ? QString("%1 done").arg(m_skinJobName) : r->report);
+        }
     }
 
-    for (auto &child : j->children) {
-        traverseSkin(curr, closest, nextClosest, minDist, nextMinDist, child.get());
+    if (m_meshJob.active()) {
+        emit sig_sendProgress(int(100 * m_meshJob.progress()));
+    } else if (m_levelJob.active()) {
+        emit sig_sendProgress(int(100 * m_levelJob.progress()));
+    } else if (m_lodJob.active()) {
+        emit sig_sendProgress(int(100 * m_lodJob.progress()));
+    } else if (m_skinJob.active()) {
+        emit sig_sendProgress(int(100 * m_skinJob.progress()));
+    } else {
+        m_jobTimer.stop();
+        emit sig_sendProgress(-1);
     }
 }
 
-void MyGL::skinMesh() {
-    for (auto const &v : m_mesh.vertices) {
-        Joint* closest = nullptr;
-        Joint* nextClosest = nullptr;
-
-        float minDist = INFINITY;
-        float nextMinDist = INFINITY;
-
-        // Traverse the mesh and keep track of the joint ptrs
-        // and distaces.
-        traverseSkin(v.get(), &closest, &nextClosest, &minDist, &nextMinDist, joint.get());
+void MyGL::slot_cancelJobs() {
+    if (!m_meshJob.active() && !m_levelJob.active() && !m_lodJob.active() && !m_skinJob.active()) {
+        return;
+    }
+    // Finished subdivision levels are kept.
+    m_levelJob.cancel();
+    m_levelWorking = nullptr;
+    m_meshJob.cancel();
+    m_lodJob.cancel();
+    m_skinJob.cancel();
+    m_jobTimer.stop();
+    emit sig_sendProgress(-1);
+    emit sig_sendStats("Cancelled");
+}
 
-        v->infl_joints[0] = closest;
-        v->infl_joints[1] = nextClosest;
+void MyGL::load_JSON(const QString JSON_file) {
+    clearSkeleton();
 
-        float sum = minDist + nextMinDist;
-        v->infl_weights[0] = 1 - minDist / sum;
-        v->infl_weights[1] = 1 - nextMinDist / sum;
+    SkeletonDesc desc;
+    std::string error;
+    if (!skeletonio::loadJSON(JSON_file.toStdString(), desc, &error)) {
+        emit sig_sendStats(QString("Cannot load skeleton\n%1").arg(QString::fromStdString(error)));
+        return;
     }
-
-    m_mesh.skinned = true;
-    updateUnifMats();
-    m_mesh.create();
+    buildSkeleton(desc);
 }
 
-// Recalculate uniform matrics and send to shader.
-void MyGL::updateUnifMats() {
-    initializeUnifMats(joint.get());
-    m_progSkelaton.setBindMats(bindMats);
-    m_progSkelaton.setOverallTMats(overallTMats);
+void MyGL::load_SKEL(const QString SKEL_file) {
+    clearSkeleton();
+
+    SkeletonDesc desc;
+    std::string error;
+    if (!skeletonio::loadBinary(SKEL_file.toStdString(), desc, &error)) {
+        emit sig_sendStats(QString("Cannot load skeleton\n%1").arg(QString::fromStdString(error)));
+        return;
+    }
+    buildSkeleton(desc);
 }
 
-void MyGL::initializeUnifMats(Joint* j) {
-    for (auto &child : j->children) {
-        initializeUnifMats(child.get());
+void MyGL::save_SKEL(const QString SKEL_file) const {
+    if (joint_loaded) {
+        skeletonio::saveBinary(SKEL_file.toStdString(), skeletonDesc());
     }
+}
 
-    bindMats[j->id] = j->bind;
-    overallTMats[j->id] = j->getOverallTransformation();
-}
-
-// CATMULL stuff is happening here
-// This function splits the passed in edge
-// by adding a vertex in the middle.
-void MyGL::splitEdge(HalfEdge* he) {
-    HalfEdge* he_sym = he->sym;
-
-    // V3 is the average of the endpoints of the selected half-edge
-    glm::vec3 v1_pos = he->vertex->pos;
-    glm::vec3 v2_pos = he_sym->vertex->pos;
-    glm::vec3 v3_pos = (v1_pos + v2_pos);
-    v3_pos /= 2;
-    m_mesh.vertices.push_back(mkU<Vertex>(Vertex(v3_pos)));
-    Vertex* v3 = m_mesh.vertices.back().get();
-
-    // Create two new half edges
-    // with the same face and vertex pointers as the original
-    m_mesh.half_edges.push_back(mkU<HalfEdge>(HalfEdge()));
-    HalfEdge* he_copy = m_mesh.half_edges.back().get();
-    // Update face and vertex half edge pointers.
-    he_copy->set_vertex(he->vertex);
-    he_copy->set_face(he->face);
-    m_mesh.half_edges.push_back(mkU<HalfEdge>(HalfEdge()));
-    HalfEdge* he_sym_copy = m_mesh.half_edges.back().get();
-    // Update face and vertex half edge pointers.
-    he_sym_copy->set_vertex(he_sym->vertex);
-    he_sym_copy->set_face(he_sym->face);
-
-    // Rearrange pointers to correct data structure flow
-    he_copy->set_next(he->next);
-    he_sym_copy->set_next(he_sym->next);
-    he->set_next(he_copy);
-    he_sym->set_next(he_sym_copy);
-
-    he->set_vertex(v3);
-    he_sym->set_vertex(v3);
-
-    he->set_sym(he_sym_copy);
-    he_sym->set_sym(he_copy);
-
-    // Send newly create vertex and half edges to GUI
-    emit sig_sendVertex(v3);
-    emit sig_sendEdge(he_copy);
-    emit sig_sendEdge(he_sym_copy);
-}
-
-// This function recursively calls itself
-// splitting out triangles from the N-gon face
-// until entire face is triangulated.
-void MyGL::triangulateFace() {
-    Face* f = m_faceDisplay.representedFace;
+void MyGL::load_BVH(const QString BVH_file) {
+    clearSkeleton();
 
-    // If no face selected, do nothing
-    if (f == nullptr) {
+    m_bvh = mkU<BvhImporter>();
+    if (!m_bvh->open(BVH_file.toStdString())) {
+        emit sig_sendStats(QString("Cannot load BVH\n%1").arg(QString::fromStdString(m_bvh->error())));
+        m_bvh = nullptr;
         return;
     }
 
-    HalfEdge* he = f->half_edge;
-    // Recursively triangulate
-    if (he->next->next->next == he) {
-        return;
-    } else {
-        // Create two new half edges
-        m_mesh.half_edges.push_back(mkU<HalfEdge>(HalfEdge()));
-        HalfEdge* he_newface = m_mesh.half_edges.back().get();
-        he_newface->set_vertex(he->vertex);
-        m_mesh.half_edges.push_back(mkU<HalfEdge>(HalfEdge()));
-        HalfEdge* he_oldface = m_mesh.half_edges.back().get();
-        // Update face and vertex half edge pointers.
-        he_oldface->set_vertex(he->next->next->vertex);
-        he_newface->set_sym(he_oldface);
-
-        // Create a new face
-        m_mesh.faces.push_back(mkU<Face>(Face()));
-        Face* new_f = m_mesh.faces.back().get();
-        he->next->set_face(new_f);
-        he->next->next->set_face(new_f);
-        he_newface->set_face(new_f);
-
-        he_oldface->set_face(f);
-
-        // Set next pointers
-        he_oldface->set_next(he->next->next->next);
-        he->next->next->set_next(he_newface);
-        he_newface->set_next(he->next);
-        he->set_next(he_oldface);
-
-        // Send newly created face half edges.
-        emit sig_sendEdge(he_newface);
-        emit sig_sendEdge(he_oldface);
-        emit sig_sendFace(new_f);
-
-        // Reset the half edge to which this face points.
-        he->set_face(f);
-        triangulateFace();
-    }
-}
-
-// This function adds centroids to the mesh
-// and populates a map such that
-// key = face*, value = centroid*.
-CENTROID_MAP MyGL::createCentroids() {
-    std::unordered_map<Face*, Vertex*, PTRHASH> centroids;
-
-    for (auto &f : m_mesh.faces) {
-        // Calculate the centroid position
-        // by averaging all vertices of the face.
-        int counter = 0;
-        glm::vec3 avg_pos(0);
-        HalfEdge* curr = f->half_edge;
-        do {
-            avg_pos += curr->vertex->pos;
-            counter++;
-            curr = curr->next;
-        } while (curr != f->half_edge);
-        avg_pos /= counter;
-
-        // Create centroid.
-        // Add the face and centroid to map.
-        m_mesh.vertices.push_back(mkU<Vertex>(Vertex(avg_pos)));
-        Vertex* centroid = m_mesh.vertices.back().get();
-        centroids[f.get()] = centroid;
-
-        // Send centroid to List Widget
-        emit sig_sendVertex(centroid);
+    // BVH joints are listed parents first, like a SkeletonDesc.
+    SkeletonDesc desc;
+    desc.reserve(m_bvh->joints().size());
+    for (const BvhJoint &bj : m_bvh->joints()) {
+        size_t i = desc.add(bj.parent);
+        desc.names[i] = bj.name;
+        desc.pos[i] = bj.offset;
     }
+    buildSkeleton(desc);
 
-    return centroids;
+    m_bvh->clip()->setInterpolation(m_interp);
+    m_bvh->start();
+    m_bvhAutoPlay = true;
+    m_frameTimer.start();
+    m_timer.start();
 }
 
-// This function adds smoothed midpoints to the mesh.
-// It also splits edges with the smooth midpoint.
-// It returns a set of all the original vertices of the mesh.
-VPTR_SET MyGL::createSmoothMidpts(CENTROID_MAP &cm) {
-    VPTR_SET og_verts;
-
-    for (size_t i = 0; i < m_mesh.vertices.size() - cm.size(); i++) {
-        og_verts.insert(m_mesh.vertices[i].get());
+void MyGL::clearSkeleton() {
+    Joint::next_id = 0;
+    // Weights computed for the old skeleton no longer apply.
+    m_skinJob.cancel();
+    if (mesh_loaded) {
+        m_mesh.skinned = false;
+        dropLods();
     }
+    m_timer.stop();
+    m_player.stop();
+    m_player.setClip(nullptr, PoseSoA());
+    m_clip = nullptr;
+    m_compressedClip = nullptr;
+    m_bvh = nullptr;
+    m_bvhAutoPlay = false;
+    joint_loaded = false;
+    jointsByID.clear();
+    m_crowd.clear();
+    emit sig_clearTreeWidget();
+}
 
-    // We only want to iterate through the original edges.
-    // Additionally if a half edge is included,
-    // it's sym does not need to be.
-    std::unordered_set<HalfEdge*, PTRHASH> syms;
-    std::vector<HalfEdge*> edges_to_split;
-    for (auto const &e : m_mesh.half_edges) {
-        if (syms.find(e.get()) == syms.end()) {
-            edges_to_split.push_back(e.get());
-            syms.insert(e->sym);
+// Since every parent precedes its children in desc, the joints
+// can be created, posed and bound by walking desc front to back.
+// Each joint takes its index in desc as its id, which the palette,
+// picking and skin weights all index by.
+void MyGL::buildSkeleton(const SkeletonDesc &desc) {
+    size_t n = desc.size();
+    if (n == 0) {
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        int p = desc.parents[i];
+        if (i == 0 ? p != -1 : (p < 0 || size_t(p) >= i)) {
+            emit sig_sendStats(QString("Cannot load skeleton\nJoint %1 is not listed after its parent").arg(i));
+            return;
         }
     }
+    std::vector<size_t> childCounts(n, 0);
+    for (size_t i = 1; i < n; i++) {
+        childCounts[desc.parents[i]]++;
+    }
 
-    for (auto const &e : edges_to_split) {
-        // Split the edge
-        splitEdge(e);
-
-        // Calculate the smoothed midpoint position
-        glm::vec3 midpt_pos(0);
-
-        // There are two cases.
-        // 1) Edge has two incident faces
-        if (e->sym->face != nullptr) {
-            midpt_pos += e->next->vertex->pos;
-            midpt_pos += e->sym->vertex->pos;
-            midpt_pos += cm.at(e->face)->pos;
-            midpt_pos += cm.at(e->sym->face)->pos;
-            midpt_pos /= 4;
-        }
-        // 2) Edge has one incident face
-        else {
-            midpt_pos += e->next->vertex->pos;
-            midpt_pos += e->sym->vertex->pos;
-            midpt_pos += cm.at(e->face)->pos;
-            midpt_pos /= 3;
+    // The root was created by sig_clearTreeWidget.
+    jointsByID.assign(n, nullptr);
+    jointsByID[0] = joint.get();
+    for (size_t i = 0; i < n; i++) {
+        Joint* j;
+        if (i == 0) {
+            j = joint.get();
+        } else {
+            Joint* parent = jointsByID[desc.parents[i]];
+            parent->children.push_back(mkU<Joint>(this));
+            j = parent->children.back().get();
+            j->parent = parent;
+            parent->QTreeWidgetItem::addChild(j);
         }
+        jointsByID[i] = j;
+        j->id = i;
+        j->children.reserve(childCounts[i]);
+        j->setName(QString::fromStdString(desc.names[i]));
+        j->pos = desc.pos[i];
+        j->rot = desc.rot[i];
+
+        j->overallT = j->parent == nullptr ? j->getLocalTransformation()
+                                           : j->parent->overallT * j->getLocalTransformation();
+        j->bind = glm::inverse(j->overallT);
+    }
+    for (Joint* j : jointsByID) {
+        j->create();
+    }
 
-        // And modify the newly created vertex
-        // from the split edge.
-        e->vertex->pos = midpt_pos;
+    m_jointPalette.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        m_jointPalette.set(i, jointsByID[i]->overallT * jointsByID[i]->bind);
     }
-    return og_verts;
+
+    joint_loaded = true;
+    rebuildCrowd();
+    emit sig_sendJoint(joint.get());
 }
 
-VPTR_SET MyGL::getAdjMidpts(Vertex* v) const {
-    VPTR_SET adjVerts;
-    HalfEdge* curr = v->half_edge;
-    do {
-        curr = curr->next;
-        adjVerts.insert(curr->vertex);
-        curr = curr->sym;
-    } while (curr != v->half_edge);
-    return adjVerts;
+SkeletonDesc MyGL::skeletonDesc() const {
+    SkeletonDesc desc;
+    desc.reserve(jointsByID.size());
+    for (Joint* j : jointsByID) {
+        size_t i = desc.add(j->parent == nullptr ? -1 : static_cast<int>(j->parent->id));
+        desc.names[i] = j->name.toStdString();
+        desc.pos[i] = j->pos;
+        desc.rot[i] = j->rot;
+    }
+    return desc;
 }
 
-VPTR_SET MyGL::getIncCentroids(Vertex* v, CENTROID_MAP &cm) const {
-    VPTR_SET incCentroids;
-    HalfEdge* curr = v->half_edge;
-    do {
-        curr = curr->next;
-        incCentroids.insert(cm.at(curr->face));
-        curr = curr->sym;
-    } while (curr != v->half_edge);
-    return incCentroids;
+void MyGL::traverseDraw(Joint* j) {
+    for (auto &child : j->children) {
+        traverseDraw(child.get());
+    }
+
+    m_progFlat.setModelMatrix(j->overallT);
+    m_progFlat.draw(*j);
 }
 
-void MyGL::smoothOrigVerts(VPTR_SET& vs, CENTROID_MAP &cm) {
-    for (auto const &vptr : vs) {
-        glm::vec3 og_pos = vptr->pos;
+void MyGL::skinMesh() {
+    TRACE_SCOPE("MyGL::skinMesh");
+    std::vector<glm::vec3> positions;
+    positions.reserve(m_mesh.vertices.size());
+    for (auto const &v : m_mesh.vertices) {
+        positions.push_back(v->pos);
+    }
+    std::vector<glm::vec3> jointPos(jointsByID.size());
+    for (size_t i = 0; i < jointsByID.size(); i++) {
+        jointPos[i] = glm::vec3(jointsByID[i]->overallT[3]);
+    }
+
+    startSkinJob("Skinning", [positions, jointPos](JobControl&) {
+        SkinResult r;
+        r.influences = nearestJointWeights(positions, jointPos);
+        return r;
+    });
+}
 
-        VPTR_SET adj_verts = getAdjMidpts(vptr);
-        glm::vec3 adjv_sum(0);
-        for (auto const &v : adj_verts) {
-            adjv_sum += v->pos;
-        }
+void MyGL::heatSkinMesh() {
+    TRACE_SCOPE("MyGL::heatSkinMesh");
+    // Flatten the mesh, fanning each face into triangles as Mesh::create does.
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> triangles;
+    m_mesh.flatten(positions, triangles);
+
+    // Joints where the mesh was bound.
+    std::vector<glm::vec3> jointPos(jointsByID.size());
+    std::vector<int> parents(jointsByID.size());
+    for (size_t i = 0; i < jointsByID.size(); i++) {
+        jointPos[i] = glm::vec3(glm::inverse(jointsByID[i]->bind)[3]);
+        Joint* p = jointsByID[i]->parent;
+        parents[i] = p == nullptr ? -1 : static_cast<int>(p->id);
+    }
 
-        VPTR_SET inc_centroids = getIncCentroids(vptr, cm);
-        glm::vec3 incc_sum(0);
-        for (auto const &c : inc_centroids) {
-            incc_sum += c->pos;
-        }
+    startSkinJob("Heat skinning", [positions, triangles, jointPos, parents](JobControl &control) {
+        HeatWeights heat(positions, triangles);
+        SkinResult r;
+        r.influences = heat.solve(jointPos, parents, HeatWeights::Settings(), &control);
+
+        const HeatSolveStats &stats = heat.stats();
+        r.report = QString("Heat skinning\n"
+                           "Vertices: %1, joints: %2\n"
+                           "Assemble: %3 ms, solve: %4 ms\n"
+                           "Max CG iterations: %5 (%6 unconverged)")
+                   .arg(positions.size()).arg(jointPos.size())
+                   .arg(stats.assembleMs, 0, 'f', 1).arg(stats.solveMs, 0, 'f', 1)
+                   .arg(stats.maxIterations).arg(stats.unconverged);
+        return r;
+    });
+}
 
-        int n = adj_verts.size();
+void MyGL::applySkin(const SkinInfluences &influences) {
+    TRACE_SCOPE("MyGL::applySkin");
+    m_mesh.setSkin(influences);
+    m_mesh.skinned = true;
+    // The LODs carry the weights they were built with.
+    dropLods();
+    updateUnifMats();
+    m_mesh.create();
+    rebuildCrowd();
+    update();
+}
 
-        og_pos *= (n - 2);
-        og_pos /= n;
-        adjv_sum /= (n * n);
-        incc_sum /= (n * n);
+void MyGL::rebuildCrowd() {
+    if (!joint_loaded || m_crowdSize == 0) {
+        m_crowd.clear();
+        return;
+    }
+    std::vector<int> parents(jointsByID.size());
+    std::vector<glm::mat4> binds(jointsByID.size());
+    for (size_t i = 0; i < jointsByID.size(); i++) {
+        Joint* p = jointsByID[i]->parent;
+        parents[i] = p == nullptr ? -1 : static_cast<int>(p->id);
+        binds[i] = jointsByID[i]->bind;
+    }
+    m_crowd.setRig(parents, binds);
 
-        vptr->pos = og_pos + adjv_sum + incc_sum;
+    // Space the instances by the mesh's footprint so they don't overlap.
+    float radius = 1.f;
+    for (auto const &v : m_mesh.vertices) {
+        radius = std::max(radius, std::max(std::abs(v->pos.x), std::abs(v->pos.z)));
     }
+    m_crowd.layoutGrid(m_crowdSize, 2.5f * radius);
 }
 
-void MyGL::quadrangulateFace(Face* f, CENTROID_MAP &cm) {
-    HalfEdge* curr = f->half_edge->next;
-    curr->set_face(f);
+void MyGL::updateCrowd() {
+    TRACE_SCOPE("paintGL: crowd palette");
+    size_t n = m_crowd.paletteSize();
+    m_crowdPalette.resize(n);
+    const ClipSource* clip = m_player.isPlaying() ? m_player.getClip() : nullptr;
+    m_crowd.evaluate(clip, m_player.currentTime(), capturePose(), m_crowdPalette.writeRange(0, n));
+    m_crowdPalette.upload();
+}
 
-    HalfEdge* connection_edge;
-    HalfEdge* next_connection_edge = curr->next;
-    HalfEdge* next_face_edge = curr->next->next;
+// Recalculate the joint palette and send it to the shader.
+void MyGL::updateUnifMats() {
+    initializeUnifMats(joint.get());
+    m_jointPalette.upload();
+}
 
-    HalfEdge* start_edge =curr->next->next;
+void MyGL::initializeUnifMats(Joint* j) {
+    for (auto &child : j->children) {
+        initializeUnifMats(child.get());
+    }
 
-    HalfEdge* first_centroid_to_midpt_edge;
-    HalfEdge* prev_midpt_to_centroid;
+    m_jointPalette.set(j->id, j->overallT * j->bind);
+}
 
-    bool loop = true;
+void MyGL::updatePose(Joint* j) {
+    traversePose(j);
+    m_jointPalette.upload();
+}
 
-    while (loop) {
-        Vertex* prev_midpt = curr->vertex;      // Store previous midpoint.
-        curr = next_face_edge;                  // Update starting edge of new face.
-        connection_edge = next_connection_edge; // Update edge that points to starting edge.
-        next_connection_edge = curr->next;      // Store pointer to next connection edge.
-        next_face_edge = curr->next->next;      // Store pointer to starting edge of next new face.
+// Unlike Joint::getOverallTransformation, which walks up
+// to the root, this reuses the parent's cached transformation
+// so a subtree is posed in a single top-down pass.
+void MyGL::traversePose(Joint* j) {
+    if (j->parent == nullptr) {
+        j->overallT = j->getLocalTransformation();
+    } else {
+        j->overallT = j->parent->overallT * j->getLocalTransformation();
+    }
+    m_jointPalette.set(j->id, j->overallT * j->bind);
 
-        // Create two new half edges
-        m_mesh.half_edges.push_back(mkU<HalfEdge>(HalfEdge()));
-        HalfEdge *midpt_to_centroid = m_mesh.half_edges.back().get();
-        midpt_to_centroid->set_vertex(cm.at(f));
-        m_mesh.half_edges.push_back(mkU<HalfEdge>(HalfEdge()));
-        HalfEdge *centroid_to_midpt = m_mesh.half_edges.back().get();
-        centroid_to_midpt->set_vertex(prev_midpt);
+    for (auto &child : j->children) {
+        traversePose(child.get());
+    }
+}
 
-        // Send to UI
-        emit sig_sendEdge(midpt_to_centroid);
-        emit sig_sendEdge(centroid_to_midpt);
+PoseSoA MyGL::capturePose() const {
+    PoseSoA pose;
+    pose.resize(jointsByID.size());
+    for (size_t i = 0; i < jointsByID.size(); i++) {
+        pose.setRotation(i, jointsByID[i]->rot);
+        pose.setTranslation(i, jointsByID[i]->pos);
+    }
+    return pose;
+}
 
-        // Last quadrangulated face is a special case.
-        // We don't need to create a new face.
-        Face* face;
-        if (next_face_edge == start_edge) {
-            face = f;
-        // Create new face
-        } else {
-            m_mesh.faces.push_back(mkU<Face>(Face()));
-            face = m_mesh.faces.back().get();
-            // Send to UI
-            emit sig_sendFace(face);
-        }
+void MyGL::applyPose(const PoseSoA &pose) {
+    for (size_t i = 0; i < jointsByID.size(); i++) {
+        jointsByID[i]->rot = pose.rotation(i);
+        jointsByID[i]->pos = pose.translation(i);
+    }
+    updatePose(joint.get());
+}
 
-        // Update half-edge face pointers.
-        midpt_to_centroid->set_face(face);
-        centroid_to_midpt->set_face(face);
-        connection_edge->set_face(face);
-        curr->set_face(face);
+RigDesc MyGL::rigDesc() const {
+    RigDesc rig;
+    rig.parents.resize(jointsByID.size());
+    for (size_t i = 0; i < jointsByID.size(); i++) {
+        Joint* p = jointsByID[i]->parent;
+        rig.parents[i] = p == nullptr ? -1 : static_cast<int>(p->id);
+    }
+    rig.restPose = capturePose();
+    return rig;
+}
 
-        // Update half edge next pointers.
-        curr->set_next(midpt_to_centroid);
-        midpt_to_centroid->set_next(centroid_to_midpt);
-        centroid_to_midpt->set_next(connection_edge);
+const ClipSource* MyGL::activeClip() const {
+    if (m_compressedClip != nullptr) {
+        return m_compressedClip.get();
+    }
+    if (m_clip != nullptr) {
+        return m_clip.get();
+    }
+    return m_bvh != nullptr ? m_bvh->clip() : nullptr;
+}
 
-        // Set sym pointers.
-        // First quadrangulated face is a special case,
-        // since no edge has been previously created.
-        if (curr == start_edge) {
-            first_centroid_to_midpt_edge = centroid_to_midpt;
-            prev_midpt_to_centroid = midpt_to_centroid;
+const AnimationClip* MyGL::sourceClip() const {
+    if (m_clip != nullptr) {
+        return m_clip.get();
+    }
+    if (m_bvh != nullptr && m_bvh->finished()) {
+        return &m_bvh->clip()->finishedClip();
+    }
+    return nullptr;
+}
 
-        } else if (next_face_edge == start_edge) {
-            centroid_to_midpt->set_sym(prev_midpt_to_centroid);
-            midpt_to_centroid->set_sym(first_centroid_to_midpt_edge);
-            loop = false;
-        }
-        else {
-            centroid_to_midpt->set_sym(prev_midpt_to_centroid);
-            prev_midpt_to_centroid = midpt_to_centroid;
-        }
+// Rotates the selected joint by rotM, applied either in the joint's
+// local frame (after its current rotation) or in its parent's frame.
+void MyGL::rotateSelectedJoint(const glm::mat4 &rotM, bool local) {
+    if (selectedJoint == nullptr) {
+        return;
     }
+    glm::mat4 curr_rot = glm::mat4_cast(selectedJoint->rot);
+    selectedJoint->rot = glm::quat_cast(local ? curr_rot * rotM : rotM * curr_rot);
+
+    updatePose(selectedJoint);
+    update();
 }
 
 void MyGL::keyPressEvent(QKeyEvent *e)
@@ -780,6 +1069,7 @@ void MyGL::slot_setSelectedHalfEdge(QListWidgetItem *i) {
 void MyGL::slot_setSelectedFace(QListWidgetItem *i) {
     m_faceDisplay.setSelected(static_cast<Face*>(i));
     m_faceDisplay.create();
+    m_mesh.setSelectedFace(m_faceDisplay.representedFace);
     update();
 }
 
@@ -797,157 +1087,473 @@ void MyGL::slot_setSelectedJoint(QTreeWidgetItem* i) {
     update();
 }
 
-void MyGL::slot_splitEdge() {
-    if (!m_heDisplay.isSelected) {
+void MyGL::recordEdit(const QString &name, uPtr<MeshDelta> delta, const void* mergeKey) {
+    delta->finish(m_mesh);
+    if (delta->createsComponents()) {
+        m_mesh.markTopologyChanged();
+    }
+    sendNewComponents(delta->firstCreatedVertex(), delta->firstCreatedHalfEdge(), delta->firstCreatedFace());
+    if (delta->changesShape()) {
+        m_meshVersion++;
+    }
+    m_history.push(EditCommand(name, std::move(delta), mergeKey));
+}
+
+void MyGL::setSelectedFaceColor(int channel, float value) {
+    if (!m_faceDisplay.isSelected) {
         return;
     }
-    splitEdge(m_heDisplay.representedHalfEdge);
-    m_heDisplay.create();
+    Face* f = m_faceDisplay.representedFace;
+    uPtr<MeshDelta> delta = mkU<MeshDelta>(m_mesh);
+    delta->touch(f);
+    f->color[channel] = value;
+    recordEdit("Recolor face", std::move(delta), f);
+    m_mesh.updateFaceColor(f);
     update();
 }
 
-void MyGL::slot_triangulateFace() {
-    if (!m_faceDisplay.isSelected) {
+void MyGL::setSelectedVertexPos(int axis, float value) {
+    if (!m_vertDisplay.isSelected) {
         return;
     }
-    triangulateFace();
+    Vertex* v = m_vertDisplay.representedVertex;
+    uPtr<MeshDelta> delta = mkU<MeshDelta>(m_mesh);
+    delta->touch(v);
+    v->pos[axis] = value;
+    recordEdit("Move vertex", std::move(delta), v);
+    m_vertDisplay.create();
     m_mesh.create();
     update();
 }
 
-void MyGL::slot_subdivide() {
-    CENTROID_MAP cm = createCentroids();
-    VPTR_SET vs = createSmoothMidpts(cm);
-    smoothOrigVerts(vs, cm);
+// Undo and redo work on the mesh on screen, like the edits they replay.
+void MyGL::applyEdit(EditCommand &command, bool undo) {
+    if (command.delta != nullptr) {
+        MeshDelta &delta = *command.delta;
+        if (delta.createsComponents()) {
+            m_mesh.markTopologyChanged();
+        }
+        if (undo) {
+            if (delta.createsComponents()) {
+                // The selection may be among the components taken away.
+                emit sig_takeListItems(delta.createdVertices(), delta.createdHalfEdges(), delta.createdFaces());
+            }
+            delta.undo(m_mesh);
+        } else {
+            delta.redo(m_mesh);
+            sendNewComponents(delta.firstCreatedVertex(), delta.firstCreatedHalfEdge(), delta.firstCreatedFace());
+        }
+        if (delta.changesShape()) {
+            m_meshVersion++;
+        }
+        m_mesh.create();
+        if (m_vertDisplay.isSelected) {
+            m_vertDisplay.create();
+        }
+        if (m_heDisplay.isSelected) {
+            m_heDisplay.create();
+        }
+        if (m_faceDisplay.isSelected) {
+            m_faceDisplay.create();
+        }
+        update();
+    } else {
+        command.other = replaceMesh(std::move(*command.other));
+    }
+}
 
-    // We need to create a copy of the original faces
-    // since quadrangulateFace will add new faces.
-    std::vector<Face*> face_copy;
-    for (auto const &f : m_mesh.faces) {
-        face_copy.push_back(f.get());
+QString MyGL::indexStats() const {
+    return QString("GPU vertices: %1, ACMR %2 -> %3\nGPU buffers: %4 MB")
+           .arg(m_mesh.gpuVertexCount())
+           .arg(m_mesh.getAcmrBefore(), 0, 'f', 3)
+           .arg(m_mesh.getAcmrAfter(), 0, 'f', 3)
+           .arg(m_mesh.gpuMemoryBytes() / double(1 << 20), 0, 'f', 2);
+}
+
+void MyGL::slot_setOptimizeIndices(bool optimize) {
+    m_mesh.setOptimizeIndices(optimize);
+    if (mesh_loaded) {
+        m_mesh.create();
+        update();
+        emit sig_sendStats(indexStats());
+    }
+}
+
+void MyGL::slot_setLimitShading(bool on) {
+    m_mesh.setLimitShading(on);
+    for (uPtr<Mesh> &lod : m_lods) {
+        lod->setLimitShading(on);
+        lod->create();
     }
-    for (auto const &f : face_copy) {
-        quadrangulateFace(f, cm);
+    if (mesh_loaded) {
+        m_mesh.create();
+        update();
     }
+}
 
-    m_mesh.create();
+QString MyGL::memoryStats() const {
+    QString stats = QString::fromStdString(memstats::report());
+    if (!memstats::hooksInstalled()) {
+        stats += "(tagged allocations only; build with CONFIG+=heap_hooks for all)\n";
+    }
+    return stats + QString("GPU buffers: %1 MB, BVH: %2 MB\n%3")
+                   .arg(m_mesh.gpuMemoryBytes() / double(1 << 20), 0, 'f', 2)
+                   .arg(m_mesh.bvhMemoryBytes() / double(1 << 20), 0, 'f', 2)
+                   .arg(historyStats());
+}
+
+void MyGL::slot_showMemory() {
+    emit sig_sendStats(memoryStats());
+}
 
-    if (m_vertDisplay.representedVertex != nullptr) {
-        m_vertDisplay.create();
+void MyGL::slot_buildLods() {
+    if (!mesh_loaded) {
+        return;
     }
-    if (m_heDisplay.representedHalfEdge != nullptr) {
-        m_heDisplay.create();
+    dropLods();
+    // Triangles of the mesh as flatten() fans them, and its bounds.
+    size_t triangles = 0;
+    for (auto const &f : m_mesh.faces) {
+        HalfEdge* he = f->half_edge;
+        do {
+            triangles++;
+            he = he->next;
+        } while (he != f->half_edge);
+        triangles -= 2;
     }
-    if (m_faceDisplay.representedFace != nullptr) {
-        m_faceDisplay.create();
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (auto const &v : m_mesh.vertices) {
+        lo = glm::min(lo, v->pos);
+        hi = glm::max(hi, v->pos);
     }
+    m_lodTriangles.push_back(triangles);
+    m_lodCenter = (lo + hi) / 2.f;
+    m_lodRadius = glm::length(hi - lo) / 2.f;
+    m_lodVersion = m_meshVersion;
+
+    sPtr<HalfEdgeMesh> copy = m_mesh.clone();
+    m_lodJob = Job<std::vector<uPtr<HalfEdgeMesh>>>::run([copy](JobControl &control) {
+        return buildLodChain(*copy, lodRatios(), &control);
+    });
+    m_jobTimer.start();
+    emit sig_sendProgress(0);
+}
+
+void MyGL::slot_setAutoLod(bool on) {
+    m_autoLod = on;
     update();
 }
 
-void MyGL::slot_changeRed(const double &d) {
-    if (!m_faceDisplay.isSelected) {
+void MyGL::slot_setWeldOnLoad(bool on) {
+    m_weldOnLoad = on;
+}
+
+QString MyGL::historyStats() const {
+    return QString("History: %1 steps, %2 of %3 MB")
+           .arg(m_history.size())
+           .arg(m_history.memoryBytes() / double(1 << 20), 0, 'f', 2)
+           .arg(m_history.getBudget() >> 20);
+}
+
+void MyGL::slot_undo() {
+    if (!m_history.canUndo()) {
         return;
     }
-    m_faceDisplay.representedFace->color.r = d;
-    m_mesh.create();
-    update();
+    EditCommand &command = m_history.nextUndo();
+    applyEdit(command, true);
+    m_history.finishUndo();
+    emit sig_sendStats(QString("Undo: %1\n%2").arg(command.name).arg(historyStats()));
 }
 
-void MyGL::slot_changeGreen(const double &d) {
-    if (!m_faceDisplay.isSelected) {
+void MyGL::slot_redo() {
+    if (!m_history.canRedo()) {
         return;
     }
-    m_faceDisplay.representedFace->color.g = d;
-    m_mesh.create();
+    EditCommand &command = m_history.nextRedo();
+    applyEdit(command, false);
+    m_history.finishRedo();
+    emit sig_sendStats(QString("Redo: %1\n%2").arg(command.name).arg(historyStats()));
+}
+
+void MyGL::slot_setHistoryBudget(int megabytes) {
+    m_history.setBudget(size_t(megabytes) << 20);
+    emit sig_sendStats(historyStats());
+}
+
+void MyGL::slot_splitEdge() {
+    if (!m_heDisplay.isSelected) {
+        return;
+    }
+    uPtr<MeshDelta> delta = mkU<MeshDelta>(m_mesh);
+    m_mesh.splitEdge(m_heDisplay.representedHalfEdge, delta.get());
+    recordEdit("Split edge", std::move(delta));
+    m_heDisplay.create();
     update();
 }
 
-void MyGL::slot_changeBlue(const double &d) {
+void MyGL::slot_triangulateFace() {
     if (!m_faceDisplay.isSelected) {
         return;
     }
-    m_faceDisplay.representedFace->color.b = d;
+    uPtr<MeshDelta> delta = mkU<MeshDelta>(m_mesh);
+    m_mesh.triangulateFace(m_faceDisplay.representedFace, delta.get());
+    recordEdit("Triangulate face", std::move(delta));
     m_mesh.create();
     update();
 }
 
-void MyGL::slot_changeX(const double &d) {
-    if (!m_vertDisplay.isSelected) {
+// Subdivides a copy of the mesh in the background, by Loop's
+// scheme if it is all triangles and by Catmull-Clark otherwise.
+void MyGL::slot_subdivide() {
+    if (!mesh_loaded) {
         return;
     }
-    m_vertDisplay.representedVertex->pos.x = d;
-    m_vertDisplay.create();
-    m_mesh.create();
-    update();
+    sPtr<HalfEdgeMesh> copy = m_mesh.clone();
+    QString name = copy->isTriangleMesh() ? "Loop subdivision" : "Subdivision";
+    startMeshJob(name, [copy](JobControl &control) -> uPtr<HalfEdgeMesh> {
+        if (!copy->refine(&control)) {
+            return nullptr;
+        }
+        return mkU<HalfEdgeMesh>(std::move(*copy));
+    }, true);
 }
 
-void MyGL::slot_changeY(const double &d) {
-    if (!m_vertDisplay.isSelected) {
+// Triangulates a copy of the mesh in the background.
+void MyGL::slot_triangulateMesh() {
+    if (!mesh_loaded) {
         return;
     }
-    m_vertDisplay.representedVertex->pos.y = d;
-    m_vertDisplay.create();
-    m_mesh.create();
-    update();
+    sPtr<HalfEdgeMesh> copy = m_mesh.clone();
+    startMeshJob("Triangulation", [copy](JobControl &control) -> uPtr<HalfEdgeMesh> {
+        if (!copy->triangulate(&control)) {
+            return nullptr;
+        }
+        return mkU<HalfEdgeMesh>(std::move(*copy));
+    }, true);
 }
 
-void MyGL::slot_changeZ(const double &d) {
-    if (!m_vertDisplay.isSelected) {
+void MyGL::slot_previewSubdivision() {
+    if (!mesh_loaded || m_levelJob.active()) {
         return;
     }
-    m_vertDisplay.representedVertex->pos.z = d;
-    m_vertDisplay.create();
-    m_mesh.create();
-    update();
+    if (m_levels.empty() || m_levelsVersion != m_meshVersion) {
+        // Start over from the mesh on screen.
+        dropLevels();
+        m_levels.push_back(nullptr);
+        m_levelsVersion = m_meshVersion;
+    }
+    // Carry on from the newest level, which a cancel may have left short.
+    int top = m_levels.size() - 1;
+    if (top >= PREVIEW_LEVELS) {
+        return;
+    }
+    const HalfEdgeMesh &newest = top == m_level ? static_cast<const HalfEdgeMesh&>(m_mesh) : *m_levels[top];
+    m_levelWorking = newest.clone();
+    startLevelJob();
 }
 
-void MyGL::slot_rotateX() {
-    if (selectedJoint != nullptr) {
-        glm::mat4 curr_rot = glm::mat4_cast(selectedJoint->rot);
-        glm::mat4 rotM = glm::rotate(glm::mat4(1.f), glm::radians(5.0f), glm::vec3(1, 0, 0));
+void MyGL::slot_setSubdivisionLevel(int i) {
+    if (m_levels.empty()) {
+        return;
+    }
+    if (m_levelsVersion != m_meshVersion) {
+        // The levels no longer match the edited mesh.
+        dropLevels();
+        return;
+    }
+    showLevel(i);
+}
 
-        selectedJoint->rot = glm::quat_cast(rotM * curr_rot);
-        traverseCreate(selectedJoint);
+void MyGL::slot_changeRed(const double &d) {
+    setSelectedFaceColor(0, d);
+}
 
-        updateUnifMats();
-        m_mesh.create();
+void MyGL::slot_changeGreen(const double &d) {
+    setSelectedFaceColor(1, d);
+}
 
-        update();
-    }
+void MyGL::slot_changeBlue(const double &d) {
+    setSelectedFaceColor(2, d);
+}
+
+void MyGL::slot_changeX(const double &d) {
+    setSelectedVertexPos(0, d);
+}
+
+void MyGL::slot_changeY(const double &d) {
+    setSelectedVertexPos(1, d);
+}
+
+void MyGL::slot_changeZ(const double &d) {
+    setSelectedVertexPos(2, d);
+}
+
+void MyGL::slot_rotateX() {
+    rotateSelectedJoint(glm::rotate(glm::mat4(1.f), glm::radians(5.0f), glm::vec3(1, 0, 0)), false);
 }
 
 void MyGL::slot_rotateY() {
-    if (selectedJoint != nullptr) {
-        glm::mat4 curr_rot = glm::mat4_cast(selectedJoint->rot);
-        glm::mat4 rotM = glm::rotate(glm::mat4(1.f), glm::radians(5.0f), glm::vec3(0, 1, 0));
+    rotateSelectedJoint(glm::rotate(glm::mat4(1.f), glm::radians(5.0f), glm::vec3(0, 1, 0)), true);
+}
 
-        selectedJoint->rot = glm::quat_cast(curr_rot * rotM);
-        traverseCreate(selectedJoint);
+void MyGL::slot_rotateZ() {
+    rotateSelectedJoint(glm::rotate(glm::mat4(1.f), glm::radians(5.0f), glm::vec3(0, 0, 1)), false);
+}
 
-        updateUnifMats();
-        m_mesh.create();
+void MyGL::slot_skinMesh() {
+    if (mesh_loaded && joint_loaded) {
+        skinMesh();
+    }
+}
 
-        update();
+void MyGL::slot_heatSkinMesh() {
+    if (mesh_loaded && joint_loaded) {
+        heatSkinMesh();
     }
 }
 
-void MyGL::slot_rotateZ() {
-    if (selectedJoint != nullptr) {
-        glm::mat4 curr_rot = glm::mat4_cast(selectedJoint->rot);
-        glm::mat4 rotM = glm::rotate(glm::mat4(1.f), glm::radians(5.0f), glm::vec3(0, 0, 1));
+void MyGL::timerUpdate() {
+    bool loading = m_bvh != nullptr && !m_bvh->finished();
+    if (m_bvhAutoPlay && (m_bvh->framesLoaded() > 1 || !loading)) {
+        m_bvhAutoPlay = false;
+        m_player.setClip(m_bvh->clip(), capturePose());
+        m_player.play();
+    }
+    if (!m_player.tick()) {
+        if (loading) {
+            emit sig_sendStats(QString("Loading BVH: %1 / %2 frames")
+                               .arg(m_bvh->framesLoaded()).arg(m_bvh->frameCount()));
+        } else {
+            m_timer.stop();
+        }
+        return;
+    }
+    applyPose(m_player.currentPose());
+    update();
 
-        selectedJoint->rot = glm::quat_cast(rotM * curr_rot);
-        traverseCreate(selectedJoint);
+    // Refresh the stats a few times a second.
+    qint64 frameNs = m_frameTimer.nsecsElapsed();
+    m_frameTimer.restart();
+    if (++m_statsFrame % 15 == 0) {
+        QString stats = QString("Time: %1 / %2 s\n"
+                                "Joints: %3\n"
+                                "Sample: %4 us (avg %5 us)\n"
+                                "Frame interval: %6 ms")
+                        .arg(m_player.currentTime(), 0, 'f', 2)
+                        .arg(m_player.getClip()->duration(), 0, 'f', 2)
+                        .arg(jointsByID.size())
+                        .arg(m_player.lastSampleTimeNs() / 1000.0, 0, 'f', 2)
+                        .arg(m_player.averageSampleTimeNs() / 1000.0, 0, 'f', 2)
+                        .arg(frameNs / 1e6, 0, 'f', 2);
+        if (m_crowd.size() > 0) {
+            stats += QString("\nCrowd: %1 instances, poses %2 ms")
+                     .arg(m_crowd.size())
+                     .arg(m_crowd.lastEvaluateTimeMs(), 0, 'f', 2);
+        }
+        if (m_bvh != nullptr) {
+            stats += QString("\nBVH frames: %1 / %2").arg(m_bvh->framesLoaded()).arg(m_bvh->frameCount());
+            if (m_bvh->finished() && !m_bvh->error().empty()) {
+                stats += QString("\n%1").arg(QString::fromStdString(m_bvh->error()));
+            }
+        }
+        emit sig_sendStats(stats);
+    }
+}
 
-        updateUnifMats();
-        m_mesh.create();
+// Keys the current pose of every joint.
+// The first key is placed at 0 s and each further key one second later.
+void MyGL::slot_setKey() {
+    if (!joint_loaded) {
+        return;
+    }
+    if (m_clip == nullptr) {
+        m_clip = mkU<AnimationClip>(jointsByID.size());
+        m_clip->setInterpolation(m_interp);
+    }
+    // Editing the clip invalidates its compressed version.
+    if (m_compressedClip != nullptr) {
+        m_player.stop();
+        m_timer.stop();
+        m_player.setClip(nullptr, PoseSoA());
+        m_compressedClip = nullptr;
+    }
+    float t = m_clip->keyCount() == 0 ? 0.f : m_clip->duration() + 1.f;
+    for (size_t i = 0; i < jointsByID.size(); i++) {
+        m_clip->setRotationKey(i, t, jointsByID[i]->rot);
+        m_clip->setTranslationKey(i, t, jointsByID[i]->pos);
+    }
+    emit sig_sendStats(QString("Keyed pose at %1 s").arg(t));
+}
 
-        update();
+void MyGL::slot_togglePlayback() {
+    const ClipSource* clip = activeClip();
+    if (clip == nullptr) {
+        return;
     }
+    m_bvhAutoPlay = false;
+    if (m_player.isPlaying()) {
+        m_player.stop();
+        m_timer.stop();
+        return;
+    }
+    if (m_player.getClip() != clip) {
+        m_player.setClip(clip, capturePose());
+    }
+    m_player.play();
+    m_frameTimer.start();
+    m_timer.start();
 }
 
-void MyGL::slot_skinMesh() {
-    if (mesh_loaded && joint_loaded) {
-        skinMesh();
+void MyGL::slot_setCubic(bool cubic) {
+    m_interp = cubic ? Interpolation::CUBIC : Interpolation::LINEAR;
+    if (m_clip != nullptr) {
+        m_clip->setInterpolation(m_interp);
     }
+    if (m_bvh != nullptr) {
+        m_bvh->clip()->setInterpolation(m_interp);
+    }
+}
+
+// Reduces and quantizes the keyed (or fully loaded BVH) clip,
+// reports how much was saved and how far the joints drift,
+// and plays the compressed clip from then on.
+void MyGL::slot_compressClip() {
+    const AnimationClip* source = sourceClip();
+    if (source == nullptr) {
+        return;
+    }
+    RigDesc rig = rigDesc();
+    CompressionSettings settings;
+    if (source != m_clip.get()) {
+        settings.sampleRate = m_bvh->frameRate();
+    }
+    ClipCompressor compressor{settings};
+    uPtr<CompressedClip> compressed = compressor.compress(*source, &rig);
+    if (compressed == nullptr) {
+        emit sig_sendStats(QString("Cannot compress clip\n"
+                                   "Keys must lie within frames 0 to 65535 at %1 fps")
+                           .arg(double(settings.sampleRate)));
+        return;
+    }
+
+    m_player.stop();
+    m_timer.stop();
+    m_player.setClip(nullptr, PoseSoA());
+    m_compressedClip = std::move(compressed);
+    CompressionReport r = compressor.evaluate(*source, *m_compressedClip, rig);
+
+    emit sig_sendStats(QString("Compressed clip\n"
+                               "Keys: %1 -> %2\n"
+                               "Size: %3 -> %4 bytes (%5x)\n"
+                               "Max joint error: %6")
+                       .arg(r.rawKeys).arg(r.keptKeys)
+                       .arg(r.rawBytes).arg(r.compressedBytes)
+                       .arg(r.compressedBytes == 0 ? 0.0 : double(r.rawBytes) / r.compressedBytes, 0, 'f', 1)
+                       .arg(r.maxWorldError, 0, 'g', 3));
+}
+
+void MyGL::slot_setCrowdSize(int n) {
+    m_crowdSize = n;
+    rebuildCrowd();
+    update();
 }
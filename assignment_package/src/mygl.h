@@ -11,42 +11,31 @@
 #include "components/vertexdisplay.h"
 #include "components/halfedgedisplay.h"
 #include "components/facedisplay.h"
+#include "jointpalette.h"
+#include "animation/animationclip.h"
+#include "animation/animationplayer.h"
+#include "animation/clipcompressor.h"
+#include "animation/bvhimporter.h"
+#include "animation/crowd.h"
+#include "skinning/heatweights.h"
+#include "lod/decimator.h"
+#include "skeletonio.h"
+#include "jobs/job.h"
+#include "edithistory.h"
+#include "pickbuffer.h"
 
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLShaderProgram>
-#include <QJsonDocument>
-#include <QJsonObject>
-
-#include <unordered_map>
-#include <unordered_set>
-
-//--------------------------------------------------
-// TYPEDEFs and HASH structs
-//--------------------------------------------------
-typedef std::pair<Vertex*, Vertex*> ENDPT;
-
-struct PAIRHASH {
-    std::size_t operator()(const ENDPT& vp) const
-    {
-        return std::hash<Vertex*>()(vp.first) ^
-           (std::hash<Vertex*>()(vp.second) << 1);
-    }
-};
+#include <QTimer>
+#include <QElapsedTimer>
 
-struct PTRHASH {
-    template<typename T>
-    std::size_t operator()(const T* ptr) const
-    {
-        return std::hash<const T*>()(ptr);
-    }
-};
+#include <functional>
 
-typedef std::unordered_map<Face*, Vertex*, PTRHASH> CENTROID_MAP;
-typedef std::unordered_map<ENDPT, HalfEdge*, PAIRHASH> ENDPT_MAP;
-typedef std::unordered_set<Vertex*, PTRHASH> VPTR_SET;
-//--------------------------------------------------
-// END
-//--------------------------------------------------
+// Weights from a skinning job, with a summary for the stats label.
+struct SkinResult {
+    SkinInfluences influences;
+    QString report;
+};
 
 class MyGL
     : public OpenGLContext
@@ -58,6 +47,7 @@ private:
     ShaderProgram m_progFlat;// A shader program that uses "flat" reflection (no shadowing at all)
 
     ShaderProgram m_progSkelaton;
+    ShaderProgram m_progPick;   // Renders element IDs for viewport picking.
 
     GLuint vao; // A handle for our vertex array object. This will store the VBOs created in our geometry classes.
                 // Don't worry too much about this. Just know it is necessary in order to render geometry.
@@ -75,9 +65,72 @@ private:
     bool joint_loaded;
 
     Joint* selectedJoint;
-
-    glm::mat4 bindMats[30];
-    glm::mat4 overallTMats[30];
+    // Every joint of the loaded skeleton, indexed by id.
+    std::vector<Joint*> jointsByID;
+
+    JointPalette m_jointPalette;
+
+    uPtr<AnimationClip> m_clip;
+    uPtr<CompressedClip> m_compressedClip; // Played instead of m_clip once built.
+    uPtr<BvhImporter> m_bvh;    // Streams the clip of a loaded BVH file.
+    bool m_bvhAutoPlay;         // Start playing once the first BVH frames arrive.
+    Interpolation m_interp;
+    AnimationPlayer m_player;
+    Crowd m_crowd;              // Instances of the skinned mesh drawn in its place.
+    int m_crowdSize;
+    JointPalette m_crowdPalette;
+
+    // Background work on the mesh. Results replace the mesh only once
+    // finished, so the previous mesh keeps rendering in the meantime.
+    Job<uPtr<HalfEdgeMesh>> m_meshJob;
+    QString m_meshJobName;
+    bool m_meshJobFromMesh;     // Works on a copy of the mesh rather than a file.
+    size_t m_meshJobVersion;    // m_meshVersion the job started from.
+    sPtr<WeldStats> m_meshJobWeld;  // Filled in by a load job that welds.
+    bool m_weldOnLoad;
+    // Progressive subdivision. m_levels[i] is the mesh after i steps
+    // of refine, m_levels[0] being the cage. The level on screen
+    // lives in m_mesh, leaving its slot empty.
+    std::vector<uPtr<HalfEdgeMesh>> m_levels;
+    int m_level;
+    size_t m_levelsVersion;     // m_meshVersion while m_levels matches m_mesh.
+    Job<uPtr<HalfEdgeMesh>> m_levelJob;
+    // Copy of the newest level that the next level job subdivides in place.
+    sPtr<HalfEdgeMesh> m_levelWorking;
+
+    // Decimated stand-ins for m_mesh, coarsest last, drawn in its place
+    // while it covers few pixels. m_lodTriangles[0] counts m_mesh's own
+    // triangles and m_lodTriangles[i] those of m_lods[i - 1].
+    std::vector<uPtr<Mesh>> m_lods;
+    std::vector<size_t> m_lodTriangles;
+    glm::vec3 m_lodCenter;      // Bounding sphere of m_mesh.
+    float m_lodRadius;
+    size_t m_lodVersion;        // m_meshVersion the LODs were built from.
+    int m_lodLevel;             // Drawn by the last frame, 0 for m_mesh.
+    bool m_autoLod;
+    Job<std::vector<uPtr<HalfEdgeMesh>>> m_lodJob;
+
+    Job<SkinResult> m_skinJob;
+    QString m_skinJobName;
+    size_t m_skinJobVersion;
+    // Bumped by every edit made on the GUI thread that moves or
+    // relinks components, so results computed from an older shape
+    // are dropped instead of applied. Recoloring a face keeps it.
+    size_t m_meshVersion;
+    QTimer m_jobTimer;          // Polls running jobs for progress and results.
+
+    EditHistory m_history;      // Undo steps for edits of the mesh on screen.
+
+    // Viewport picking. A click renders the ID pass on the next frame,
+    // and later frames pick up the result once the GPU has it.
+    PickBuffer m_pickBuffer;
+    bool m_pickRequested;
+    int m_pickX, m_pickY;       // In framebuffer pixels from the bottom left.
+    size_t m_pickVersion;       // m_meshVersion when the ID pass ran.
+
+    QTimer m_timer;             // Steady 60 Hz tick that drives playback.
+    QElapsedTimer m_frameTimer; // Measures the real interval between ticks.
+    int m_statsFrame;
 
 friend class MainWindow;
 
@@ -90,34 +143,118 @@ public:
     void paintGL();
 
     void populateWidgets();
-    ENDPT generateKey(Vertex* v_ptr1, Vertex* v_ptr2);
+    // Tolerance of welding on load, as a fraction of the mesh's size.
+    static constexpr float WELD_TOLERANCE = 1e-6f;
+    // Loads the OBJ file in the background, welding it if m_weldOnLoad.
     void load_OBJ(const QString OBJ_file);
+    // Swaps in a mesh built by a job and refreshes everything showing it.
+    // Returns the mesh that was on screen.
+    uPtr<HalfEdgeMesh> replaceMesh(HalfEdgeMesh &&m);
+    // Binds the mesh with the given weights.
+    void applySkin(const SkinInfluences &influences);
+    // Start work on the pool, replacing any job of the same kind.
+    // A mesh job fromMesh is dropped if the mesh is edited meanwhile.
+    void startMeshJob(const QString &name,
+                      std::function<uPtr<HalfEdgeMesh>(JobControl&)> work,
+                      bool fromMesh);
+    void startSkinJob(const QString &name, std::function<SkinResult(JobControl&)> work);
+
+    // The finest level the progressive preview computes.
+    static const int PREVIEW_LEVELS = 4;
+    // Computes the level above the newest one from m_levelWorking.
+    void startLevelJob();
+    // Stashes the level on screen and shows level i in its place.
+    void showLevel(int i);
+    // Forgets every level but the one on screen.
+    void dropLevels();
+
+    // Fractions of the mesh's triangles the LOD chain keeps.
+    static const std::vector<float>& lodRatios();
+    void dropLods();
+    // The mesh to draw this frame: m_mesh, or the LOD that suits its
+    // size on screen.
+    Mesh& displayMesh();
 
     void load_JSON(const QString JSON_file);
-    void read(const QJsonObject &json);
-    void traverseCalcBind(Joint* j);
-    void traverseCreate(Joint* j);
+    // Loads / saves a skeleton in the binary skeleton format.
+    void load_SKEL(const QString SKEL_file);
+    void save_SKEL(const QString SKEL_file) const;
+    // Loads a BVH skeleton and streams its motion in the background.
+    // Playback starts as soon as the first frames are read.
+    void load_BVH(const QString BVH_file);
+    // Drops the skeleton along with every clip that animates it.
+    void clearSkeleton();
+    // Creates a Joint for every entry of desc in a single pass.
+    // Joint ids match the indices in desc.
+    void buildSkeleton(const SkeletonDesc &desc);
+    // The current skeleton as a flat description.
+    SkeletonDesc skeletonDesc() const;
     void traverseDraw(Joint* j);
-    void traverseSkin(Vertex* curr, Joint** closest, Joint** nextClosest,
-                      float* minDist, float* nextMinDist, Joint* j) const;
 
+    // Both compute weights in the background and bind the mesh
+    // once they are done.
     void skinMesh();
+    // Binds the mesh with weights from heat diffusion over its surface,
+    // which, unlike skinMesh, does not bleed across nearby limbs.
+    void heatSkinMesh();
     void updateUnifMats();
     void initializeUnifMats(Joint* j);
 
-    // CATMULL stuff is happening here
-    void splitEdge(HalfEdge* he);
-    void triangulateFace();
-
-    CENTROID_MAP createCentroids();
-    VPTR_SET createSmoothMidpts(CENTROID_MAP &cm);
-    VPTR_SET getAdjMidpts(Vertex* v) const;
-    VPTR_SET getIncCentroids(Vertex* v, CENTROID_MAP &cm) const;
-    void smoothOrigVerts(VPTR_SET& vs, CENTROID_MAP &cm);
-    void quadrangulateFace(Face* f, CENTROID_MAP &cm);
+    // Recomputes the pose of j and every joint below it
+    // and re-uploads only the joint matrix palette.
+    // Mesh VBOs and joint display geometry are left untouched.
+    void updatePose(Joint* j);
+    void traversePose(Joint* j);
+    void rotateSelectedJoint(const glm::mat4 &rotM, bool local);
+
+    // Lays the crowd out again for the current skeleton and mesh.
+    void rebuildCrowd();
+    // Poses every crowd instance and uploads their palettes.
+    void updateCrowd();
+
+    // Captures / applies the local pose of every joint.
+    PoseSoA capturePose() const;
+    void applyPose(const PoseSoA &pose);
+    // Describes the loaded skeleton for clip compression.
+    RigDesc rigDesc() const;
+    // The clip played back: the compressed clip if there is one,
+    // then the keyed clip, then the clip of a loaded BVH file.
+    const ClipSource* activeClip() const;
+    // The uncompressed clip that compression starts from, or
+    // nullptr while there is none or a BVH file is still loading.
+    const AnimationClip* sourceClip() const;
+
+    // Sends list items for components added past the given counts.
+    void sendNewComponents(size_t vertCount, size_t edgeCount, size_t faceCount);
+
+    // Finishes delta for an edit just made to m_mesh and records it.
+    void recordEdit(const QString &name, uPtr<MeshDelta> delta, const void* mergeKey = nullptr);
+    void setSelectedFaceColor(int channel, float value);
+    void setSelectedVertexPos(int axis, float value);
+    void applyEdit(EditCommand &command, bool undo);
+    QString historyStats() const;
+    // GPU vertex count and buffer size, and the cache miss
+    // ratios of the mesh's index buffer.
+    QString indexStats() const;
+    // Heap memory by subsystem, then what the GPU, BVH and history hold.
+    QString memoryStats() const;
+
+    // Draws every pickable element into m_pickBuffer and starts
+    // reading back the pixels around the pick position.
+    void renderPickPass();
+    // Selects what the ID pass found under the cursor.
+    void applyPick(const PickResult &result);
+    // Selects the face under widget pixel (x, y) with a ray cast on the
+    // CPU instead, reporting the hit and how long the cast took.
+    void raycastFace(int x, int y);
 
 protected:
     void keyPressEvent(QKeyEvent *e);
+    void mousePressEvent(QMouseEvent *e);
+
+private slots:
+    void timerUpdate() override;
+    void pollJobs();
 
 signals:
     void sig_sendVertex(QListWidgetItem*);
@@ -126,8 +263,21 @@ signals:
     void sig_sendJoint(QTreeWidgetItem*);
 
     void sig_clearListWidgets();
+    // Takes the items off the list widgets without deleting them.
+    void sig_releaseListWidgets();
+    // Takes that many items off the end of each list widget.
+    void sig_takeListItems(int, int, int);
     void sig_clearTreeWidget();
 
+    void sig_sendStats(QString);
+    // Progress of the running job in percent, or -1 when idle.
+    void sig_sendProgress(int);
+    // The subdivision level on screen and the finest one available.
+    void sig_sendLevels(int, int);
+    // Shows an item selected in the viewport in its widget.
+    void sig_showListItem(QListWidgetItem*);
+    void sig_showTreeItem(QTreeWidgetItem*);
+
 public slots:
     void slot_setSelectedVertex(QListWidgetItem*);
     void slot_setSelectedHalfEdge(QListWidgetItem*);
@@ -136,7 +286,11 @@ public slots:
 
     void slot_splitEdge();
     void slot_triangulateFace();
+    void slot_triangulateMesh();
     void slot_subdivide();
+    // Shows the next subdivision levels one by one as they finish.
+    void slot_previewSubdivision();
+    void slot_setSubdivisionLevel(int);
 
     void slot_changeRed(const double &d);
     void slot_changeGreen(const double &d);
@@ -151,6 +305,27 @@ public slots:
     void slot_rotateZ();
 
     void slot_skinMesh();
+    void slot_heatSkinMesh();
+
+    void slot_setKey();
+    void slot_togglePlayback();
+    void slot_setCubic(bool);
+    void slot_compressClip();
+    void slot_setCrowdSize(int);
+    void slot_cancelJobs();
+
+    void slot_undo();
+    void slot_redo();
+    void slot_setHistoryBudget(int megabytes);
+    // Toggles vertex cache ordering of the mesh's index buffer.
+    void slot_setOptimizeIndices(bool);
+    // Draws the mesh and its LODs at their Catmull-Clark limit surface.
+    void slot_setLimitShading(bool);
+    void slot_showMemory();
+    // Decimates the mesh into a chain of LODs in the background.
+    void slot_buildLods();
+    void slot_setAutoLod(bool);
+    void slot_setWeldOnLoad(bool);
 };
 
 
@@ -0,0 +1,55 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "jobs/threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+// Calls fn(begin, end) on disjoint ranges that together cover [0, count),
+// spread over the global thread pool, and returns once every range is done.
+// Ranges are at least minGrain long, so small jobs stay on the calling thread.
+// The calling thread works through the ranges too, and only those, so a
+// wait here never runs unrelated pool work and nesting cannot deadlock.
+template<typename F>
+void parallelFor(size_t count, size_t minGrain, F fn) {
+    if (count == 0) {
+        return;
+    }
+    ThreadPool &pool = ThreadPool::global();
+    minGrain = std::max<size_t>(minGrain, 1);
+    // A few ranges per thread so threads that finish early can take more.
+    size_t chunks = std::min(4 * (pool.threadCount() + 1), (count + minGrain - 1) / minGrain);
+    if (chunks <= 1) {
+        fn(size_t(0), count);
+        return;
+    }
+    size_t step = (count + chunks - 1) / chunks;
+    chunks = (count + step - 1) / step;
+
+    // Helpers may start after every range is taken; they then return
+    // without touching fn, so only the counters need to outlive this call.
+    struct Ranges {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+    };
+    std::shared_ptr<Ranges> ranges = std::make_shared<Ranges>();
+    auto work = [ranges, chunks, step, count, &fn]() {
+        for (size_t c = ranges->next++; c < chunks; c = ranges->next++) {
+            fn(c * step, std::min(count, (c + 1) * step));
+            ranges->done++;
+        }
+    };
+
+    size_t helpers = std::min(pool.threadCount(), chunks - 1);
+    for (size_t i = 0; i < helpers; i++) {
+        pool.submit(work);
+    }
+    work();
+    while (ranges->done < chunks) {
+        std::this_thread::yield();
+    }
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,30 @@
+#ifndef PARSENUMBER_H
+#define PARSENUMBER_H
+
+#include <charconv>
+#include <system_error>
+
+// Reads the number at the start of [p, end) into out, always with '.'
+// as the decimal point. strtof and sscanf follow LC_NUMERIC, which
+// QApplication takes from the environment, so under a locale such as
+// de_DE they would stop at the '.' of "0.5". Leading spaces, tabs and
+// a '+' are skipped. Returns the character after the number, or p,
+// leaving out as it was, if there is no number there that fits a float.
+inline const char* parseFloat(const char* p, const char* end, float &out) {
+    const char* s = p;
+    while (s < end && (*s == ' ' || *s == '\t')) {
+        s++;
+    }
+    if (s < end && *s == '+') {
+        s++;
+    }
+    float value;
+    std::from_chars_result r = std::from_chars(s, end, value);
+    if (r.ec != std::errc()) {
+        return p;
+    }
+    out = value;
+    return r.ptr;
+}
+
+#endif // PARSENUMBER_H
@@ -0,0 +1,119 @@
+#include "pickbuffer.h"
+#include <algorithm>
+
+PickBuffer::PickBuffer(OpenGLContext* context)
+    : fbo(), idRb(), depthRb(), pbo(), fence(nullptr),
+      width(0), height(0), clickX(0), clickY(0), created(false), reading(false),
+      mp_context(context)
+{}
+
+PickBuffer::~PickBuffer() {
+    destroy();
+}
+
+void PickBuffer::begin(int w, int h) {
+    if (!created) {
+        mp_context->glGenFramebuffers(1, &fbo);
+        mp_context->glGenRenderbuffers(1, &idRb);
+        mp_context->glGenRenderbuffers(1, &depthRb);
+        mp_context->glGenBuffers(1, &pbo);
+        mp_context->glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        mp_context->glBufferData(GL_PIXEL_PACK_BUFFER, REGION * REGION * 2 * sizeof(uint32_t), nullptr, GL_STREAM_READ);
+        mp_context->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        created = true;
+    }
+    mp_context->glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    if (w != width || h != height) {
+        width = w;
+        height = h;
+        mp_context->glBindRenderbuffer(GL_RENDERBUFFER, idRb);
+        mp_context->glRenderbufferStorage(GL_RENDERBUFFER, GL_RG32UI, w, h);
+        mp_context->glBindRenderbuffer(GL_RENDERBUFFER, depthRb);
+        mp_context->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+        mp_context->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, idRb);
+        mp_context->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRb);
+    }
+    mp_context->glViewport(0, 0, w, h);
+    const GLuint none[4] = {0, 0, 0, 0};
+    mp_context->glClearBufferuiv(GL_COLOR, 0, none);
+    mp_context->glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void PickBuffer::end(int x, int y, GLuint framebuffer) {
+    // Clip the region to the buffer; whatever falls outside stays zero.
+    int x0 = std::max(0, std::min(x - REGION / 2, width - REGION));
+    int y0 = std::max(0, std::min(y - REGION / 2, height - REGION));
+    clickX = x - x0;
+    clickY = y - y0;
+    mp_context->glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    mp_context->glReadBuffer(GL_COLOR_ATTACHMENT0);
+    mp_context->glReadPixels(x0, y0, std::min(REGION, width), std::min(REGION, height),
+                             GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+    mp_context->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (fence != nullptr) {
+        mp_context->glDeleteSync(fence);
+    }
+    fence = mp_context->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    reading = true;
+    mp_context->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+bool PickBuffer::pending() const {
+    return reading;
+}
+
+bool PickBuffer::poll(PickResult &result) {
+    if (!reading) {
+        return false;
+    }
+    // A zero timeout only asks whether the copy is done.
+    GLenum status = mp_context->glClientWaitSync(fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        return false;
+    }
+    mp_context->glDeleteSync(fence);
+    fence = nullptr;
+    reading = false;
+
+    mp_context->glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    const uint32_t* texels = static_cast<const uint32_t*>(
+                mp_context->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, REGION * REGION * 2 * sizeof(uint32_t),
+                                             GL_MAP_READ_BIT));
+    result = {PickKind::NONE, 0};
+    if (texels != nullptr) {
+        int w = std::min(REGION, width), h = std::min(REGION, height);
+        int best = -1;
+        for (int i = 0; i < w * h; i++) {
+            PickKind kind = PickKind(texels[i * 2]);
+            if (kind == PickKind::NONE || kind < result.kind) {
+                continue;
+            }
+            int dx = i % w - clickX, dy = i / w - clickY;
+            int dist = dx * dx + dy * dy;
+            if (kind > result.kind || dist < best) {
+                result = {kind, texels[i * 2 + 1]};
+                best = dist;
+            }
+        }
+        mp_context->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    mp_context->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+void PickBuffer::destroy() {
+    if (!created) {
+        return;
+    }
+    if (fence != nullptr) {
+        mp_context->glDeleteSync(fence);
+        fence = nullptr;
+    }
+    mp_context->glDeleteFramebuffers(1, &fbo);
+    mp_context->glDeleteRenderbuffers(1, &idRb);
+    mp_context->glDeleteRenderbuffers(1, &depthRb);
+    mp_context->glDeleteBuffers(1, &pbo);
+    created = false;
+    reading = false;
+    width = height = 0;
+}
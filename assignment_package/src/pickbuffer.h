@@ -0,0 +1,54 @@
+#ifndef PICKBUFFER_H
+#define PICKBUFFER_H
+
+#include <openglcontext.h>
+#include <cstdint>
+
+// What a texel of the ID buffer names.
+enum class PickKind : uint32_t {
+    NONE = 0, FACE, HALF_EDGE, VERTEX, JOINT
+};
+
+struct PickResult {
+    PickKind kind;
+    uint32_t index;     // Into the list of elements of that kind.
+};
+
+// An offscreen RG32UI framebuffer the ID pass renders into: .r holds
+// the PickKind of the element under each pixel and .g its index. The
+// pixels around a click are copied into a pixel buffer object and read
+// back once a fence says the GPU is done, frames later if need be, so
+// picking never waits on the GPU.
+class PickBuffer
+{
+private:
+    GLuint fbo, idRb, depthRb, pbo;
+    GLsync fence;
+    int width, height;
+    int clickX, clickY; // Within the region read back.
+    bool created;
+    bool reading;       // A read back is in flight.
+
+    OpenGLContext* mp_context;
+
+public:
+    // Side of the square of pixels read around a click.
+    static const int REGION = 9;
+
+    PickBuffer(OpenGLContext* context);
+    ~PickBuffer();
+
+    // Binds the ID buffer, sized to the given framebuffer, and clears it.
+    void begin(int w, int h);
+    // Starts reading back the pixels around (x, y), measured from the
+    // bottom left, and rebinds the given framebuffer.
+    void end(int x, int y, GLuint framebuffer);
+    bool pending() const;
+    // Once the read back has arrived, stores the element nearest the
+    // center of the region in result and returns true. Joints beat
+    // vertices, which beat edges, which beat faces.
+    bool poll(PickResult &result);
+    void destroy();
+};
+
+#endif // PICKBUFFER_H
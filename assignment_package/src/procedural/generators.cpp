@@ -0,0 +1,337 @@
+#include "procedural/generators.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float PI = 3.14159265358979f;
+
+    // SplitMix64, so every polygon of a soup draws from its own stream.
+    uint64_t mix(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    float unitFloat(uint64_t &state) {
+        state = mix(state);
+        return float(state >> 40) / float(1 << 24);
+    }
+
+    // Sizes every array for faceCount faces of the same number of corners.
+    void uniformFaces(PolygonList &p, size_t vertexCount, size_t faceCount, uint32_t corners) {
+        p.positions.resize(vertexCount);
+        p.faceStarts.resize(faceCount + 1);
+        p.indices.resize(faceCount * corners);
+        parallelFor(faceCount + 1, 1 << 16, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                p.faceStarts[i] = uint32_t(i * corners);
+            }
+        });
+    }
+
+    void setQuad(PolygonList &p, size_t face, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        uint32_t* q = &p.indices[face * 4];
+        q[0] = a;
+        q[1] = b;
+        q[2] = c;
+        q[3] = d;
+    }
+}
+
+size_t PolygonList::faceCount() const {
+    return faceStarts.empty() ? 0 : faceStarts.size() - 1;
+}
+
+bool PolygonList::build(HalfEdgeMesh &m) const {
+    return m.buildFromPolygons(positions, faceStarts, indices);
+}
+
+PolygonList procedural::grid(size_t w, size_t h, size_t holeEvery) {
+    w = std::max<size_t>(w, 1);
+    h = std::max<size_t>(h, 1);
+    size_t hole = holeEvery / 2;
+    auto isHole = [holeEvery, hole](size_t i) {
+        return holeEvery >= 2 && i % holeEvery == hole;
+    };
+    // Faces before each row, less the holes of earlier rows.
+    size_t holesPerRow = holeEvery >= 2 && w > hole ? (w - hole + holeEvery - 1) / holeEvery : 0;
+    std::vector<size_t> rowStart(h + 1, 0);
+    for (size_t y = 0; y < h; y++) {
+        rowStart[y + 1] = rowStart[y] + w - (isHole(y) ? holesPerRow : 0);
+    }
+
+    PolygonList p;
+    uniformFaces(p, (w + 1) * (h + 1), rowStart[h], 4);
+    parallelFor(h + 1, 64, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            for (size_t x = 0; x <= w; x++) {
+                p.positions[y * (w + 1) + x] = glm::vec3(float(x) / w, 0.f, float(y) / h);
+            }
+        }
+    });
+    parallelFor(h, 64, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            size_t face = rowStart[y];
+            for (size_t x = 0; x < w; x++) {
+                if (isHole(x) && isHole(y)) {
+                    continue;
+                }
+                uint32_t a = uint32_t(y * (w + 1) + x), b = a + uint32_t(w + 1);
+                setQuad(p, face++, a, b, b + 1, a + 1);
+            }
+        }
+    });
+    return p;
+}
+
+PolygonList procedural::torus(size_t w, size_t h) {
+    w = std::max<size_t>(w, 3);
+    h = std::max<size_t>(h, 3);
+    PolygonList p;
+    uniformFaces(p, w * h, w * h, 4);
+    parallelFor(h, 64, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            float v = 2.f * PI * y / h;
+            float r = 1.f + 0.4f * std::cos(v);
+            for (size_t x = 0; x < w; x++) {
+                float u = 2.f * PI * x / w;
+                p.positions[y * w + x] = glm::vec3(r * std::cos(u), 0.4f * std::sin(v), r * std::sin(u));
+
+                uint32_t a = uint32_t(y * w + x), b = uint32_t(y * w + (x + 1) % w);
+                uint32_t c = uint32_t((y + 1) % h * w + (x + 1) % w), d = uint32_t((y + 1) % h * w + x);
+                setQuad(p, y * w + x, a, d, c, b);
+            }
+        }
+    });
+    return p;
+}
+
+PolygonList procedural::uvSphere(size_t segments, size_t rings) {
+    segments = std::max<size_t>(segments, 3);
+    rings = std::max<size_t>(rings, 2);
+    size_t s = segments;
+    // The north pole, then rings - 1 rings of segments, then the south pole.
+    uint32_t north = 0, south = uint32_t(1 + (rings - 1) * s);
+    auto at = [s](size_t ring, size_t i) {
+        return uint32_t(1 + (ring - 1) * s + i % s);
+    };
+
+    PolygonList p;
+    size_t quads = (rings - 2) * s;
+    p.positions.resize(south + 1);
+    p.faceStarts.resize(2 * s + quads + 1);
+    p.indices.resize(6 * s + 4 * quads);
+    p.positions[north] = glm::vec3(0.f, 1.f, 0.f);
+    p.positions[south] = glm::vec3(0.f, -1.f, 0.f);
+    parallelFor(rings - 1, 16, [&](size_t begin, size_t end) {
+        for (size_t ring = begin + 1; ring <= end; ring++) {
+            float theta = PI * ring / rings;
+            for (size_t i = 0; i < s; i++) {
+                float phi = 2.f * PI * i / s;
+                p.positions[at(ring, i)] = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta),
+                                                     std::sin(theta) * std::sin(phi));
+            }
+        }
+    });
+
+    // Triangles at the north pole, quads ring by ring, then the south pole.
+    parallelFor(s, 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            p.faceStarts[i] = uint32_t(3 * i);
+            uint32_t* t = &p.indices[3 * i];
+            t[0] = north;
+            t[1] = at(1, i + 1);
+            t[2] = at(1, i);
+
+            size_t last = s + quads + i;
+            p.faceStarts[last] = uint32_t(3 * s + 4 * quads + 3 * i);
+            t = &p.indices[p.faceStarts[last]];
+            t[0] = south;
+            t[1] = at(rings - 1, i);
+            t[2] = at(rings - 1, i + 1);
+        }
+    });
+    parallelFor(rings - 2, 16, [&](size_t begin, size_t end) {
+        for (size_t ring = begin + 1; ring <= end; ring++) {
+            for (size_t i = 0; i < s; i++) {
+                size_t q = (ring - 1) * s + i;
+                p.faceStarts[s + q] = uint32_t(3 * s + 4 * q);
+                uint32_t* f = &p.indices[3 * s + 4 * q];
+                f[0] = at(ring, i);
+                f[1] = at(ring, i + 1);
+                f[2] = at(ring + 1, i + 1);
+                f[3] = at(ring + 1, i);
+            }
+        }
+    });
+    p.faceStarts.back() = uint32_t(p.indices.size());
+    return p;
+}
+
+PolygonList procedural::fans(size_t sides, size_t count) {
+    sides = std::max<size_t>(sides, 3);
+    count = std::max<size_t>(count, 1);
+    // Each fan is its hub then its rim, sides triangles then the cap.
+    size_t verts = sides + 1, faces = sides + 1, corners = 4 * sides;
+    PolygonList p;
+    p.positions.resize(count * verts);
+    p.faceStarts.resize(count * faces + 1);
+    p.indices.resize(count * corners);
+    parallelFor(count, 16, [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; j++) {
+            float cx = 2.5f * j;
+            uint32_t hub = uint32_t(j * verts);
+            p.positions[hub] = glm::vec3(cx, 0.3f, 0.f);
+            for (size_t i = 0; i < sides; i++) {
+                float phi = 2.f * PI * i / sides;
+                p.positions[hub + 1 + i] = glm::vec3(cx + std::cos(phi), 0.f, std::sin(phi));
+            }
+
+            size_t face = j * faces, k = j * corners;
+            for (size_t i = 0; i < sides; i++) {
+                p.faceStarts[face++] = uint32_t(k);
+                p.indices[k++] = hub;
+                p.indices[k++] = hub + 1 + uint32_t((i + 1) % sides);
+                p.indices[k++] = hub + 1 + uint32_t(i);
+            }
+            p.faceStarts[face] = uint32_t(k);
+            for (size_t i = 0; i < sides; i++) {
+                p.indices[k++] = hub + 1 + uint32_t(i);
+            }
+        }
+    });
+    p.faceStarts.back() = uint32_t(p.indices.size());
+    return p;
+}
+
+PolygonList procedural::soup(size_t count, size_t minSides, size_t maxSides, uint32_t seed) {
+    minSides = std::max<size_t>(minSides, 3);
+    maxSides = std::max(maxSides, minSides);
+    PolygonList p;
+    p.faceStarts.resize(count + 1);
+    parallelFor(count, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            p.faceStarts[i + 1] = uint32_t(minSides + mix(uint64_t(seed) << 32 ^ i) % (maxSides - minSides + 1));
+        }
+    });
+    p.faceStarts[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        p.faceStarts[i + 1] += p.faceStarts[i];
+    }
+
+    // Every corner is a vertex of its own, so the soup has no shared edges.
+    p.positions.resize(p.faceStarts[count]);
+    p.indices.resize(p.faceStarts[count]);
+    float size = 0.5f / std::cbrt(float(std::max<size_t>(count, 1)));
+    parallelFor(count, 1 << 12, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            uint64_t state = mix(uint64_t(seed) << 32 ^ i ^ 0x5eed);
+            glm::vec3 center(unitFloat(state), unitFloat(state), unitFloat(state));
+            float radius = size * (0.5f + unitFloat(state));
+            // A uniformly random facing.
+            float z = 2.f * unitFloat(state) - 1.f, a = 2.f * PI * unitFloat(state);
+            float rxy = std::sqrt(1.f - z * z);
+            glm::vec3 n(rxy * std::cos(a), rxy * std::sin(a), z);
+            glm::vec3 u = glm::normalize(glm::cross(n, std::abs(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0)));
+            glm::vec3 v = glm::cross(n, u);
+
+            uint32_t first = p.faceStarts[i], sides = p.faceStarts[i + 1] - first;
+            for (uint32_t c = 0; c < sides; c++) {
+                float phi = 2.f * PI * c / sides;
+                p.positions[first + c] = center + radius * (std::cos(phi) * u + std::sin(phi) * v);
+                p.indices[first + c] = first + c;
+            }
+        }
+    });
+    return p;
+}
+
+const char* procedural::shapeNames() {
+    return "grid holes torus sphere fans soup";
+}
+
+bool procedural::shape(const std::string &name, size_t faces, PolygonList &out) {
+    faces = std::max<size_t>(faces, 1);
+    size_t side = std::max<size_t>(1, size_t(std::sqrt(double(faces))));
+    size_t wide = std::max<size_t>(3, size_t(std::sqrt(2.0 * faces)));
+    if (name == "grid") {
+        out = grid(side, side);
+    } else if (name == "holes") {
+        out = grid(side, side, 4);
+    } else if (name == "torus") {
+        out = torus(wide, faces / wide);
+    } else if (name == "sphere") {
+        out = uvSphere(wide, std::max<size_t>(2, faces / wide));
+    } else if (name == "fans") {
+        size_t sides = std::min<size_t>(256, std::max<size_t>(3, faces));
+        out = fans(sides, faces / (sides + 1));
+    } else if (name == "soup") {
+        out = soup(faces, 3, 12);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+SkeletonDesc procedural::skeleton(size_t depth, size_t fanOut, const glm::vec3 &lo, const glm::vec3 &hi) {
+    fanOut = std::max<size_t>(fanOut, 1);
+    glm::vec3 extent = hi - lo;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+    int across = axis == 0 ? (extent.y >= extent.z ? 1 : 2) : axis == 1 ? (extent.x >= extent.z ? 0 : 2)
+                                                                        : (extent.x >= extent.y ? 0 : 1);
+
+    std::vector<size_t> levelStart = {0};
+    size_t width = 1;
+    for (size_t level = 0; level <= depth; level++) {
+        levelStart.push_back(levelStart.back() + width);
+        width *= fanOut;
+    }
+    size_t n = levelStart.back();
+
+    SkeletonDesc desc;
+    desc.names.resize(n);
+    desc.parents.resize(n);
+    desc.pos.resize(n);
+    desc.rot.assign(n, glm::quat(1.f, 0.f, 0.f, 0.f));
+    // World positions; the description keeps them relative to the parent.
+    std::vector<glm::vec3> world(n);
+    width = 1;
+    for (size_t level = 0; level <= depth; level++) {
+        size_t start = levelStart[level];
+        parallelFor(width, 4096, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                size_t j = start + k;
+                glm::vec3 p = lo + extent * 0.5f;
+                p[axis] = lo[axis] + extent[axis] * (k + 0.5f) / width;
+                // Levels step across the second axis so bones have length.
+                p[across] = lo[across] + extent[across] * (level + 1.f) / (depth + 2.f);
+                world[j] = p;
+                if (level == 0) {
+                    desc.parents[j] = -1;
+                    desc.pos[j] = p;
+                } else {
+                    size_t parent = levelStart[level - 1] + k / fanOut;
+                    desc.parents[j] = int(parent);
+                    desc.pos[j] = p - world[parent];
+                }
+                desc.names[j] = "joint_" + std::to_string(level) + "_" + std::to_string(k);
+            }
+        });
+        width *= fanOut;
+    }
+    return desc;
+}
+
+SkeletonDesc procedural::skeleton(const PolygonList &mesh, size_t depth, size_t fanOut) {
+    glm::vec3 lo(0.f), hi(0.f);
+    if (!mesh.positions.empty()) {
+        lo = hi = mesh.positions[0];
+        for (const glm::vec3 &p : mesh.positions) {
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+    }
+    return skeleton(depth, fanOut, lo, hi);
+}
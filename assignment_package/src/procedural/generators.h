@@ -0,0 +1,60 @@
+#ifndef GENERATORS_H
+#define GENERATORS_H
+
+#include "halfedgemesh.h"
+#include "skeletonio.h"
+#include <la.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Polygons by index, in the layout HalfEdgeMesh::buildFromPolygons takes.
+// Face i runs through indices[faceStarts[i]] up to indices[faceStarts[i + 1]].
+struct PolygonList {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> faceStarts;
+    std::vector<uint32_t> indices;
+
+    size_t faceCount() const;
+    // Builds m from these polygons, replacing what it held.
+    bool build(HalfEdgeMesh &m) const;
+};
+
+// Meshes and skeletons made in memory for scaling tests. Every generator
+// fills its arrays in parallel, and sizes are limited only by 32 bit
+// indices, so meshes run to hundreds of millions of half-edges.
+// Faces are counter-clockwise seen from outside.
+namespace procedural {
+    // A w by h grid of quads in the unit square of the XZ plane. If
+    // holeEvery is 2 or more, one quad in every holeEvery by holeEvery
+    // block is left out, giving the mesh inner boundaries as well.
+    PolygonList grid(size_t w, size_t h, size_t holeEvery = 0);
+    // A closed torus of w quads around the ring and h around the tube.
+    PolygonList torus(size_t w, size_t h);
+    // A closed unit sphere: triangle fans at the poles, quads between.
+    // rings is at least 2 and segments at least 3.
+    PolygonList uvSphere(size_t segments, size_t rings);
+    // count closed fans in a row. Each is a hub vertex of valence sides
+    // with a triangle to every edge of its rim, capped by one n-gon.
+    PolygonList fans(size_t sides, size_t count);
+    // count unconnected polygons of minSides to maxSides corners, of
+    // random size and facing, scattered through the unit cube. The same
+    // seed gives the same soup at any thread count.
+    PolygonList soup(size_t count, size_t minSides, size_t maxSides, uint32_t seed = 1);
+
+    // The shapes above by name, "grid", "holes", "torus", "sphere", "fans"
+    // or "soup", sized to about faces faces. False for an unknown name.
+    bool shape(const std::string &name, size_t faces, PolygonList &out);
+    // The names shape() knows, separated by spaces.
+    const char* shapeNames();
+
+    // A tree of joints depth levels below the root, each joint with
+    // fanOut children. Level L spreads its fanOut^L joints along the
+    // longest axis of the box from lo to hi, so every level covers the
+    // whole box. Joints are listed level by level, parents first.
+    SkeletonDesc skeleton(size_t depth, size_t fanOut, const glm::vec3 &lo, const glm::vec3 &hi);
+    // A skeleton fitted to the bounds of mesh.
+    SkeletonDesc skeleton(const PolygonList &mesh, size_t depth, size_t fanOut);
+}
+
+#endif // GENERATORS_H
@@ -0,0 +1,67 @@
+// Replaces the global operator new and delete so that every allocation
+// of the process is counted by memstats, under the tag of the scope it
+// was made in. Built only with CONFIG+=heap_hooks; each block carries a
+// 16 byte header recording its size and tag.
+
+#include "profiling/memstats.h"
+#include <cstdint>
+#include <cstdlib>
+
+namespace {
+    struct alignas(16) Header {
+        size_t size;
+        uint32_t offset;    // From the start of the malloc block.
+        uint8_t tag;
+    };
+    static_assert(sizeof(Header) == 16, "blocks keep 16 byte alignment");
+
+    void* hookedAlloc(size_t size, size_t align) {
+        align = align < sizeof(Header) ? sizeof(Header) : align;
+        // Room for the header and for rounding up to the alignment.
+        unsigned char* base = static_cast<unsigned char*>(std::malloc(size + sizeof(Header) + align - 1));
+        if (base == nullptr) {
+            return nullptr;
+        }
+        uintptr_t user = (reinterpret_cast<uintptr_t>(base) + sizeof(Header) + align - 1) / align * align;
+        Header* h = reinterpret_cast<Header*>(user) - 1;
+        memstats::Tag tag = memstats::currentTag();
+        h->size = size;
+        h->offset = uint32_t(user - reinterpret_cast<uintptr_t>(base));
+        h->tag = uint8_t(tag);
+        memstats::allocated(tag, size);
+        return reinterpret_cast<void*>(user);
+    }
+
+    void hookedFree(void* p) noexcept {
+        if (p == nullptr) {
+            return;
+        }
+        Header* h = static_cast<Header*>(p) - 1;
+        memstats::freed(memstats::Tag(h->tag), h->size);
+        std::free(static_cast<unsigned char*>(p) - h->offset);
+    }
+
+    void* hookedNew(size_t size, size_t align) {
+        if (void* p = hookedAlloc(size, align)) {
+            return p;
+        }
+        throw std::bad_alloc();
+    }
+
+    const bool installed = (memstats::detail::setHooksInstalled(), true);
+}
+
+void* operator new(size_t size) { return hookedNew(size, 16); }
+void* operator new[](size_t size) { return hookedNew(size, 16); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return hookedAlloc(size, 16); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return hookedAlloc(size, 16); }
+void* operator new(size_t size, std::align_val_t align) { return hookedNew(size, size_t(align)); }
+void* operator new[](size_t size, std::align_val_t align) { return hookedNew(size, size_t(align)); }
+void operator delete(void* p) noexcept { hookedFree(p); }
+void operator delete[](void* p) noexcept { hookedFree(p); }
+void operator delete(void* p, size_t) noexcept { hookedFree(p); }
+void operator delete[](void* p, size_t) noexcept { hookedFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { hookedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { hookedFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { hookedFree(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { hookedFree(p); }
@@ -0,0 +1,141 @@
+#include "profiling/memstats.h"
+#include <atomic>
+#include <cstdio>
+
+namespace {
+    // One cache line per tag, so threads filling different
+    // subsystems do not contend.
+    struct alignas(64) Slot {
+        std::atomic<size_t> current{0};
+        std::atomic<size_t> peak{0};
+        std::atomic<size_t> allocations{0};
+        std::atomic<size_t> total{0};
+    };
+
+    Slot slots[memstats::TAG_COUNT];
+    Slot sum;
+
+    bool hooked = false;
+    thread_local memstats::Tag t_tag = memstats::Tag::OTHER;
+
+    void raisePeak(Slot &s, size_t now) {
+        size_t peak = s.peak.load(std::memory_order_relaxed);
+        while (now > peak && !s.peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+        }
+    }
+
+    void add(Slot &s, size_t bytes, size_t allocations) {
+        size_t now = s.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        s.allocations.fetch_add(allocations, std::memory_order_relaxed);
+        s.total.fetch_add(bytes, std::memory_order_relaxed);
+        raisePeak(s, now);
+    }
+
+    memstats::Counters read(const Slot &s) {
+        return { s.current.load(std::memory_order_relaxed), s.peak.load(std::memory_order_relaxed),
+                 s.allocations.load(std::memory_order_relaxed), s.total.load(std::memory_order_relaxed) };
+    }
+}
+
+const char* memstats::tagName(Tag tag) {
+    static const char* names[TAG_COUNT] = {
+        "other", "vertices", "half-edges", "faces", "list items", "topology maps",
+        "render buffers", "gpu staging", "bvh", "skinning", "history"
+    };
+    return size_t(tag) < TAG_COUNT ? names[size_t(tag)] : "?";
+}
+
+memstats::Counters memstats::counters(Tag tag) {
+    return read(slots[size_t(tag)]);
+}
+
+memstats::Counters memstats::totals() {
+    return read(sum);
+}
+
+void memstats::resetPeaks() {
+    for (Slot &s : slots) {
+        s.peak.store(s.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    sum.peak.store(sum.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+std::string memstats::report() {
+    std::string out;
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-15s %10s %10s %12s\n", "memory", "now MB", "peak MB", "allocations");
+    out += line;
+    auto row = [&line, &out](const char* name, const Counters &c) {
+        std::snprintf(line, sizeof(line), "%-15s %10.2f %10.2f %12zu\n", name,
+                      c.current / double(1 << 20), c.peak / double(1 << 20), c.allocations);
+        out += line;
+    };
+    for (size_t i = 0; i < TAG_COUNT; i++) {
+        Counters c = counters(Tag(i));
+        if (c.allocations > 0) {
+            row(tagName(Tag(i)), c);
+        }
+    }
+    row("total", totals());
+    return out;
+}
+
+bool memstats::hooksInstalled() {
+    return hooked;
+}
+
+void memstats::detail::setHooksInstalled() {
+    hooked = true;
+}
+
+void memstats::allocated(Tag tag, size_t bytes) {
+    add(slots[size_t(tag)], bytes, 1);
+    add(sum, bytes, 1);
+}
+
+void memstats::freed(Tag tag, size_t bytes) {
+    slots[size_t(tag)].current.fetch_sub(bytes, std::memory_order_relaxed);
+    sum.current.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void memstats::transfer(Tag from, Tag to, size_t bytes) {
+    if (bytes == 0 || from == to) {
+        return;
+    }
+    slots[size_t(from)].current.fetch_sub(bytes, std::memory_order_relaxed);
+    Slot &s = slots[size_t(to)];
+    raisePeak(s, s.current.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void* memstats::allocate(Tag tag, size_t bytes) {
+    // The hooks count whatever is allocated under the current tag.
+    if (hooked) {
+        Scope scope(tag);
+        return ::operator new(bytes);
+    }
+    void* p = ::operator new(bytes);
+    allocated(tag, bytes);
+    return p;
+}
+
+void memstats::deallocate(Tag tag, void* p, size_t bytes) {
+    if (p == nullptr) {
+        return;
+    }
+    if (!hooked) {
+        freed(tag, bytes);
+    }
+    ::operator delete(p);
+}
+
+memstats::Tag memstats::currentTag() {
+    return t_tag;
+}
+
+memstats::Scope::Scope(Tag tag) : previous(t_tag) {
+    t_tag = tag;
+}
+
+memstats::Scope::~Scope() {
+    t_tag = previous;
+}
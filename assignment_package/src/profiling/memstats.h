@@ -0,0 +1,122 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+
+// Heap use by subsystem, for telling where a mesh's memory goes and for
+// holding assets to a budget. Every tag keeps the bytes it holds now,
+// its peak since the last resetPeaks(), and how many allocations and
+// bytes it has made in all.
+//
+// Mesh components, the hash maps of subdivision and loading, and the
+// staging arrays of Mesh::create count themselves through the operators
+// and allocator below. Building with CONFIG+=heap_hooks also replaces
+// the global operator new, so every other allocation, Qt's included,
+// counts too: under the tag of the innermost MEMORY_SCOPE of its thread,
+// or OTHER outside any.
+namespace memstats {
+    enum class Tag : uint8_t {
+        OTHER,
+        VERTICES,
+        HALF_EDGES,
+        FACES,
+        LIST_ITEMS,         // The QListWidgetItem part of components, and Qt's own.
+        TOPOLOGY_MAPS,      // ENDPT_MAP, CENTROID_MAP, VPTR_SET and Loop tables.
+        RENDER_BUFFERS,     // Index buffers and vertex sources kept by Mesh.
+        GPU_STAGING,        // Arrays Mesh::create fills before uploading.
+        BVH,
+        SKINNING,
+        HISTORY,
+        COUNT
+    };
+    const size_t TAG_COUNT = size_t(Tag::COUNT);
+
+    const char* tagName(Tag tag);
+
+    struct Counters {
+        size_t current;     // Bytes held now.
+        size_t peak;        // Most bytes held since the last resetPeaks().
+        size_t allocations; // Allocations ever made.
+        size_t total;       // Bytes ever allocated.
+    };
+
+    Counters counters(Tag tag);
+    // Every tag added up. The peak is of the sum, not a sum of peaks.
+    Counters totals();
+    // Starts new peaks from what is held now.
+    void resetPeaks();
+    // One line per tag that has allocated anything, plus a total.
+    std::string report();
+
+    // Whether the global operator new counts allocations itself.
+    bool hooksInstalled();
+
+    // Bookkeeping for memory obtained some other way.
+    void allocated(Tag tag, size_t bytes);
+    void freed(Tag tag, size_t bytes);
+    // Moves bytes already counted under one tag to another.
+    void transfer(Tag from, Tag to, size_t bytes);
+
+    // operator new and delete, counted under tag.
+    void* allocate(Tag tag, size_t bytes);
+    void deallocate(Tag tag, void* p, size_t bytes);
+
+    // The tag heap hooks charge the calling thread's allocations to.
+    Tag currentTag();
+
+    class Scope {
+    private:
+        Tag previous;
+
+    public:
+        explicit Scope(Tag tag);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // A standard allocator that counts under TAG.
+    template<typename T, Tag TAG>
+    struct Allocator {
+        typedef T value_type;
+
+        Allocator() = default;
+        template<typename U>
+        Allocator(const Allocator<U, TAG>&) {}
+
+        template<typename U>
+        struct rebind {
+            typedef Allocator<U, TAG> other;
+        };
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(memstats::allocate(TAG, n * sizeof(T)));
+        }
+        void deallocate(T* p, size_t n) {
+            memstats::deallocate(TAG, p, n * sizeof(T));
+        }
+
+        template<typename U>
+        bool operator==(const Allocator<U, TAG>&) const { return true; }
+        template<typename U>
+        bool operator!=(const Allocator<U, TAG>&) const { return false; }
+    };
+
+    template<typename T, Tag TAG>
+    using Vector = std::vector<T, Allocator<T, TAG>>;
+
+    namespace detail {
+        // Called by the heap hooks as they install themselves.
+        void setHooksInstalled();
+    }
+}
+
+#define MEMORY_SCOPE_CONCAT_INNER(a, b) a##b
+#define MEMORY_SCOPE_CONCAT(a, b) MEMORY_SCOPE_CONCAT_INNER(a, b)
+#define MEMORY_SCOPE(tag) memstats::Scope MEMORY_SCOPE_CONCAT(memoryScope, __LINE__)(memstats::Tag::tag)
+
+#endif // MEMSTATS_H
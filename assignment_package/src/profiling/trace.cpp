@@ -0,0 +1,189 @@
+#include "profiling/trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> trace::detail::enabled{false};
+
+namespace {
+    // Spans kept per thread; older ones are overwritten.
+    const uint64_t CAPACITY = 1 << 15;
+
+    // Slots are written by their thread while an export may read them,
+    // so every field is atomic. Relaxed access compiles to plain moves.
+    struct Slot {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> start{0};
+        std::atomic<uint64_t> end{0};
+    };
+
+    struct ThreadBuffer {
+        uint32_t tid;
+        std::string name;                   // Guarded by the registry lock.
+        std::unique_ptr<Slot[]> slots{new Slot[CAPACITY]};
+        std::atomic<uint64_t> written{0};   // Spans ever recorded.
+        std::atomic<uint64_t> cleared{0};   // Spans before this are forgotten.
+    };
+
+    // Buffers outlive their threads, so spans of finished jobs still export.
+    struct Registry {
+        std::mutex lock;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    };
+
+    Registry& registry() {
+        static Registry r;
+        return r;
+    }
+
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    thread_local ThreadBuffer* t_buffer = nullptr;
+    // Kept apart from the buffer so naming a thread that never records
+    // allocates nothing.
+    thread_local std::string t_name;
+
+    ThreadBuffer* threadBuffer() {
+        if (t_buffer == nullptr) {
+            Registry &r = registry();
+            std::lock_guard<std::mutex> guard(r.lock);
+            r.buffers.push_back(std::make_unique<ThreadBuffer>());
+            t_buffer = r.buffers.back().get();
+            t_buffer->tid = uint32_t(r.buffers.size());
+            t_buffer->name = t_name.empty() ? "thread " + std::to_string(t_buffer->tid) : t_name;
+        }
+        return t_buffer;
+    }
+
+    struct Event {
+        const char* name;
+        uint64_t start, end;
+    };
+
+    // The spans of b still in its ring, oldest first.
+    std::vector<Event> snapshot(const ThreadBuffer &b) {
+        uint64_t last = b.written.load(std::memory_order_acquire);
+        uint64_t first = std::max(b.cleared.load(std::memory_order_relaxed),
+                                  last > CAPACITY ? last - CAPACITY : 0);
+        std::vector<Event> events;
+        events.reserve(last - std::min(first, last));
+        for (uint64_t i = first; i < last; i++) {
+            const Slot &s = b.slots[i % CAPACITY];
+            events.push_back({s.name.load(std::memory_order_relaxed),
+                              s.start.load(std::memory_order_relaxed),
+                              s.end.load(std::memory_order_relaxed)});
+        }
+        // Drop slots the thread may have reused while they were copied.
+        uint64_t now = b.written.load(std::memory_order_acquire);
+        if (now > CAPACITY && now - CAPACITY > first) {
+            size_t stale = size_t(std::min(now - CAPACITY, last) - first);
+            events.erase(events.begin(), events.begin() + stale);
+        }
+        return events;
+    }
+
+    void writeEscaped(std::ofstream &out, const std::string &s) {
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                out << '\\';
+            }
+            out << (c < ' ' ? ' ' : c);
+        }
+    }
+}
+
+void trace::setEnabled(bool on) {
+    detail::enabled.store(on, std::memory_order_relaxed);
+}
+
+uint64_t trace::now() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - epoch).count());
+}
+
+void trace::record(const char* name, uint64_t start, uint64_t end) {
+    ThreadBuffer* b = threadBuffer();
+    uint64_t i = b->written.load(std::memory_order_relaxed);
+    Slot &s = b->slots[i % CAPACITY];
+    s.name.store(name, std::memory_order_relaxed);
+    s.start.store(start, std::memory_order_relaxed);
+    s.end.store(end, std::memory_order_relaxed);
+    b->written.store(i + 1, std::memory_order_release);
+}
+
+void trace::setThreadName(const std::string &name) {
+    t_name = name;
+    if (t_buffer != nullptr) {
+        std::lock_guard<std::mutex> guard(registry().lock);
+        t_buffer->name = name;
+    }
+}
+
+void trace::clear() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    for (auto const &b : r.buffers) {
+        b->cleared.store(b->written.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+size_t trace::eventCount() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    size_t count = 0;
+    for (auto const &b : r.buffers) {
+        uint64_t last = b->written.load(std::memory_order_acquire);
+        uint64_t first = std::max(b->cleared.load(std::memory_order_relaxed),
+                                  last > CAPACITY ? last - CAPACITY : 0);
+        count += size_t(last - std::min(first, last));
+    }
+    return count;
+}
+
+bool trace::writeChromeJSON(const std::string &path, std::string* error) {
+    std::ofstream out(path);
+    if (!out) {
+        if (error != nullptr) {
+            *error = "cannot open " + path;
+        }
+        return false;
+    }
+
+    Registry &r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    // Timestamps are in microseconds; three decimals keep nanoseconds.
+    char number[32];
+    auto micros = [&number](uint64_t ns) {
+        std::snprintf(number, sizeof(number), "%llu.%03u",
+                      (unsigned long long)(ns / 1000), unsigned(ns % 1000));
+        return number;
+    };
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+    bool first = true;
+    for (auto const &b : r.buffers) {
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+            << b->tid << ", \"args\": {\"name\": \"";
+        writeEscaped(out, b->name);
+        out << "\"}}";
+        first = false;
+
+        for (const Event &e : snapshot(*b)) {
+            out << ",\n{\"name\": \"";
+            writeEscaped(out, e.name);
+            out << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << b->tid << ", \"ts\": " << micros(e.start);
+            out << ", \"dur\": " << micros(e.end - e.start) << "}";
+        }
+    }
+    out << "\n]}\n";
+    if (!out) {
+        if (error != nullptr) {
+            *error = "cannot write " + path;
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped trace markers for finding out which stage of a slow operation
+// took the time. TRACE_SCOPE("name") records the span from the marker
+// to the end of its block, with nanosecond timestamps, into a ring
+// buffer owned by the calling thread. Writing a span takes no lock and
+// no allocation; the buffers keep the latest spans of every thread and
+// export as Chrome trace JSON, which chrome://tracing and Perfetto open.
+//
+// Tracing starts disabled, and a disabled marker costs one relaxed load
+// and a branch. Building with MICROMAYA_NO_TRACE removes markers outright.
+// Names must outlive the trace; string literals are the intended use.
+namespace trace {
+    namespace detail {
+        extern std::atomic<bool> enabled;
+    }
+
+    inline bool enabled() {
+        return detail::enabled.load(std::memory_order_relaxed);
+    }
+    void setEnabled(bool on);
+
+    // Nanoseconds on a steady clock since the process started tracing code.
+    uint64_t now();
+    // Records a span on the calling thread's buffer.
+    void record(const char* name, uint64_t start, uint64_t end);
+    // Names the calling thread in exported traces. Cheap enough to call
+    // from every thread at startup, whether or not tracing is on.
+    void setThreadName(const std::string &name);
+
+    // Forgets every span recorded so far. Safe while other threads record.
+    void clear();
+    // The number of spans an export would write.
+    size_t eventCount();
+    // Writes the spans of every thread as Chrome trace JSON. Safe while
+    // other threads record; spans they overwrite meanwhile are left out.
+    bool writeChromeJSON(const std::string &path, std::string* error = nullptr);
+
+    class Scope {
+    private:
+        const char* name;
+        uint64_t start;
+
+    public:
+        explicit Scope(const char* name)
+            : name(enabled() ? name : nullptr), start(this->name != nullptr ? now() : 0) {}
+        ~Scope() {
+            if (name != nullptr) {
+                record(name, start, now());
+            }
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#ifdef MICROMAYA_NO_TRACE
+#define TRACE_SCOPE(name) ((void)0)
+#else
+#define TRACE_SCOPE(name) trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#endif
+
+#endif // TRACE_H
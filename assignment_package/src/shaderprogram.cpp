@@ -1,4 +1,5 @@
 #include "shaderprogram.h"
+#include "profiling/trace.h"
 #include <QFile>
 #include <QStringBuilder>
 #include <iostream>
@@ -9,7 +10,10 @@ ShaderProgram::ShaderProgram(OpenGLContext *context)
     : vertShader(), fragShader(), prog(),
       attrPos(-1), attrNor(-1), attrCol(-1),
 
-      attrJointWts(-1), attrJointIds(-1), unifBindMats(-1), unifOverallTMats(-1),
+      attrJointWts(-1), attrJointIds(-1), unifJointPalette(-1), unifJointCount(-1),
+      unifPosOffset(-1), unifPosScale(-1), unifOctNormals(-1), unifSmoothNormals(-1), unifFaceColors(-1), unifSkinned(-1),
+      unifFaceAttribs(-1), unifTriangleFaces(-1),
+      unifPickKind(-1), unifPickMode(-1), unifPickIndex(-1),
 
       unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifCamPos(-1),
       context(context)
@@ -17,6 +21,7 @@ ShaderProgram::ShaderProgram(OpenGLContext *context)
 
 void ShaderProgram::create(const char *vertfile, const char *fragfile)
 {
+    TRACE_SCOPE("ShaderProgram::create");
     // Allocate space on our GPU for a vertex shader and a fragment shader and a shader program to manage the two
     vertShader = context->glCreateShader(GL_VERTEX_SHADER);
     fragShader = context->glCreateShader(GL_FRAGMENT_SHADER);
@@ -35,29 +40,36 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     context->glShaderSource(vertShader, 1, &vertSource, 0);
     context->glShaderSource(fragShader, 1, &fragSource, 0);
     // Tell OpenGL to compile the shader text stored above
-    context->glCompileShader(vertShader);
-    context->glCompileShader(fragShader);
-    // Check if everything compiled OK
+    // Drivers may compile lazily, so the status queries are traced too.
     GLint compiled;
-    context->glGetShaderiv(vertShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        printShaderInfoLog(vertShader);
-    }
-    context->glGetShaderiv(fragShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        printShaderInfoLog(fragShader);
+    {
+        TRACE_SCOPE("ShaderProgram::create: compile");
+        context->glCompileShader(vertShader);
+        context->glCompileShader(fragShader);
+        // Check if everything compiled OK
+        context->glGetShaderiv(vertShader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            printShaderInfoLog(vertShader);
+        }
+        context->glGetShaderiv(fragShader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            printShaderInfoLog(fragShader);
+        }
     }
 
     // Tell prog that it manages these particular vertex and fragment shaders
     context->glAttachShader(prog, vertShader);
     context->glAttachShader(prog, fragShader);
-    context->glLinkProgram(prog);
-
-    // Check for linking success
     GLint linked;
-    context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
-    if (!linked) {
-        printLinkInfoLog(prog);
+    {
+        TRACE_SCOPE("ShaderProgram::create: link");
+        context->glLinkProgram(prog);
+
+        // Check for linking success
+        context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            printLinkInfoLog(prog);
+        }
     }
 
     // Get the handles to the variables stored in our shaders
@@ -70,8 +82,22 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     attrJointWts = context->glGetAttribLocation(prog, "jointWts");
     attrJointIds = context->glGetAttribLocation(prog, "jointIDs");
 
-    unifBindMats     = context->glGetUniformLocation(prog, "bindMats");
-    unifOverallTMats = context->glGetUniformLocation(prog, "overallTMats");
+    unifJointPalette = context->glGetUniformLocation(prog, "u_JointPalette");
+    unifJointCount = context->glGetUniformLocation(prog, "u_JointCount");
+
+    unifPosOffset  = context->glGetUniformLocation(prog, "u_PosOffset");
+    unifPosScale   = context->glGetUniformLocation(prog, "u_PosScale");
+    unifOctNormals = context->glGetUniformLocation(prog, "u_OctNormals");
+    unifSmoothNormals = context->glGetUniformLocation(prog, "u_SmoothNormals");
+    unifFaceColors = context->glGetUniformLocation(prog, "u_FaceColors");
+    unifSkinned    = context->glGetUniformLocation(prog, "u_Skinned");
+
+    unifFaceAttribs   = context->glGetUniformLocation(prog, "u_FaceAttribs");
+    unifTriangleFaces = context->glGetUniformLocation(prog, "u_TriangleFaces");
+
+    unifPickKind  = context->glGetUniformLocation(prog, "u_PickKind");
+    unifPickMode  = context->glGetUniformLocation(prog, "u_PickMode");
+    unifPickIndex = context->glGetUniformLocation(prog, "u_PickIndex");
 
     unifModel      = context->glGetUniformLocation(prog, "u_Model");
     unifModelInvTr = context->glGetUniformLocation(prog, "u_ModelInvTr");
@@ -142,28 +168,61 @@ void ShaderProgram::setCamPos(glm::vec3 pos)
     }
 }
 
-void ShaderProgram::setBindMats(const glm::mat4 bindMats[30])
+void ShaderProgram::setJointPalette(int textureUnit)
 {
     useMe();
 
-    if(unifBindMats != -1)
+    if(unifJointPalette != -1)
     {
-        context->glUniformMatrix4fv(unifBindMats, 30, GL_FALSE, glm::value_ptr(bindMats[0]));
+        context->glUniform1i(unifJointPalette, textureUnit);
     }
 }
 
-void ShaderProgram::setOverallTMats(const glm::mat4 overallTMats[30])
+//Sets the number of joints in each instance's palette
+void ShaderProgram::setJointCount(int count)
 {
     useMe();
 
-    if(unifOverallTMats != -1)
+    if(unifJointCount != -1)
     {
-        context->glUniformMatrix4fv(unifOverallTMats, 30, GL_FALSE, glm::value_ptr(overallTMats[0]));
+        context->glUniform1i(unifJointCount, count);
+    }
+}
+
+void ShaderProgram::setFaceAttributes(int faceUnit, int triangleUnit)
+{
+    useMe();
+
+    if(unifFaceAttribs != -1)
+    {
+        context->glUniform1i(unifFaceAttribs, faceUnit);
+    }
+    if(unifTriangleFaces != -1)
+    {
+        context->glUniform1i(unifTriangleFaces, triangleUnit);
+    }
+}
+
+void ShaderProgram::setPick(unsigned kind, int mode, int index)
+{
+    useMe();
+
+    if(unifPickKind != -1)
+    {
+        context->glUniform1ui(unifPickKind, kind);
+    }
+    if(unifPickMode != -1)
+    {
+        context->glUniform1i(unifPickMode, mode);
+    }
+    if(unifPickIndex != -1)
+    {
+        context->glUniform1i(unifPickIndex, index);
     }
 }
 
 //This function, as its name implies, uses the passed in GL widget
-void ShaderProgram::draw(Drawable &d)
+void ShaderProgram::draw(Drawable &d, int instanceCount)
 {
     if(d.elemCount() < 0) {
         throw std::invalid_argument(
@@ -171,6 +230,61 @@ void ShaderProgram::draw(Drawable &d)
         );
     }
     useMe();
+    bindAttributes(d);
+
+    // Bind the index buffer and then draw shapes from it.
+    // This invokes the shader program, which accesses the vertex buffers.
+    d.bindIdx();
+    if (instanceCount > 1) {
+        context->glDrawElementsInstanced(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0, instanceCount);
+    } else {
+        context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
+    }
+
+    releaseAttributes();
+    context->printGLErrorLog();
+}
+
+void ShaderProgram::drawElements(Drawable &d, GLenum mode, GLuint indexBuffer, int count)
+{
+    useMe();
+    bindAttributes(d);
+    context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    context->glDrawElements(mode, count, GL_UNSIGNED_INT, 0);
+    releaseAttributes();
+    context->printGLErrorLog();
+}
+
+void ShaderProgram::drawArrays(Drawable &d, GLenum mode, int count)
+{
+    useMe();
+    bindAttributes(d);
+    context->glDrawArrays(mode, 0, count);
+    releaseAttributes();
+    context->printGLErrorLog();
+}
+
+void ShaderProgram::bindAttributes(Drawable &d)
+{
+    // Tell the shader how the Drawable packed its positions and normals.
+    if (unifPosOffset != -1) {
+        context->glUniform3fv(unifPosOffset, 1, &d.posOffset[0]);
+    }
+    if (unifPosScale != -1) {
+        context->glUniform3fv(unifPosScale, 1, &d.posScale[0]);
+    }
+    if (unifOctNormals != -1) {
+        context->glUniform1i(unifOctNormals, d.octNormals);
+    }
+    if (unifSmoothNormals != -1) {
+        context->glUniform1i(unifSmoothNormals, d.smoothNormals);
+    }
+    if (unifFaceColors != -1) {
+        context->glUniform1i(unifFaceColors, d.faceColors);
+    }
+    if (unifSkinned != -1) {
+        context->glUniform1i(unifSkinned, d.wtsBound && d.IDsBound);
+    }
 
     // Each of the following blocks checks that:
     //   * This shader has this attribute, and
@@ -183,42 +297,38 @@ void ShaderProgram::draw(Drawable &d)
         // (referred to by attrPos) with that VBO
     if (attrPos != -1 && d.bindPos()) {
         context->glEnableVertexAttribArray(attrPos);
-        context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, nullptr);
+        context->glVertexAttribPointer(attrPos, d.posFormat.size, d.posFormat.type, d.posFormat.normalized, 0, nullptr);
     }
 
     if (attrNor != -1 && d.bindNor()) {
         context->glEnableVertexAttribArray(attrNor);
-        context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, nullptr);
+        context->glVertexAttribPointer(attrNor, d.norFormat.size, d.norFormat.type, d.norFormat.normalized, 0, nullptr);
     }
 
     if (attrCol != -1 && d.bindCol()) {
         context->glEnableVertexAttribArray(attrCol);
-        context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, 0, nullptr);
+        context->glVertexAttribPointer(attrCol, d.colFormat.size, d.colFormat.type, d.colFormat.normalized, 0, nullptr);
     }
 
     if (attrJointWts != -1 && d.bindWts()) {
         context->glEnableVertexAttribArray(attrJointWts);
-        context->glVertexAttribPointer(attrJointWts, 2, GL_FLOAT, false, 0, nullptr);
+        context->glVertexAttribPointer(attrJointWts, d.wtsFormat.size, d.wtsFormat.type, d.wtsFormat.normalized, 0, nullptr);
     }
 
     if (attrJointIds != -1 && d.bindIDs()) {
         context->glEnableVertexAttribArray(attrJointIds);
-        context->glVertexAttribIPointer(attrJointIds, 2, GL_INT, 0, nullptr);
+        context->glVertexAttribIPointer(attrJointIds, d.IDsFormat.size, d.IDsFormat.type, 0, nullptr);
     }
+}
 
-    // Bind the index buffer and then draw shapes from it.
-    // This invokes the shader program, which accesses the vertex buffers.
-    d.bindIdx();
-    context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
-
+void ShaderProgram::releaseAttributes()
+{
     if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
     if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
     if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
 
     if (attrJointWts != -1) context->glDisableVertexAttribArray(attrJointWts);
     if (attrJointIds != -1) context->glDisableVertexAttribArray(attrJointIds);
-
-    context->printGLErrorLog();
 }
 
 char* ShaderProgram::textFileRead(const char* fileName) {
@@ -22,8 +22,22 @@ public:
     int attrJointWts;   // A handle for the "in" vec2 representing joint weights.
     int attrJointIds;
 
-    int unifBindMats;   // A handle for the "uniform" mat4s representing the bind matrices of each joint.
-    int unifOverallTMats;
+    int unifJointPalette; // A handle for the "uniform" samplerBuffer holding each joint's skinning matrix.
+    int unifJointCount; // A handle for the "uniform" int holding the number of joints per instance palette.
+
+    int unifPosOffset;  // Handles for the "uniform"s that decode the Drawable's
+    int unifPosScale;   // positions and normals, set from the Drawable on draw.
+    int unifOctNormals;
+    int unifSmoothNormals;
+    int unifFaceColors;
+    int unifSkinned;
+
+    int unifFaceAttribs;    // Handles for the "uniform" usamplerBuffers holding per-face
+    int unifTriangleFaces;  // attributes and the face of every triangle.
+
+    int unifPickKind;   // Handles for the "uniform"s of the ID pass
+    int unifPickMode;   // that say what the pixels drawn name.
+    int unifPickIndex;
 
     int unifModel; // A handle for the "uniform" mat4 representing model matrix in the vertex shader
     int unifModelInvTr; // A handle for the "uniform" mat4 representing inverse transpose of the model matrix in the vertex shader
@@ -43,13 +57,23 @@ public:
     // Pass the given color to this shader on the GPU
     void setCamPos(glm::vec3 pos);
 
-    // Pass the given set of bind matrices
-    // and overall transformation matrices to the shader.
-    void setBindMats(const glm::mat4 bindMats[30]);
-    void setOverallTMats(const glm::mat4 overallTMats[30]);
+    // Tell the shader which texture unit the joint palette is bound to.
+    void setJointPalette(int textureUnit);
+    // Tell the shader how many palette entries belong to each instance.
+    void setJointCount(int count);
+    // Tell the shader which texture units hold the face attributes
+    // and the face of every triangle.
+    void setFaceAttributes(int faceUnit, int triangleUnit);
+    // Tell the ID pass what kind of element is drawn next and where
+    // its index comes from (see pick.frag.glsl).
+    void setPick(unsigned kind, int mode, int index = 0);
 
-    // Draw the given object to our screen using this ShaderProgram's shaders
-    void draw(Drawable &d);
+    // Draw the given object to our screen using this ShaderProgram's shaders.
+    // With instanceCount > 1 the object is drawn that many times in one call.
+    void draw(Drawable &d, int instanceCount = 1);
+    // Draw the Drawable's vertices with another index buffer or none at all.
+    void drawElements(Drawable &d, GLenum mode, GLuint indexBuffer, int count);
+    void drawArrays(Drawable &d, GLenum mode, int count);
     // Utility function used in create()
     char* textFileRead(const char*);
     // Utility function that prints any shader compilation errors to the console
@@ -60,6 +84,10 @@ public:
     QString qTextFileRead(const char*);
 
 private:
+    // Point this shader's attributes at the Drawable's VBOs / undo that.
+    void bindAttributes(Drawable &d);
+    void releaseAttributes();
+
     OpenGLContext* context;   // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                             // we need to pass our OpenGL context to the Drawable in order to call GL functions
                             // from within this class.
@@ -0,0 +1,449 @@
+#include "skeletonio.h"
+#include "parsenumber.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+static const char BINARY_MAGIC[4] = { 'M', 'M', 'S', 'K' };
+static const uint32_t BINARY_VERSION = 1;
+
+//--------------------------------------------------
+// SkeletonDesc
+//--------------------------------------------------
+size_t SkeletonDesc::size() const {
+    return parents.size();
+}
+
+void SkeletonDesc::clear() {
+    names.clear();
+    parents.clear();
+    pos.clear();
+    rot.clear();
+}
+
+void SkeletonDesc::reserve(size_t n) {
+    names.reserve(n);
+    parents.reserve(n);
+    pos.reserve(n);
+    rot.reserve(n);
+}
+
+size_t SkeletonDesc::add(int parent) {
+    names.emplace_back();
+    parents.push_back(parent);
+    pos.push_back(glm::vec3(0.f));
+    rot.push_back(glm::quat(1.f, 0.f, 0.f, 0.f));
+    return parents.size() - 1;
+}
+
+std::vector<glm::mat4> SkeletonDesc::worldTransforms() const {
+    std::vector<glm::mat4> world(size());
+    for (size_t i = 0; i < size(); i++) {
+        glm::mat4 local = glm::translate(glm::mat4(1.f), pos[i]) * glm::mat4_cast(rot[i]);
+        world[i] = parents[i] < 0 ? local : world[parents[i]] * local;
+    }
+    return world;
+}
+
+//--------------------------------------------------
+// JSON
+//--------------------------------------------------
+namespace {
+
+// A minimal pull parser over the text of a skeleton file.
+// It only understands as much JSON as the skeleton layout needs
+// and skips any other value without descending into it recursively.
+class JsonCursor {
+private:
+    const char* begin;
+    const char* p;
+    const char* end;
+
+public:
+    std::string error;
+
+    JsonCursor(const std::string &text)
+        : begin(text.data()), p(text.data()), end(text.data() + text.size()), error()
+    {}
+
+    bool fail(const std::string &msg) {
+        if (error.empty()) {
+            error = msg + " at offset " + std::to_string(p - begin);
+        }
+        return false;
+    }
+
+    char peek() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+            p++;
+        }
+        return p < end ? *p : '\0';
+    }
+
+    bool expect(char c) {
+        if (peek() != c) {
+            return fail(std::string("Expected '") + c + "'");
+        }
+        p++;
+        return true;
+    }
+
+    // Consumes c if it is next.
+    bool accept(char c) {
+        if (peek() == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    bool readString(std::string &out) {
+        if (!expect('"')) {
+            return false;
+        }
+        out.clear();
+        while (p < end && *p != '"') {
+            if (*p == '\\' && p + 1 < end) {
+                p++;
+                switch (*p) {
+                case 'n': out.push_back('\n'); break;
+                case 't': out.push_back('\t'); break;
+                case 'r': out.push_back('\r'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'u':
+                    // Names are expected to be ASCII; other code points become '?'.
+                    out.push_back('?');
+                    p += std::min<ptrdiff_t>(4, end - p - 1);
+                    break;
+                default: out.push_back(*p); break;
+                }
+            } else {
+                out.push_back(*p);
+            }
+            p++;
+        }
+        return expect('"');
+    }
+
+    bool readNumber(float &out) {
+        peek();
+        const char* numEnd = parseFloat(p, end, out);
+        if (numEnd == p) {
+            return fail("Expected a number");
+        }
+        p = numEnd;
+        return true;
+    }
+
+    // Reads an array of up to n numbers into out.
+    bool readNumbers(float* out, int n) {
+        if (!expect('[')) {
+            return false;
+        }
+        for (int i = 0; peek() != ']'; i++) {
+            if (i > 0 && !expect(',')) {
+                return false;
+            }
+            float v = 0.f;
+            if (!readNumber(v)) {
+                return false;
+            }
+            if (i < n) {
+                out[i] = v;
+            }
+        }
+        return expect(']');
+    }
+
+    // Skips one value of any type, counting brackets instead of recursing.
+    bool skipValue() {
+        int depth = 0;
+        do {
+            char c = peek();
+            if (c == '\0') {
+                return fail("Unexpected end of file");
+            } else if (c == '"') {
+                std::string ignored;
+                if (!readString(ignored)) {
+                    return false;
+                }
+            } else if (c == '{' || c == '[') {
+                depth++;
+                p++;
+            } else if (c == '}' || c == ']') {
+                depth--;
+                p++;
+            } else if (depth == 0) {
+                // A number or literal on its own runs up to what follows it.
+                while (p < end && std::strchr(",}] \t\n\r", *p) == nullptr) {
+                    p++;
+                }
+            } else {
+                // Numbers, literals, commas and colons.
+                p++;
+            }
+        } while (depth > 0);
+        return true;
+    }
+
+    // Upper bound on the number of objects in the text.
+    size_t countObjects() const {
+        size_t n = 0;
+        bool inString = false;
+        for (const char* c = p; c < end; c++) {
+            if (inString) {
+                if (*c == '\\') {
+                    c++;
+                } else if (*c == '"') {
+                    inString = false;
+                }
+            } else if (*c == '"') {
+                inString = true;
+            } else if (*c == '{') {
+                n++;
+            }
+        }
+        return n;
+    }
+};
+
+} // namespace
+
+bool skeletonio::readJSON(const std::string &text, SkeletonDesc &out, std::string *error) {
+    out.clear();
+    JsonCursor json(text);
+    out.reserve(json.countObjects());
+
+    // One entry per joint whose object is still open. inChildren is set
+    // while the joint's "children" array is being read.
+    struct Frame {
+        size_t joint;
+        bool inChildren;
+        bool first; // Nothing read yet at the current level.
+    };
+    std::vector<Frame> stack;
+
+    bool ok = json.expect('{');
+    bool foundRoot = false;
+    std::string key;
+    while (ok && !foundRoot && json.peek() != '}') {
+        if (!key.empty() && !json.expect(',')) {
+            ok = false;
+            break;
+        }
+        ok = json.readString(key) && json.expect(':');
+        if (!ok) {
+            break;
+        }
+        if (key != "root") {
+            ok = json.skipValue();
+            continue;
+        }
+        foundRoot = true;
+        ok = json.expect('{');
+        stack.push_back({ out.add(-1), false, true });
+
+        while (ok && !stack.empty()) {
+            Frame &f = stack.back();
+            if (f.inChildren) {
+                if (json.accept(']')) {
+                    // The array counts as read, so a ',' comes next.
+                    f.inChildren = false;
+                    f.first = false;
+                    continue;
+                }
+                if (!f.first && !json.expect(',')) {
+                    ok = false;
+                    break;
+                }
+                f.first = false;
+                ok = json.expect('{');
+                size_t child = out.add(static_cast<int>(f.joint));
+                stack.push_back({ child, false, true });
+                continue;
+            }
+
+            if (json.accept('}')) {
+                stack.pop_back();
+                if (!stack.empty()) {
+                    stack.back().first = false;
+                }
+                continue;
+            }
+            if (!f.first && !json.expect(',')) {
+                ok = false;
+                break;
+            }
+            f.first = false;
+            ok = json.readString(key) && json.expect(':');
+            if (!ok) {
+                break;
+            }
+
+            size_t j = f.joint;
+            if (key == "name") {
+                ok = json.readString(out.names[j]);
+            } else if (key == "pos") {
+                float v[3] = { 0.f, 0.f, 0.f };
+                ok = json.readNumbers(v, 3);
+                out.pos[j] = glm::vec3(v[0], v[1], v[2]);
+            } else if (key == "rot") {
+                float v[4] = { 0.f, 1.f, 0.f, 0.f };
+                ok = json.readNumbers(v, 4);
+                float half = glm::radians(v[0]) / 2.f;
+                float s = glm::sin(half);
+                out.rot[j] = glm::quat(glm::cos(half), v[1] * s, v[2] * s, v[3] * s);
+            } else if (key == "children") {
+                ok = json.expect('[');
+                f.inChildren = true;
+                f.first = true;
+            } else {
+                ok = json.skipValue();
+            }
+        }
+    }
+
+    if (ok && !foundRoot) {
+        json.fail("Missing \"root\"");
+        ok = false;
+    }
+    if (!ok && error != nullptr) {
+        *error = json.error;
+    }
+    return ok;
+}
+
+bool skeletonio::loadJSON(const std::string &path, SkeletonDesc &out, std::string *error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        if (error != nullptr) {
+            *error = "Cannot open " + path;
+        }
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    return readJSON(text.str(), out, error);
+}
+
+//--------------------------------------------------
+// Binary
+//--------------------------------------------------
+template<typename T>
+static bool readArray(std::ifstream &file, std::vector<T> &v, size_t n) {
+    v.resize(n);
+    file.read(reinterpret_cast<char*>(v.data()), n * sizeof(T));
+    return bool(file);
+}
+
+template<typename T>
+static void writeArray(std::ofstream &file, const std::vector<T> &v) {
+    file.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+}
+
+bool skeletonio::loadBinary(const std::string &path, SkeletonDesc &out, std::string *error) {
+    out.clear();
+    auto fail = [&](const std::string &msg) {
+        if (error != nullptr) {
+            *error = msg;
+        }
+        out.clear();
+        return false;
+    };
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return fail("Cannot open " + path);
+    }
+    char magic[4];
+    uint32_t version = 0, count = 0;
+    file.read(magic, 4);
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!file || std::memcmp(magic, BINARY_MAGIC, 4) != 0) {
+        return fail("Not a binary skeleton");
+    }
+    if (version != BINARY_VERSION) {
+        return fail("Unsupported skeleton version " + std::to_string(version));
+    }
+
+    // The counts come from the file, so they are checked against what
+    // it holds before anything is sized by them.
+    std::streamoff headerEnd = file.tellg();
+    file.seekg(0, std::ios::end);
+    uint64_t remaining = uint64_t(file.tellg() - headerEnd);
+    file.seekg(headerEnd);
+    const uint64_t jointBytes = sizeof(int32_t) + 7 * sizeof(float) + sizeof(uint32_t);
+    if (uint64_t(count) * jointBytes > remaining) {
+        return fail("Truncated skeleton");
+    }
+    remaining -= uint64_t(count) * jointBytes;
+
+    std::vector<int32_t> parents;
+    std::vector<float> pos, rot;
+    std::vector<uint32_t> nameLengths;
+    if (!readArray(file, parents, count) || !readArray(file, pos, 3 * size_t(count)) ||
+        !readArray(file, rot, 4 * size_t(count)) || !readArray(file, nameLengths, count)) {
+        return fail("Truncated skeleton");
+    }
+    for (uint32_t length : nameLengths) {
+        if (length > remaining) {
+            return fail("Truncated skeleton");
+        }
+        remaining -= length;
+    }
+
+    out.reserve(count);
+    std::string name;
+    for (uint32_t i = 0; i < count; i++) {
+        if (parents[i] >= static_cast<int32_t>(i) || (i > 0 && parents[i] < 0) ||
+            (i == 0 && parents[i] != -1)) {
+            return fail("Joint " + std::to_string(i) + " is not listed after its parent");
+        }
+        name.resize(nameLengths[i]);
+        file.read(&name[0], nameLengths[i]);
+        if (!file) {
+            return fail("Truncated skeleton");
+        }
+        size_t j = out.add(parents[i]);
+        out.names[j] = name;
+        out.pos[j] = glm::vec3(pos[3 * i], pos[3 * i + 1], pos[3 * i + 2]);
+        out.rot[j] = glm::quat(rot[4 * i], rot[4 * i + 1], rot[4 * i + 2], rot[4 * i + 3]);
+    }
+    return true;
+}
+
+bool skeletonio::saveBinary(const std::string &path, const SkeletonDesc &desc) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    size_t n = desc.size();
+    std::vector<int32_t> parents(desc.parents.begin(), desc.parents.end());
+    std::vector<float> pos, rot;
+    std::vector<uint32_t> nameLengths;
+    pos.reserve(3 * n);
+    rot.reserve(4 * n);
+    nameLengths.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        pos.insert(pos.end(), { desc.pos[i].x, desc.pos[i].y, desc.pos[i].z });
+        rot.insert(rot.end(), { desc.rot[i].w, desc.rot[i].x, desc.rot[i].y, desc.rot[i].z });
+        nameLengths.push_back(desc.names[i].size());
+    }
+
+    uint32_t version = BINARY_VERSION, count = n;
+    file.write(BINARY_MAGIC, 4);
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    writeArray(file, parents);
+    writeArray(file, pos);
+    writeArray(file, rot);
+    writeArray(file, nameLengths);
+    for (const std::string &name : desc.names) {
+        file.write(name.data(), name.size());
+    }
+    return bool(file);
+}
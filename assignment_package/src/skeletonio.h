@@ -0,0 +1,42 @@
+#ifndef SKELETONIO_H
+#define SKELETONIO_H
+
+#include <la.h>
+#include <string>
+#include <vector>
+
+// A flat description of a skeleton. Joints are stored parents first,
+// so a joint's index is also the id the loaded Joint receives.
+struct SkeletonDesc {
+    std::vector<std::string> names;
+    std::vector<int> parents;       // -1 for the root.
+    std::vector<glm::vec3> pos;     // Local translation.
+    std::vector<glm::quat> rot;     // Local rotation.
+
+    size_t size() const;
+    void clear();
+    void reserve(size_t n);
+    // Appends a joint with an empty name at the origin and returns its index.
+    size_t add(int parent);
+    // The world transform of every joint, which is its bind pose.
+    std::vector<glm::mat4> worldTransforms() const;
+};
+
+// Reading and writing skeletons without building any Joints.
+// Neither reader recurses, so hierarchies of any depth load in one pass.
+namespace skeletonio {
+    // Parses the {"root": {"name", "pos", "rot", "children"}} layout of the
+    // files in jsons/. "rot" is an angle in degrees followed by an axis.
+    bool readJSON(const std::string &text, SkeletonDesc &out, std::string *error);
+    bool loadJSON(const std::string &path, SkeletonDesc &out, std::string *error);
+
+    // The binary skeleton format: a header, then each attribute stored
+    // for every joint at once so loading is a handful of bulk reads.
+    //   char[4] "MMSK", uint32 version, uint32 jointCount,
+    //   int32 parents[n], float pos[3n], float rot[4n] (w, x, y, z),
+    //   uint32 nameLengths[n], then the name bytes back to back.
+    bool loadBinary(const std::string &path, SkeletonDesc &out, std::string *error);
+    bool saveBinary(const std::string &path, const SkeletonDesc &desc);
+}
+
+#endif // SKELETONIO_H
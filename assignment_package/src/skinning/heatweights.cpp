@@ -0,0 +1,355 @@
+#include "heatweights.h"
+#include "parallel.h"
+#include "profiling/memstats.h"
+#include "profiling/trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+//--------------------------------------------------
+// CsrMatrix
+//--------------------------------------------------
+size_t CsrMatrix::rows() const {
+    return rowStart.empty() ? 0 : rowStart.size() - 1;
+}
+
+//--------------------------------------------------
+// Assembly
+//--------------------------------------------------
+HeatWeights::Settings::Settings()
+    : tolerance(1e-4f), maxIterations(2000), heatConstant(1.f)
+{}
+
+namespace {
+
+struct Entry {
+    uint32_t row, col;
+    float val;
+};
+
+// Cotangent of the angle at a between b and c.
+float cotangent(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+    glm::vec3 u = b - a, v = c - a;
+    float s = glm::length(glm::cross(u, v));
+    return s > 1e-12f ? glm::dot(u, v) / s : 0.f;
+}
+
+// Distance from p to the segment ab.
+float segmentDistance(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b) {
+    glm::vec3 ab = b - a;
+    float len2 = glm::dot(ab, ab);
+    float t = len2 > 0.f ? glm::clamp(glm::dot(p - a, ab) / len2, 0.f, 1.f) : 0.f;
+    return glm::length(p - (a + t * ab));
+}
+
+} // namespace
+
+HeatWeights::HeatWeights(const std::vector<glm::vec3> &positions,
+                         const std::vector<uint32_t> &triangles)
+    : positions(positions), laplacian(), mass(positions.size(), 0.f), solveStats()
+{
+    TRACE_SCOPE("HeatWeights: assemble");
+    MEMORY_SCOPE(SKINNING);
+    auto start = Clock::now();
+    size_t n = positions.size();
+
+    // Every triangle adds half the cotangent of each corner to the edge
+    // opposite it. Duplicate edges are merged after sorting.
+    std::vector<Entry> entries;
+    entries.reserve(triangles.size() * 2);
+    for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+        uint32_t v[3] = { triangles[t], triangles[t + 1], triangles[t + 2] };
+        const glm::vec3 &a = positions[v[0]], &b = positions[v[1]], &c = positions[v[2]];
+        float area = glm::length(glm::cross(b - a, c - a)) / 2.f;
+        for (int k = 0; k < 3; k++) {
+            uint32_t i = v[(k + 1) % 3], j = v[(k + 2) % 3];
+            float w = cotangent(positions[v[k]], positions[i], positions[j]) / 2.f;
+            // Obtuse corners give negative weights, which break the
+            // maximum principle and let weights leave [0, 1].
+            w = std::max(w, 0.f);
+            entries.push_back({ i, j, w });
+            entries.push_back({ j, i, w });
+            mass[v[k]] += area / 3.f;
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.row != b.row ? a.row < b.row : a.col < b.col;
+    });
+
+    // L_ij = -w_ij, L_ii = sum of w_ij. The diagonal is stored first
+    // in each row so the solver can find it without searching.
+    laplacian.rowStart.assign(n + 1, 0);
+    laplacian.cols.reserve(entries.size() / 2 + n);
+    laplacian.vals.reserve(entries.size() / 2 + n);
+    size_t e = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        laplacian.rowStart[i] = laplacian.cols.size();
+        size_t diag = laplacian.cols.size();
+        laplacian.cols.push_back(i);
+        laplacian.vals.push_back(0.f);
+        for (; e < entries.size() && entries[e].row == i; e++) {
+            if (laplacian.cols.size() > diag + 1 && laplacian.cols.back() == entries[e].col) {
+                laplacian.vals.back() -= entries[e].val;
+            } else {
+                laplacian.cols.push_back(entries[e].col);
+                laplacian.vals.push_back(-entries[e].val);
+            }
+            laplacian.vals[diag] += entries[e].val;
+        }
+    }
+    laplacian.rowStart[n] = laplacian.cols.size();
+
+    solveStats.assembleMs = msSince(start);
+}
+
+//--------------------------------------------------
+// Solve
+//--------------------------------------------------
+SkinInfluences HeatWeights::solve(const std::vector<glm::vec3> &jointPos,
+                                  const std::vector<int> &parents,
+                                  const Settings &settings,
+                                  JobControl* control) {
+    TRACE_SCOPE("HeatWeights: solve");
+    MEMORY_SCOPE(SKINNING);
+    auto start = Clock::now();
+    size_t n = positions.size();
+    size_t joints = jointPos.size();
+
+    SkinInfluences result;
+    result.ids.assign(n, glm::ivec2(0));
+    result.weights.assign(n, glm::vec2(0.f));
+    solveStats.maxIterations = 0;
+    solveStats.unconverged = 0;
+    if (n == 0 || joints == 0) {
+        solveStats.solveMs = msSince(start);
+        return result;
+    }
+
+    std::vector<std::vector<uint32_t>> children(joints);
+    for (size_t j = 0; j < joints; j++) {
+        if (parents[j] >= 0) {
+            children[parents[j]].push_back(j);
+        }
+    }
+
+    // Nearest bone of every vertex and the screening term M H.
+    std::vector<uint32_t> nearest(n);
+    std::vector<float> heat(n);
+    parallelFor(n, 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            float best = INFINITY;
+            uint32_t bestJoint = 0;
+            for (size_t j = 0; j < joints; j++) {
+                float d = glm::length(positions[i] - jointPos[j]);
+                for (uint32_t c : children[j]) {
+                    d = std::min(d, segmentDistance(positions[i], jointPos[j], jointPos[c]));
+                }
+                if (d < best) {
+                    best = d;
+                    bestJoint = j;
+                }
+            }
+            nearest[i] = bestJoint;
+            best = std::max(best, 1e-4f);
+            heat[i] = mass[i] * settings.heatConstant / (best * best);
+        }
+    });
+
+    // Jacobi preconditioner of L + M H.
+    std::vector<float> invDiag(n);
+    for (size_t i = 0; i < n; i++) {
+        float d = laplacian.vals[laplacian.rowStart[i]] + heat[i];
+        invDiag[i] = d > 0.f ? 1.f / d : 1.f;
+    }
+
+    // Vertices grouped by nearest joint.
+    std::vector<uint32_t> bucketStart(joints + 1, 0), byJoint(n);
+    for (size_t i = 0; i < n; i++) {
+        bucketStart[nearest[i] + 1]++;
+    }
+    for (size_t j = 0; j < joints; j++) {
+        bucketStart[j + 1] += bucketStart[j];
+    }
+    std::vector<uint32_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+    for (size_t i = 0; i < n; i++) {
+        byJoint[fill[nearest[i]]++] = i;
+    }
+
+    std::mutex mergeLock;
+    std::atomic<size_t> jointsDone(0);
+    parallelFor(joints, 1, [&](size_t begin, size_t end) {
+        // Strongest two joints seen by this thread.
+        std::vector<glm::ivec2> ids(n, glm::ivec2(0));
+        std::vector<glm::vec2> weights(n, glm::vec2(0.f));
+        // Zero outside the current joint's region, so products with
+        // the full matrix only pick up values from inside it.
+        std::vector<float> x(n, 0.f), r(n, 0.f), z(n, 0.f), p(n, 0.f), ap(n, 0.f);
+        std::vector<uint32_t> region;
+        size_t maxIterations = 0, unconverged = 0;
+
+        for (size_t j = begin; j < end; j++) {
+            TRACE_SCOPE("HeatWeights: joint");
+            if (control != nullptr) {
+                if (control->isCancelled()) {
+                    break;
+                }
+                control->setProgress(float(jointsDone++) / joints);
+            }
+            // Heat from j's bones is absorbed by the bones around them,
+            // so j's weights are only solved where a joint at most two
+            // links from j in the skeleton owns the nearest bone, with
+            // w_j = 0 beyond.
+            region.clear();
+            auto addBucket = [&](size_t k) {
+                region.insert(region.end(), byJoint.begin() + bucketStart[k], byJoint.begin() + bucketStart[k + 1]);
+            };
+            addBucket(j);
+            for (uint32_t c : children[j]) {
+                addBucket(c);
+                for (uint32_t g : children[c]) {
+                    addBucket(g);
+                }
+            }
+            if (parents[j] >= 0) {
+                int pj = parents[j];
+                addBucket(pj);
+                if (parents[pj] >= 0) {
+                    addBucket(parents[pj]);
+                }
+                for (uint32_t s : children[pj]) {
+                    if (s != j) {
+                        addBucket(s);
+                    }
+                }
+            }
+
+            // Warm start from the nearest-bone indicator, which is
+            // already close to the solution away from bone boundaries.
+            double bNorm = 0.0;
+            for (uint32_t i : region) {
+                float b = nearest[i] == j ? heat[i] : 0.f;
+                x[i] = nearest[i] == j ? 1.f : 0.f;
+                r[i] = b;
+                bNorm += double(b) * b;
+            }
+            bNorm = std::sqrt(bNorm);
+
+            // y = A v over the region
+            auto multiply = [&](const std::vector<float> &v, std::vector<float> &y) {
+                for (uint32_t i : region) {
+                    float sum = heat[i] * v[i];
+                    for (uint32_t k = laplacian.rowStart[i]; k < laplacian.rowStart[i + 1]; k++) {
+                        sum += laplacian.vals[k] * v[laplacian.cols[k]];
+                    }
+                    y[i] = sum;
+                }
+            };
+
+            // r = b - A x
+            multiply(x, ap);
+            double rz = 0.0;
+            for (uint32_t i : region) {
+                r[i] -= ap[i];
+                z[i] = r[i] * invDiag[i];
+                p[i] = z[i];
+                rz += double(r[i]) * z[i];
+            }
+
+            size_t it = 0;
+            for (; it < settings.maxIterations; it++) {
+                double rNorm = 0.0;
+                for (uint32_t i : region) {
+                    rNorm += double(r[i]) * r[i];
+                }
+                if (std::sqrt(rNorm) <= settings.tolerance * bNorm || bNorm == 0.0) {
+                    break;
+                }
+
+                multiply(p, ap);
+                double pap = 0.0;
+                for (uint32_t i : region) {
+                    pap += double(p[i]) * ap[i];
+                }
+                if (pap <= 0.0) {
+                    break;
+                }
+                float alpha = rz / pap;
+                double rzNext = 0.0;
+                for (uint32_t i : region) {
+                    x[i] += alpha * p[i];
+                    r[i] -= alpha * ap[i];
+                    z[i] = r[i] * invDiag[i];
+                    rzNext += double(r[i]) * z[i];
+                }
+                float beta = rzNext / rz;
+                rz = rzNext;
+                for (uint32_t i : region) {
+                    p[i] = z[i] + beta * p[i];
+                }
+            }
+            maxIterations = std::max(maxIterations, it);
+            if (it == settings.maxIterations) {
+                unconverged++;
+            }
+
+            for (uint32_t i : region) {
+                float w = glm::clamp(x[i], 0.f, 1.f);
+                if (w > weights[i][0]) {
+                    weights[i][1] = weights[i][0];
+                    ids[i][1] = ids[i][0];
+                    weights[i][0] = w;
+                    ids[i][0] = j;
+                } else if (w > weights[i][1]) {
+                    weights[i][1] = w;
+                    ids[i][1] = j;
+                }
+                x[i] = r[i] = z[i] = p[i] = ap[i] = 0.f;
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(mergeLock);
+        solveStats.maxIterations = std::max(solveStats.maxIterations, maxIterations);
+        solveStats.unconverged += unconverged;
+        for (size_t i = 0; i < n; i++) {
+            for (int k = 0; k < 2; k++) {
+                float w = weights[i][k];
+                if (w > result.weights[i][0]) {
+                    result.weights[i][1] = result.weights[i][0];
+                    result.ids[i][1] = result.ids[i][0];
+                    result.weights[i][0] = w;
+                    result.ids[i][0] = ids[i][k];
+                } else if (w > result.weights[i][1]) {
+                    result.weights[i][1] = w;
+                    result.ids[i][1] = ids[i][k];
+                }
+            }
+        }
+    });
+
+    // Normalize the two kept weights. A vertex no joint reached
+    // keeps its nearest bone.
+    for (size_t i = 0; i < n; i++) {
+        float sum = result.weights[i][0] + result.weights[i][1];
+        if (sum > 0.f) {
+            result.weights[i] /= sum;
+        } else {
+            result.ids[i] = glm::ivec2(nearest[i]);
+            result.weights[i] = glm::vec2(1.f, 0.f);
+        }
+    }
+
+    solveStats.solveMs = msSince(start);
+    return result;
+}
+
+const HeatSolveStats& HeatWeights::stats() const {
+    return solveStats;
+}
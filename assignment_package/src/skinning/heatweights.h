@@ -0,0 +1,68 @@
+#ifndef HEATWEIGHTS_H
+#define HEATWEIGHTS_H
+
+#include "skinning/skinweights.h"
+#include "jobs/job.h"
+#include <la.h>
+#include <cstdint>
+#include <vector>
+
+// A symmetric sparse matrix in compressed sparse row form.
+struct CsrMatrix {
+    std::vector<uint32_t> rowStart;     // rows + 1 entries
+    std::vector<uint32_t> cols;
+    std::vector<float> vals;
+
+    size_t rows() const;
+};
+
+struct HeatSolveStats {
+    double assembleMs;
+    double solveMs;
+    size_t maxIterations;       // Most CG iterations any joint needed.
+    size_t unconverged;         // Joints that hit the iteration limit.
+};
+
+// Automatic skin weights by heat diffusion ("bone heat").
+// For each joint j the weights w_j solve
+//     (L + M H) w_j = M H p_j
+// where L is the cotangent Laplacian, M the lumped vertex areas,
+// H_ii = c / d_i^2 with d_i the distance from vertex i to its nearest
+// bone, and p_j marks the vertices whose nearest bone is j's.
+// The matrix is the same for every joint, so it is assembled once
+// and each joint is a separate right-hand side, solved in parallel.
+class HeatWeights {
+public:
+    struct Settings {
+        float tolerance;        // Relative residual at which CG stops.
+        size_t maxIterations;
+        float heatConstant;     // c above.
+
+        Settings();
+    };
+
+private:
+    std::vector<glm::vec3> positions;
+    CsrMatrix laplacian;
+    std::vector<float> mass;
+    HeatSolveStats solveStats;
+
+public:
+    // positions are the bind pose vertices, triangles three indices each.
+    HeatWeights(const std::vector<glm::vec3> &positions,
+                const std::vector<uint32_t> &triangles);
+
+    // jointPos are the bind pose joint positions, parents precede children.
+    // Each joint owns the bones to its children, or just its own
+    // position if it is a leaf.
+    // If control is given, progress is reported per joint and the
+    // remaining joints are skipped once it is cancelled.
+    SkinInfluences solve(const std::vector<glm::vec3> &jointPos,
+                         const std::vector<int> &parents,
+                         const Settings &settings = Settings(),
+                         JobControl* control = nullptr);
+
+    const HeatSolveStats& stats() const;
+};
+
+#endif // HEATWEIGHTS_H
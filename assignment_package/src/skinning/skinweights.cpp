@@ -0,0 +1,44 @@
+#include "skinweights.h"
+#include "parallel.h"
+#include "profiling/trace.h"
+#include <cmath>
+
+SkinInfluences nearestJointWeights(const std::vector<glm::vec3> &positions,
+                                   const std::vector<glm::vec3> &jointPos) {
+    TRACE_SCOPE("nearestJointWeights");
+    SkinInfluences result;
+    result.ids.assign(positions.size(), glm::ivec2(0));
+    result.weights.assign(positions.size(), glm::vec2(1.f, 0.f));
+    if (jointPos.empty()) {
+        return result;
+    }
+
+    parallelFor(positions.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            int closest = 0, nextClosest = -1;
+            float minDist = INFINITY, nextMinDist = INFINITY;
+            for (size_t j = 0; j < jointPos.size(); j++) {
+                float d = glm::length(positions[i] - jointPos[j]);
+                if (d < minDist) {
+                    nextMinDist = minDist;
+                    nextClosest = closest;
+                    minDist = d;
+                    closest = j;
+                } else if (d < nextMinDist) {
+                    nextMinDist = d;
+                    nextClosest = j;
+                }
+            }
+            if (jointPos.size() == 1) {
+                // A single joint takes the whole vertex.
+                continue;
+            }
+
+            float sum = minDist + nextMinDist;
+            result.ids[i] = glm::ivec2(closest, nextClosest);
+            result.weights[i] = sum > 0.f ? glm::vec2(1 - minDist / sum, 1 - nextMinDist / sum)
+                                          : glm::vec2(0.5f);
+        }
+    });
+    return result;
+}
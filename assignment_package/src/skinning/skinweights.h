@@ -0,0 +1,19 @@
+#ifndef SKINWEIGHTS_H
+#define SKINWEIGHTS_H
+
+#include <la.h>
+#include <vector>
+
+// The two strongest joints of every vertex and their normalized weights,
+// matching the two influences the skinning shader reads.
+struct SkinInfluences {
+    std::vector<glm::ivec2> ids;
+    std::vector<glm::vec2> weights;
+};
+
+// Binds every vertex to its two closest joint positions, weighting
+// each by one minus its share of the two distances.
+SkinInfluences nearestJointWeights(const std::vector<glm::vec3> &positions,
+                                   const std::vector<glm::vec3> &jointPos);
+
+#endif // SKINWEIGHTS_H
@@ -0,0 +1,614 @@
+#include "spatial/bvh.h"
+#include "parallel.h"
+#include "profiling/memstats.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define BVH_SSE
+#endif
+
+namespace {
+    const float INF = std::numeric_limits<float>::infinity();
+
+    struct Box {
+        glm::vec3 lo, hi;
+
+        Box() : lo(INF), hi(-INF) {}
+
+        void grow(const glm::vec3 &p) {
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+        void grow(const Box &b) {
+            lo = glm::min(lo, b.lo);
+            hi = glm::max(hi, b.hi);
+        }
+        float area() const {
+            glm::vec3 d = hi - lo;
+            if (d.x < 0 || d.y < 0 || d.z < 0) {
+                return 0;
+            }
+            return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        }
+    };
+
+    // A node of the binary tree the build makes before collapsing it.
+    // Leaves have a count, inner nodes a left and right child.
+    struct BuildNode {
+        Box box;
+        uint32_t left, right;
+        uint32_t first, count;
+    };
+
+    const int BINS = 16;
+    // Ranges at least this long bin their triangles in parallel...
+    const size_t PARALLEL_BINNING = 1 << 15;
+    // ...and ranges at least this long build their two halves in parallel.
+    const size_t PARALLEL_BUILD = 1 << 12;
+
+    struct Bins {
+        Box box[3][BINS];
+        uint32_t count[3][BINS];
+        Box bounds, centroids;
+
+        Bins() : count{} {}
+
+        void merge(const Bins &b) {
+            for (int a = 0; a < 3; a++) {
+                for (int i = 0; i < BINS; i++) {
+                    box[a][i].grow(b.box[a][i]);
+                    count[a][i] += b.count[a][i];
+                }
+            }
+            bounds.grow(b.bounds);
+            centroids.grow(b.centroids);
+        }
+    };
+
+    struct Builder {
+        const std::vector<Box> &boxes;
+        const std::vector<glm::vec3> &centroids;
+        std::vector<uint32_t> &order;
+        std::vector<BuildNode> &nodes;
+        std::atomic<uint32_t> nodeCount;
+
+        Builder(const std::vector<Box> &boxes, const std::vector<glm::vec3> &centroids,
+                std::vector<uint32_t> &order, std::vector<BuildNode> &nodes)
+            : boxes(boxes), centroids(centroids), order(order), nodes(nodes), nodeCount(1)
+        {}
+
+        // Bounds of the triangles and of their centroids.
+        void measure(uint32_t begin, uint32_t end, Bins &out) const {
+            for (uint32_t i = begin; i < end; i++) {
+                out.bounds.grow(boxes[order[i]]);
+                out.centroids.grow(centroids[order[i]]);
+            }
+        }
+
+        void fill(uint32_t begin, uint32_t end, const Box &cbox, Bins &out) const {
+            glm::vec3 extent = cbox.hi - cbox.lo;
+            for (uint32_t i = begin; i < end; i++) {
+                uint32_t t = order[i];
+                for (int a = 0; a < 3; a++) {
+                    if (extent[a] <= 0) {
+                        continue;
+                    }
+                    int b = std::min(BINS - 1, int((centroids[t][a] - cbox.lo[a]) / extent[a] * BINS));
+                    out.box[a][b].grow(boxes[t]);
+                    out.count[a][b]++;
+                }
+            }
+        }
+
+        // Runs f over [begin, end) in chunks, merging each chunk's Bins.
+        template<typename F>
+        void gather(uint32_t begin, uint32_t end, Bins &out, F f) const {
+            if (end - begin < PARALLEL_BINNING) {
+                f(begin, end, out);
+                return;
+            }
+            std::mutex lock;
+            parallelFor(end - begin, PARALLEL_BINNING / 4, [&](size_t b, size_t e) {
+                Bins local;
+                f(uint32_t(begin + b), uint32_t(begin + e), local);
+                std::lock_guard<std::mutex> guard(lock);
+                out.merge(local);
+            });
+        }
+
+        void build(uint32_t index, uint32_t begin, uint32_t end) {
+            BuildNode &n = nodes[index];
+            uint32_t count = end - begin;
+
+            Bins bounds;
+            gather(begin, end, bounds, [this](uint32_t b, uint32_t e, Bins &out) { measure(b, e, out); });
+            n.box = bounds.bounds;
+            n.first = begin;
+            n.count = count;
+            if (count <= 2) {
+                return;
+            }
+
+            Box cbox = bounds.centroids;
+            Bins bins;
+            gather(begin, end, bins, [this, &cbox](uint32_t b, uint32_t e, Bins &out) { fill(b, e, cbox, out); });
+
+            // Sweep every axis for the cheapest split by surface area.
+            int bestAxis = -1, bestBin = 0;
+            float bestCost = INF;
+            for (int a = 0; a < 3; a++) {
+                if (cbox.hi[a] - cbox.lo[a] <= 0) {
+                    continue;
+                }
+                float rightArea[BINS];
+                uint32_t rightCount[BINS];
+                Box acc;
+                uint32_t c = 0;
+                for (int i = BINS - 1; i > 0; i--) {
+                    acc.grow(bins.box[a][i]);
+                    c += bins.count[a][i];
+                    rightArea[i] = acc.area();
+                    rightCount[i] = c;
+                }
+                acc = Box();
+                c = 0;
+                for (int i = 0; i < BINS - 1; i++) {
+                    acc.grow(bins.box[a][i]);
+                    c += bins.count[a][i];
+                    if (c == 0 || rightCount[i + 1] == 0) {
+                        continue;
+                    }
+                    float cost = acc.area() * c + rightArea[i + 1] * rightCount[i + 1];
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = a;
+                        bestBin = i;
+                    }
+                }
+            }
+
+            // Splitting costs a box test on top of the two halves.
+            float leafCost = n.box.area() * count;
+            if (count <= uint32_t(BVH::MAX_LEAF) && (bestAxis < 0 || leafCost <= n.box.area() + bestCost)) {
+                return;
+            }
+
+            uint32_t mid = begin;
+            if (bestAxis >= 0) {
+                float lo = cbox.lo[bestAxis], extent = cbox.hi[bestAxis] - lo;
+                const std::vector<glm::vec3> &c = centroids;
+                int axis = bestAxis, bin = bestBin;
+                mid = uint32_t(std::partition(order.begin() + begin, order.begin() + end, [&](uint32_t t) {
+                    return std::min(BINS - 1, int((c[t][axis] - lo) / extent * BINS)) <= bin;
+                }) - order.begin());
+            }
+            if (mid == begin || mid == end) {
+                // Every centroid in one spot; halve by order instead.
+                mid = begin + count / 2;
+            }
+
+            uint32_t left = nodeCount.fetch_add(2);
+            n.left = left;
+            n.right = left + 1;
+            n.count = 0;
+            if (count >= PARALLEL_BUILD) {
+                parallelFor(2, 1, [&](size_t b, size_t e) {
+                    for (size_t i = b; i < e; i++) {
+                        if (i == 0) {
+                            build(left, begin, mid);
+                        } else {
+                            build(left + 1, mid, end);
+                        }
+                    }
+                });
+            } else {
+                build(left, begin, mid);
+                build(left + 1, mid, end);
+            }
+        }
+    };
+
+    // Closest point on triangle abc to p, from Ericson's Real-Time Collision Detection.
+    glm::vec3 closestOnTriangle(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+        glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if (d1 <= 0 && d2 <= 0) {
+            return a;
+        }
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if (d3 >= 0 && d4 <= d3) {
+            return b;
+        }
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+            return a + ab * (d1 / (d1 - d3));
+        }
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if (d6 >= 0 && d5 <= d6) {
+            return c;
+        }
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+            return a + ac * (d2 / (d2 - d6));
+        }
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        }
+        float denom = 1.f / (va + vb + vc);
+        return a + ab * (vb * denom) + ac * (vc * denom);
+    }
+
+    // Where a traversal goes next and how near that subtree may be.
+    struct Entry {
+        int32_t node;
+        float key;
+    };
+}
+
+BVH::BVH() : nodes(), leafOrder(), corners(), indices() {}
+
+void BVH::clear() {
+    nodes.clear();
+    leafOrder.clear();
+    corners.clear();
+    indices.clear();
+}
+
+bool BVH::empty() const {
+    return nodes.empty();
+}
+
+size_t BVH::nodeCount() const {
+    return nodes.size();
+}
+
+size_t BVH::triangleCount() const {
+    return leafOrder.size();
+}
+
+size_t BVH::memoryBytes() const {
+    return nodes.capacity() * sizeof(Node) + leafOrder.capacity() * sizeof(uint32_t)
+           + corners.capacity() * sizeof(glm::vec3) + indices.capacity() * sizeof(uint32_t);
+}
+
+void BVH::build(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &triIndices) {
+    MEMORY_SCOPE(BVH);
+    clear();
+    indices = triIndices;
+    size_t triCount = indices.size() / 3;
+    if (triCount == 0) {
+        return;
+    }
+
+    std::vector<Box> boxes(triCount);
+    std::vector<glm::vec3> centroids(triCount);
+    std::vector<uint32_t> order(triCount);
+    parallelFor(triCount, 4096, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++) {
+            Box b;
+            for (int c = 0; c < 3; c++) {
+                b.grow(positions[indices[t * 3 + c]]);
+            }
+            boxes[t] = b;
+            centroids[t] = (b.lo + b.hi) * 0.5f;
+            order[t] = uint32_t(t);
+        }
+    });
+
+    // A binary tree over n triangles has at most 2n - 1 nodes.
+    std::vector<BuildNode> binary(2 * triCount);
+    Builder builder(boxes, centroids, order, binary);
+    builder.build(0, 0, uint32_t(triCount));
+
+    // Collapse into four wide nodes, parents first, opening the
+    // largest inner child until each node has four children.
+    nodes.reserve(builder.nodeCount / 2 + 1);
+    leafOrder.reserve(triCount);
+    struct Pending {
+        uint32_t binary;
+        int32_t parent;
+        int lane;
+    };
+    std::vector<Pending> stack = {{0, -1, 0}};
+    while (!stack.empty()) {
+        Pending p = stack.back();
+        stack.pop_back();
+
+        uint32_t kids[WIDTH] = {p.binary};
+        int k = 1;
+        if (binary[p.binary].count == 0) {
+            kids[0] = binary[p.binary].left;
+            kids[1] = binary[p.binary].right;
+            k = 2;
+        }
+        while (k < WIDTH) {
+            int open = -1;
+            float largest = -1;
+            for (int i = 0; i < k; i++) {
+                if (binary[kids[i]].count == 0 && binary[kids[i]].box.area() > largest) {
+                    largest = binary[kids[i]].box.area();
+                    open = i;
+                }
+            }
+            if (open < 0) {
+                break;
+            }
+            uint32_t opened = kids[open];
+            kids[open] = binary[opened].left;
+            kids[k++] = binary[opened].right;
+        }
+
+        int32_t index = int32_t(nodes.size());
+        nodes.push_back(Node());
+        if (p.parent >= 0) {
+            nodes[p.parent].child[p.lane] = index;
+        }
+        Node &n = nodes.back();
+        for (int i = 0; i < WIDTH; i++) {
+            n.child[i] = EMPTY;
+            n.count[i] = 0;
+            n.minX[i] = n.minY[i] = n.minZ[i] = INF;
+            n.maxX[i] = n.maxY[i] = n.maxZ[i] = -INF;
+        }
+        for (int i = 0; i < k; i++) {
+            const BuildNode &b = binary[kids[i]];
+            n.minX[i] = b.box.lo.x; n.minY[i] = b.box.lo.y; n.minZ[i] = b.box.lo.z;
+            n.maxX[i] = b.box.hi.x; n.maxY[i] = b.box.hi.y; n.maxZ[i] = b.box.hi.z;
+            if (b.count > 0) {
+                n.child[i] = ~int32_t(leafOrder.size());
+                n.count[i] = b.count;
+                leafOrder.insert(leafOrder.end(), order.begin() + b.first, order.begin() + b.first + b.count);
+            } else {
+                stack.push_back({kids[i], index, i});
+            }
+        }
+    }
+
+    corners.resize(triCount * 3);
+    gatherCorners(positions);
+}
+
+void BVH::gatherCorners(const std::vector<glm::vec3> &positions) {
+    parallelFor(leafOrder.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t* tri = &indices[leafOrder[i] * 3];
+            corners[i * 3] = positions[tri[0]];
+            corners[i * 3 + 1] = positions[tri[1]];
+            corners[i * 3 + 2] = positions[tri[2]];
+        }
+    });
+}
+
+void BVH::setLeafBounds(Node &n, int lane) const {
+    Box b;
+    size_t first = size_t(~n.child[lane]) * 3;
+    for (size_t i = first; i < first + n.count[lane] * 3; i++) {
+        b.grow(corners[i]);
+    }
+    n.minX[lane] = b.lo.x; n.minY[lane] = b.lo.y; n.minZ[lane] = b.lo.z;
+    n.maxX[lane] = b.hi.x; n.maxY[lane] = b.hi.y; n.maxZ[lane] = b.hi.z;
+}
+
+void BVH::refit(const std::vector<glm::vec3> &positions) {
+    if (nodes.empty()) {
+        return;
+    }
+    gatherCorners(positions);
+    // Leaves only read triangles, so they refit in parallel. Inner
+    // children come after their parents, so one backward pass does the rest.
+    parallelFor(nodes.size(), 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            for (int lane = 0; lane < WIDTH; lane++) {
+                if (nodes[i].count[lane] > 0) {
+                    setLeafBounds(nodes[i], lane);
+                }
+            }
+        }
+    });
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node &n = nodes[i];
+        for (int lane = 0; lane < WIDTH; lane++) {
+            if (n.count[lane] > 0 || n.child[lane] == EMPTY) {
+                continue;
+            }
+            const Node &c = nodes[n.child[lane]];
+            float lo[3] = {INF, INF, INF}, hi[3] = {-INF, -INF, -INF};
+            for (int j = 0; j < WIDTH; j++) {
+                lo[0] = std::min(lo[0], c.minX[j]); hi[0] = std::max(hi[0], c.maxX[j]);
+                lo[1] = std::min(lo[1], c.minY[j]); hi[1] = std::max(hi[1], c.maxY[j]);
+                lo[2] = std::min(lo[2], c.minZ[j]); hi[2] = std::max(hi[2], c.maxZ[j]);
+            }
+            n.minX[lane] = lo[0]; n.minY[lane] = lo[1]; n.minZ[lane] = lo[2];
+            n.maxX[lane] = hi[0]; n.maxY[lane] = hi[1]; n.maxZ[lane] = hi[2];
+        }
+    }
+}
+
+bool BVH::raycast(const Ray &ray, Hit &hit, float tMax) const {
+    if (nodes.empty()) {
+        return false;
+    }
+    const float EPS = 1e-7f;
+    glm::vec3 inv;
+    for (int a = 0; a < 3; a++) {
+        // Keeps 0 * inf out of the slab test.
+        float d = ray.direction[a];
+        if (std::abs(d) < 1e-30f) {
+            d = d < 0 ? -1e-30f : 1e-30f;
+        }
+        inv[a] = 1.f / d;
+    }
+    float best = tMax;
+    bool found = false;
+
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    stack.push_back({0, 0.f});
+    while (!stack.empty()) {
+        Entry e = stack.back();
+        stack.pop_back();
+        if (e.key >= best) {
+            continue;
+        }
+        const Node &n = nodes[e.node];
+
+        // Slab test of the ray against all four child boxes.
+        alignas(16) float tNear[WIDTH];
+        int mask = 0;
+#ifdef BVH_SSE
+        __m128 ox = _mm_set1_ps(ray.origin.x), oy = _mm_set1_ps(ray.origin.y), oz = _mm_set1_ps(ray.origin.z);
+        __m128 ix = _mm_set1_ps(inv.x), iy = _mm_set1_ps(inv.y), iz = _mm_set1_ps(inv.z);
+        __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(n.minX), ox), ix);
+        __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(n.maxX), ox), ix);
+        __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(n.minY), oy), iy);
+        __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(n.maxY), oy), iy);
+        __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(n.minZ), oz), iz);
+        __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(n.maxZ), oz), iz);
+        __m128 tmin = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+                                 _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+        __m128 tmax = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+                                 _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(best)));
+        mask = _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+        _mm_store_ps(tNear, tmin);
+#else
+        for (int i = 0; i < WIDTH; i++) {
+            float x0 = (n.minX[i] - ray.origin.x) * inv.x, x1 = (n.maxX[i] - ray.origin.x) * inv.x;
+            float y0 = (n.minY[i] - ray.origin.y) * inv.y, y1 = (n.maxY[i] - ray.origin.y) * inv.y;
+            float z0 = (n.minZ[i] - ray.origin.z) * inv.z, z1 = (n.maxZ[i] - ray.origin.z) * inv.z;
+            float tmin = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.f));
+            float tmax = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), best));
+            tNear[i] = tmin;
+            mask |= (tmin <= tmax) << i;
+        }
+#endif
+
+        // Intersect leaves now, and visit inner children nearest first.
+        Entry inner[WIDTH];
+        int innerCount = 0;
+        for (int i = 0; i < WIDTH; i++) {
+            if (!(mask & (1 << i)) || n.child[i] == EMPTY) {
+                continue;
+            }
+            if (n.count[i] == 0) {
+                int j = innerCount++;
+                while (j > 0 && inner[j - 1].key < tNear[i]) {
+                    inner[j] = inner[j - 1];
+                    j--;
+                }
+                inner[j] = {n.child[i], tNear[i]};
+                continue;
+            }
+            size_t first = size_t(~n.child[i]);
+            for (size_t t = first; t < first + n.count[i]; t++) {
+                const glm::vec3 &v0 = corners[t * 3];
+                glm::vec3 e1 = corners[t * 3 + 1] - v0, e2 = corners[t * 3 + 2] - v0;
+                glm::vec3 p = glm::cross(ray.direction, e2);
+                float det = glm::dot(e1, p);
+                if (std::abs(det) < 1e-12f) {
+                    continue;
+                }
+                float invDet = 1.f / det;
+                glm::vec3 s = ray.origin - v0;
+                float u = glm::dot(s, p) * invDet;
+                if (u < 0 || u > 1) {
+                    continue;
+                }
+                glm::vec3 q = glm::cross(s, e1);
+                float v = glm::dot(ray.direction, q) * invDet;
+                if (v < 0 || u + v > 1) {
+                    continue;
+                }
+                float tHit = glm::dot(e2, q) * invDet;
+                if (tHit > EPS && tHit < best) {
+                    best = tHit;
+                    hit = {tHit, leafOrder[t], u, v};
+                    found = true;
+                }
+            }
+        }
+        // Sorted far to near, so the nearest is popped first.
+        for (int i = 0; i < innerCount; i++) {
+            stack.push_back(inner[i]);
+        }
+    }
+    return found;
+}
+
+bool BVH::closestPoint(const glm::vec3 &p, Closest &result, float maxDistance) const {
+    if (nodes.empty()) {
+        return false;
+    }
+    float best = maxDistance < std::sqrt(std::numeric_limits<float>::max())
+                 ? maxDistance * maxDistance : std::numeric_limits<float>::max();
+    bool found = false;
+
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    stack.push_back({0, 0.f});
+    while (!stack.empty()) {
+        Entry e = stack.back();
+        stack.pop_back();
+        if (e.key > best) {
+            continue;
+        }
+        const Node &n = nodes[e.node];
+
+        // Squared distance from p to all four child boxes.
+        alignas(16) float dist[WIDTH];
+#ifdef BVH_SSE
+        __m128 zero = _mm_setzero_ps();
+        __m128 px = _mm_set1_ps(p.x), py = _mm_set1_ps(p.y), pz = _mm_set1_ps(p.z);
+        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(n.minX), px), _mm_sub_ps(px, _mm_load_ps(n.maxX))), zero);
+        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(n.minY), py), _mm_sub_ps(py, _mm_load_ps(n.maxY))), zero);
+        __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(n.minZ), pz), _mm_sub_ps(pz, _mm_load_ps(n.maxZ))), zero);
+        _mm_store_ps(dist, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+#else
+        for (int i = 0; i < WIDTH; i++) {
+            float dx = std::max(std::max(n.minX[i] - p.x, p.x - n.maxX[i]), 0.f);
+            float dy = std::max(std::max(n.minY[i] - p.y, p.y - n.maxY[i]), 0.f);
+            float dz = std::max(std::max(n.minZ[i] - p.z, p.z - n.maxZ[i]), 0.f);
+            dist[i] = dx * dx + dy * dy + dz * dz;
+        }
+#endif
+
+        Entry inner[WIDTH];
+        int innerCount = 0;
+        for (int i = 0; i < WIDTH; i++) {
+            if (n.child[i] == EMPTY || dist[i] > best) {
+                continue;
+            }
+            if (n.count[i] == 0) {
+                int j = innerCount++;
+                while (j > 0 && inner[j - 1].key < dist[i]) {
+                    inner[j] = inner[j - 1];
+                    j--;
+                }
+                inner[j] = {n.child[i], dist[i]};
+                continue;
+            }
+            size_t first = size_t(~n.child[i]);
+            for (size_t t = first; t < first + n.count[i]; t++) {
+                glm::vec3 q = closestOnTriangle(p, corners[t * 3], corners[t * 3 + 1], corners[t * 3 + 2]);
+                glm::vec3 d = q - p;
+                float d2 = glm::dot(d, d);
+                if (d2 <= best) {
+                    best = d2;
+                    result = {q, d2, leafOrder[t]};
+                    found = true;
+                }
+            }
+        }
+        for (int i = 0; i < innerCount; i++) {
+            stack.push_back(inner[i]);
+        }
+    }
+    return found;
+}
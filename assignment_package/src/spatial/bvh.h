@@ -0,0 +1,77 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "spatial/ray.h"
+#include <la.h>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// A bounding volume hierarchy over triangles for ray casts and closest
+// point queries on the CPU. It is built top-down with binned SAH, big
+// subtrees in parallel, then collapsed into nodes of four children whose
+// boxes are stored lane by lane so one SSE test covers all four.
+// Moving vertices only calls for refit(); new topology for build().
+class BVH
+{
+public:
+    static const int WIDTH = 4;
+    // Most triangles a leaf holds.
+    static const int MAX_LEAF = 8;
+
+    struct Hit {
+        float t;            // Along the ray, in units of its direction.
+        uint32_t triangle;  // Index into the triangles given to build().
+        float u, v;         // Barycentrics of the hit on the triangle.
+    };
+
+    struct Closest {
+        glm::vec3 point;
+        float distanceSq;
+        uint32_t triangle;
+    };
+
+private:
+    // Child boxes are split by axis so every comparison is four wide.
+    // A child is an inner node at index child[i] >= 0, a leaf of count[i]
+    // triangles from ~child[i] in leaf order, or unused when count[i] is 0
+    // and child[i] is EMPTY.
+    struct alignas(16) Node {
+        float minX[WIDTH], minY[WIDTH], minZ[WIDTH];
+        float maxX[WIDTH], maxY[WIDTH], maxZ[WIDTH];
+        int32_t child[WIDTH];
+        uint32_t count[WIDTH];
+    };
+    static const int32_t EMPTY = std::numeric_limits<int32_t>::min();
+
+    std::vector<Node> nodes;            // Parents before their children.
+    std::vector<uint32_t> leafOrder;    // Triangle ids in leaf order.
+    std::vector<glm::vec3> corners;     // Their corners, three each, in leaf order.
+    std::vector<uint32_t> indices;      // As given to build().
+
+    void gatherCorners(const std::vector<glm::vec3> &positions);
+    void setLeafBounds(Node &n, int lane) const;
+
+public:
+    BVH();
+
+    // Builds over the triangles (indices[3i], indices[3i + 1], indices[3i + 2]).
+    void build(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &indices);
+    // Recomputes every box for new positions of the same triangles.
+    void refit(const std::vector<glm::vec3> &positions);
+    void clear();
+    bool empty() const;
+
+    // The nearest hit with t in (0, tMax), if any.
+    bool raycast(const Ray &ray, Hit &hit,
+                 float tMax = std::numeric_limits<float>::max()) const;
+    // The point of the mesh nearest to p within maxDistance, if any.
+    bool closestPoint(const glm::vec3 &p, Closest &result,
+                      float maxDistance = std::numeric_limits<float>::max()) const;
+
+    size_t nodeCount() const;
+    size_t triangleCount() const;
+    size_t memoryBytes() const;
+};
+
+#endif // BVH_H
@@ -0,0 +1,11 @@
+#ifndef RAY_H
+#define RAY_H
+
+#include <la.h>
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;    // Need not be normalized; hit distances are in its units.
+};
+
+#endif // RAY_H
@@ -0,0 +1,193 @@
+#include "weld.h"
+#include "parallel.h"
+#include "profiling/trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+namespace {
+
+struct Cell {
+    int64_t x, y, z;
+};
+
+uint64_t hashCell(const Cell &c) {
+    uint64_t h = uint64_t(c.x) * 0x9E3779B97F4A7C15ull ^ uint64_t(c.y) * 0xC2B2AE3D27D4EB4Full
+               ^ uint64_t(c.z) * 0x165667B19E3779F9ull;
+    return h ^ (h >> 29);
+}
+
+} // namespace
+
+void weldVertices(std::vector<glm::vec3> &positions, std::vector<uint32_t> &remap,
+                  float tolerance, WeldStats* stats) {
+    TRACE_SCOPE("weldVertices");
+    auto start = Clock::now();
+    size_t n = positions.size();
+    remap.resize(n);
+
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    std::mutex boundsMutex;
+    parallelFor(n, 1 << 16, [&](size_t begin, size_t end) {
+        glm::vec3 l(std::numeric_limits<float>::max()), h(-std::numeric_limits<float>::max());
+        for (size_t i = begin; i < end; i++) {
+            l = glm::min(l, positions[i]);
+            h = glm::max(h, positions[i]);
+        }
+        std::lock_guard<std::mutex> lock(boundsMutex);
+        lo = glm::min(lo, l);
+        hi = glm::max(hi, h);
+    });
+    float diagonal = n > 0 ? glm::length(hi - lo) : 0.f;
+    float eps = std::max(tolerance, 0.f) * diagonal;
+    // Cells as wide as eps put every vertex within reach in a neighbouring
+    // cell. Exact duplicates share a cell of any width, so then the cells
+    // are sized to hold about one vertex each and only their own is searched.
+    // Wider cells are still correct, so they are kept to a billion across.
+    float width = eps > 0.f ? std::max(eps, diagonal * 1e-9f)
+                            : std::max(diagonal / std::cbrt(float(std::max<size_t>(n, 1))), 1e-30f);
+    int reach = eps > 0.f ? 1 : 0;
+    auto cellOf = [&lo, width](const glm::vec3 &p) {
+        glm::vec3 c = (p - lo) / width;
+        return Cell{ int64_t(std::floor(c.x)), int64_t(std::floor(c.y)), int64_t(std::floor(c.z)) };
+    };
+
+    // Vertices by bucket, counted and then placed with atomics.
+    size_t buckets = 1;
+    while (buckets < 2 * n) {
+        buckets <<= 1;
+    }
+    std::vector<uint32_t> bucketOf(n);
+    std::unique_ptr<std::atomic<uint32_t>[]> fill(new std::atomic<uint32_t>[buckets]());
+    parallelFor(n, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            bucketOf[i] = uint32_t(hashCell(cellOf(positions[i])) & (buckets - 1));
+            fill[bucketOf[i]].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    std::vector<uint32_t> bucketStart(buckets + 1, 0);
+    for (size_t b = 0; b < buckets; b++) {
+        bucketStart[b + 1] = bucketStart[b] + fill[b].load(std::memory_order_relaxed);
+        fill[b].store(bucketStart[b], std::memory_order_relaxed);
+    }
+    std::vector<uint32_t> grid(n);
+    parallelFor(n, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            grid[fill[bucketOf[i]].fetch_add(1, std::memory_order_relaxed)] = uint32_t(i);
+        }
+    });
+    fill.reset();
+
+    // Each vertex looks for the lowest index within eps. Which thread
+    // placed what where does not matter, so the result is deterministic.
+    std::vector<uint32_t> lowest(n);
+    float epsSq = eps * eps;
+    parallelFor(n, 1 << 12, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const glm::vec3 &p = positions[i];
+            Cell c = cellOf(p);
+            uint32_t best = uint32_t(i);
+            for (int dx = -reach; dx <= reach; dx++) {
+                for (int dy = -reach; dy <= reach; dy++) {
+                    for (int dz = -reach; dz <= reach; dz++) {
+                        size_t b = hashCell(Cell{ c.x + dx, c.y + dy, c.z + dz }) & (buckets - 1);
+                        for (uint32_t k = bucketStart[b]; k < bucketStart[b + 1]; k++) {
+                            uint32_t j = grid[k];
+                            glm::vec3 d = positions[j] - p;
+                            if (j < best && glm::dot(d, d) <= epsSq) {
+                                best = j;
+                            }
+                        }
+                    }
+                }
+            }
+            lowest[i] = best;
+        }
+    });
+
+    // lowest[i] <= i, so in one pass in order every vertex finds where the
+    // vertex it joins already went, and those that remain are packed.
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t j = lowest[i];
+        if (j == i) {
+            remap[i] = uint32_t(count);
+            positions[count++] = positions[i];
+        } else {
+            remap[i] = remap[j];
+        }
+    }
+    positions.resize(count);
+
+    if (stats != nullptr) {
+        *stats = { n, count, 0, 0, msSince(start) };
+    }
+}
+
+void remapPolygons(const std::vector<uint32_t> &remap,
+                   std::vector<uint32_t> &faceStarts, std::vector<uint32_t> &indices,
+                   WeldStats* stats) {
+    TRACE_SCOPE("remapPolygons");
+    auto start = Clock::now();
+    size_t faceCount = faceStarts.empty() ? 0 : faceStarts.size() - 1;
+
+    // Corners that differ from the one before them, around each face.
+    std::vector<uint32_t> kept(faceCount);
+    parallelFor(faceCount, 4096, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; f++) {
+            uint32_t first = faceStarts[f], last = faceStarts[f + 1] - 1;
+            uint32_t count = 0;
+            for (uint32_t k = first; k <= last; k++) {
+                count += remap[indices[k]] != remap[indices[k == first ? last : k - 1]];
+            }
+            kept[f] = count;
+        }
+    });
+
+    std::vector<uint32_t> newStarts(1, 0);
+    newStarts.reserve(faceCount + 1);
+    std::vector<uint32_t> oldFace;
+    oldFace.reserve(faceCount);
+    size_t corners = 0, faces = 0;
+    for (size_t f = 0; f < faceCount; f++) {
+        corners += faceStarts[f + 1] - faceStarts[f] - kept[f];
+        if (kept[f] < 3) {
+            faces++;
+            continue;
+        }
+        newStarts.push_back(newStarts.back() + kept[f]);
+        oldFace.push_back(uint32_t(f));
+    }
+
+    std::vector<uint32_t> newIndices(newStarts.back());
+    parallelFor(oldFace.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            uint32_t first = faceStarts[oldFace[i]], last = faceStarts[oldFace[i] + 1] - 1;
+            uint32_t out = newStarts[i];
+            for (uint32_t k = first; k <= last; k++) {
+                uint32_t v = remap[indices[k]];
+                if (v != remap[indices[k == first ? last : k - 1]]) {
+                    newIndices[out++] = v;
+                }
+            }
+        }
+    });
+    faceStarts.swap(newStarts);
+    indices.swap(newIndices);
+
+    if (stats != nullptr) {
+        stats->cornersDropped += corners;
+        stats->facesDropped += faces;
+        stats->ms += msSince(start);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef WELD_H
+#define WELD_H
+
+#include <la.h>
+#include <cstdint>
+#include <vector>
+
+struct WeldStats {
+    size_t verticesIn;
+    size_t verticesOut;
+    size_t cornersDropped;  // Corners that ran into the corner before them.
+    size_t facesDropped;    // Faces left with fewer than three corners.
+    double ms;
+};
+
+// Merges vertices that lie within tolerance of each other, tolerance
+// being a fraction of the diagonal of their bounding box, so files split
+// along UV seams or normal creases come out as one connected surface.
+// Vertices are binned into a hash grid of cells as wide as the tolerance,
+// filled and searched in parallel, and each one joins the lowest index
+// within reach in its own or a neighbouring cell. A tolerance of 0 merges
+// only exact duplicates.
+//
+// positions keeps the first vertex of every group, in order, and
+// remap[i] gives where vertex i went. stats, if given, starts over.
+void weldVertices(std::vector<glm::vec3> &positions, std::vector<uint32_t> &remap,
+                  float tolerance, WeldStats* stats = nullptr);
+
+// Points polygons, laid out as for HalfEdgeMesh::buildFromPolygons, at
+// welded vertices. Corners equal to the one before them are dropped, and
+// then faces with fewer than three corners. Adds to stats, if given.
+void remapPolygons(const std::vector<uint32_t> &remap,
+                   std::vector<uint32_t> &faceStarts, std::vector<uint32_t> &indices,
+                   WeldStats* stats = nullptr);
+
+#endif // WELD_H
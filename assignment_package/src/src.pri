@@ -1,17 +1,18 @@
 INCLUDEPATH += $$PWD
 DEPENDPATH += $$PWD
 
+include($$PWD/core.pri)
+
 SOURCES += \
-    $$PWD/components/face.cpp \
     $$PWD/components/facedisplay.cpp \
-    $$PWD/components/halfedge.cpp \
     $$PWD/components/halfedgedisplay.cpp \
     $$PWD/components/joint.cpp \
-    $$PWD/components/vertex.cpp \
     $$PWD/components/vertexdisplay.cpp \
     $$PWD/main.cpp \
     $$PWD/mainwindow.cpp \
     $$PWD/mesh.cpp \
+    $$PWD/faceattributes.cpp \
+    $$PWD/pickbuffer.cpp \
     $$PWD/mygl.cpp \
     $$PWD/shaderprogram.cpp \
     $$PWD/utils.cpp \
@@ -20,19 +21,18 @@ SOURCES += \
     $$PWD/camera.cpp \
     $$PWD/cameracontrolshelp.cpp \
     $$PWD/openglcontext.cpp \
-    $$PWD/scene/squareplane.cpp
+    $$PWD/scene/squareplane.cpp \
+    $$PWD/jointpalette.cpp
 
 HEADERS += \
-    $$PWD/components/face.h \
     $$PWD/components/facedisplay.h \
-    $$PWD/components/halfedge.h \
     $$PWD/components/halfedgedisplay.h \
     $$PWD/components/joint.h \
-    $$PWD/components/vertex.h \
     $$PWD/components/vertexdisplay.h \
-    $$PWD/la.h \
     $$PWD/mainwindow.h \
     $$PWD/mesh.h \
+    $$PWD/faceattributes.h \
+    $$PWD/pickbuffer.h \
     $$PWD/mygl.h \
     $$PWD/shaderprogram.h \
     $$PWD/utils.h \
@@ -40,5 +40,10 @@ HEADERS += \
     $$PWD/camera.h \
     $$PWD/cameracontrolshelp.h \
     $$PWD/openglcontext.h \
-    $$PWD/scene/squareplane.h\
-    $$PWD/smartpointerhelp.h
+    $$PWD/scene/squareplane.h \
+    $$PWD/jointpalette.h
+
+# Counts every allocation by subsystem, Qt's included.
+heap_hooks {
+    SOURCES += $$PWD/profiling/heaphooks.cpp
+}
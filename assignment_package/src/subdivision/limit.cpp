@@ -0,0 +1,32 @@
+#include "limit.h"
+#include <cmath>
+
+LimitFrame catmullClarkLimit(const glm::vec3 &v, const glm::vec3* edges, const glm::vec3* faces, size_t n) {
+    LimitFrame frame;
+    glm::vec3 edgeSum(0.f), faceSum(0.f);
+    for (size_t i = 0; i < n; i++) {
+        edgeSum += edges[i];
+        faceSum += faces[i];
+    }
+    float fn = float(n);
+    frame.position = (fn * fn * v + 4.f * edgeSum + faceSum) / (fn * (fn + 5.f));
+
+    // Walks the cosines once, tangentV taking each one a step late.
+    const double step = 2.0 * 3.14159265358979 / n;
+    float a = float(1.0 + std::cos(step) + std::cos(step / 2.0) * std::sqrt(2.0 * (9.0 + std::cos(step))));
+    glm::vec3 u(0.f), w(0.f);
+    float prev = float(std::cos(-step)), curr = 1.f;
+    for (size_t i = 0; i < n; i++) {
+        float next = float(std::cos(step * double(i + 1)));
+        u += a * curr * edges[i] + (curr + next) * faces[i];
+        w += a * prev * edges[i] + (prev + curr) * faces[i];
+        prev = curr;
+        curr = next;
+    }
+    frame.tangentU = u;
+    frame.tangentV = w;
+    glm::vec3 normal = glm::cross(u, w);
+    float length = glm::length(normal);
+    frame.normal = length > 0.f ? normal / length : glm::vec3(0.f);
+    return frame;
+}
@@ -0,0 +1,27 @@
+#ifndef LIMIT_H
+#define LIMIT_H
+
+#include <la.h>
+#include <cstddef>
+
+// Where a vertex ends up under endless subdivision, and the surface there.
+struct LimitFrame {
+    glm::vec3 position;
+    glm::vec3 tangentU, tangentV;
+    glm::vec3 normal;           // Unit length, along tangentU x tangentV.
+};
+
+// The Catmull-Clark limit point, tangents and normal of a vertex v of
+// valence n among quads, from the closed-form masks of the subdivision
+// matrix's eigenvectors (Halstead, Kass and DeRose):
+//
+//   position  (n^2 v + 4 sum e_i + sum f_i) / (n (n + 5))
+//   tangentU  sum A_n cos(2 pi i / n) e_i + (cos(2 pi i / n) + cos(2 pi (i + 1) / n)) f_i
+//   tangentV  the same with every angle turned back by 2 pi / n
+//
+// with A_n = 1 + cos(2 pi / n) + cos(pi / n) sqrt(2 (9 + cos(2 pi / n))).
+// edges holds the n neighbours e_i counter-clockwise around the normal,
+// and faces the corners f_i across v in the quad between e_i and e_i+1.
+LimitFrame catmullClarkLimit(const glm::vec3 &v, const glm::vec3* edges, const glm::vec3* faces, size_t n);
+
+#endif // LIMIT_H
@@ -0,0 +1,200 @@
+#include "loop.h"
+#include "parallel.h"
+#include "profiling/memstats.h"
+#include "profiling/trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+namespace {
+
+uint32_t nextCorner(uint32_t k) {
+    return k % 3 == 2 ? k - 2 : k + 1;
+}
+
+uint32_t prevCorner(uint32_t k) {
+    return k % 3 == 0 ? k + 2 : k - 1;
+}
+
+// Loop's weight of every neighbour of an inner vertex of valence n.
+float innerWeight(size_t n) {
+    double w = 3.0 / 8.0 + std::cos(2.0 * 3.14159265358979 / n) / 4.0;
+    return float((5.0 / 8.0 - w * w) / n);
+}
+
+} // namespace
+
+LoopSubdivider::LoopSubdivider(const std::vector<uint32_t> &triangles, size_t vertexCount)
+    : vertexCount(vertexCount)
+{
+    TRACE_SCOPE("LoopSubdivider");
+    MEMORY_SCOPE(TOPOLOGY_MAPS);
+    size_t corners = triangles.size() - triangles.size() % 3;
+    size_t n = vertexCount;
+
+    // Corner k starts the half-edge from its vertex to the next corner's.
+    // Those leaving every vertex, counted and then placed with atomics.
+    std::vector<uint32_t> start(n + 1, 0);
+    std::vector<uint32_t> outgoing(corners);
+    {
+        std::unique_ptr<std::atomic<uint32_t>[]> fill(new std::atomic<uint32_t>[n]());
+        parallelFor(corners, 1 << 16, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                fill[triangles[k]].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        for (size_t v = 0; v < n; v++) {
+            start[v + 1] = start[v] + fill[v].load(std::memory_order_relaxed);
+            fill[v].store(start[v], std::memory_order_relaxed);
+        }
+        parallelFor(corners, 1 << 16, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                outgoing[fill[triangles[k]].fetch_add(1, std::memory_order_relaxed)] = uint32_t(k);
+            }
+        });
+    }
+
+    // The half-edge back along every corner's, the lowest if there are
+    // several. Only pairs that find each other make an inner edge.
+    std::vector<uint32_t> sym(corners);
+    parallelFor(corners, 4096, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            uint32_t from = triangles[k], to = triangles[nextCorner(uint32_t(k))];
+            uint32_t best = NONE;
+            for (uint32_t o = start[to]; o < start[to + 1]; o++) {
+                uint32_t j = outgoing[o];
+                if (triangles[nextCorner(j)] == from && j < best) {
+                    best = j;
+                }
+            }
+            sym[k] = best;
+        }
+    });
+    auto paired = [&sym](uint32_t k) {
+        return sym[k] != NONE && sym[sym[k]] == k;
+    };
+
+    // Every edge belongs to the lower corner of its pair.
+    std::vector<uint32_t> cornerEdge(corners);
+    edges.reserve(corners / 2 + 1);
+    for (size_t k = 0; k < corners; k++) {
+        if (!paired(uint32_t(k)) || k < sym[k]) {
+            cornerEdge[k] = uint32_t(edges.size());
+            edges.push_back({ triangles[k], triangles[nextCorner(uint32_t(k))], triangles[prevCorner(uint32_t(k))],
+                              paired(uint32_t(k)) ? triangles[prevCorner(sym[k])] : NONE });
+        }
+    }
+    parallelFor(corners, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            if (paired(uint32_t(k)) && sym[k] < k) {
+                cornerEdge[k] = cornerEdge[sym[k]];
+            }
+        }
+    });
+
+    // Inner vertices average every neighbour and those on one outline
+    // only the two along it. Any others stay put.
+    std::vector<uint32_t> valence(n, 0), open(n, 0);
+    for (const Edge &e : edges) {
+        valence[e.a]++;
+        valence[e.b]++;
+        if (e.d == NONE) {
+            open[e.a]++;
+            open[e.b]++;
+        }
+    }
+    ringStart.assign(n + 1, 0);
+    selfWeight.resize(n);
+    neighbourWeight.resize(n);
+    for (size_t v = 0; v < n; v++) {
+        uint32_t size = 0;
+        if (open[v] == 0 && valence[v] >= 3) {
+            size = valence[v];
+            neighbourWeight[v] = innerWeight(size);
+            selfWeight[v] = 1.f - size * neighbourWeight[v];
+        } else if (open[v] == 2) {
+            size = 2;
+            neighbourWeight[v] = 1.f / 8.f;
+            selfWeight[v] = 3.f / 4.f;
+        } else {
+            neighbourWeight[v] = 0.f;
+            selfWeight[v] = 1.f;
+        }
+        ringStart[v + 1] = ringStart[v] + size;
+    }
+    // Filled in edge order, so sums come out the same on every run.
+    ring.resize(ringStart[n]);
+    std::vector<uint32_t> fill(ringStart.begin(), ringStart.end() - 1);
+    auto add = [&](uint32_t v, uint32_t neighbour, bool openEdge) {
+        bool wanted = open[v] == 2 ? openEdge : ringStart[v + 1] > ringStart[v];
+        if (wanted) {
+            ring[fill[v]++] = neighbour;
+        }
+    };
+    for (const Edge &e : edges) {
+        add(e.a, e.b, e.d == NONE);
+        add(e.b, e.a, e.d == NONE);
+    }
+
+    // Child i of a triangle keeps corner i and the points of the edges
+    // on either side of it. The middle child joins the three edge points.
+    size_t count = corners / 3;
+    children.resize(12 * count);
+    parallelFor(count, 4096, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++) {
+            uint32_t e[3];
+            for (int i = 0; i < 3; i++) {
+                e[i] = uint32_t(n + cornerEdge[3 * t + i]);
+            }
+            uint32_t* c = &children[12 * t];
+            for (int i = 0; i < 3; i++) {
+                c[3 * i] = triangles[3 * t + i];
+                c[3 * i + 1] = e[i];
+                c[3 * i + 2] = e[(i + 2) % 3];
+                c[9 + i] = e[i];
+            }
+        }
+    });
+}
+
+size_t LoopSubdivider::childVertexCount() const {
+    return vertexCount + edges.size();
+}
+
+const std::vector<uint32_t>& LoopSubdivider::childTriangles() const {
+    return children;
+}
+
+size_t LoopSubdivider::edgeCount() const {
+    return edges.size();
+}
+
+void LoopSubdivider::edgeEnds(size_t i, uint32_t &a, uint32_t &b) const {
+    a = edges[i].a;
+    b = edges[i].b;
+}
+
+void LoopSubdivider::refine(const glm::vec3* in, glm::vec3* out) const {
+    TRACE_SCOPE("LoopSubdivider::refine");
+    parallelFor(vertexCount, 4096, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            glm::vec3 sum(0.f);
+            for (uint32_t r = ringStart[v]; r < ringStart[v + 1]; r++) {
+                sum += in[ring[r]];
+            }
+            out[v] = selfWeight[v] * in[v] + neighbourWeight[v] * sum;
+        }
+    });
+    glm::vec3* edgePoints = out + vertexCount;
+    parallelFor(edges.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const Edge &e = edges[i];
+            if (e.d == NONE) {
+                edgePoints[i] = 0.5f * (in[e.a] + in[e.b]);
+            } else {
+                edgePoints[i] = 0.375f * (in[e.a] + in[e.b]) + 0.125f * (in[e.c] + in[e.d]);
+            }
+        }
+    });
+}
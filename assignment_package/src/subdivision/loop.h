@@ -0,0 +1,61 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include <la.h>
+#include <cstdint>
+#include <vector>
+
+// One step of Loop subdivision on an indexed triangle mesh. Every
+// triangle splits into four through a new point on each edge, and every
+// old vertex moves towards the average of its neighbours, so triangle
+// cages keep their triangles instead of turning into quads.
+//
+// The constructor works out the topology once: the edges with the two
+// vertices across them, the neighbours every vertex point averages with
+// their weights, and the child triangles. refine then only gathers
+// positions through those tables, in parallel and without allocating, so
+// the same tables serve any number of poses of one cage.
+//
+// Open edges and their vertices follow the boundary rules, so outlines
+// stay curves of their own. Vertices on more than two open edges are
+// kept where they are.
+class LoopSubdivider
+{
+private:
+    struct Edge {
+        uint32_t a, b;          // Its ends.
+        uint32_t c, d;          // Across it, d being NONE on open edges.
+    };
+
+    size_t vertexCount;
+    std::vector<Edge> edges;
+    // The neighbours of vertex v are ring[ringStart[v]] up to but
+    // excluding ring[ringStart[v + 1]], each weighted neighbourWeight[v].
+    std::vector<uint32_t> ringStart;
+    std::vector<uint32_t> ring;
+    std::vector<float> selfWeight;
+    std::vector<float> neighbourWeight;
+    std::vector<uint32_t> children;     // Three corners each.
+
+public:
+    static constexpr uint32_t NONE = 0xffffffffu;
+
+    // triangles as from HalfEdgeMesh::flatten, three corners each.
+    LoopSubdivider(const std::vector<uint32_t> &triangles, size_t vertexCount);
+
+    // Vertex points come first, in the order of the old vertices,
+    // then one edge point per edge.
+    size_t childVertexCount() const;
+    // Four per triangle. Child 4t + i of triangle t is the one at its
+    // corner i, and 4t + 3 the one in the middle.
+    const std::vector<uint32_t>& childTriangles() const;
+    size_t edgeCount() const;
+    // The ends of edge i, whose point is child vertex vertexCount + i.
+    void edgeEnds(size_t i, uint32_t &a, uint32_t &b) const;
+
+    // Writes childVertexCount() positions to out from the vertexCount
+    // given to the constructor in in.
+    void refine(const glm::vec3* in, glm::vec3* out) const;
+};
+
+#endif // LOOP_H
@@ -0,0 +1,201 @@
+#include "vertexcache.h"
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace {
+    // Tuning from Forsyth's "Linear-Speed Vertex Cache Optimisation".
+    const int CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRI_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+    const int VALENCE_TABLE_SIZE = 32;
+
+    const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    struct ScoreTable {
+        float cache[CACHE_SIZE];
+        float valence[VALENCE_TABLE_SIZE];
+
+        ScoreTable() {
+            for (int i = 0; i < CACHE_SIZE; i++) {
+                // The three corners of the last triangle score the same so the
+                // next triangle does not depend on the order they went in.
+                cache[i] = i < 3 ? LAST_TRI_SCORE
+                                 : std::pow(1.f - float(i - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+            }
+            valence[0] = 0.f;
+            for (int i = 1; i < VALENCE_TABLE_SIZE; i++) {
+                valence[i] = VALENCE_BOOST_SCALE * std::pow(float(i), -VALENCE_BOOST_POWER);
+            }
+        }
+
+        // Favours vertices in the cache, and vertices with few triangles
+        // left so lone triangles are not stranded for later.
+        float score(int cachePos, uint32_t remaining) const {
+            if (remaining == 0) {
+                return -1.f;
+            }
+            float s = cachePos >= 0 ? cache[cachePos] : 0.f;
+            s += remaining < VALENCE_TABLE_SIZE
+                    ? valence[remaining]
+                    : VALENCE_BOOST_SCALE * std::pow(float(remaining), -VALENCE_BOOST_POWER);
+            return s;
+        }
+    };
+}
+
+float vertexcache::computeACMR(const std::vector<uint32_t> &indices, size_t vertexCount,
+                               int cacheSize) {
+    if (indices.size() < 3) {
+        return 0.f;
+    }
+    // In a FIFO a vertex stays cached until cacheSize further misses,
+    // so stamping each vertex with the miss count is enough.
+    std::vector<size_t> inserted(vertexCount, std::numeric_limits<size_t>::max());
+    size_t misses = 0;
+    for (uint32_t v : indices) {
+        if (inserted[v] == std::numeric_limits<size_t>::max()
+                || misses - inserted[v] >= size_t(cacheSize)) {
+            inserted[v] = misses++;
+        }
+    }
+    return float(misses) / float(indices.size() / 3);
+}
+
+void vertexcache::optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount,
+                                      std::vector<uint32_t>* triangleOrder) {
+    static const ScoreTable table;
+    size_t triCount = indices.size() / 3;
+    if (triCount == 0) {
+        return;
+    }
+
+    // Triangles of each vertex. The first remaining[v] entries of
+    // a vertex's range are the triangles not emitted yet.
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triCount * 3; i++) {
+        offsets[indices[i] + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<uint32_t> adjacency(triCount * 3);
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triCount * 3; i++) {
+        uint32_t v = indices[i];
+        adjacency[offsets[v] + remaining[v]++] = uint32_t(i / 3);
+    }
+
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScore[v] = table.score(-1, remaining[v]);
+    }
+    std::vector<float> triScore(triCount);
+    std::vector<bool> emitted(triCount, false);
+    uint32_t best = 0;
+    for (size_t t = 0; t < triCount; t++) {
+        const uint32_t* tri = &indices[t * 3];
+        triScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+        if (triScore[t] > triScore[best]) {
+            best = uint32_t(t);
+        }
+    }
+
+    std::vector<uint32_t> out;
+    out.reserve(triCount * 3);
+    if (triangleOrder != nullptr) {
+        triangleOrder->clear();
+        triangleOrder->reserve(triCount);
+    }
+    std::vector<uint32_t> cache, nextCache;
+    cache.reserve(CACHE_SIZE + 3);
+    nextCache.reserve(CACHE_SIZE + 3);
+    size_t scan = 0;
+
+    while (out.size() < triCount * 3) {
+        if (best == NONE) {
+            // Nothing in the cache has triangles left, so start
+            // over from the next triangle in the original order.
+            while (emitted[scan]) {
+                scan++;
+            }
+            best = uint32_t(scan);
+        }
+        const uint32_t* tri = &indices[best * 3];
+        emitted[best] = true;
+        if (triangleOrder != nullptr) {
+            triangleOrder->push_back(best);
+        }
+        nextCache.clear();
+        for (int c = 0; c < 3; c++) {
+            uint32_t v = tri[c];
+            out.push_back(v);
+            // Swap the triangle out of the live part of the vertex's range.
+            uint32_t* first = &adjacency[offsets[v]];
+            uint32_t* last = first + --remaining[v];
+            for (uint32_t* a = first; a <= last; a++) {
+                if (*a == best) {
+                    std::swap(*a, *last);
+                    break;
+                }
+            }
+            if (cachePos[v] != -2) {
+                nextCache.push_back(v);
+                cachePos[v] = -2;
+            }
+        }
+        for (uint32_t v : cache) {
+            if (cachePos[v] != -2) {
+                nextCache.push_back(v);
+                cachePos[v] = -2;
+            }
+        }
+
+        // Rescore everything whose cache position moved, pushing the
+        // change on to its live triangles, then pick the best of those.
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            uint32_t v = nextCache[i];
+            cachePos[v] = i < CACHE_SIZE ? int(i) : -1;
+            float score = table.score(cachePos[v], remaining[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+            for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+                triScore[adjacency[a]] += delta;
+            }
+        }
+        best = NONE;
+        float bestScore = -std::numeric_limits<float>::max();
+        for (size_t i = 0; i < nextCache.size() && i < CACHE_SIZE; i++) {
+            uint32_t v = nextCache[i];
+            for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+                uint32_t t = adjacency[a];
+                if (triScore[t] > bestScore) {
+                    bestScore = triScore[t];
+                    best = t;
+                }
+            }
+        }
+        if (nextCache.size() > CACHE_SIZE) {
+            nextCache.resize(CACHE_SIZE);
+        }
+        std::swap(cache, nextCache);
+    }
+    indices.swap(out);
+}
+
+std::vector<uint32_t> vertexcache::optimizeVertexFetch(std::vector<uint32_t> &indices, size_t vertexCount) {
+    std::vector<uint32_t> remap(vertexCount, NONE);
+    std::vector<uint32_t> order;
+    order.reserve(vertexCount);
+    for (uint32_t &i : indices) {
+        if (remap[i] == NONE) {
+            remap[i] = uint32_t(order.size());
+            order.push_back(i);
+        }
+        i = remap[i];
+    }
+    return order;
+}
@@ -0,0 +1,33 @@
+#ifndef VERTEXCACHE_H
+#define VERTEXCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Orders triangle lists for the post-transform vertex cache, so the
+// vertex shader runs about once per vertex instead of once per corner.
+namespace vertexcache {
+    // Entries of the FIFO cache computeACMR models, a conservative
+    // stand-in for the cache of current hardware.
+    const int FIFO_SIZE = 16;
+
+    // Average cache miss ratio: vertex shader runs per triangle.
+    // 3 means no reuse at all; closed meshes approach 0.5.
+    float computeACMR(const std::vector<uint32_t> &indices, size_t vertexCount,
+                      int cacheSize = FIFO_SIZE);
+
+    // Reorders the triangles of indices in place with Forsyth's linear-speed
+    // heuristic, scoring vertices against a simulated 32 entry LRU cache.
+    // Triangles keep their corner order, so the provoking vertex survives.
+    // triangleOrder, if given, receives the old index of each new triangle.
+    void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount,
+                             std::vector<uint32_t>* triangleOrder = nullptr);
+
+    // Renumbers vertices in the order indices first use them, so vertex
+    // fetches walk the buffers front to back. Returns the old index of
+    // each new vertex; vertices indices never use are dropped.
+    std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t> &indices, size_t vertexCount);
+}
+
+#endif // VERTEXCACHE_H